@@ -0,0 +1,222 @@
+//----------------------------------------------------------------------
+// FILE: compile_bench.cpp
+// DATE: Spring 2023
+// AUTH: Nisa Meshal
+// DESC: Front end benchmark (parse, flatten, check, fold, and code
+//       generation time, heap allocations, and peak memory on large
+//       synthetic programs)
+//----------------------------------------------------------------------
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <string>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "ast_parser.h"
+#include "code_generator.h"
+#include "constant_folder.h"
+#include "flat_ast.h"
+#include "lexer.h"
+#include "semantic_checker.h"
+#include "source_buffer.h"
+#include "vm.h"
+
+using namespace std;
+
+
+// heap allocations (counted by the replaced operator new)
+static size_t allocations = 0;
+static size_t allocated_bytes = 0;
+
+void* operator new(size_t size)
+{
+  ++allocations;
+  allocated_bytes += size;
+  if (void* p = malloc(size ? size : 1))
+    return p;
+  throw bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+  free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+  free(p);
+}
+
+
+// one function of the synthetic program, calling the one before it
+string helper(int i)
+{
+  string n = to_string(i);
+  string prev = to_string(i - 1);
+  return "int helper_" + n + "(int n, Node node) {\n"
+    "  # sum up the counts, with a few branches\n"
+    "  int total = 0\n"
+    "  for (int j = 0; j < n; j = j + 1) {\n"
+    "    if (((j / 2) * 2) == j) {\n"
+    "      total = total + (j * 3) + node.val\n"
+    "    }\n"
+    "    elseif ((j > 10) and not (j == 12)) {\n"
+    "      total = total - (1 + 2 * 3)\n"
+    "    }\n"
+    "    else {\n"
+    "      node.counts[j] = total\n"
+    "    }\n"
+    "  }\n"
+    "  while (total > 1000) {\n"
+    "    total = total / 2\n"
+    "  }\n"
+    "  string s = concat(\"total \", to_string(total))\n"
+    "  double d = to_double(total) * 0.5\n"
+    "  return total + helper_" + prev + "(n - 1, node)\n"
+    "}\n\n";
+}
+
+
+// a program of the given number of functions
+string program(int functions)
+{
+  string text = "struct Node {\n  int val,\n  Node next,\n"
+    "  array int counts\n}\n\n"
+    "int helper_0(int n, Node node) {\n  return n\n}\n\n";
+  for (int i = 1; i <= functions; ++i)
+    text += helper(i);
+  text += "void main() {\n  Node node = new Node\n"
+    "  node.counts = new int[100]\n"
+    "  print(helper_" + to_string(functions) + "(20, node))\n}\n";
+  return text;
+}
+
+
+// the peak resident set size so far (in MB)
+double peak_rss()
+{
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss / 1024.0;
+}
+
+
+// time a front end phase, printing its time, heap allocations, and the
+// peak memory so far
+template<typename F>
+void measure(const string& label, F f)
+{
+  size_t start_allocations = allocations;
+  size_t start_bytes = allocated_bytes;
+  auto start = chrono::steady_clock::now();
+  f();
+  auto stop = chrono::steady_clock::now();
+  cout << "  " << left << setw(10) << label << right << fixed
+       << setprecision(3) << setw(8)
+       << chrono::duration<double>(stop - start).count() << " s  "
+       << setw(10) << (allocations - start_allocations) << " allocations  "
+       << setprecision(1) << setw(8)
+       << ((allocated_bytes - start_bytes) / 1e6) << " MB  "
+       << setw(7) << peak_rss() << " MB peak" << endl;
+}
+
+
+// the compile as the mypl driver does it: the program is encoded once
+// (and its tree freed), and each pass walks that encoding
+void flat_compile(const SourceBuffer& source)
+{
+  FlatAST flat;
+  {
+    Program p;
+    measure("parse", [&]() {p = ASTParser(Lexer(source)).parse();});
+    measure("flatten", [&]() {flat = FlatAST(p, false);});
+  }
+  cout << "  flat      " << flat.stmts.size() << " stmts, "
+       << flat.exprs.size() << " exprs, " << flat.names.size() << " names"
+       << endl;
+  measure("check", [&]() {
+    SemanticChecker checker;
+    checker.check(flat);
+  });
+  measure("fold", [&]() {
+    ConstantFolder folder;
+    folder.fold(flat);
+  });
+  measure("codegen", [&]() {
+    VM vm;
+    CodeGenerator generator(vm, 2);
+    generator.generate(flat);
+  });
+}
+
+
+// the compile through the tree visitor interface (each pass visits the
+// tree, so here each encodes it again)
+void tree_compile(const SourceBuffer& source)
+{
+  Program p;
+  measure("parse", [&]() {p = ASTParser(Lexer(source)).parse();});
+  cout << "  arena     " << p.arena->block_count() << " blocks, "
+       << setprecision(1) << (p.arena->reserved() / 1e6) << " MB" << endl;
+  measure("check", [&]() {
+    SemanticChecker checker;
+    p.accept(checker);
+  });
+  measure("fold", [&]() {
+    ConstantFolder folder;
+    p.accept(folder);
+  });
+  measure("codegen", [&]() {
+    VM vm;
+    CodeGenerator generator(vm, 2);
+    p.accept(generator);
+  });
+}
+
+
+// run a compile in its own process, so that its peak memory is its own
+template<typename F>
+void run(const string& label, const SourceBuffer& source, F compile)
+{
+  cout << label << endl;
+  if (fork() == 0) {
+    double base_rss = peak_rss();
+    auto start = chrono::steady_clock::now();
+    compile(source);
+    auto stop = chrono::steady_clock::now();
+    cout << "  total     " << setprecision(3) << setw(8)
+         << chrono::duration<double>(stop - start).count() << " s" << endl;
+    cout << "  peak rss  " << setprecision(1) << setw(8) << peak_rss()
+         << " MB (" << (peak_rss() - base_rss) << " MB for the compile)"
+         << endl;
+    exit(0);
+  }
+  wait(nullptr);
+}
+
+
+// usage: compile_bench [functions]
+//
+// Compiles (parse, check, fold, and generate code at opt level 2) a
+// synthetic program of the given number of functions both ways. For
+// reference, the tree passes this replaced (in the commit before the
+// flat encoding), timed in the same session as the flat compile's
+// 1.96 to 2.39 s, took 2.33 to 2.75 s on the default 20000 functions
+// (parse 0.57 to 0.95 s, check 0.18 to 0.35 s, fold 0.20 to 0.38 s,
+// and codegen 0.72 to 1.25 s), with a peak rss of 599 MB.
+int main(int argc, char* argv[])
+{
+  int functions = argc > 1 ? stoi(argv[1]) : 20000;
+  SourceBuffer source = SourceBuffer::from_string(program(functions));
+  cout << functions << " functions, " << count(source.text().begin(),
+                                               source.text().end(), '\n')
+       << " lines (" << setprecision(1) << fixed
+       << (source.text().size() / 1e6) << " MB)" << endl;
+  cout.flush();
+  run("flat (encoded once)", source, flat_compile);
+  run("tree (each pass visits the tree)", source, tree_compile);
+}
@@ -0,0 +1,229 @@
+//----------------------------------------------------------------------
+// FILE: lexer_bench.cpp
+// DATE: Spring 2023
+// AUTH: Nisa Meshal
+// DESC: Lexer throughput benchmark (MB of source per second on large
+//       synthetic programs, from a stream and from a source buffer with
+//       each scanner instruction set, and as printed by --lex mode)
+//----------------------------------------------------------------------
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "keywords.h"
+#include "lexer.h"
+#include "lexer_scan.h"
+#include "source_buffer.h"
+
+using namespace std;
+
+
+// the size of each synthetic input
+const size_t INPUT_BYTES = 16 << 20;
+
+// timed passes over each input (the fastest is reported)
+const int REPS = 3;
+
+
+struct Input {
+  string name;
+  string text;
+};
+
+
+// helper to repeat a numbered chunk of source up to the input size
+template<typename Chunk>
+string repeat(Chunk chunk)
+{
+  string text = "";
+  for (int i = 0; text.size() < INPUT_BYTES; ++i)
+    text += chunk(to_string(i));
+  return text;
+}
+
+
+// ordinary code in the style of examples/sudoku.mypl
+string code_input()
+{
+  return repeat([](const string& n) {
+    return "# checks row " + n + " of the grid\n"
+      "bool check_row_" + n + "(array int grid, int row) {\n"
+      "  for (int col = 0; col < 9; col = col + 1) {\n"
+      "    if (grid[row][col] == " + n + ") {\n"
+      "      print(\"duplicate in row \" + to_string(row) + \"\\n\")\n"
+      "      return false\n"
+      "    }\n"
+      "  }\n"
+      "  double ratio = 3.14159 * " + n + ".5\n"
+      "  return true\n"
+      "}\n\n";
+  });
+}
+
+
+// long comments between short statements
+string comment_input()
+{
+  return repeat([](const string& n) {
+    return "# " + string(100, '=') + "\n"
+      "# this function is documented at some length, as its comment\n"
+      "# block is much longer than its body, which only counts to " + n +
+      "\n# " + string(100, '=') + "\n"
+      "int count_" + n + "() { return " + n + " }\n";
+  });
+}
+
+
+// long string literals and identifiers
+string string_input()
+{
+  return repeat([](const string& n) {
+    return "  string message_for_the_longer_identifier_case_" + n +
+      " = \"a string literal long enough to span several vectors of "
+      "characters, as error messages and prompts often do " + n + "\"\n";
+  });
+}
+
+
+// mostly reserved words, type names, and short identifiers
+string identifier_input()
+{
+  return repeat([](const string& n) {
+    return "struct node_" + n + " { int val, double weight, bool seen, "
+      "string name, char tag, array node_" + n + " next }\n"
+      "void visit_" + n + " (node_" + n + " n, bool deep) {\n"
+      "  while not n.seen and deep or false { n = n.next }\n"
+      "  for int i = i; i; i = i { if i { return null } elseif n { x } "
+      "else { y } }\n"
+      "  if true and not null or deep { n = new node_" + n + " }\n"
+      "  return n\n"
+      "}\n";
+  });
+}
+
+
+// run the lexer over the input, returning its token count (and adding
+// the --lex mode output size to printed, if given)
+int lex(Lexer& lexer, size_t* printed = nullptr)
+{
+  int tokens = 0;
+  Token t = lexer.next_token();
+  while (t.type() != TokenType::EOS) {
+    ++tokens;
+    if (printed)
+      *printed += to_string(t).size() + 1;
+    t = lexer.next_token();
+  }
+  return tokens;
+}
+
+
+// time the fastest of REPS passes of f over the input, printing the
+// throughput and the token count
+template<typename F>
+void measure(const string& label, const Input& input, F f)
+{
+  double best = 0;
+  int tokens = 0;
+  for (int i = 0; i < REPS; ++i) {
+    auto start = chrono::steady_clock::now();
+    tokens = f();
+    auto stop = chrono::steady_clock::now();
+    double seconds = chrono::duration<double>(stop - start).count();
+    if (i == 0 or seconds < best)
+      best = seconds;
+  }
+  cout << "  " << left << setw(16) << label << right
+       << setw(10) << tokens << " tokens  "
+       << fixed << setprecision(3) << setw(7) << best << " s  "
+       << setprecision(1) << setw(7) << (input.text.size() / best / 1e6)
+       << " MB/s" << endl;
+}
+
+
+// the reserved word lookup the perfect hash replaced: comparing the
+// word against each reserved word in turn
+TokenType linear_keyword_type(string_view word)
+{
+  for (const Keyword& keyword : KEYWORDS)
+    if (keyword.word == word)
+      return keyword.type;
+  return TokenType::ID;
+}
+
+
+// time the fastest of REPS lookups of each of the words, printing the
+// time per word
+template<typename F>
+void measure_lookup(const string& label, const vector<string_view>& words,
+                    F lookup)
+{
+  double best = 0;
+  int checksum = 0;
+  for (int i = 0; i < REPS; ++i) {
+    auto start = chrono::steady_clock::now();
+    for (string_view word : words)
+      checksum += int(lookup(word));
+    auto stop = chrono::steady_clock::now();
+    double seconds = chrono::duration<double>(stop - start).count();
+    if (i == 0 or seconds < best)
+      best = seconds;
+  }
+  cout << "  " << left << setw(16) << label << right
+       << setw(10) << words.size() << " words   "
+       << fixed << setprecision(3) << setw(7) << best << " s  "
+       << setprecision(2) << setw(7) << (best / words.size() * 1e9)
+       << " ns/word  (" << checksum << ")" << endl;
+}
+
+
+int main(int argc, char* argv[])
+{
+  vector<Input> inputs = {
+    {"code", code_input()},
+    {"comments", comment_input()},
+    {"strings", string_input()},
+    {"identifiers", identifier_input()}
+  };
+  string best_isa = scan_isa();
+  cout << "scanner: " << best_isa << endl;
+  for (const Input& input : inputs) {
+    cout << input.name << " (" << setprecision(1) << fixed
+         << (input.text.size() / 1e6) << " MB)" << endl;
+    measure("stream", input, [&]() {
+      stringstream in(input.text);
+      Lexer lexer(in);
+      return lex(lexer);
+    });
+    SourceBuffer buffer = SourceBuffer::from_string(input.text);
+    for (string isa : {"scalar", "sse2", "avx2"}) {
+      if (!set_scan_isa(isa))
+        continue;
+      measure("buffer " + isa, input, [&]() {
+        Lexer lexer(buffer);
+        return lex(lexer);
+      });
+    }
+    set_scan_isa(best_isa);
+    // as printed by --lex (the output is formatted but not written)
+    measure("--lex", input, [&]() {
+      Lexer lexer(buffer);
+      size_t printed = 0;
+      return lex(lexer, &printed);
+    });
+  }
+  // the reserved words and identifiers of the identifier input
+  SourceBuffer buffer = SourceBuffer::from_string(inputs.back().text);
+  Lexer lexer(buffer);
+  vector<string_view> words;
+  for (Token t = lexer.next_token(); t.type() != TokenType::EOS;
+       t = lexer.next_token())
+    if (isalpha(t.lexeme_view()[0]))
+      words.push_back(t.lexeme_view());
+  cout << "reserved word lookup" << endl;
+  measure_lookup("linear", words, linear_keyword_type);
+  measure_lookup("perfect hash", words, keyword_type);
+}
@@ -0,0 +1,246 @@
+//----------------------------------------------------------------------
+// FILE: vm_bench.cpp
+// DATE: Spring 2023
+// AUTH: Nisa Meshal
+// DESC: VM dispatch microbenchmark (instructions per second on loop
+//       heavy MyPL programs, on the stack and register vms and the jit,
+//       and the cost of profiling)
+//----------------------------------------------------------------------
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "ast_parser.h"
+#include "code_generator.h"
+#include "constant_folder.h"
+#include "lexer.h"
+#include "reg_code_generator.h"
+#include "semantic_checker.h"
+#include "vm.h"
+
+using namespace std;
+
+
+struct Benchmark {
+  string name;
+  string source;
+};
+
+
+// nested 9x9 grid loops in the style of examples/sudoku.mypl
+const string GRID_LOOPS = R"(
+int compare_vals(array int a, array int ans) {
+  int errors = 0
+  for (int row = 0; row < 9; row = row + 1) {
+    for (int col = 0; col < 9; col = col + 1) {
+      if (a[row][col] != ans[row][col]) {
+        errors = errors + 1
+      }
+    }
+  }
+  return errors
+}
+
+void main() {
+  array int player = new int [9][9]
+  array int answer = new int [9][9]
+  for (int row = 0; row < 9; row = row + 1) {
+    for (int col = 0; col < 9; col = col + 1) {
+      player[row][col] = row
+      answer[row][col] = col
+    }
+  }
+  int total = 0
+  for (int i = 0; i < 2000; i = i + 1) {
+    total = total + compare_vals(player, answer)
+  }
+}
+)";
+
+
+// tight counting loop (mostly LOAD/PUSH/ADD/STORE/compare/jump)
+const string COUNT_LOOP = R"(
+void main() {
+  int sum = 0
+  int i = 0
+  while (i < 500000) {
+    if ((i == 3) or (i == 6)) {
+      sum = sum + 2
+    }
+    else {
+      sum = sum + 1
+    }
+    i = i + 1
+  }
+}
+)";
+
+
+// integer and double arithmetic (mostly typed operations once checked)
+const string ARITH_LOOP = R"(
+void main() {
+  int x = 1
+  double d = 1.0
+  for (int i = 0; i < 200000; i = i + 1) {
+    x = (((x * 31) + i) / 7) - (i * 3)
+    d = ((d * 0.5) + 1.25) - (d / 4.0)
+    if ((x > 1000000) or (x < (0 - 1000000))) {
+      x = x / 2
+    }
+  }
+}
+)";
+
+
+// call heavy recursion (one CALL/RET pair per 10 or so instructions)
+const string FIB = R"(
+int fib(int n) {
+  if (n < 2) {
+    return n
+  }
+  return fib(n - 1) + fib(n - 2)
+}
+
+void main() {
+  int f = fib(25)
+}
+)";
+
+
+// allocation heavy loop (mostly short lived arrays and list nodes)
+const string ALLOC_LOOP = R"(
+struct Node {
+  int val,
+  Node next
+}
+
+void main() {
+  for (int i = 0; i < 2000; i = i + 1) {
+    Node head = null
+    for (int j = 0; j < 50; j = j + 1) {
+      Node n = new Node
+      n.val = j
+      n.next = head
+      head = n
+      array int xs = new int[16]
+    }
+  }
+}
+)";
+
+
+// parse and check the program (folding constants at opt level 1 or more)
+Program parse(const string& source, int opt_level)
+{
+  stringstream in(source);
+  Program p = ASTParser(Lexer(in)).parse();
+  SemanticChecker checker;
+  p.accept(checker);
+  if (opt_level > 0) {
+    ConstantFolder folder;
+    p.accept(folder);
+  }
+  return p;
+}
+
+
+// build a VM for the given program (parse, check, fold, generate)
+VM compile(const string& source, int opt_level, bool jit = false,
+           bool profile = false)
+{
+  Program p = parse(source, opt_level);
+  VM vm;
+  vm.set_jit(jit);
+  vm.set_profiling(profile);
+  CodeGenerator generator(vm, opt_level);
+  p.accept(generator);
+  return vm;
+}
+
+
+// build a register VM for the given program
+RegVM compile_reg(const string& source, int opt_level)
+{
+  Program p = parse(source, opt_level);
+  RegVM vm;
+  RegCodeGenerator generator(vm);
+  p.accept(generator);
+  return vm;
+}
+
+
+// run reps fresh copies of the vm, printing the instructions executed
+// and their rate (and gc statistics of the last run), returning the
+// total run time in seconds
+template<typename Machine>
+double measure(const string& label, const Machine& base, int reps)
+{
+  uint64_t instructions = 0;
+  double seconds = 0;
+  VMGCStats gc;
+  for (int i = 0; i < reps; ++i) {
+    Machine vm = base;
+    auto start = chrono::steady_clock::now();
+    vm.run();
+    auto stop = chrono::steady_clock::now();
+    seconds += chrono::duration<double>(stop - start).count();
+    instructions += vm.instructions_retired();
+    gc = vm.gc_stats();
+  }
+  cout << left << setw(12) << label << right
+       << setw(14) << instructions << " instrs  "
+       << fixed << setprecision(3) << setw(8) << seconds << " s  "
+       << setprecision(1) << setw(8) << (instructions / seconds / 1e6)
+       << " M instrs/s" << endl;
+  if (gc.collections > 0)
+    cout << "  gc (last run): " << gc.collections << " collections  "
+         << setprecision(1) << (gc.bytes_freed / 1e6) << " MB freed  "
+         << setprecision(3) << gc.max_pause << " ms max pause" << endl;
+  return seconds;
+}
+
+
+// usage: vm_bench [reps] [opt level]
+//
+// Each benchmark runs on the stack vm, on the stack vm with profiling
+// on, on the register vm, and on the stack vm with the jit on (whose
+// instruction count only includes the instructions left to the
+// interpreter)
+int main(int argc, char* argv[])
+{
+  const int REPS = argc > 1 ? stoi(argv[1]) : 5;
+  const int OPT_LEVEL = argc > 2 ? stoi(argv[2]) : 0;
+  vector<Benchmark> benchmarks = {
+    {"grid_loops", GRID_LOOPS},
+    {"count_loop", COUNT_LOOP},
+    {"arith_loop", ARITH_LOOP},
+    {"fib", FIB},
+    {"alloc_loop", ALLOC_LOOP}
+  };
+#ifdef MYPL_SWITCH_DISPATCH
+  cout << "dispatch: switch" << endl;
+#else
+  cout << "dispatch: threaded" << endl;
+#endif
+  cout << "opt level: " << OPT_LEVEL << endl;
+  for (const Benchmark& b : benchmarks) {
+    double stack_seconds = measure(b.name, compile(b.source, OPT_LEVEL), REPS);
+    double profiled_seconds =
+      measure("  profiled", compile(b.source, OPT_LEVEL, false, true), REPS);
+    cout << "  profiling overhead: " << setprecision(1)
+         << (100 * (profiled_seconds / stack_seconds - 1)) << "%" << endl;
+    double reg_seconds = measure("  register", compile_reg(b.source, OPT_LEVEL),
+                                 REPS);
+    cout << "  register vm speedup: " << setprecision(2)
+         << (stack_seconds / reg_seconds) << "x" << endl;
+    if (!native_supported())
+      continue;
+    double jit_seconds = measure("  jit", compile(b.source, OPT_LEVEL, true),
+                                 REPS);
+    cout << "  jit speedup: " << setprecision(2)
+         << (stack_seconds / jit_seconds) << "x" << endl;
+  }
+}
@@ -8,9 +8,11 @@
 #ifndef AST_H
 #define AST_H
 
+#include <cstdint>
 #include <vector>
 #include <memory>
 #include <optional>
+#include "ast_arena.h"
 #include "token.h"
 
 
@@ -98,11 +100,16 @@ public:
 //----------------------------------------------------------------------
 
 
+// Statement, expression, term, and rvalue nodes, and the lists of
+// child nodes, are allocated in the program's arena and referred to by
+// plain pointers and lists (copies of a program share its nodes, as
+// they share the arena)
 class Program : public ASTNode
 {
 public:
   std::vector<StructDef> struct_defs;
   std::vector<FunDef> fun_defs;
+  std::shared_ptr<ASTArena> arena = std::make_shared<ASTArena>();
   void accept(Visitor& v) {v.visit(*this);}
 };
 
@@ -139,7 +146,7 @@ public:
   DataType return_type;
   Token fun_name;
   std::vector<VarDef> params;
-  std::vector<std::shared_ptr<Stmt>> stmts;
+  ASTList<Stmt*> stmts;
   void accept(Visitor& v) {v.visit(*this);}  
 };
 
@@ -149,13 +156,19 @@ public:
 //----------------------------------------------------------------------
 
 
+// the type of both operands of a binary operator, set by the semantic
+// checker when they have the same (non-array) type (NONE otherwise)
+enum class OpType : uint8_t {NONE, INT, DOUBLE, BOOL, CHAR, STRING, STRUCT};
+
+
 class Expr : public ASTNode
 {
 public:
   bool negated = false;
-  std::shared_ptr<ExprTerm> first = nullptr;
-  std::optional<Token> op = std::nullopt;
-  std::shared_ptr<Expr> rest = nullptr;
+  OpType op_type = OpType::NONE;
+  ExprTerm* first = nullptr;
+  Token* op = nullptr;
+  Expr* rest = nullptr;
   void accept(Visitor& v) {v.visit(*this);}  
   Token first_token() {return first->first_token();}
 };
@@ -164,7 +177,7 @@ public:
 class SimpleTerm : public ExprTerm
 {
 public:
-  std::shared_ptr<RValue> rvalue = nullptr;
+  RValue* rvalue = nullptr;
   void accept(Visitor& v) {v.visit(*this);}
   Token first_token() {return rvalue->first_token();}
 };
@@ -211,7 +224,7 @@ public:
 class VarRValue : public RValue
 {
 public:
-  std::vector<VarRef> path;
+  ASTList<VarRef> path;
   void accept(Visitor& v) {v.visit(*this);}        
   Token first_token() {return path[0].var_name;}
 };
@@ -234,7 +247,7 @@ class WhileStmt : public Stmt
 {
 public:
   Expr condition;
-  std::vector<std::shared_ptr<Stmt>> stmts;
+  ASTList<Stmt*> stmts;
   void accept(Visitor& v) {v.visit(*this);}  
 };
 
@@ -251,7 +264,7 @@ public:
 class AssignStmt : public Stmt
 {
 public:
-  std::vector<VarRef> lvalue;
+  ASTList<VarRef> lvalue;
   Expr expr;
   void accept(Visitor& v) {v.visit(*this);}  
 };
@@ -263,7 +276,7 @@ public:
   VarDeclStmt var_decl;
   Expr condition;
   AssignStmt assign_stmt;
-  std::vector<std::shared_ptr<Stmt>> stmts;
+  ASTList<Stmt*> stmts;
   void accept(Visitor& v) {v.visit(*this);}  
 };
 
@@ -272,7 +285,7 @@ class BasicIf
 {
 public:
   Expr condition;
-  std::vector<std::shared_ptr<Stmt>> stmts;
+  ASTList<Stmt*> stmts;
 };
 
 
@@ -280,8 +293,8 @@ class IfStmt : public Stmt
 {
 public:
   BasicIf if_part;
-  std::vector<BasicIf> else_ifs;
-  std::vector<std::shared_ptr<Stmt>> else_stmts;
+  ASTList<BasicIf> else_ifs;
+  ASTList<Stmt*> else_stmts;
   void accept(Visitor& v) {v.visit(*this);}  
 };
 
@@ -290,7 +303,7 @@ class CallExpr : public Stmt, public RValue
 {
 public:
   Token fun_name;
-  std::vector<Expr> args;
+  ASTList<Expr> args;
   void accept(Visitor& v) {v.visit(*this);}  
   Token first_token() {return fun_name;}
 };
@@ -0,0 +1,54 @@
+//----------------------------------------------------------------------
+// FILE: ast_arena.cpp
+// DATE: Spring 2023
+// AUTH: Nisa Meshal
+// DESC: AST arena implementation
+//----------------------------------------------------------------------
+
+#include <algorithm>
+#include <cstdint>
+#include "ast_arena.h"
+
+using namespace std;
+
+
+ASTArena::~ASTArena()
+{
+  for (Destructor* d = destructors; d; d = d->next)
+    d->destroy(d->objects, d->count);
+}
+
+
+size_t ASTArena::block_count() const
+{
+  return blocks.size();
+}
+
+
+size_t ASTArena::reserved() const
+{
+  return reserved_bytes;
+}
+
+
+void* ASTArena::allocate(size_t size, size_t align)
+{
+  uintptr_t address = (reinterpret_cast<uintptr_t>(next) + align - 1) &
+    ~uintptr_t(align - 1);
+  char* start = reinterpret_cast<char*>(address);
+  if (!next or start + size > end) {
+    size_t block_size = blocks.empty() ? FIRST_BLOCK :
+      min(2 * (end - blocks.back().get()), ptrdiff_t(MAX_BLOCK));
+    // oversized requests get a block of their own
+    block_size = max(block_size, size + align);
+    blocks.emplace_back(new char[block_size]);
+    reserved_bytes += block_size;
+    next = blocks.back().get();
+    end = next + block_size;
+    address = (reinterpret_cast<uintptr_t>(next) + align - 1) &
+      ~uintptr_t(align - 1);
+    start = reinterpret_cast<char*>(address);
+  }
+  next = start + size;
+  return start;
+}
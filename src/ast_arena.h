@@ -0,0 +1,130 @@
+//----------------------------------------------------------------------
+// FILE: ast_arena.h
+// DATE: Spring 2023
+// AUTH: Nisa Meshal
+// DESC: Bump allocator owning the nodes of a parsed program
+//----------------------------------------------------------------------
+
+#ifndef AST_ARENA_H
+#define AST_ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+// A list of nodes (or node pointers) stored contiguously in an arena,
+// made all at once (see ASTArena::make_list). A list is a view, so
+// copies of a list (like copies of a node pointer) share its elements.
+template<typename T>
+class ASTList
+{
+public:
+
+  ASTList() = default;
+  ASTList(T* items, size_t count) : items(items), count(count) {}
+
+  T* begin() const {return items;}
+  T* end() const {return items + count;}
+  size_t size() const {return count;}
+  bool empty() const {return count == 0;}
+  T& operator[](size_t i) const {return items[i];}
+  T& front() const {return items[0];}
+  T& back() const {return items[count - 1];}
+
+private:
+
+  T* items = nullptr;
+  size_t count = 0;
+
+};
+
+
+// Allocates AST nodes from large blocks, handing out plain pointers
+// that stay valid (the nodes never move) until the arena is destroyed,
+// which destroys the nodes (newest first) and frees the blocks at once.
+class ASTArena
+{
+public:
+
+  ASTArena() = default;
+  ASTArena(const ASTArena&) = delete;
+  ASTArena& operator=(const ASTArena&) = delete;
+  ~ASTArena();
+
+  // construct a node in the arena
+  template<typename T, typename... Args>
+  T* make(Args&&... args)
+  {
+    void* memory = allocate(sizeof(T), alignof(T));
+    T* node = new (memory) T(std::forward<Args>(args)...);
+    add_destructor(node, 1);
+    return node;
+  }
+
+  // move items[from..] into a list in the arena (removing them from
+  // items, so a parser can build nested lists on one stack)
+  template<typename T>
+  ASTList<T> make_list(std::vector<T>& items, size_t from = 0)
+  {
+    size_t count = items.size() - from;
+    if (count == 0)
+      return {};
+    T* list = static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+    for (size_t i = 0; i < count; ++i)
+      new (list + i) T(std::move(items[from + i]));
+    items.erase(items.begin() + from, items.end());
+    add_destructor(list, count);
+    return {list, count};
+  }
+
+  // the number of blocks and the bytes reserved for them
+  size_t block_count() const;
+  size_t reserved() const;
+
+private:
+
+  // the first block's size (later blocks double, up to the maximum)
+  static const size_t FIRST_BLOCK = 16 * 1024;
+  static const size_t MAX_BLOCK = 1024 * 1024;
+
+  // get (suitably aligned) memory, starting a new block if needed
+  void* allocate(size_t size, size_t align);
+
+  // record count objects (made in the arena) to destroy with it
+  template<typename T>
+  void add_destructor(T* objects, size_t count)
+  {
+    if constexpr (!std::is_trivially_destructible_v<T>) {
+      void* record = allocate(sizeof(Destructor), alignof(Destructor));
+      destructors = new (record) Destructor {
+        [](void* objects, size_t count) {
+          for (size_t i = count; i > 0; --i)
+            static_cast<T*>(objects)[i - 1].~T();
+        },
+        objects, count, destructors
+      };
+    }
+  }
+
+  std::vector<std::unique_ptr<char[]>> blocks;
+  size_t reserved_bytes = 0;
+  char* next = nullptr;
+  char* end = nullptr;
+
+  // the nodes (and lists of them) needing destruction, newest first
+  struct Destructor {
+    void (*destroy)(void*, size_t);
+    void* objects;
+    size_t count;
+    Destructor* next;
+  };
+  Destructor* destructors = nullptr;
+
+};
+
+
+#endif
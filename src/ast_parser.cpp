@@ -21,7 +21,7 @@ void ASTParser::advance()
 }
 
 
-void ASTParser::eat(TokenType t, const string& msg)
+void ASTParser::eat(TokenType t, const char* msg)
 {
   if (!match(t))
     error(msg);
@@ -64,6 +64,7 @@ bool ASTParser::bin_op()
 Program ASTParser::parse()
 {
   Program p;
+  arena = p.arena.get();
   advance();
   while (!match(TokenType::EOS)) {
     if (match(TokenType::STRUCT))
@@ -95,7 +96,7 @@ void ASTParser::struct_def(Program& p){
     eat(TokenType::RBRACE, "expecting '}' in struct fields");
   }
 
-  p.struct_defs.push_back(sd); //push the struct into program structs
+  p.struct_defs.push_back(std::move(sd)); //push the struct into program structs
 }
 
 //----( <data_type> | VOID_TYPE ) ID LPAREN <params> RPAREN LBRACE ( <stmt> )∗ RBRACE----
@@ -124,12 +125,10 @@ void ASTParser::fun_def(Program& p){
 
   //function body
   eat(TokenType::LBRACE, "expecting '{' in fun_def");
-  while(!match(TokenType::RBRACE)) {
-    stmt(fd.stmts);
-  }
+  fd.stmts = stmts();
   eat(TokenType::RBRACE, "expecting '}' in fun def");
 
-  p.fun_defs.push_back(fd);
+  p.fun_defs.push_back(std::move(fd));
 }
 
 //---- <data_type> ID ( COMMA <data_type> ID )∗ | ϵ ----
@@ -141,7 +140,7 @@ void ASTParser::fields(StructDef& s) {
   vd.var_name = curr_token; 
   eat(TokenType::ID, "expecting id in fields"); 
 
-  s.fields.push_back(vd);
+  s.fields.push_back(std::move(vd));
 
   if(match(TokenType::COMMA)) {
     while(match(TokenType::COMMA)) {
@@ -152,7 +151,7 @@ void ASTParser::fields(StructDef& s) {
       new_var_def.var_name = curr_token;
       eat(TokenType::ID, "expecting id in fields recursion");
 
-      s.fields.push_back(new_var_def);
+      s.fields.push_back(std::move(new_var_def));
     }
   }
 }
@@ -168,7 +167,7 @@ void ASTParser::params(FunDef& f)
     vd.var_name = curr_token; 
     eat(TokenType::ID, "expecting id in params");
 
-    f.params.push_back(vd);
+    f.params.push_back(std::move(vd));
 
     if(match(TokenType::COMMA)) {
       advance(); 
@@ -218,9 +217,9 @@ bool ASTParser::base_type()
 // Statement-related functions
 //----------------------------------------------------------------------
 
-//accepts a vector of shared pointers since this is used in a few different cases
+//accepts a vector of statement pointers since this is used in a few different cases
 //----<vdecl_stmt> | <assign_stmt> | <if_stmt> | <while_stmt> | <for_stmt> | <call_expr> | <ret_stmt>
-void ASTParser::stmt(std::vector<std::shared_ptr<Stmt>>& s){
+void ASTParser::stmt(std::vector<Stmt*>& s){
 
   if(match(TokenType::ID)) {
 
@@ -228,13 +227,13 @@ void ASTParser::stmt(std::vector<std::shared_ptr<Stmt>>& s){
     advance(); //curr_token should now equal ( or [
 
     if(match(TokenType::LPAREN)) { //call expression
-      std::shared_ptr<CallExpr> ce = make_shared<CallExpr>(call_expr(id));
+      CallExpr* ce = arena->make<CallExpr>(call_expr(id));
       s.push_back(ce);
     }
     else if (match(TokenType::ID)) { //vdecl statement
       //my_struct x2 = null
       
-      std::shared_ptr<VarDeclStmt> vdec = make_shared<VarDeclStmt>(vdecl_stmt(id)); 
+      VarDeclStmt* vdec = arena->make<VarDeclStmt>(vdecl_stmt(id)); 
       s.push_back(vdec); 
 
     }
@@ -244,7 +243,7 @@ void ASTParser::stmt(std::vector<std::shared_ptr<Stmt>>& s){
       lvalue(new_assign.lvalue, id); 
       assign_stmt(new_assign);
 
-      std::shared_ptr<AssignStmt> as = make_shared<AssignStmt>(new_assign); 
+      AssignStmt* as = arena->make<AssignStmt>(std::move(new_assign)); 
 
       s.push_back(as); 
     }
@@ -253,7 +252,7 @@ void ASTParser::stmt(std::vector<std::shared_ptr<Stmt>>& s){
   else if (match(TokenType::RETURN)) { //return statement
 
     advance(); 
-    std::shared_ptr<ReturnStmt> st = make_shared<ReturnStmt>(ret_stmt());
+    ReturnStmt* st = arena->make<ReturnStmt>(ret_stmt());
     s.push_back(st);
 
   }
@@ -265,31 +264,31 @@ void ASTParser::stmt(std::vector<std::shared_ptr<Stmt>>& s){
     //encounter else or else if cases
     if(match({TokenType::ELSE, TokenType::ELSEIF})) { 
       IfStmt new_if; 
-      new_if.if_part = bi;  
+      new_if.if_part = std::move(bi);  
 
+      size_t else_ifs_from = else_if_stack.size();
       while(match(TokenType::ELSEIF)) {
         advance();
         BasicIf basic_new_if = if_stmt();
-        new_if.else_ifs.push_back(basic_new_if);
+        else_if_stack.push_back(std::move(basic_new_if));
       }
+      new_if.else_ifs = arena->make_list(else_if_stack, else_ifs_from);
 
       if(match(TokenType::ELSE)) {
         advance();
         
         eat(TokenType::LBRACE, "expecting '{' in else");
-        while(!match(TokenType::RBRACE)) {
-          stmt(new_if.else_stmts);
-        }       
+        new_if.else_stmts = stmts();
         eat(TokenType::RBRACE, "expecting '}' in else");
       }
 
-      std::shared_ptr<IfStmt> ptr = make_shared<IfStmt>(new_if);
+      IfStmt* ptr = arena->make<IfStmt>(std::move(new_if));
       s.push_back(ptr);
     } 
     //simple if statement
     else { 
-      std::shared_ptr<IfStmt> is = make_shared<IfStmt>();
-      is->if_part = bi;
+      IfStmt* is = arena->make<IfStmt>();
+      is->if_part = std::move(bi);
       s.push_back(is); 
     }
 
@@ -297,24 +296,34 @@ void ASTParser::stmt(std::vector<std::shared_ptr<Stmt>>& s){
   else if (match(TokenType::WHILE)) { //while statements
 
     advance(); 
-    std::shared_ptr<WhileStmt> ws = make_shared<WhileStmt>(while_stmt());
+    WhileStmt* ws = arena->make<WhileStmt>(while_stmt());
     s.push_back(ws);
 
   }
   else if (match(TokenType::FOR)) { //for statements
 
     advance(); 
-    std::shared_ptr<ForStmt> fs = make_shared<ForStmt>(for_stmt());
+    ForStmt* fs = arena->make<ForStmt>(for_stmt());
     s.push_back(fs);
 
   }
   else { //if any of the above didn't
-    std::shared_ptr<VarDeclStmt> vds = make_shared<VarDeclStmt>(vdecl_stmt());
+    VarDeclStmt* vds = arena->make<VarDeclStmt>(vdecl_stmt());
     s.push_back(vds);
   }
 }
 
 
+//statements up to the closing '}' of a block
+ASTList<Stmt*> ASTParser::stmts() {
+  size_t from = stmt_stack.size();
+  while(!match(TokenType::RBRACE)) {
+    stmt(stmt_stack);
+  }
+  return arena->make_list(stmt_stack, from);
+}
+
+
 //---  RETURN <expr> ---
 ReturnStmt ASTParser::ret_stmt() {
   ReturnStmt rs; 
@@ -333,9 +342,7 @@ WhileStmt ASTParser::while_stmt() {
   eat(TokenType::RPAREN, "expecting ')' in while stmt");
 
   eat(TokenType::LBRACE, "expecting '{' in while stmt");
-  while(!match(TokenType::RBRACE)){
-    stmt(ws.stmts);
-  }
+  ws.stmts = stmts();
   eat(TokenType::RBRACE, "expecting '}' in while stmt");
 
   return ws; 
@@ -406,17 +413,16 @@ ForStmt ASTParser::for_stmt() {
   VarRef vr; 
   vr.var_name = curr_token;
   advance(); 
-  as.lvalue.push_back(vr);
+  ref_stack.push_back(vr);
+  as.lvalue = arena->make_list(ref_stack, ref_stack.size() - 1);
 
   assign_stmt(as); 
-  fs.assign_stmt = as;
+  fs.assign_stmt = std::move(as);
   eat(TokenType::RPAREN, "expecting ')' in for");
 
   //body
   eat(TokenType::LBRACE, "expecting '{' in for");
-  while(!match(TokenType::RBRACE)) {
-    stmt(fs.stmts);
-  }
+  fs.stmts = stmts();
   eat(TokenType::RBRACE, "expecting '}' in for");
 
   return fs; 
@@ -433,9 +439,7 @@ BasicIf ASTParser::if_stmt() {
 
   //body
   eat(TokenType::LBRACE, "expecting '{' in if");
-  while(!match(TokenType::RBRACE)) {
-    stmt(bi.stmts);
-  }
+  bi.stmts = stmts();
   eat(TokenType::RBRACE, "expecting '}' in if");
 
   return bi; 
@@ -450,15 +454,14 @@ IfStmt ASTParser::if_stmt_t(BasicIf bi) {
   
   if(match(TokenType::ELSEIF)) {
     advance(); //handles elseif token
-    is.else_ifs.push_back(if_stmt());
+    else_if_stack.push_back(if_stmt());
+    is.else_ifs = arena->make_list(else_if_stack, else_if_stack.size() - 1);
   }
   else { //else case
     advance(); 
     eat(TokenType::LBRACE, "expecting '{' in else");
 
-    while(!match(TokenType::RBRACE)) {
-      stmt(is.else_stmts);
-    }
+    is.else_stmts = stmts();
 
     eat(TokenType::RBRACE, "expecting '}' in else"); 
   }
@@ -472,14 +475,16 @@ CallExpr ASTParser::call_expr(Token id) {
   ce.fun_name = id; 
 
   eat(TokenType::LPAREN, "expecting '(' in call expr"); 
+  size_t args_from = arg_stack.size();
   while(!match(TokenType::RPAREN)) {
     Expr e; 
     expr(e);
-    ce.args.push_back(e);
+    arg_stack.push_back(std::move(e));
     if(match(TokenType::COMMA)) {
       advance(); 
     }
   }
+  ce.args = arena->make_list(arg_stack, args_from);
 
   eat(TokenType::RPAREN, "expecting ')' in call expr"); 
 
@@ -488,7 +493,8 @@ CallExpr ASTParser::call_expr(Token id) {
 
 
 //--- ID ( LBRACKET <expr> RBRACKET | ϵ ) ( DOT ID ( LBRACKET <expr> RBRACKET | ϵ ) )∗ ---
-void ASTParser::lvalue(std::vector<VarRef>& v, Token id) { //!!!!!!
+void ASTParser::lvalue(ASTList<VarRef>& v, Token id) { //!!!!!!
+  size_t from = ref_stack.size();
   VarRef vr;
   //we should start sitting at dot or lbracket, id was already ate in stmt
   vr.var_name = id; 
@@ -498,7 +504,7 @@ void ASTParser::lvalue(std::vector<VarRef>& v, Token id) { //!!!!!!
 
     Expr e; 
     expr(e);
-    vr.array_expr = e; 
+    vr.array_expr = std::move(e); 
 
     eat(TokenType::RBRACKET, "expecting ']' in lval");
 
@@ -506,13 +512,13 @@ void ASTParser::lvalue(std::vector<VarRef>& v, Token id) { //!!!!!!
       advance();
       Expr expr2d; 
       expr(expr2d);
-      vr.array_expr_2D = expr2d;
+      vr.array_expr_2D = std::move(expr2d);
 
       eat(TokenType::RBRACKET, "expecting ']' in 2d array lval");
     }
   }
 
-  v.push_back(vr);
+  ref_stack.push_back(std::move(vr));
 
   while(match(TokenType::DOT)) {
     advance(); //pass the dot
@@ -526,21 +532,23 @@ void ASTParser::lvalue(std::vector<VarRef>& v, Token id) { //!!!!!!
       advance();
       Expr e; 
       expr(e);
-      new_var.array_expr = e; 
+      new_var.array_expr = std::move(e); 
       eat(TokenType::RBRACKET, "expecting ']' in lval");
 
       if(match(TokenType::LBRACKET)) {
         advance(); 
         Expr expr2d; 
         expr(expr2d);
-        new_var.array_expr_2D = expr2d; 
+        new_var.array_expr_2D = std::move(expr2d); 
 
         eat(TokenType::RBRACKET, "expecting ']' in 2d array lval");
       }
     }
 
-    v.push_back(new_var); 
+    ref_stack.push_back(std::move(new_var)); 
   }    
+
+  v = arena->make_list(ref_stack, from);
 }
 
 //----------------------------------------------------------------------
@@ -564,7 +572,7 @@ void ASTParser::expr(Expr& e) {
     ComplexTerm new_complex;
     expr(new_complex.expr);
 
-    std::shared_ptr<ComplexTerm> ptr = make_shared<ComplexTerm>(new_complex);
+    ComplexTerm* ptr = arena->make<ComplexTerm>(std::move(new_complex));
     e.first = ptr; 
 
     eat(TokenType::RPAREN, "expecting ')' in expr");
@@ -574,12 +582,12 @@ void ASTParser::expr(Expr& e) {
   }
 
   if(bin_op()) {
-    e.op = curr_token; 
+    e.op = arena->make<Token>(curr_token); 
     advance();
     
     Expr new_exp; 
     expr(new_exp);
-    std::shared_ptr<Expr> ptr = make_shared<Expr>(new_exp);
+    Expr* ptr = arena->make<Expr>(std::move(new_exp));
     e.rest = ptr; 
   }
 }
@@ -593,13 +601,13 @@ void ASTParser::rvalue(Expr& e) {
     SimpleRValue sr; 
 
     sr.value = curr_token; 
-    std::shared_ptr<SimpleRValue> simple_rval_ptr = make_shared<SimpleRValue>(sr);
+    SimpleRValue* simple_rval_ptr = arena->make<SimpleRValue>(std::move(sr));
     st.rvalue = simple_rval_ptr; 
 
     advance();
   }
   else if (match(TokenType::NEW)) {
-    std::shared_ptr<NewRValue> new_rval = make_shared<NewRValue>(new_rvalue());
+    NewRValue* new_rval = arena->make<NewRValue>(new_rvalue());
 
     st.rvalue = new_rval;
   }
@@ -610,18 +618,18 @@ void ASTParser::rvalue(Expr& e) {
 
     if(match(TokenType::LPAREN)) {
 
-      std::shared_ptr<CallExpr> new_call_e = make_shared<CallExpr>(call_expr(id));
+      CallExpr* new_call_e = arena->make<CallExpr>(call_expr(id));
 
       st.rvalue = new_call_e;
     }
     else {
-      std::shared_ptr<VarRValue> new_var_rval = make_shared<VarRValue>(var_rvalue(id)); 
+      VarRValue* new_var_rval = arena->make<VarRValue>(var_rvalue(id)); 
 
       st.rvalue = new_var_rval;
     }
   }
 
-  std::shared_ptr<SimpleTerm> simple_ptr = make_shared<SimpleTerm>(st);
+  SimpleTerm* simple_ptr = arena->make<SimpleTerm>(std::move(st));
 
   e.first = simple_ptr; 
 }
@@ -648,7 +656,7 @@ NewRValue ASTParser::new_rvalue() {
       
       Expr e; 
       expr(e);
-      new_rval.array_expr = e; 
+      new_rval.array_expr = std::move(e); 
       eat(TokenType::RBRACKET, "expecting ']' in new rval");
 
       if(match(TokenType::LBRACKET)) {
@@ -656,7 +664,7 @@ NewRValue ASTParser::new_rvalue() {
 
         Expr array2d; 
         expr(array2d);
-        new_rval.array_expr_2D = array2d;
+        new_rval.array_expr_2D = std::move(array2d);
 
         eat(TokenType::RBRACKET, "expecting ']' in new 2d array rval");
       }
@@ -670,7 +678,7 @@ NewRValue ASTParser::new_rvalue() {
 
     Expr e; 
     expr(e);
-    new_rval.array_expr = e; 
+    new_rval.array_expr = std::move(e); 
     
     eat(TokenType::RBRACKET, "expecting ']' in new rval");
 
@@ -679,7 +687,7 @@ NewRValue ASTParser::new_rvalue() {
 
       Expr array2d; 
       expr(array2d);
-      new_rval.array_expr_2D = array2d;
+      new_rval.array_expr_2D = std::move(array2d);
 
       eat(TokenType::RBRACKET, "expecting ']' in new 2d array rval");
     }
@@ -693,6 +701,7 @@ NewRValue ASTParser::new_rvalue() {
 VarRValue ASTParser::var_rvalue(Token id) {
   //id was already ate in the caller, so we're on dot or id, or it's empty
   VarRValue vrv; 
+  size_t from = ref_stack.size();
 
   VarRef vr; 
   vr.var_name = id; 
@@ -701,7 +710,7 @@ VarRValue ASTParser::var_rvalue(Token id) {
     
     Expr e; 
     expr(e);
-    vr.array_expr = e; 
+    vr.array_expr = std::move(e); 
     eat(TokenType::RBRACKET, "expecting ']' in var rval"); 
 
     if(match(TokenType::LBRACKET)) {
@@ -709,12 +718,12 @@ VarRValue ASTParser::var_rvalue(Token id) {
 
       Expr array2d; 
       expr(array2d);
-      vr.array_expr_2D = array2d;
+      vr.array_expr_2D = std::move(array2d);
 
       eat(TokenType::RBRACKET, "expecting ']' in new 2d array rval");
     }
   }
-  vrv.path.push_back(vr); 
+  ref_stack.push_back(std::move(vr)); 
 
   while(match(TokenType::DOT)) {
     VarRef new_ref; 
@@ -728,7 +737,7 @@ VarRValue ASTParser::var_rvalue(Token id) {
 
       Expr e; 
       expr(e);
-      new_ref.array_expr = e; 
+      new_ref.array_expr = std::move(e); 
       eat(TokenType::RBRACKET, "expecting ']' in var rval"); 
 
       if(match(TokenType::LBRACKET)) {
@@ -736,14 +745,15 @@ VarRValue ASTParser::var_rvalue(Token id) {
 
         Expr array2d; 
         expr(array2d);
-        new_ref.array_expr_2D = array2d;
+        new_ref.array_expr_2D = std::move(array2d);
 
         eat(TokenType::RBRACKET, "expecting ']' in new 2d array rval");
       }
     }
 
-    vrv.path.push_back(new_ref);     
+    ref_stack.push_back(std::move(new_ref));     
   }
+  vrv.path = arena->make_list(ref_stack, from);
 
   return vrv; 
 }
\ No newline at end of file
@@ -27,10 +27,21 @@ private:
   
   Lexer lexer;
   Token curr_token;
+
+  // the arena of the program being parsed
+  ASTArena* arena = nullptr;
+
+  // the items of the lists being parsed, which are moved into the
+  // arena as each list ends (see ASTArena::make_list)
+  std::vector<Stmt*> stmt_stack;
+  std::vector<BasicIf> else_if_stack;
+  std::vector<Expr> arg_stack;
+  std::vector<VarRef> ref_stack;
   
   // helper functions
   void advance();
-  void eat(TokenType t, const std::string& msg);
+  // (the message is only made into a string on an error)
+  void eat(TokenType t, const char* msg);
   bool match(TokenType t);
   bool match(std::initializer_list<TokenType> types);
   void error(const std::string& msg);
@@ -44,11 +55,12 @@ private:
   void params(FunDef& f);
   void data_type(DataType& dt);
   bool base_type();
-  void stmt(std::vector<std::shared_ptr<Stmt>>& st);
+  void stmt(std::vector<Stmt*>& st);
+  ASTList<Stmt*> stmts();
   VarDeclStmt vdecl_stmt();
   VarDeclStmt vdecl_stmt(Token id); 
   void assign_stmt(AssignStmt& s);
-  void lvalue (std::vector<VarRef>& v, Token id);
+  void lvalue (ASTList<VarRef>& v, Token id);
   BasicIf if_stmt();
   IfStmt if_stmt_t(BasicIf bi);
   WhileStmt while_stmt();
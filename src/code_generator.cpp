@@ -7,6 +7,7 @@
 
 #include <iostream>             // for debugging
 #include "code_generator.h"
+#include "optimizer.h"
 
 using namespace std;
 
@@ -19,273 +20,119 @@ void replace_all(string& s, const string& old_str, const string& new_str)
 }
 
 
-CodeGenerator::CodeGenerator(VM& vm)
-  : vm(vm)
+CodeGenerator::CodeGenerator(VM& vm, int opt_level)
+  : vm(vm), opt_level(opt_level)
 {
 }
 
 
-void CodeGenerator::visit(Program& p)
+void CodeGenerator::add_var(FlatIndex name, const string& type)
 {
-  for (auto& struct_def : p.struct_defs)
-    struct_def.accept(*this);
-  for (auto& fun_def : p.fun_defs)
-    fun_def.accept(*this);
+  //a name declared again in the same environment keeps its index
+  int index = var_table.in_curr_env(name) ? *var_table.get(name) :
+    var_table.size();
+  var_table.add(name, index);
+  if (index >= var_types.size())
+    var_types.resize(index + 1);
+  var_types[index] = type;
 }
 
 
-void CodeGenerator::visit(FunDef& f)
+int CodeGenerator::var_index(FlatIndex token) const
 {
-  //make a new frame for the function and set it to the current frame
-  VMFrameInfo new_frame {f.fun_name.lexeme(), int(f.params.size())}; 
-  curr_frame = new_frame; 
-  
-  //new var table for function
-  var_table.push_environment(); 
-  
-  //iterate through params for frame
-  for(auto param : f.params) {
-    var_table.add(param.var_name.lexeme()); 
-    //we can grab from var table to get the oid/address to store
-    curr_frame.instructions.push_back(VMInstr::STORE(var_table.get(param.var_name.lexeme()))); 
-  }
-
-  //funciton body
-  for(auto stmt : f.stmts) {
-    stmt->accept(*this);
-  }
-
-  //if there is no return type, then add a return. 
-  if(f.return_type.type_name == "void") {
-    curr_frame.instructions.push_back(VMInstr::PUSH(nullptr)); 
-    curr_frame.instructions.push_back(VMInstr::RET()); 
-  }
-
-  var_table.pop_environment(); 
-
-  vm.add(curr_frame); //add the current frame info to the vm for execution
+  const int* index = var_table.get(flat->tokens[token].name);
+  return index ? *index : -1;
 }
 
 
-void CodeGenerator::visit(StructDef& s)
+int CodeGenerator::field_slot(const string& type, const string& field) const
 {
-  //struct name only needs to be added, information is already generated in semantic checker
-  struct_defs[s.struct_name.lexeme()] = s; 
+  auto entry = struct_defs.find(type);
+  if (entry == struct_defs.end())
+    return -1;
+  const vector<VarDef>& fields = entry->second->fields;
+  for (int i = 0; i < fields.size(); ++i)
+    if (fields[i].var_name.lexeme() == field)
+      return i;
+  return -1;
 }
 
 
-void CodeGenerator::visit(ReturnStmt& s)
+void CodeGenerator::get_field(string& type, const string& field)
 {
-  s.expr.accept(*this); 
-  curr_frame.instructions.push_back(VMInstr::RET()); 
-}
-
-//refer to class notes for explanation
-void CodeGenerator::visit(WhileStmt& s)
-{
-  int start = curr_frame.instructions.size(); 
-  s.condition.accept(*this); 
-  curr_frame.instructions.push_back(VMInstr::JMPF(-1));
-  int jmpf = curr_frame.instructions.size() - 1;  
-  var_table.push_environment(); 
-  for(auto stmt : s.stmts) {
-    stmt->accept(*this);
+  int slot = field_slot(type, field);
+  if (slot < 0) {
+    curr_frame.instructions.push_back(VMInstr::GETF(field));
+    type = "";
+    return;
   }
-  var_table.pop_environment(); 
-  curr_frame.instructions.push_back(VMInstr::JMP(start)); 
-  curr_frame.instructions.push_back(VMInstr::NOP()); 
-  curr_frame.instructions[jmpf] = VMInstr::JMPF(curr_frame.instructions.size() - 1); 
+  curr_frame.instructions.push_back(VMInstr::GETFI(slot));
+  curr_frame.instructions.back().set_comment(field);
+  type = struct_defs.at(type)->fields[slot].data_type.type_name;
 }
 
-//refer to class notes for explanation
-void CodeGenerator::visit(ForStmt& s)
+
+void CodeGenerator::set_field(const string& type, const string& field)
 {
-  var_table.push_environment(); 
-  s.var_decl.accept(*this); 
-  
-  int start = curr_frame.instructions.size();
-  s.condition.accept(*this);
-  curr_frame.instructions.push_back(VMInstr::JMPF(-1)); 
-  int jmpf = curr_frame.instructions.size() -1; 
-
-  var_table.push_environment();
-  for(auto stmt : s.stmts) {
-    stmt->accept(*this);
+  int slot = field_slot(type, field);
+  if (slot < 0) {
+    curr_frame.instructions.push_back(VMInstr::SETF(field));
+    return;
   }
-  var_table.pop_environment();
-
-  s.assign_stmt.accept(*this);
-  var_table.pop_environment(); 
-
-  curr_frame.instructions.push_back(VMInstr::JMP(start)); 
-  curr_frame.instructions.push_back(VMInstr::NOP()); 
-  curr_frame.instructions[jmpf] = VMInstr::JMPF(curr_frame.instructions.size() - 1); 
+  curr_frame.instructions.push_back(VMInstr::SETFI(slot));
+  curr_frame.instructions.back().set_comment(field);
 }
 
 
-void CodeGenerator::visit(IfStmt& s)
+void CodeGenerator::visit(Program& p)
 {
-  //use this to set jumpf indexes. 
-  int jmpf_last = 0; //jmpf will be adjusted as the statements grow
-  vector<int> jmp_indexes; //stores all the indexes of the jmp instructions, because all jmps will go to the nop at the end
-
-  //inital if part
-  s.if_part.condition.accept(*this); //generate the condition
-  curr_frame.instructions.push_back(VMInstr::JMPF(-1)); //condition is false
-  jmpf_last = curr_frame.instructions.size() - 1; 
-  //initial if statement body, condition is true
-  var_table.push_environment(); //stmt environment
-  for (auto stmt : s.if_part.stmts) {
-    stmt->accept(*this); 
-  }
-  var_table.pop_environment(); 
-
-  //add to jmp indexes
-  curr_frame.instructions.push_back(VMInstr::JMP(-1)); //jump to nop
-  jmp_indexes.push_back(curr_frame.instructions.size() - 1); 
-
-  //else if statements
-  for(auto elifs : s.else_ifs) {
-    //set the previous jump false to the condition that will be generated
-    curr_frame.instructions[jmpf_last] = VMInstr::JMPF(curr_frame.instructions.size()); 
-
-    //condition of the statement
-    elifs.condition.accept(*this); 
-    curr_frame.instructions.push_back(VMInstr::JMPF(-1)); 
-    jmpf_last = curr_frame.instructions.size() - 1; //update the last jmpf index to this one (set later)
-
-    //statement body
-    var_table.push_environment(); 
-    for (auto stmt : elifs.stmts) {
-      stmt->accept(*this); 
-    }
-    var_table.pop_environment(); 
-
-    //add to jmp indexes
-    curr_frame.instructions.push_back(VMInstr::JMP(-1)); 
-    jmp_indexes.push_back(curr_frame.instructions.size() - 1); 
-  }
-
-  //go through else statemets, don't need jmp because it will automatically fall to nop
-  if(!s.else_stmts.empty()) {
-    curr_frame.instructions[jmpf_last] = VMInstr::JMPF(curr_frame.instructions.size()); 
-
-    var_table.push_environment(); 
-    for(auto stmt : s.else_stmts) {
-      stmt->accept(*this); 
-    }
-    var_table.pop_environment(); 
-  }
-
-  curr_frame.instructions.push_back(VMInstr::NOP()); 
-
-  //set the jmpf for the initial if when there are no other conditions to check
-  if(s.else_ifs.empty() && s.else_stmts.empty())
-    curr_frame.instructions[jmpf_last] = VMInstr::JMPF(curr_frame.instructions.size() - 1); 
-
-  //set all the jmp indexes to nop
-  for(auto jmp : jmp_indexes) {
-    curr_frame.instructions[jmp] = VMInstr::JMP(curr_frame.instructions.size() - 1); 
-  }
+  generate(FlatAST(p));
 }
 
 
-void CodeGenerator::visit(VarDeclStmt& s)
+void CodeGenerator::begin_function(const FlatFunDef& f)
 {
-  //add the new var name to symbol table
-  var_table.add(s.var_def.var_name.lexeme()); 
-
-  s.expr.accept(*this); 
-
-  curr_frame.instructions.push_back(VMInstr::STORE(var_table.get(s.var_def.var_name.lexeme()))); //store expr into index
+  //make a new frame for the function and set it to the current frame
+  VMFrameInfo new_frame {flat->lexeme(f.name), int(f.params.size())}; 
+  curr_frame = new_frame; 
+  
+  //new var table for function
+  var_table.push_environment(); 
+  
+  //iterate through params for frame
+  for (FlatIndex p = f.params.begin; p < f.params.end; ++p) {
+    const FlatVar& param = flat->vars[p];
+    add_var(flat->tokens[param.name].name, flat->names[param.type.name]); 
+    //we can grab from var table to get the oid/address to store
+    curr_frame.instructions.push_back(VMInstr::STORE(var_index(param.name))); 
+  }
 }
 
 
-void CodeGenerator::visit(AssignStmt& s)
+void CodeGenerator::end_function(const FlatFunDef& f)
 {
-  //load initial value
-  int index = var_table.get(s.lvalue[0].var_name.lexeme()); 
-
-  curr_frame.instructions.push_back(VMInstr::LOAD(index)); //also covers 2 value path expressions x.y
-
-  if(s.lvalue[0].array_expr.has_value()) //if array, evaluate the index that you need to push
-    s.lvalue[0].array_expr->accept(*this); 
+  //if there is no return type, then add a return. 
+  if(flat->names[f.return_type.name] == "void") {
+    curr_frame.instructions.push_back(VMInstr::PUSH(nullptr)); 
+    curr_frame.instructions.push_back(VMInstr::RET()); 
+  }
 
-  //changes made to acommodate any 2d array expressions
-  if(s.lvalue[0].array_expr_2D.has_value())
-    s.lvalue[0].array_expr_2D->accept(*this); 
-  
-  //if the path does not exceed one, store into it or set the value at the index if it's an array
-  if(s.lvalue.size() == 1) {
-    if(s.lvalue[0].array_expr.has_value()) {
+  var_table.pop_environment(); 
 
-      s.expr.accept(*this); 
+  //size the operand stack for the deepest point in the function and
+  //the variables for the most that were in scope at once
+  curr_frame.max_stack = max_stack_depth(curr_frame); 
+  curr_frame.local_count = var_table.max_size();
 
-      if(s.lvalue[0].array_expr_2D.has_value())
-        curr_frame.instructions.push_back(VMInstr::SETI2D()); 
-      else
-        curr_frame.instructions.push_back(VMInstr::SETI()); 
-    }
-    else {
-      s.expr.accept(*this); 
-      curr_frame.instructions.push_back(VMInstr::STORE(index)); 
-    }
-  } 
-  else  { //path is greater than one
-      if(s.lvalue[0].array_expr.has_value())
-        curr_frame.instructions.push_back(VMInstr::GETI()); 
-
-    if(s.lvalue[0].array_expr_2D.has_value())
-      curr_frame.instructions.push_back(VMInstr::GETI2D());
-
-    //itreate through to the second from last variable
-    for(int i = 1; i < s.lvalue.size() - 1; i++) {
-      curr_frame.instructions.push_back(VMInstr::GETF(s.lvalue[i].var_name.lexeme())); 
-      //if the var is an array, then push(index) and geti()
-      if(s.lvalue[i].array_expr.has_value()) {
-        s.lvalue[i].array_expr->accept(*this); 
-
-        if(s.lvalue[i].array_expr_2D.has_value())
-          s.lvalue[i].array_expr_2D->accept(*this); 
-
-        if(s.lvalue[i].array_expr_2D.has_value())
-          curr_frame.instructions.push_back(VMInstr::GETI2D()); 
-        else 
-          curr_frame.instructions.push_back(VMInstr::GETI()); 
-      }
-    }
+  //clean up the naive code (this also resizes the operand stack)
+  optimize(curr_frame, opt_level);
 
-    //end of path,seti if array, setf if field
-    if(s.lvalue.back().array_expr.has_value()) {
-      curr_frame.instructions.push_back(VMInstr::GETF(s.lvalue.back().var_name.lexeme())); 
-      if(s.lvalue.back().array_expr_2D.has_value()) 
-        s.lvalue.back().array_expr_2D->accept(*this); 
-    
-      s.lvalue.back().array_expr->accept(*this); 
-      s.expr.accept(*this); 
-
-      if(s.lvalue.back().array_expr_2D.has_value())
-        curr_frame.instructions.push_back(VMInstr::SETI2D()); 
-      else
-        curr_frame.instructions.push_back(VMInstr::SETI()); 
-    }
-    else {
-      s.expr.accept(*this); 
-      curr_frame.instructions.push_back(VMInstr::SETF(s.lvalue.back().var_name.lexeme())); 
-    }
-  }
+  vm.add(curr_frame); //add the current frame info to the vm for execution
 }
 
 
-void CodeGenerator::visit(CallExpr& e)
+void CodeGenerator::push_call(const string& fun_name)
 {
-  //push all arguments onto stack
-  for(auto ex : e.args) {
-    ex.accept(*this); 
-  }
-
-  string fun_name = e.fun_name.lexeme(); 
-
   //check for built ins, if not then it's just a call instruction
   if(fun_name == "concat")
     curr_frame.instructions.push_back(VMInstr::CONCAT());  
@@ -310,80 +157,64 @@ void CodeGenerator::visit(CallExpr& e)
 }
 
 
-void CodeGenerator::visit(Expr& e)
-{  
-  e.first->accept(*this); 
-
-  //check if rest has value
-  if(e.rest != nullptr) {
-    e.rest->accept(*this); 
-
-    //check op types and push
-    if(e.op->type() == TokenType::PLUS)
-      curr_frame.instructions.push_back(VMInstr::ADD()); 
-    else if (e.op->type() == TokenType::MINUS)
-      curr_frame.instructions.push_back(VMInstr::SUB());
-    else if (e.op->type() == TokenType::TIMES)
-      curr_frame.instructions.push_back(VMInstr::MUL()); 
-    else if (e.op->type() == TokenType::DIVIDE)
-      curr_frame.instructions.push_back(VMInstr::DIV()); 
-    else if (e.op->type() == TokenType::EQUAL)
-      curr_frame.instructions.push_back(VMInstr::CMPEQ()); 
-    else if (e.op->type() == TokenType::NOT_EQUAL)
-      curr_frame.instructions.push_back(VMInstr::CMPNE()); 
-    else if (e.op->type() == TokenType::LESS)
-      curr_frame.instructions.push_back(VMInstr::CMPLT()); 
-    else if (e.op->type() == TokenType::GREATER)
-      curr_frame.instructions.push_back(VMInstr::CMPGT()); 
-    else if (e.op->type() == TokenType::LESS_EQ)
-      curr_frame.instructions.push_back(VMInstr::CMPLE()); 
-    else if (e.op->type() == TokenType::GREATER_EQ)
-      curr_frame.instructions.push_back(VMInstr::CMPGE()); 
-    else if (e.op->type() == TokenType::AND)
-      curr_frame.instructions.push_back(VMInstr::AND());
-    else if (e.op->type() == TokenType::OR)
-      curr_frame.instructions.push_back(VMInstr::OR()); 
-  } 
-
-  //negate the expression at the end, once everything is loaded in 
-  if(e.negated)
-    curr_frame.instructions.push_back(VMInstr::NOT()); 
-}
-
-
-void CodeGenerator::visit(SimpleTerm& t)
+void CodeGenerator::push_op(TokenType op, OpType op_type)
 {
-  t.rvalue->accept(*this); 
+  //check op types and push (the typed instructions when the checker
+  //found both operands to be ints or doubles)
+  bool ints = op_type == OpType::INT;
+  bool doubles = op_type == OpType::DOUBLE;
+  if(op == TokenType::PLUS)
+    curr_frame.instructions.push_back(ints ? VMInstr::IADD() :
+                                      doubles ? VMInstr::DADD() : VMInstr::ADD());
+  else if (op == TokenType::MINUS)
+    curr_frame.instructions.push_back(ints ? VMInstr::ISUB() :
+                                      doubles ? VMInstr::DSUB() : VMInstr::SUB());
+  else if (op == TokenType::TIMES)
+    curr_frame.instructions.push_back(ints ? VMInstr::IMUL() :
+                                      doubles ? VMInstr::DMUL() : VMInstr::MUL());
+  else if (op == TokenType::DIVIDE)
+    curr_frame.instructions.push_back(ints ? VMInstr::IDIV() :
+                                      doubles ? VMInstr::DDIV() : VMInstr::DIV());
+  else if (op == TokenType::EQUAL)
+    curr_frame.instructions.push_back(ints ? VMInstr::ICMPEQ() : VMInstr::CMPEQ());
+  else if (op == TokenType::NOT_EQUAL)
+    curr_frame.instructions.push_back(ints ? VMInstr::ICMPNE() : VMInstr::CMPNE());
+  else if (op == TokenType::LESS)
+    curr_frame.instructions.push_back(ints ? VMInstr::ICMPLT() : VMInstr::CMPLT());
+  else if (op == TokenType::GREATER)
+    curr_frame.instructions.push_back(ints ? VMInstr::ICMPGT() : VMInstr::CMPGT());
+  else if (op == TokenType::LESS_EQ)
+    curr_frame.instructions.push_back(ints ? VMInstr::ICMPLE() : VMInstr::CMPLE());
+  else if (op == TokenType::GREATER_EQ)
+    curr_frame.instructions.push_back(ints ? VMInstr::ICMPGE() : VMInstr::CMPGE());
+  else if (op == TokenType::AND)
+    curr_frame.instructions.push_back(VMInstr::AND());
+  else if (op == TokenType::OR)
+    curr_frame.instructions.push_back(VMInstr::OR());
 }
- 
 
-void CodeGenerator::visit(ComplexTerm& t)
-{
-  t.expr.accept(*this); 
-}
 
-//refer to lecture notes for expalanations
-void CodeGenerator::visit(SimpleRValue& v)
+void CodeGenerator::push_value(TokenType type, const string& lexeme)
 {
-  if (v.value.type() == TokenType::INT_VAL) {
-    int val = stoi(v.value.lexeme()); 
+  if (type == TokenType::INT_VAL) {
+    int val = stoi(lexeme); 
     curr_frame.instructions.push_back(VMInstr::PUSH(val)); 
   }
-  else if (v.value.type() == TokenType::DOUBLE_VAL) {
-    double val = stod(v.value.lexeme());
+  else if (type == TokenType::DOUBLE_VAL) {
+    double val = stod(lexeme);
     curr_frame.instructions.push_back(VMInstr::PUSH(val)); 
   }
-  else if (v.value.type() == TokenType::NULL_VAL) {
+  else if (type == TokenType::NULL_VAL) {
     curr_frame.instructions.push_back(VMInstr::PUSH(nullptr));
   }
-  else if (v.value.type() == TokenType::BOOL_VAL) {
-    if(v.value.lexeme() == "true")
+  else if (type == TokenType::BOOL_VAL) {
+    if(lexeme == "true")
       curr_frame.instructions.push_back(VMInstr::PUSH(true)); 
     else
       curr_frame.instructions.push_back(VMInstr::PUSH(false)); 
   }
   else {
-    string s = v.value.lexeme(); 
+    string s = lexeme; 
     replace_all(s, "\\n", "\n"); 
     replace_all(s, "\\t", "\t");
     replace_all(s, "\\'", "\'");
@@ -392,72 +223,283 @@ void CodeGenerator::visit(SimpleRValue& v)
 }
 
 
-void CodeGenerator::visit(NewRValue& v)
+void CodeGenerator::push_alloc(const string& type)
 {
-  //check for new array expression, if not, it's a new struct
-  //if 1D array, push column and null
-  //if 2D array, push in column, row, and null
-  if(v.array_expr.has_value()) {  
-    if(v.array_expr_2D.has_value()) { //for 2D arrays the columns counts are stored in the 2nd array expression
-      v.array_expr_2D->accept(*this); 
-    }
+  //allocate every field slot at once (each starts as null)
+  auto entry = struct_defs.find(type);
+  int field_count = entry == struct_defs.end() ? 0 :
+    entry->second->fields.size();
+  curr_frame.instructions.push_back(VMInstr::ALLOCS(field_count)); 
+}
 
-    v.array_expr->accept(*this); //if 2D this stores the row counts, if 1D this stores columns
 
-    curr_frame.instructions.push_back(VMInstr::PUSH(nullptr)); //initial set to null
+//----------------------------------------------------------------------
+// Flat program walk
+//----------------------------------------------------------------------
 
-    if(v.array_expr_2D.has_value()) 
-      curr_frame.instructions.push_back(VMInstr::ALLOCA2D()); 
-    else
-      curr_frame.instructions.push_back(VMInstr::ALLOCA()); 
-  }
-  else { //not an array so has to be a struct
-    curr_frame.instructions.push_back(VMInstr::ALLOCS()); 
-    //loop to add and initialize fields
-    for(auto field : struct_defs[v.type.lexeme()].fields) {
-      curr_frame.instructions.push_back(VMInstr::DUP()); 
-      curr_frame.instructions.push_back(VMInstr::ADDF(field.var_name.lexeme())); 
-      curr_frame.instructions.push_back(VMInstr::DUP()); 
-      curr_frame.instructions.push_back(VMInstr::PUSH(nullptr)); 
-      curr_frame.instructions.push_back(VMInstr::SETF(field.var_name.lexeme())); 
-    }
+void CodeGenerator::generate(const FlatAST& ast)
+{
+  flat = &ast;
+  for (const FlatStructDef& d : ast.struct_defs)
+    flat_structs.push_back(ast.struct_def(d));
+  for (const StructDef& s : flat_structs)
+    struct_defs[s.struct_name.lexeme()] = &s;
+  for (const FlatFunDef& f : ast.fun_defs) {
+    begin_function(f);
+    gen_block(f.body);
+    end_function(f);
   }
+  vm.link();
 }
 
 
-void CodeGenerator::visit(VarRValue& v)
+void CodeGenerator::walk_struct_def(FlatAST& ast, FlatIndex s)
 {
-  //initial value load
-  int index = var_table.get(v.path[0].var_name.lexeme());
-  curr_frame.instructions.push_back(VMInstr::LOAD(index));
-  if(v.path[0].array_expr.has_value()) {
+  flat_structs.push_back(ast.struct_def(ast.struct_defs[s]));
+  struct_defs[flat_structs.back().struct_name.lexeme()] = &flat_structs.back();
+}
 
-    v.path[0].array_expr->accept(*this);
 
-    if(v.path[0].array_expr_2D.has_value())
-      v.path[0].array_expr_2D->accept(*this); 
+void CodeGenerator::walk_fun_def(FlatAST& ast, FlatIndex f)
+{
+  flat = &ast;
+  begin_function(ast.fun_defs[f]);
+  gen_block(ast.fun_defs[f].body);
+  end_function(ast.fun_defs[f]);
+}
 
-    if(v.path[0].array_expr_2D.has_value())
-      curr_frame.instructions.push_back(VMInstr::GETI2D()); 
-    else
-      curr_frame.instructions.push_back(VMInstr::GETI()); 
+
+void CodeGenerator::walk_stmt(FlatAST& ast, FlatIndex s)
+{
+  flat = &ast;
+  gen_stmt(s);
+}
+
+
+void CodeGenerator::walk_expr(FlatAST& ast, FlatIndex e)
+{
+  flat = &ast;
+  gen_expr(e);
+}
+
+
+void CodeGenerator::gen_block(FlatRange body)
+{
+  for (FlatIndex i = body.begin; i < body.end; ++i) {
+    gen_stmt(i);
+    //pop the unused result of a call statement
+    if (flat->stmts[i].kind == FlatStmtKind::CALL &&
+        curr_frame.instructions.back().opcode() != OpCode::WRITE)
+      curr_frame.instructions.push_back(VMInstr::POP());
   }
+}
 
-  //for path expressions
-  for(int i = 1; i < v.path.size(); i++) {
-    curr_frame.instructions.push_back(VMInstr::GETF(v.path[i].var_name.lexeme()));
-    if(v.path[i].array_expr.has_value()) {
 
-      v.path[i].array_expr->accept(*this); 
+void CodeGenerator::gen_stmt(FlatIndex i)
+{
+  const FlatStmt& s = flat->stmts[i];
+  vector<VMInstr>& code = curr_frame.instructions;
+  switch (s.kind) {
+  case FlatStmtKind::VAR_DECL: {
+    const FlatVar& var = flat->vars[s.var];
+    add_var(flat->tokens[var.name].name, flat->names[var.type.name]);
+    gen_expr(s.expr);
+    code.push_back(VMInstr::STORE(var_index(var.name)));
+    break;
+  }
+  case FlatStmtKind::ASSIGN: {
+    const FlatRef* path = &flat->refs[s.path.begin];
+    const FlatRef& last = path[s.path.size() - 1];
+    int index = var_index(path[0].name);
+    bool indexed = path[0].array_expr != FLAT_NONE;
+    bool indexed_2D = path[0].array_expr_2D != FLAT_NONE;
+
+    //a plain variable is just stored into, otherwise load the reference
+    if (s.path.size() > 1 || indexed)
+      code.push_back(VMInstr::LOAD(index));
+    if (indexed)
+      gen_expr(path[0].array_expr);
+    if (indexed_2D)
+      gen_expr(path[0].array_expr_2D);
+
+    if (s.path.size() == 1) {
+      gen_expr(s.expr);
+      if (indexed_2D)
+        code.push_back(VMInstr::SETI2D());
+      else if (indexed)
+        code.push_back(VMInstr::SETI());
+      else
+        code.push_back(VMInstr::STORE(index));
+      break;
+    }
 
-      if(v.path[i].array_expr_2D.has_value())
-        v.path[i].array_expr_2D->accept(*this); 
+    if (indexed)
+      code.push_back(VMInstr::GETI());
+    if (indexed_2D)
+      code.push_back(VMInstr::GETI2D());
+    //follow the path to the second from last variable (tracking the
+    //struct type to resolve field slots)
+    string type = index >= 0 ? var_types[index] : "";
+    for (FlatIndex p = 1; p < s.path.size() - 1; ++p) {
+      get_field(type, flat->lexeme(path[p].name));
+      if (path[p].array_expr != FLAT_NONE) {
+        gen_expr(path[p].array_expr);
+        if (path[p].array_expr_2D != FLAT_NONE) {
+          gen_expr(path[p].array_expr_2D);
+          code.push_back(VMInstr::GETI2D());
+        }
+        else
+          code.push_back(VMInstr::GETI());
+      }
+    }
+    //end of path, seti if array, setf if field
+    if (last.array_expr != FLAT_NONE) {
+      get_field(type, flat->lexeme(last.name));
+      if (last.array_expr_2D != FLAT_NONE)
+        gen_expr(last.array_expr_2D);
+      gen_expr(last.array_expr);
+      gen_expr(s.expr);
+      if (last.array_expr_2D != FLAT_NONE)
+        code.push_back(VMInstr::SETI2D());
+      else
+        code.push_back(VMInstr::SETI());
+    }
+    else {
+      gen_expr(s.expr);
+      set_field(type, flat->lexeme(last.name));
+    }
+    break;
+  }
+  case FlatStmtKind::CALL:
+    gen_expr(s.expr);
+    break;
+  case FlatStmtKind::RETURN:
+    gen_expr(s.expr);
+    code.push_back(VMInstr::RET());
+    break;
+  case FlatStmtKind::WHILE: {
+    int start = code.size();
+    gen_expr(s.expr);
+    code.push_back(VMInstr::JMPF(-1));
+    int jmpf = code.size() - 1;
+    var_table.push_environment();
+    gen_block(s.body);
+    var_table.pop_environment();
+    code.push_back(VMInstr::JMP(start));
+    code.push_back(VMInstr::NOP());
+    code[jmpf] = VMInstr::JMPF(code.size() - 1);
+    break;
+  }
+  case FlatStmtKind::FOR: {
+    var_table.push_environment();
+    gen_stmt(s.init);
+    int start = code.size();
+    gen_expr(s.expr);
+    code.push_back(VMInstr::JMPF(-1));
+    int jmpf = code.size() - 1;
+    var_table.push_environment();
+    gen_block(s.body);
+    var_table.pop_environment();
+    gen_stmt(s.update);
+    var_table.pop_environment();
+    code.push_back(VMInstr::JMP(start));
+    code.push_back(VMInstr::NOP());
+    code[jmpf] = VMInstr::JMPF(code.size() - 1);
+    break;
+  }
+  case FlatStmtKind::IF: {
+    //each condition jumps to the next branch when false, and each
+    //branch body jumps to the nop at the end
+    int jmpf_last = -1;
+    vector<int> jmp_indexes;
+    bool has_else = false;
+    for (FlatIndex b = s.body.begin; b < s.body.end; ++b) {
+      const FlatBranch& branch = flat->branches[b];
+      if (jmpf_last >= 0)
+        code[jmpf_last] = VMInstr::JMPF(code.size());
+      if (branch.condition != FLAT_NONE) {
+        gen_expr(branch.condition);
+        code.push_back(VMInstr::JMPF(-1));
+        jmpf_last = code.size() - 1;
+      }
+      else
+        has_else = true;
+      var_table.push_environment();
+      gen_block(branch.body);
+      var_table.pop_environment();
+      if (branch.condition != FLAT_NONE) {
+        code.push_back(VMInstr::JMP(-1));
+        jmp_indexes.push_back(code.size() - 1);
+      }
+    }
+    code.push_back(VMInstr::NOP());
+    if (!has_else)
+      code[jmpf_last] = VMInstr::JMPF(code.size() - 1);
+    for (int jmp : jmp_indexes)
+      code[jmp] = VMInstr::JMP(code.size() - 1);
+    break;
+  }
+  }
+}
 
-      if(v.path[i].array_expr_2D.has_value())
-        curr_frame.instructions.push_back(VMInstr::GETI2D());
+
+void CodeGenerator::gen_expr(FlatIndex i)
+{
+  const FlatExpr& e = flat->exprs[i];
+  vector<VMInstr>& code = curr_frame.instructions;
+  switch (e.kind) {
+  case FlatExprKind::VALUE:
+    push_value(flat->tokens[e.token].type, flat->lexeme(e.token));
+    break;
+  case FlatExprKind::NEW:
+    if (e.children.empty())
+      push_alloc(flat->lexeme(e.token));
+    else {
+      //the 2D column counts are pushed before the row counts
+      for (FlatIndex size = e.children.end; size > e.children.begin; --size)
+        gen_expr(size - 1);
+      code.push_back(VMInstr::PUSH(nullptr));
+      if (e.children.size() > 1)
+        code.push_back(VMInstr::ALLOCA2D());
       else
-        curr_frame.instructions.push_back(VMInstr::GETI()); 
+        code.push_back(VMInstr::ALLOCA());
+    }
+    break;
+  case FlatExprKind::VAR: {
+    const FlatRef* path = &flat->refs[e.children.begin];
+    int index = var_index(path[0].name);
+    code.push_back(VMInstr::LOAD(index));
+    //follow the path (tracking the struct type to resolve field slots)
+    string type = index >= 0 ? var_types[index] : "";
+    for (FlatIndex p = 0; p < e.children.size(); ++p) {
+      if (p > 0)
+        get_field(type, flat->lexeme(path[p].name));
+      if (path[p].array_expr != FLAT_NONE) {
+        gen_expr(path[p].array_expr);
+        if (path[p].array_expr_2D != FLAT_NONE) {
+          gen_expr(path[p].array_expr_2D);
+          code.push_back(VMInstr::GETI2D());
+        }
+        else
+          code.push_back(VMInstr::GETI());
+      }
     }
+    break;
+  }
+  case FlatExprKind::CALL:
+    for (FlatIndex arg = e.children.begin; arg < e.children.end; ++arg)
+      gen_expr(arg);
+    push_call(flat->lexeme(e.token));
+    break;
+  case FlatExprKind::PAREN:
+    gen_expr(e.children.begin);
+    break;
+  }
+
+  if (e.rest != FLAT_NONE) {
+    gen_expr(e.rest);
+    push_op(flat->tokens[e.op].type, e.op_type);
   }
+  if (e.negated)
+    code.push_back(VMInstr::NOT());
 }
-    
\ No newline at end of file
@@ -9,40 +9,94 @@
 #ifndef CODE_GENERATOR_H
 #define CODE_GENERATOR_H
 
+#include <deque>
 #include <string>
 #include <unordered_map>
+#include <vector>
 #include "ast.h"
-#include "var_table.h"
+#include "flat_ast.h"
 #include "vm.h"
 
 
-class CodeGenerator : public Visitor {
+// replace all occurrences of old_str in s with new_str (used to apply
+// string literal escapes)
+void replace_all(std::string& s, const std::string& old_str,
+                 const std::string& new_str);
+
+
+class CodeGenerator : public ProgramVisitor {
 public:
-  CodeGenerator(VM& vm);
+  // generate code into the vm, optimizing each function at the given
+  // level (see optimizer.h)
+  CodeGenerator(VM& vm, int opt_level = 0);
+
+  // generate code for a (checked) program, through its flat encoding
   void visit(Program& p);
-  void visit(FunDef& f);
-  void visit(StructDef& s);
-  void visit(ReturnStmt& s);
-  void visit(WhileStmt& s);
-  void visit(ForStmt& s);
-  void visit(IfStmt& s);
-  void visit(VarDeclStmt& s);
-  void visit(AssignStmt& s);
-  void visit(CallExpr& e);
-  void visit(Expr& e);
-  void visit(SimpleTerm& t); 
-  void visit(ComplexTerm& t);
-  void visit(SimpleRValue& v);
-  void visit(NewRValue& v);
-  void visit(VarRValue& v);    
+
+  // generate code for a (checked) flat program
+  void generate(const FlatAST& ast);
 
 private:
 
   VM& vm;
+  int opt_level;
   VMFrameInfo curr_frame;
   int next_var_index = 0;  
-  VarTable var_table;
-  std::unordered_map<std::string,StructDef> struct_defs;
+  // the var table index of each variable in scope (by name index)
+  FlatScopes<int> var_table;
+  std::unordered_map<std::string,const StructDef*> struct_defs;
+
+  // type names of the variables in scope, by var table index (for
+  // arrays, the element type name)
+  std::vector<std::string> var_types;
+
+  // add a variable to the var table, recording its type name, and
+  // return the index of a variable (-1 if it is not in scope)
+  void add_var(FlatIndex name, const std::string& type);
+  int var_index(FlatIndex token) const;
+
+  // start a function's frame (storing its params), and finish it (and
+  // add it to the vm)
+  void begin_function(const FlatFunDef& f);
+  void end_function(const FlatFunDef& f);
+
+  // generate a literal value, a binary operation (with the type of its
+  // operands, if known), a call (after its arguments), and a struct
+  // allocation
+  void push_value(TokenType type, const std::string& lexeme);
+  void push_op(TokenType op, OpType op_type);
+  void push_call(const std::string& fun_name);
+  void push_alloc(const std::string& type);
+
+  // the flat program being generated, and the tree definitions
+  // standing for its structs (a deque, so struct_defs stays valid as
+  // structs visited on their own are added)
+  const FlatAST* flat = nullptr;
+  std::deque<StructDef> flat_structs;
+
+  // flat program walk
+  void gen_block(FlatRange body);
+  void gen_stmt(FlatIndex s);
+  void gen_expr(FlatIndex e);
+
+  // generate a node visited on its own (see ProgramVisitor): a struct
+  // is recorded for the code that follows, a function is added to the
+  // vm, and a statement or expression is added to the current frame
+  void walk_struct_def(FlatAST& ast, FlatIndex s);
+  void walk_fun_def(FlatAST& ast, FlatIndex f);
+  void walk_stmt(FlatAST& ast, FlatIndex s);
+  void walk_expr(FlatAST& ast, FlatIndex e);
+
+  // returns the slot of the field in the struct type (or -1 if the
+  // struct or field is not known)
+  int field_slot(const std::string& type, const std::string& field) const;
+
+  // generate a field read of an object of the given struct type, which
+  // is then updated to the field's type ("" if unknown)
+  void get_field(std::string& type, const std::string& field);
+
+  // generate a field write of an object of the given struct type
+  void set_field(const std::string& type, const std::string& field);
 
 };
 
@@ -0,0 +1,581 @@
+//----------------------------------------------------------------------
+// FILE: constant_folder.cpp
+// DATE: Spring 2023
+// AUTH: Nisa Meshal
+// DESC: Constant folding and propagation implementation
+//----------------------------------------------------------------------
+
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+#include "constant_folder.h"
+
+using namespace std;
+
+
+// helper to make a literal token (positioned at the given token)
+static Token literal(TokenType type, const string& lexeme, const Token& at)
+{
+  return Token(type, lexeme, at.line(), at.column());
+}
+
+
+static Token bool_literal(bool val, const Token& at)
+{
+  return literal(TokenType::BOOL_VAL, val ? "true" : "false", at);
+}
+
+
+// helper to compare two values with the given comparison operator
+template<typename T>
+static optional<bool> compare(const T& x, TokenType op, const T& y)
+{
+  switch (op) {
+  case TokenType::EQUAL: return x == y;
+  case TokenType::NOT_EQUAL: return x != y;
+  case TokenType::LESS: return x < y;
+  case TokenType::LESS_EQ: return x <= y;
+  case TokenType::GREATER: return x > y;
+  case TokenType::GREATER_EQ: return x >= y;
+  default: return nullopt;
+  }
+}
+
+
+// helper to evaluate x op y the way the vm would (empty if the result
+// isn't known or the operation should be left to the vm)
+static optional<Token> fold_binary(const Token& x, const Token& op,
+                                   const Token& y)
+{
+  TokenType type = x.type();
+  // only equality is defined on null
+  if (type == TokenType::NULL_VAL or y.type() == TokenType::NULL_VAL) {
+    optional<bool> result = compare(type, op.type(), y.type());
+    if (!result or (op.type() != TokenType::EQUAL and
+                    op.type() != TokenType::NOT_EQUAL))
+      return nullopt;
+    return bool_literal(*result, x);
+  }
+  if (type != y.type())
+    return nullopt;
+  if (type == TokenType::INT_VAL) {
+    long long a = stoll(x.lexeme());
+    long long b = stoll(y.lexeme());
+    if (a < INT_MIN or a > INT_MAX or b < INT_MIN or b > INT_MAX)
+      return nullopt;
+    long long result;
+    switch (op.type()) {
+    case TokenType::PLUS: result = a + b; break;
+    case TokenType::MINUS: result = a - b; break;
+    case TokenType::TIMES: result = a * b; break;
+    case TokenType::DIVIDE:
+      if (b == 0)
+        return nullopt;
+      result = a / b;
+      break;
+    default:
+      optional<bool> cmp = compare(a, op.type(), b);
+      return cmp ? optional<Token>(bool_literal(*cmp, x)) : nullopt;
+    }
+    if (result < INT_MIN or result > INT_MAX)
+      return nullopt;
+    return literal(TokenType::INT_VAL, to_string(result), x);
+  }
+  if (type == TokenType::DOUBLE_VAL) {
+    double a = stod(x.lexeme());
+    double b = stod(y.lexeme());
+    double result;
+    switch (op.type()) {
+    case TokenType::PLUS: result = a + b; break;
+    case TokenType::MINUS: result = a - b; break;
+    case TokenType::TIMES: result = a * b; break;
+    case TokenType::DIVIDE: result = a / b; break;
+    default:
+      optional<bool> cmp = compare(a, op.type(), b);
+      return cmp ? optional<Token>(bool_literal(*cmp, x)) : nullopt;
+    }
+    if (!isfinite(result))
+      return nullopt;
+    // enough digits to read back the same double
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.17g", result);
+    return literal(TokenType::DOUBLE_VAL, buffer, x);
+  }
+  if (type == TokenType::BOOL_VAL) {
+    bool a = x.lexeme() == "true";
+    bool b = y.lexeme() == "true";
+    if (op.type() == TokenType::AND)
+      return bool_literal(a and b, x);
+    if (op.type() == TokenType::OR)
+      return bool_literal(a or b, x);
+    optional<bool> cmp = compare(a, op.type(), b);
+    return cmp ? optional<Token>(bool_literal(*cmp, x)) : nullopt;
+  }
+  // strings and chars compare by their text once escapes are replaced
+  // (by the code generator), so only compare those without escapes
+  if (type == TokenType::STRING_VAL or type == TokenType::CHAR_VAL) {
+    if (x.lexeme().find('\\') != string::npos or
+        y.lexeme().find('\\') != string::npos)
+      return nullopt;
+    optional<bool> cmp = compare(x.lexeme(), op.type(), y.lexeme());
+    return cmp ? optional<Token>(bool_literal(*cmp, x)) : nullopt;
+  }
+  return nullopt;
+}
+
+
+//----------------------------------------------------------------------
+// Folding a tree
+//----------------------------------------------------------------------
+
+void ConstantFolder::visit(Program& p)
+{
+  // (the tree is freed before its folded form is made)
+  FlatAST ast(p, false);
+  p = Program();
+  fold(ast);
+  p = ast.to_program();
+  arena = p.arena;
+}
+
+
+ASTArena& ConstantFolder::node_arena()
+{
+  if (!arena)
+    throw logic_error("a program is folded before any node on its own");
+  return *arena;
+}
+
+
+template<typename T>
+void ConstantFolder::fold_alone(T& s)
+{
+  FlatAST ast;
+  FlatIndex i = ast.add(static_cast<Stmt&>(s));
+  begin(ast);
+  fold_stmt(i);
+  s = std::move(*static_cast<T*>(ast.stmt(i, node_arena())));
+}
+
+
+void ConstantFolder::visit(FunDef& f)
+{
+  FlatAST ast;
+  FlatIndex i = ast.add(f);
+  begin(ast);
+  fold_fun_def(i);
+  f.stmts = ast.block(ast.fun_defs[i].body, node_arena());
+}
+
+
+void ConstantFolder::visit(StructDef& s)
+{
+}
+
+
+void ConstantFolder::visit(ReturnStmt& s) {fold_alone(s);}
+void ConstantFolder::visit(WhileStmt& s) {fold_alone(s);}
+void ConstantFolder::visit(ForStmt& s) {fold_alone(s);}
+void ConstantFolder::visit(IfStmt& s) {fold_alone(s);}
+void ConstantFolder::visit(VarDeclStmt& s) {fold_alone(s);}
+void ConstantFolder::visit(AssignStmt& s) {fold_alone(s);}
+
+
+void ConstantFolder::visit(CallExpr& e)
+{
+  for (Expr& arg : e.args)
+    arg.accept(*this);
+}
+
+
+void ConstantFolder::visit(Expr& e)
+{
+  FlatAST ast;
+  FlatIndex i = ast.add(e);
+  begin(ast);
+  fold_expr(i);
+  e = ast.expr(i, node_arena());
+}
+
+
+void ConstantFolder::visit(SimpleTerm& t)
+{
+  // (the term is replaced by its value, as it is in an expression)
+  FlatAST ast;
+  FlatIndex i = ast.add(t);
+  begin(ast);
+  fold_term(i);
+  if (curr_value != FLAT_NONE) {
+    ast.exprs[i].kind = FlatExprKind::VALUE;
+    ast.exprs[i].token = curr_value;
+    ast.exprs[i].children = {};
+  }
+  t = std::move(*static_cast<SimpleTerm*>(ast.expr(i, node_arena()).first));
+}
+
+
+void ConstantFolder::visit(ComplexTerm& t)
+{
+  t.expr.accept(*this);
+}
+
+
+void ConstantFolder::visit(SimpleRValue& v)
+{
+}
+
+
+void ConstantFolder::visit(NewRValue& v)
+{
+  if (v.array_expr)
+    v.array_expr->accept(*this);
+  if (v.array_expr_2D)
+    v.array_expr_2D->accept(*this);
+}
+
+
+void ConstantFolder::visit(VarRValue& v)
+{
+  for (VarRef& var : v.path) {
+    if (var.array_expr)
+      var.array_expr->accept(*this);
+    if (var.array_expr_2D)
+      var.array_expr_2D->accept(*this);
+  }
+}
+
+
+//----------------------------------------------------------------------
+// Flat program walk
+//----------------------------------------------------------------------
+
+void ConstantFolder::fold(FlatAST& ast)
+{
+  begin(ast);
+  for (FlatIndex f = 0; f < ast.fun_defs.size(); ++f)
+    fold_fun_def(f);
+}
+
+
+void ConstantFolder::begin(FlatAST& ast)
+{
+  flat = &ast;
+  var_decls.assign(ast.names.size(), 0);
+  var_values.assign(ast.names.size(), FLAT_NONE);
+  fun_vars.clear();
+}
+
+
+FlatIndex ConstantFolder::literal(TokenType type, string_view lexeme,
+                                  FlatIndex at)
+{
+  const FlatToken& t = flat->tokens[at];
+  FlatToken value {type, flat->intern(lexeme), t.line, t.column};
+  flat->tokens.push_back(value);
+  return flat->tokens.size() - 1;
+}
+
+
+FlatIndex ConstantFolder::literal(const Token& value)
+{
+  flat->tokens.push_back({value.type(), flat->intern(value.lexeme()),
+      value.line(), value.column()});
+  return flat->tokens.size() - 1;
+}
+
+
+optional<bool> ConstantFolder::bool_value(FlatIndex i) const
+{
+  const FlatExpr& e = flat->exprs[i];
+  if (e.negated or e.rest != FLAT_NONE or e.kind != FlatExprKind::VALUE or
+      flat->tokens[e.token].type != TokenType::BOOL_VAL)
+    return nullopt;
+  return flat->lexeme(e.token) == "true";
+}
+
+
+void ConstantFolder::declared(FlatIndex name)
+{
+  if (var_decls[name] == 0)
+    fun_vars.push_back(name);
+  if (var_decls[name] >= 0)
+    ++var_decls[name];
+}
+
+
+void ConstantFolder::assigned(FlatIndex name)
+{
+  if (var_decls[name] == 0)
+    fun_vars.push_back(name);
+  var_decls[name] = -1;
+}
+
+
+void ConstantFolder::scan_vars(FlatRange body)
+{
+  for (FlatIndex i = body.begin; i < body.end; ++i) {
+    const FlatStmt& s = flat->stmts[i];
+    switch (s.kind) {
+    case FlatStmtKind::VAR_DECL:
+      declared(flat->tokens[flat->vars[s.var].name].name);
+      break;
+    case FlatStmtKind::ASSIGN:
+      assigned(flat->tokens[flat->refs[s.path.begin].name].name);
+      break;
+    case FlatStmtKind::WHILE:
+      scan_vars(s.body);
+      break;
+    case FlatStmtKind::FOR: {
+      const FlatStmt& init = flat->stmts[s.init];
+      const FlatStmt& update = flat->stmts[s.update];
+      declared(flat->tokens[flat->vars[init.var].name].name);
+      assigned(flat->tokens[flat->refs[update.path.begin].name].name);
+      scan_vars(s.body);
+      break;
+    }
+    case FlatStmtKind::IF:
+      for (FlatIndex b = s.body.begin; b < s.body.end; ++b)
+        scan_vars(flat->branches[b].body);
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+
+void ConstantFolder::fold_fun_def(FlatIndex f)
+{
+  // only variables declared once and never assigned keep the value
+  // they are declared with (parameters are never propagated)
+  for (FlatIndex name : fun_vars) {
+    var_decls[name] = 0;
+    var_values[name] = FLAT_NONE;
+  }
+  fun_vars.clear();
+  const FlatFunDef& def = flat->fun_defs[f];
+  for (FlatIndex param = def.params.begin; param < def.params.end; ++param)
+    assigned(flat->tokens[flat->vars[param].name].name);
+  scan_vars(def.body);
+  fold_block(flat->fun_defs[f].body);
+}
+
+
+void ConstantFolder::fold_block(FlatRange& body)
+{
+  // the statements kept are moved down over those removed
+  FlatIndex kept = body.begin;
+  for (FlatIndex i = body.begin; i < body.end; ++i) {
+    fold_stmt(i);
+    const FlatStmt& s = flat->stmts[i];
+    // drop loops that never run and if statements left empty
+    if (s.kind == FlatStmtKind::WHILE) {
+      optional<bool> condition = bool_value(s.expr);
+      if (condition and !*condition)
+        continue;
+    }
+    if (s.kind == FlatStmtKind::IF) {
+      const FlatBranch& branch = flat->branches[s.body.begin];
+      optional<bool> condition = bool_value(branch.condition);
+      if (condition and *condition and branch.body.empty())
+        continue;
+    }
+    flat->stmts[kept++] = s;
+  }
+  body.end = kept;
+}
+
+
+void ConstantFolder::fold_stmt(FlatIndex i)
+{
+  FlatStmt& s = flat->stmts[i];
+  switch (s.kind) {
+  case FlatStmtKind::VAR_DECL: {
+    fold_expr(s.expr);
+    FlatIndex name = flat->tokens[flat->vars[s.var].name].name;
+    if (curr_value != FLAT_NONE and var_decls[name] == 1)
+      var_values[name] = curr_value;
+    break;
+  }
+  case FlatStmtKind::ASSIGN:
+    fold_path(s.path);
+    fold_expr(s.expr);
+    break;
+  case FlatStmtKind::CALL:
+    // (the call itself is kept)
+    fold_call(s.expr);
+    break;
+  case FlatStmtKind::RETURN:
+    fold_expr(s.expr);
+    break;
+  case FlatStmtKind::WHILE:
+    fold_expr(s.expr);
+    fold_block(s.body);
+    break;
+  case FlatStmtKind::FOR:
+    fold_stmt(s.init);
+    fold_expr(s.expr);
+    fold_block(s.body);
+    fold_stmt(s.update);
+    break;
+  case FlatStmtKind::IF: {
+    // keep the if and elseif branches that may run, up to the first
+    // one that always runs (whose statements become the else part)
+    FlatIndex kept = s.body.begin;
+    bool has_else = false;
+    FlatRange else_body;
+    for (FlatIndex b = s.body.begin; b < s.body.end; ++b) {
+      FlatBranch branch = flat->branches[b];
+      if (branch.condition == FLAT_NONE) {
+        fold_block(branch.body);
+        has_else = true;
+        else_body = branch.body;
+        break;
+      }
+      fold_expr(branch.condition);
+      optional<bool> condition = bool_value(branch.condition);
+      if (condition and !*condition)
+        continue;
+      fold_block(branch.body);
+      if (condition and *condition) {
+        has_else = true;
+        else_body = branch.body;
+        break;
+      }
+      flat->branches[kept++] = branch;
+    }
+    // with no conditions left the else part always runs
+    if (kept == s.body.begin) {
+      FlatIndex condition = flat->exprs.size();
+      flat->exprs.emplace_back();
+      flat->exprs[condition].token = literal(bool_literal(true, Token()));
+      flat->branches[kept++] = {condition, else_body};
+    }
+    else if (has_else)
+      flat->branches[kept++] = {FLAT_NONE, else_body};
+    s.body.end = kept;
+    break;
+  }
+  }
+}
+
+
+void ConstantFolder::fold_expr(FlatIndex i)
+{
+  FlatExpr& e = flat->exprs[i];
+  fold_term(i);
+  FlatIndex value = curr_value;
+  // a constant term (a parenthesized literal, or a constant call or
+  // variable) becomes a plain literal
+  if (value != FLAT_NONE) {
+    e.kind = FlatExprKind::VALUE;
+    e.token = value;
+    e.children = {};
+  }
+  if (e.rest != FLAT_NONE) {
+    fold_expr(e.rest);
+    FlatIndex rest_value = curr_value;
+    optional<Token> result;
+    if (value != FLAT_NONE and rest_value != FLAT_NONE)
+      result = fold_binary(flat->token(value), flat->token(e.op),
+                           flat->token(rest_value));
+    value = FLAT_NONE;
+    if (result) {
+      value = literal(*result);
+      e.token = value;
+      e.op = FLAT_NONE;
+      e.rest = FLAT_NONE;
+      e.op_type = OpType::NONE;
+    }
+  }
+  // not applies to the whole expression
+  if (value != FLAT_NONE and e.negated) {
+    if (flat->tokens[value].type == TokenType::BOOL_VAL) {
+      value = literal(bool_literal(flat->lexeme(value) != "true",
+                                   flat->token(value)));
+      e.token = value;
+      e.negated = false;
+    }
+    else
+      value = FLAT_NONE;
+  }
+  curr_value = value;
+}
+
+
+void ConstantFolder::fold_term(FlatIndex i)
+{
+  const FlatExpr& e = flat->exprs[i];
+  switch (e.kind) {
+  case FlatExprKind::VALUE:
+    curr_value = e.token;
+    break;
+  case FlatExprKind::NEW:
+    for (FlatIndex size = e.children.begin; size < e.children.end; ++size)
+      fold_expr(size);
+    curr_value = FLAT_NONE;
+    break;
+  case FlatExprKind::VAR: {
+    fold_path(e.children);
+    curr_value = FLAT_NONE;
+    const FlatRef& var = flat->refs[e.children.begin];
+    if (e.children.size() == 1 and var.array_expr == FLAT_NONE)
+      curr_value = var_values[flat->tokens[var.name].name];
+    break;
+  }
+  case FlatExprKind::CALL:
+    fold_call(i);
+    break;
+  case FlatExprKind::PAREN:
+    fold_expr(e.children.begin);
+    break;
+  }
+}
+
+
+void ConstantFolder::fold_call(FlatIndex i)
+{
+  const FlatExpr& e = flat->exprs[i];
+  // (only the values of the first two arguments are used)
+  FlatIndex args[2] = {FLAT_NONE, FLAT_NONE};
+  for (FlatIndex arg = e.children.begin; arg < e.children.end; ++arg) {
+    fold_expr(arg);
+    if (arg - e.children.begin < 2)
+      args[arg - e.children.begin] = curr_value;
+  }
+  curr_value = FLAT_NONE;
+  const string& name = flat->lexeme(e.token);
+  FlatIndex x = args[0];
+  if (name == "concat" and e.children.size() == 2 and x != FLAT_NONE and
+      args[1] != FLAT_NONE) {
+    // a trailing backslash would start an escape across the two strings
+    const string& x_lexeme = flat->lexeme(x);
+    if (x_lexeme.empty() or x_lexeme.back() != '\\')
+      curr_value = literal(TokenType::STRING_VAL,
+                           x_lexeme + flat->lexeme(args[1]), x);
+  }
+  else if (name == "to_string" and e.children.size() == 1 and
+           x != FLAT_NONE) {
+    const string& x_lexeme = flat->lexeme(x);
+    TokenType type = flat->tokens[x].type;
+    if (type == TokenType::INT_VAL)
+      curr_value = literal(TokenType::STRING_VAL, to_string(stoi(x_lexeme)), x);
+    else if (type == TokenType::DOUBLE_VAL)
+      curr_value = literal(TokenType::STRING_VAL, to_string(stod(x_lexeme)), x);
+    else if (type == TokenType::CHAR_VAL)
+      curr_value = literal(TokenType::STRING_VAL, x_lexeme, x);
+  }
+}
+
+
+void ConstantFolder::fold_path(FlatRange path)
+{
+  for (FlatIndex i = path.begin; i < path.end; ++i) {
+    const FlatRef& var = flat->refs[i];
+    if (var.array_expr != FLAT_NONE)
+      fold_expr(var.array_expr);
+    if (var.array_expr_2D != FLAT_NONE)
+      fold_expr(var.array_expr_2D);
+  }
+}
@@ -0,0 +1,129 @@
+//----------------------------------------------------------------------
+// FILE: constant_folder.h
+// DATE: Spring 2023
+// AUTH: Nisa Meshal
+// DESC: AST constant folding and propagation pass (run between the
+//       semantic checker and the code generator)
+//----------------------------------------------------------------------
+
+#ifndef CONSTANT_FOLDER_H
+#define CONSTANT_FOLDER_H
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "ast.h"
+#include "flat_ast.h"
+#include "token.h"
+
+
+// Rewrites a (checked) program in place. Expressions whose operands
+// are all literals are replaced by their value: arithmetic,
+// comparisons, boolean logic, negation, and the concat and to_string
+// built-ins. Uses of a variable declared once in its function with a
+// literal value and never assigned are replaced by that literal. If
+// statement branches with literal false conditions are removed (as is
+// everything after one with a literal true condition), as are while
+// loops with a literal false condition.
+//
+// Operations the vm would not perform the same way are left alone
+// (integer overflow, division by zero, non-finite doubles, and string
+// operations that depend on escape sequences).
+//
+// The folding is done on the flat encoding of the program (see
+// fold()); a tree is folded by encoding it and replacing it with the
+// tree form of the folded encoding.
+class ConstantFolder : public Visitor
+{
+public:
+
+  // fold a program (through its flat encoding, whose tree form then
+  // replaces the program)
+  void visit(Program& p);
+
+  // fold a node on its own (see FlatAST::add), replacing its children
+  // with their folded tree form, made in the arena of the program last
+  // folded (so a program is folded first)
+  void visit(FunDef& f);
+  void visit(StructDef& s);
+  void visit(ReturnStmt& s);
+  void visit(WhileStmt& s);
+  void visit(ForStmt& s);
+  void visit(IfStmt& s);
+  void visit(VarDeclStmt& s);
+  void visit(AssignStmt& s);
+  void visit(CallExpr& e);
+  void visit(Expr& e);
+  void visit(SimpleTerm& t);
+  void visit(ComplexTerm& t);
+  void visit(SimpleRValue& v);
+  void visit(NewRValue& v);
+  void visit(VarRValue& v);
+
+  // fold a (checked) flat program in place
+  void fold(FlatAST& ast);
+
+private:
+
+  // the arena of the program last folded (holding the nodes made for
+  // nodes folded on their own)
+  std::shared_ptr<ASTArena> arena;
+
+  // the flat program being folded
+  FlatAST* flat = nullptr;
+
+  // the literal value (token) of the last folded expression or term
+  // (FLAT_NONE if it isn't constant)
+  FlatIndex curr_value = FLAT_NONE;
+
+  // by name: the number of declarations of the variable in the current
+  // function (-1 for parameters and assigned variables, which are
+  // never propagated), and the literal value (token) of a propagated
+  // variable once it is declared
+  std::vector<int> var_decls;
+  std::vector<FlatIndex> var_values;
+
+  // the names given an entry above in the current function
+  std::vector<FlatIndex> fun_vars;
+
+  // start folding the flat program (or a node of it)
+  void begin(FlatAST& ast);
+
+  // the arena for the tree form of a node folded on its own
+  ASTArena& node_arena();
+
+  // add a literal token (positioned at the given token)
+  FlatIndex literal(TokenType type, std::string_view lexeme, FlatIndex at);
+  FlatIndex literal(const Token& value);
+
+  // the value of an expression that is just a bool literal
+  std::optional<bool> bool_value(FlatIndex e) const;
+
+  // record a declaration or assignment of a variable, and those made
+  // in the statements
+  void declared(FlatIndex name);
+  void assigned(FlatIndex name);
+  void scan_vars(FlatRange body);
+
+  // flat program walk: each statement of a block is folded, and those
+  // that can never run are removed (shrinking the block); a term's
+  // value is left in curr_value (the expression holding it replaces it
+  // by its value)
+  void fold_fun_def(FlatIndex f);
+  void fold_block(FlatRange& body);
+  void fold_stmt(FlatIndex s);
+  void fold_expr(FlatIndex e);
+  void fold_term(FlatIndex e);
+  void fold_call(FlatIndex e);
+  void fold_path(FlatRange path);
+
+  // fold a statement on its own, replacing it with its folded tree form
+  template<typename T>
+  void fold_alone(T& s);
+
+};
+
+
+#endif
@@ -0,0 +1,615 @@
+//----------------------------------------------------------------------
+// FILE: cpp_emitter.cpp
+// DATE: Spring 2023
+// AUTH: Nisa Meshal
+// DESC: Visitor that translates a checked MyPL program into a
+//       standalone C++ translation unit
+//----------------------------------------------------------------------
+
+#include <unordered_map>
+#include "cpp_emitter.h"
+#include "code_generator.h"
+
+using namespace std;
+
+
+// names are prefixed so they cannot clash with C++ keywords or the
+// runtime: v_ for variables, m_ for fields, f_ for functions, and s_
+// for structs
+
+static string var_name(const string& name) {return "v_" + name;}
+static string field_name(const string& name) {return "m_" + name;}
+static string fun_name(const string& name) {return "f_" + name;}
+static string struct_name(const string& name) {return "s_" + name;}
+
+
+// helper to check if an expression makes a call (whose side effects
+// could be seen by the other operands)
+static bool has_call(Expr& e);
+
+static bool has_call(ExprTerm& t)
+{
+  if (ComplexTerm* c = dynamic_cast<ComplexTerm*>(&t))
+    return has_call(c->expr);
+  RValue* v = static_cast<SimpleTerm&>(t).rvalue;
+  if (dynamic_cast<CallExpr*>(v))
+    return true;
+  if (NewRValue* n = dynamic_cast<NewRValue*>(v))
+    return (n->array_expr and has_call(*n->array_expr)) or
+      (n->array_expr_2D and has_call(*n->array_expr_2D));
+  if (VarRValue* r = dynamic_cast<VarRValue*>(v)) {
+    for (VarRef& ref : r->path)
+      if ((ref.array_expr and has_call(*ref.array_expr)) or
+          (ref.array_expr_2D and has_call(*ref.array_expr_2D)))
+        return true;
+  }
+  return false;
+}
+
+static bool has_call(Expr& e)
+{
+  return has_call(*e.first) or (e.rest and has_call(*e.rest));
+}
+
+
+// helpers to check if a term or expression is a single literal (which
+// needs no temporary to keep its place in the evaluation order)
+static bool is_literal(ExprTerm& t)
+{
+  SimpleTerm* s = dynamic_cast<SimpleTerm*>(&t);
+  return s and dynamic_cast<SimpleRValue*>(s->rvalue);
+}
+
+static bool is_literal(Expr& e)
+{
+  return !e.rest and !e.negated and is_literal(*e.first);
+}
+
+
+// helper to check if an expression's value can never be null, given
+// the variables known to never be null
+static bool non_null(Expr& e, const unordered_set<string>& natives)
+{
+  // operators either produce a value or report an error
+  if (e.rest or e.negated)
+    return true;
+  if (ComplexTerm* c = dynamic_cast<ComplexTerm*>(e.first))
+    return non_null(c->expr, natives);
+  RValue* v = static_cast<SimpleTerm&>(*e.first).rvalue;
+  if (SimpleRValue* s = dynamic_cast<SimpleRValue*>(v))
+    return s->value.type() != TokenType::NULL_VAL;
+  if (CallExpr* c = dynamic_cast<CallExpr*>(v)) {
+    static const unordered_set<string> built_ins = {"input", "to_string",
+      "to_int", "to_double", "length", "length@array", "get", "concat"};
+    return built_ins.contains(c->fun_name.lexeme());
+  }
+  if (VarRValue* r = dynamic_cast<VarRValue*>(v))
+    return r->path.size() == 1 and !r->path[0].array_expr and
+      natives.contains(r->path[0].var_name.lexeme());
+  return false;
+}
+
+
+// helper to gather a function's variable declarations and the values
+// assigned to plain variables, by variable name
+static void collect(ASTList<Stmt*> stmts,
+                    unordered_map<string, vector<DataType>>& decls,
+                    vector<pair<string, Expr*>>& assigns);
+
+static void collect(VarDeclStmt& s,
+                    unordered_map<string, vector<DataType>>& decls,
+                    vector<pair<string, Expr*>>& assigns)
+{
+  string name = s.var_def.var_name.lexeme();
+  decls[name].push_back(s.var_def.data_type);
+  assigns.push_back({name, &s.expr});
+}
+
+static void collect(AssignStmt& s,
+                    vector<pair<string, Expr*>>& assigns)
+{
+  if (s.lvalue.size() == 1 and !s.lvalue[0].array_expr)
+    assigns.push_back({s.lvalue[0].var_name.lexeme(), &s.expr});
+}
+
+static void collect(ASTList<Stmt*> stmts,
+                    unordered_map<string, vector<DataType>>& decls,
+                    vector<pair<string, Expr*>>& assigns)
+{
+  for (Stmt* stmt : stmts) {
+    if (VarDeclStmt* d = dynamic_cast<VarDeclStmt*>(stmt))
+      collect(*d, decls, assigns);
+    else if (AssignStmt* a = dynamic_cast<AssignStmt*>(stmt))
+      collect(*a, assigns);
+    else if (WhileStmt* w = dynamic_cast<WhileStmt*>(stmt))
+      collect(w->stmts, decls, assigns);
+    else if (ForStmt* f = dynamic_cast<ForStmt*>(stmt)) {
+      collect(f->var_decl, decls, assigns);
+      collect(f->assign_stmt, assigns);
+      collect(f->stmts, decls, assigns);
+    }
+    else if (IfStmt* i = dynamic_cast<IfStmt*>(stmt)) {
+      collect(i->if_part.stmts, decls, assigns);
+      for (BasicIf& else_if : i->else_ifs)
+        collect(else_if.stmts, decls, assigns);
+      collect(i->else_stmts, decls, assigns);
+    }
+  }
+}
+
+
+// helper to get the plain C++ type of a primitive mypl type (or "" if
+// it is not primitive)
+static string primitive_type(const string& type)
+{
+  if (type == "int" or type == "double" or type == "bool")
+    return type;
+  if (type == "string" or type == "char")
+    return "std::string";
+  return "";
+}
+
+
+// helper to get the runtime function of a binary operator (other than
+// !=, which negates eq)
+static string operator_function(TokenType op)
+{
+  switch (op) {
+  case TokenType::PLUS: return "add";
+  case TokenType::MINUS: return "sub";
+  case TokenType::TIMES: return "mul";
+  case TokenType::DIVIDE: return "div";
+  case TokenType::LESS: return "less";
+  case TokenType::LESS_EQ: return "less_eq";
+  case TokenType::GREATER: return "greater";
+  case TokenType::GREATER_EQ: return "greater_eq";
+  case TokenType::AND: return "logical_and";
+  case TokenType::OR: return "logical_or";
+  default: return "eq";
+  }
+}
+
+
+// helper to write a string value as a C++ literal
+static string string_literal(const string& s)
+{
+  string result = "std::string(\"";
+  for (char ch : s) {
+    if (ch == '"' or ch == '\\')
+      result += string("\\") + ch;
+    else if (ch == '\n')
+      result += "\\n";
+    else if (ch == '\t')
+      result += "\\t";
+    else
+      result += ch;
+  }
+  return result + "\")";
+}
+
+
+CppEmitter::CppEmitter(ostream& output)
+  : out(output)
+{
+}
+
+
+void CppEmitter::line(const string& s)
+{
+  out << string(indent, ' ') << s << endl;
+}
+
+
+void CppEmitter::flush_pending()
+{
+  for (const string& decl : pending)
+    line(decl);
+  pending.clear();
+}
+
+
+string CppEmitter::expr(Expr& e)
+{
+  e.accept(*this);
+  return curr_expr;
+}
+
+
+string CppEmitter::hoist(const string& expr)
+{
+  string temp = "t" + to_string(++temp_count);
+  pending.push_back("auto " + temp + " = " + expr + ";");
+  return temp;
+}
+
+
+void CppEmitter::stmt(Stmt& s)
+{
+  if (CallExpr* call = dynamic_cast<CallExpr*>(&s)) {
+    call->accept(*this);
+    flush_pending();
+    line(curr_expr + ";");
+  }
+  else
+    s.accept(*this);
+}
+
+
+void CppEmitter::block(ASTList<Stmt*> stmts)
+{
+  indent += INDENT_AMT;
+  for (Stmt* s : stmts)
+    stmt(*s);
+  indent -= INDENT_AMT;
+}
+
+
+string CppEmitter::slot_type(const DataType& type) const
+{
+  string primitive = primitive_type(type.type_name);
+  string slot = primitive != "" ? "mypl::Maybe<" + primitive + ">" :
+    "mypl::Ref<" + struct_name(type.type_name) + ">";
+  if (type.is_array)
+    return "mypl::Ref<mypl::Array<" + slot + ">>";
+  return slot;
+}
+
+
+string CppEmitter::var_type(const VarDef& var) const
+{
+  if (native_vars.contains(var.var_name.lexeme()))
+    return primitive_type(var.data_type.type_name);
+  return slot_type(var.data_type);
+}
+
+
+void CppEmitter::find_native_vars(FunDef& f)
+{
+  unordered_map<string, vector<DataType>> decls;
+  vector<pair<string, Expr*>> assigns;
+  collect(f.stmts, decls, assigns);
+  // candidates are declared with a single primitive (non array) type,
+  // and are not parameters (callers may pass null)
+  native_vars.clear();
+  for (auto& [name, types] : decls) {
+    bool candidate = true;
+    for (const DataType& type : types)
+      candidate = candidate and !type.is_array and
+        primitive_type(type.type_name) != "" and
+        type.type_name == types[0].type_name;
+    for (const VarDef& param : f.params)
+      candidate = candidate and param.var_name.lexeme() != name;
+    if (candidate)
+      native_vars.insert(name);
+  }
+  // drop the variables assigned a possibly null value until none are
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (auto& [name, value] : assigns) {
+      if (native_vars.contains(name) and !non_null(*value, native_vars)) {
+        native_vars.erase(name);
+        changed = true;
+      }
+    }
+  }
+}
+
+
+void CppEmitter::visit(Program& p)
+{
+  line("// generated from MyPL");
+  line("#include \"mypl_runtime.h\"");
+  line("");
+  for (StructDef& s : p.struct_defs)
+    line("struct " + struct_name(s.struct_name.lexeme()) + ";");
+  for (StructDef& s : p.struct_defs)
+    s.accept(*this);
+  line("");
+  // prototypes, so functions can call each other in any order
+  for (FunDef& f : p.fun_defs) {
+    native_vars.clear();
+    string params;
+    for (VarDef& param : f.params)
+      params += string(params == "" ? "" : ", ") + slot_type(param.data_type) +
+        " " + var_name(param.var_name.lexeme());
+    string ret = f.return_type.type_name == "void" ? "void" :
+      slot_type(f.return_type);
+    line(ret + " " + fun_name(f.fun_name.lexeme()) + "(" + params + ");");
+  }
+  for (FunDef& f : p.fun_defs)
+    f.accept(*this);
+  line("");
+  line("int main()");
+  line("{");
+  line("  return mypl::run(" + fun_name("main") + ");");
+  line("}");
+}
+
+
+void CppEmitter::visit(FunDef& f)
+{
+  find_native_vars(f);
+  void_function = f.return_type.type_name == "void";
+  temp_count = 0;
+  string params;
+  for (VarDef& param : f.params)
+    params += string(params == "" ? "" : ", ") + slot_type(param.data_type) +
+      " " + var_name(param.var_name.lexeme());
+  string ret = void_function ? "void" : slot_type(f.return_type);
+  line("");
+  line(ret + " " + fun_name(f.fun_name.lexeme()) + "(" + params + ")");
+  line("{");
+  block(f.stmts);
+  // like the vm, a function that runs off its end returns null
+  if (!void_function)
+    line("  return {};");
+  line("}");
+}
+
+
+void CppEmitter::visit(StructDef& s)
+{
+  line("");
+  line("struct " + struct_name(s.struct_name.lexeme()) + " : mypl::Object");
+  line("{");
+  for (VarDef& field : s.fields)
+    line("  " + slot_type(field.data_type) + " " +
+         field_name(field.var_name.lexeme()) + ";");
+  line("};");
+}
+
+
+void CppEmitter::visit(ReturnStmt& s)
+{
+  string value = expr(s.expr);
+  flush_pending();
+  if (!void_function)
+    line("return " + value + ";");
+  else {
+    if (!is_literal(s.expr))
+      line("(void) " + value + ";");
+    line("return;");
+  }
+}
+
+
+void CppEmitter::visit(WhileStmt& s)
+{
+  string condition = expr(s.condition);
+  if (pending.empty())
+    line("while (mypl::val(" + condition + ")) {");
+  else {
+    // the condition's temporaries are recomputed on each iteration
+    line("while (true) {");
+    indent += INDENT_AMT;
+    flush_pending();
+    line("if (!mypl::val(" + condition + "))");
+    line("  break;");
+    indent -= INDENT_AMT;
+  }
+  block(s.stmts);
+  line("}");
+}
+
+
+void CppEmitter::visit(ForStmt& s)
+{
+  line("{");
+  indent += INDENT_AMT;
+  s.var_decl.accept(*this);
+  string condition = expr(s.condition);
+  if (pending.empty())
+    line("while (mypl::val(" + condition + ")) {");
+  else {
+    line("while (true) {");
+    indent += INDENT_AMT;
+    flush_pending();
+    line("if (!mypl::val(" + condition + "))");
+    line("  break;");
+    indent -= INDENT_AMT;
+  }
+  indent += INDENT_AMT;
+  line("{");
+  block(s.stmts);
+  line("}");
+  s.assign_stmt.accept(*this);
+  indent -= INDENT_AMT;
+  line("}");
+  indent -= INDENT_AMT;
+  line("}");
+}
+
+
+void CppEmitter::visit(IfStmt& s)
+{
+  string condition = expr(s.if_part.condition);
+  flush_pending();
+  line("if (mypl::val(" + condition + ")) {");
+  block(s.if_part.stmts);
+  // an else if whose condition needs temporaries becomes an if nested
+  // in an else (closed at the end)
+  int nested = 0;
+  for (BasicIf& else_if : s.else_ifs) {
+    condition = expr(else_if.condition);
+    if (pending.empty())
+      line("} else if (mypl::val(" + condition + ")) {");
+    else {
+      line("} else {");
+      indent += INDENT_AMT;
+      ++nested;
+      flush_pending();
+      line("if (mypl::val(" + condition + ")) {");
+    }
+    block(else_if.stmts);
+  }
+  if (!s.else_stmts.empty()) {
+    line("} else {");
+    block(s.else_stmts);
+  }
+  line("}");
+  for (int i = 0; i < nested; ++i) {
+    indent -= INDENT_AMT;
+    line("}");
+  }
+}
+
+
+void CppEmitter::visit(VarDeclStmt& s)
+{
+  string value = expr(s.expr);
+  flush_pending();
+  string name = s.var_def.var_name.lexeme();
+  if (native_vars.contains(name))
+    value = "mypl::val(" + value + ")";
+  line(var_type(s.var_def) + " " + var_name(name) + " = " + value + ";");
+}
+
+
+void CppEmitter::visit(AssignStmt& s)
+{
+  string target = path(s.lvalue);
+  string value = expr(s.expr);
+  flush_pending();
+  if (s.lvalue.size() == 1 and !s.lvalue[0].array_expr and
+      native_vars.contains(s.lvalue[0].var_name.lexeme()))
+    value = "mypl::val(" + value + ")";
+  line(target + " = " + value + ";");
+}
+
+
+void CppEmitter::visit(CallExpr& e)
+{
+  // evaluate the arguments left to right
+  vector<string> args;
+  for (int i = 0; i < e.args.size(); ++i) {
+    string arg = expr(e.args[i]);
+    bool later_call = false;
+    for (int j = i + 1; j < e.args.size(); ++j)
+      later_call = later_call or has_call(e.args[j]);
+    if (later_call and !is_literal(e.args[i]))
+      arg = hoist(arg);
+    args.push_back(arg);
+  }
+  string name = e.fun_name.lexeme();
+  static const unordered_set<string> built_ins = {"print", "input",
+    "to_string", "to_int", "to_double", "length", "get", "concat"};
+  if (name == "length@array")
+    name = "mypl::length_array";
+  else if (built_ins.contains(name))
+    name = "mypl::" + name;
+  else
+    name = fun_name(name);
+  curr_expr = name + "(";
+  for (int i = 0; i < args.size(); ++i)
+    curr_expr += (i > 0 ? ", " : "") + args[i];
+  curr_expr += ")";
+}
+
+
+void CppEmitter::visit(Expr& e)
+{
+  e.first->accept(*this);
+  string lhs = curr_expr;
+  if (e.rest) {
+    if (has_call(*e.rest) and !is_literal(*e.first))
+      lhs = hoist(lhs);
+    string rhs = expr(*e.rest);
+    TokenType op = e.op->type();
+    if (op == TokenType::NOT_EQUAL)
+      curr_expr = "!mypl::eq(" + lhs + ", " + rhs + ")";
+    else
+      curr_expr = "mypl::" + operator_function(op) + "(" + lhs + ", " +
+        rhs + ")";
+  }
+  if (e.negated)
+    curr_expr = "mypl::logical_not(" + curr_expr + ")";
+}
+
+
+void CppEmitter::visit(SimpleTerm& t)
+{
+  t.rvalue->accept(*this);
+}
+
+
+void CppEmitter::visit(ComplexTerm& t)
+{
+  curr_expr = expr(t.expr);
+}
+
+
+void CppEmitter::visit(SimpleRValue& v)
+{
+  TokenType type = v.value.type();
+  if (type == TokenType::INT_VAL or type == TokenType::BOOL_VAL)
+    curr_expr = v.value.lexeme();
+  else if (type == TokenType::DOUBLE_VAL)
+    // folded constants may be written without a decimal point
+    curr_expr = "double(" + v.value.lexeme() + ")";
+  else if (type == TokenType::NULL_VAL)
+    curr_expr = "mypl::null";
+  else {
+    string s = v.value.lexeme();
+    replace_all(s, "\\n", "\n");
+    replace_all(s, "\\t", "\t");
+    replace_all(s, "\\'", "\'");
+    curr_expr = string_literal(s);
+  }
+}
+
+
+void CppEmitter::visit(NewRValue& v)
+{
+  string type = v.type.lexeme();
+  if (!v.array_expr) {
+    curr_expr = "mypl::make<" + struct_name(type) + ">()";
+    return;
+  }
+  string element = slot_type(DataType {false, type});
+  if (v.array_expr_2D) {
+    // the vm evaluates the column count first
+    string columns = expr(*v.array_expr_2D);
+    if (has_call(*v.array_expr) and !is_literal(*v.array_expr_2D))
+      columns = hoist(columns);
+    string rows = expr(*v.array_expr);
+    curr_expr = "mypl::new_array<" + element + ">(" + rows + ", " +
+      columns + ")";
+  }
+  else
+    curr_expr = "mypl::new_array<" + element + ">(" +
+      expr(*v.array_expr) + ")";
+}
+
+
+void CppEmitter::visit(VarRValue& v)
+{
+  curr_expr = path(v.path);
+}
+
+
+string CppEmitter::path(ASTList<VarRef> refs)
+{
+  string result = var_name(refs[0].var_name.lexeme());
+  for (int i = 0; i < refs.size(); ++i) {
+    VarRef& ref = refs[i];
+    if (i > 0)
+      result += "->" + field_name(ref.var_name.lexeme());
+    if (!ref.array_expr)
+      continue;
+    bool calls = has_call(*ref.array_expr) or
+      (ref.array_expr_2D and has_call(*ref.array_expr_2D));
+    if (calls)
+      result = hoist(result);
+    string index = expr(*ref.array_expr);
+    if (ref.array_expr_2D) {
+      if (has_call(*ref.array_expr_2D) and !is_literal(*ref.array_expr))
+        index = hoist(index);
+      result = "mypl::at(" + result + ", " + index + ", " +
+        expr(*ref.array_expr_2D) + ")";
+    }
+    else
+      result = "mypl::at(" + result + ", " + index + ")";
+  }
+  return result;
+}
@@ -0,0 +1,105 @@
+//----------------------------------------------------------------------
+// FILE: cpp_emitter.h
+// DATE: Spring 2023
+// AUTH: Nisa Meshal
+// DESC: Visitor that translates a checked MyPL program into a
+//       standalone C++ translation unit
+//----------------------------------------------------------------------
+
+#ifndef CPP_EMITTER_H
+#define CPP_EMITTER_H
+
+#include <ostream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "ast.h"
+
+
+// Writes a C++ translation unit with the same behavior as the vm code
+// for the program (which must have passed the semantic checker). The
+// output includes mypl_runtime.h, so it builds with, e.g.,
+//
+//   g++ -std=c++20 -O2 -pthread -I src out.cpp
+//
+// Local variables of primitive type that are never assigned a
+// possibly null value become plain C++ ints, doubles, bools, and
+// strings; everything else uses the runtime's nullable Maybe and Ref
+// types. Operands are evaluated left to right as in the vm (an operand
+// is moved into a temporary when a later operand makes a call).
+class CppEmitter : public Visitor {
+public:
+  CppEmitter(std::ostream& output);
+  void visit(Program& p);
+  void visit(FunDef& f);
+  void visit(StructDef& s);
+  void visit(ReturnStmt& s);
+  void visit(WhileStmt& s);
+  void visit(ForStmt& s);
+  void visit(IfStmt& s);
+  void visit(VarDeclStmt& s);
+  void visit(AssignStmt& s);
+  void visit(CallExpr& e);
+  void visit(Expr& e);
+  void visit(SimpleTerm& t);
+  void visit(ComplexTerm& t);
+  void visit(SimpleRValue& v);
+  void visit(NewRValue& v);
+  void visit(VarRValue& v);
+
+private:
+  std::ostream& out;
+  int indent = 0;
+  const int INDENT_AMT = 2;
+
+  // the C++ expression for the last visited expression, term, or
+  // rvalue
+  std::string curr_expr;
+
+  // declarations of the temporaries the current statement's
+  // expressions use, to be written just before it
+  std::vector<std::string> pending;
+  int temp_count = 0;
+
+  // the names of the current function's variables that are never null
+  // (declared as plain C++ types)
+  std::unordered_set<std::string> native_vars;
+
+  // true if the current function returns void
+  bool void_function = false;
+
+  // write a line at the current indentation
+  void line(const std::string& s);
+
+  // write (and clear) the pending temporaries
+  void flush_pending();
+
+  // returns the C++ for an expression
+  std::string expr(Expr& e);
+
+  // returns a temporary holding the value of the C++ expression
+  std::string hoist(const std::string& expr);
+
+  // write a statement (a call statement's result is discarded)
+  void stmt(Stmt& s);
+
+  // write a braced block of statements
+  void block(ASTList<Stmt*> stmts);
+
+  // returns the C++ for a variable path, given as a variable reference
+  std::string path(ASTList<VarRef> path);
+
+  // returns the C++ type of a variable, field, or array element that
+  // may be null (for arrays, of the array reference)
+  std::string slot_type(const DataType& type) const;
+
+  // returns the C++ type of a declared variable
+  std::string var_type(const VarDef& var) const;
+
+  // finds the function's never null variables
+  void find_native_vars(FunDef& f);
+
+};
+
+
+#endif
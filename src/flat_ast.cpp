@@ -0,0 +1,807 @@
+//----------------------------------------------------------------------
+// FILE: flat_ast.cpp
+// DATE: Spring 2023
+// AUTH: Nisa Meshal
+// DESC: Flat program encoding (from and back to the tree)
+//----------------------------------------------------------------------
+
+#include "flat_ast.h"
+
+using namespace std;
+
+
+//----------------------------------------------------------------------
+// Encoding a tree
+//----------------------------------------------------------------------
+
+namespace {
+
+// Appends the nodes of a program to a flat program. Each node's slot is
+// reserved (along with those of its siblings) before its children are
+// added, so siblings are contiguous. Statement and term visits fill in
+// the slot given by stmt_at and expr_at.
+class Flattener : public Visitor
+{
+public:
+
+  Flattener(FlatAST& ast) : ast(ast) {}
+
+  void visit(Program& p);
+  void visit(FunDef& f);
+  void visit(StructDef& s);
+  void visit(ReturnStmt& s);
+  void visit(WhileStmt& s);
+  void visit(ForStmt& s);
+  void visit(IfStmt& s);
+  void visit(VarDeclStmt& s);
+  void visit(AssignStmt& s);
+  void visit(CallExpr& e);
+  void visit(Expr& e);
+  void visit(SimpleTerm& t);
+  void visit(ComplexTerm& t);
+  void visit(SimpleRValue& v);
+  void visit(NewRValue& v);
+  void visit(VarRValue& v);
+
+  // add a statement, expression, or term (or rvalue) on its own
+  FlatIndex stmt(Stmt& s);
+  FlatIndex expr(Expr& e);
+  FlatIndex term(ASTNode& t);
+
+private:
+
+  FlatAST& ast;
+
+  // the slots to fill, and whether a call is a statement (rather than
+  // a term)
+  FlatIndex stmt_at = FLAT_NONE;
+  FlatIndex expr_at = FLAT_NONE;
+  bool call_stmt = false;
+
+  // reserve count slots at the end of the nodes (and, for
+  // expressions, of their tree nodes)
+  template<typename T>
+  FlatRange reserve(vector<T>& nodes, size_t count);
+  FlatRange reserve_exprs(size_t count);
+
+  FlatIndex token(const Token& t);
+  FlatType type(const DataType& t);
+
+  // fill in a reserved slot
+  void stmt(Stmt& s, FlatIndex at);
+  void expr(Expr& e, FlatIndex at);
+
+  // add a run of nodes
+  FlatRange block(ASTList<Stmt*> s);
+  FlatRange path(ASTList<VarRef> path);
+  FlatRange var_defs(vector<VarDef>& defs);
+};
+
+
+template<typename T>
+FlatRange Flattener::reserve(vector<T>& nodes, size_t count)
+{
+  FlatRange range {FlatIndex(nodes.size()), FlatIndex(nodes.size() + count)};
+  nodes.resize(range.end);
+  return range;
+}
+
+
+FlatRange Flattener::reserve_exprs(size_t count)
+{
+  FlatRange range = reserve(ast.exprs, count);
+  if (ast.records_nodes()) {
+    ast.expr_nodes.resize(range.end);
+    ast.call_nodes.resize(range.end);
+  }
+  return range;
+}
+
+
+FlatIndex Flattener::token(const Token& t)
+{
+  ast.tokens.push_back({t.type(), ast.intern(t.lexeme_view()), t.line(),
+      t.column()});
+  return ast.tokens.size() - 1;
+}
+
+
+FlatType Flattener::type(const DataType& t)
+{
+  return {t.is_array, ast.intern(t.type_name)};
+}
+
+
+void Flattener::stmt(Stmt& s, FlatIndex at)
+{
+  stmt_at = at;
+  call_stmt = true;
+  s.accept(*this);
+}
+
+
+void Flattener::expr(Expr& e, FlatIndex at)
+{
+  if (ast.records_nodes())
+    ast.expr_nodes[at] = &e;
+  ast.exprs[at].negated = e.negated;
+  expr_at = at;
+  e.first->accept(*this);
+  if (e.op) {
+    FlatIndex op = token(*e.op);
+    ast.exprs[at].op = op;
+  }
+  if (e.rest) {
+    FlatIndex rest = expr(*e.rest);
+    ast.exprs[at].rest = rest;
+  }
+  ast.exprs[at].op_type = e.op_type;
+}
+
+
+FlatIndex Flattener::expr(Expr& e)
+{
+  FlatIndex at = reserve_exprs(1).begin;
+  expr(e, at);
+  return at;
+}
+
+
+FlatIndex Flattener::stmt(Stmt& s)
+{
+  FlatIndex at = reserve(ast.stmts, 1).begin;
+  stmt(s, at);
+  return at;
+}
+
+
+FlatIndex Flattener::term(ASTNode& t)
+{
+  FlatIndex at = reserve_exprs(1).begin;
+  expr_at = at;
+  call_stmt = false;
+  t.accept(*this);
+  return at;
+}
+
+
+FlatRange Flattener::block(ASTList<Stmt*> s)
+{
+  FlatRange range = reserve(ast.stmts, s.size());
+  for (FlatIndex i = 0; i < s.size(); ++i)
+    stmt(*s[i], range.begin + i);
+  return range;
+}
+
+
+FlatRange Flattener::path(ASTList<VarRef> path)
+{
+  FlatRange range = reserve(ast.refs, path.size());
+  for (FlatIndex i = 0; i < path.size(); ++i) {
+    FlatRef ref {token(path[i].var_name), FLAT_NONE, FLAT_NONE};
+    if (path[i].array_expr.has_value())
+      ref.array_expr = expr(*path[i].array_expr);
+    if (path[i].array_expr_2D.has_value())
+      ref.array_expr_2D = expr(*path[i].array_expr_2D);
+    ast.refs[range.begin + i] = ref;
+  }
+  return range;
+}
+
+
+FlatRange Flattener::var_defs(vector<VarDef>& defs)
+{
+  FlatRange range = reserve(ast.vars, defs.size());
+  for (FlatIndex i = 0; i < defs.size(); ++i)
+    ast.vars[range.begin + i] = {type(defs[i].data_type),
+                                 token(defs[i].var_name)};
+  return range;
+}
+
+
+void Flattener::visit(Program& p)
+{
+  for (auto& struct_def : p.struct_defs)
+    struct_def.accept(*this);
+  for (auto& fun_def : p.fun_defs)
+    fun_def.accept(*this);
+}
+
+
+void Flattener::visit(StructDef& s)
+{
+  FlatStructDef def {token(s.struct_name), var_defs(s.fields)};
+  ast.struct_defs.push_back(def);
+}
+
+
+void Flattener::visit(FunDef& f)
+{
+  FlatFunDef def {type(f.return_type), token(f.fun_name), var_defs(f.params),
+                  block(f.stmts)};
+  ast.fun_defs.push_back(def);
+}
+
+
+void Flattener::visit(ReturnStmt& s)
+{
+  FlatStmt flat {FlatStmtKind::RETURN, FLAT_NONE, FLAT_NONE, FLAT_NONE, FLAT_NONE,
+    {}, {}};
+  FlatIndex at = stmt_at;
+  call_stmt = false;
+  flat.expr = expr(s.expr);
+  ast.stmts[at] = flat;
+}
+
+
+void Flattener::visit(WhileStmt& s)
+{
+  FlatStmt flat {FlatStmtKind::WHILE, FLAT_NONE, FLAT_NONE, FLAT_NONE, FLAT_NONE,
+    {}, {}};
+  FlatIndex at = stmt_at;
+  call_stmt = false;
+  flat.expr = expr(s.condition);
+  flat.body = block(s.stmts);
+  ast.stmts[at] = flat;
+}
+
+
+void Flattener::visit(ForStmt& s)
+{
+  FlatStmt flat {FlatStmtKind::FOR, FLAT_NONE, FLAT_NONE, FLAT_NONE, FLAT_NONE,
+    {}, {}};
+  FlatIndex at = stmt_at;
+  call_stmt = false;
+  flat.init = reserve(ast.stmts, 1).begin;
+  stmt(s.var_decl, flat.init);
+  flat.expr = expr(s.condition);
+  flat.update = reserve(ast.stmts, 1).begin;
+  stmt(s.assign_stmt, flat.update);
+  flat.body = block(s.stmts);
+  ast.stmts[at] = flat;
+}
+
+
+void Flattener::visit(IfStmt& s)
+{
+  FlatStmt flat {FlatStmtKind::IF, FLAT_NONE, FLAT_NONE, FLAT_NONE, FLAT_NONE,
+    {}, {}};
+  FlatIndex at = stmt_at;
+  call_stmt = false;
+  size_t count = 1 + s.else_ifs.size() + (s.else_stmts.empty() ? 0 : 1);
+  flat.body = reserve(ast.branches, count);
+  FlatIndex i = flat.body.begin;
+  FlatBranch branch {expr(s.if_part.condition), block(s.if_part.stmts)};
+  ast.branches[i++] = branch;
+  for (auto& else_if : s.else_ifs) {
+    branch = {expr(else_if.condition), block(else_if.stmts)};
+    ast.branches[i++] = branch;
+  }
+  if (!s.else_stmts.empty()) {
+    branch = {FLAT_NONE, block(s.else_stmts)};
+    ast.branches[i++] = branch;
+  }
+  ast.stmts[at] = flat;
+}
+
+
+void Flattener::visit(VarDeclStmt& s)
+{
+  FlatStmt flat {FlatStmtKind::VAR_DECL, FLAT_NONE, FLAT_NONE, FLAT_NONE, FLAT_NONE,
+    {}, {}};
+  FlatIndex at = stmt_at;
+  call_stmt = false;
+  flat.var = reserve(ast.vars, 1).begin;
+  ast.vars[flat.var] = {type(s.var_def.data_type), token(s.var_def.var_name)};
+  flat.expr = expr(s.expr);
+  ast.stmts[at] = flat;
+}
+
+
+void Flattener::visit(AssignStmt& s)
+{
+  FlatStmt flat {FlatStmtKind::ASSIGN, FLAT_NONE, FLAT_NONE, FLAT_NONE, FLAT_NONE,
+    {}, {}};
+  FlatIndex at = stmt_at;
+  call_stmt = false;
+  flat.path = path(s.lvalue);
+  flat.expr = expr(s.expr);
+  ast.stmts[at] = flat;
+}
+
+
+void Flattener::visit(CallExpr& e)
+{
+  // a call statement is a statement holding a call term
+  if (call_stmt) {
+    call_stmt = false;
+    FlatIndex call = reserve_exprs(1).begin;
+    ast.stmts[stmt_at] = {FlatStmtKind::CALL, FLAT_NONE, call, FLAT_NONE,
+      FLAT_NONE, {}, {}};
+    expr_at = call;
+  }
+  FlatIndex at = expr_at;
+  FlatIndex name = token(e.fun_name);
+  FlatRange args = reserve_exprs(e.args.size());
+  for (FlatIndex i = 0; i < e.args.size(); ++i)
+    expr(e.args[i], args.begin + i);
+  ast.exprs[at].kind = FlatExprKind::CALL;
+  ast.exprs[at].token = name;
+  ast.exprs[at].children = args;
+  if (ast.records_nodes())
+    ast.call_nodes[at] = &e;
+}
+
+
+void Flattener::visit(Expr& e)
+{
+  expr(e, expr_at);
+}
+
+
+void Flattener::visit(SimpleTerm& t)
+{
+  t.rvalue->accept(*this);
+}
+
+
+void Flattener::visit(ComplexTerm& t)
+{
+  FlatIndex at = expr_at;
+  FlatRange inner = reserve_exprs(1);
+  expr(t.expr, inner.begin);
+  ast.exprs[at].kind = FlatExprKind::PAREN;
+  ast.exprs[at].children = inner;
+}
+
+
+void Flattener::visit(SimpleRValue& v)
+{
+  ast.exprs[expr_at].kind = FlatExprKind::VALUE;
+  ast.exprs[expr_at].token = token(v.value);
+}
+
+
+void Flattener::visit(NewRValue& v)
+{
+  FlatIndex at = expr_at;
+  FlatIndex type = token(v.type);
+  size_t count = v.array_expr_2D.has_value() ? 2 :
+    v.array_expr.has_value() ? 1 : 0;
+  FlatRange sizes = reserve_exprs(count);
+  if (count > 0)
+    expr(*v.array_expr, sizes.begin);
+  if (count > 1)
+    expr(*v.array_expr_2D, sizes.begin + 1);
+  ast.exprs[at].kind = FlatExprKind::NEW;
+  ast.exprs[at].token = type;
+  ast.exprs[at].children = sizes;
+}
+
+
+void Flattener::visit(VarRValue& v)
+{
+  FlatIndex at = expr_at;
+  FlatRange refs = path(v.path);
+  ast.exprs[at].kind = FlatExprKind::VAR;
+  ast.exprs[at].children = refs;
+}
+
+
+//----------------------------------------------------------------------
+// Decoding back to a tree
+//----------------------------------------------------------------------
+
+// Builds the tree nodes of a flat program in the arena of the program
+// being built.
+class Unflattener
+{
+public:
+
+  Unflattener(const FlatAST& ast, ASTArena& arena)
+    : ast(ast), arena(arena) {}
+
+  Expr expr(FlatIndex i);
+  Stmt* stmt(FlatIndex i);
+  ASTList<Stmt*> block(FlatRange range);
+  ASTList<VarRef> path(FlatRange range);
+
+private:
+
+  const FlatAST& ast;
+  ASTArena& arena;
+
+  CallExpr call(const FlatExpr& e);
+  VarDeclStmt var_decl(const FlatStmt& s);
+  AssignStmt assign(const FlatStmt& s);
+};
+
+
+Expr Unflattener::expr(FlatIndex i)
+{
+  const FlatExpr& flat = ast.exprs[i];
+  Expr e;
+  e.negated = flat.negated;
+  if (flat.kind == FlatExprKind::PAREN) {
+    ComplexTerm* term = arena.make<ComplexTerm>();
+    term->expr = expr(flat.children.begin);
+    e.first = term;
+  }
+  else {
+    SimpleTerm* term = arena.make<SimpleTerm>();
+    if (flat.kind == FlatExprKind::VALUE) {
+      SimpleRValue* value = arena.make<SimpleRValue>();
+      value->value = ast.token(flat.token);
+      term->rvalue = value;
+    }
+    else if (flat.kind == FlatExprKind::NEW) {
+      NewRValue* value = arena.make<NewRValue>();
+      value->type = ast.token(flat.token);
+      if (flat.children.size() > 0)
+        value->array_expr = expr(flat.children.begin);
+      if (flat.children.size() > 1)
+        value->array_expr_2D = expr(flat.children.begin + 1);
+      term->rvalue = value;
+    }
+    else if (flat.kind == FlatExprKind::VAR) {
+      VarRValue* value = arena.make<VarRValue>();
+      value->path = path(flat.children);
+      term->rvalue = value;
+    }
+    else
+      term->rvalue = arena.make<CallExpr>(call(flat));
+    e.first = term;
+  }
+  if (flat.op != FLAT_NONE)
+    e.op = arena.make<Token>(ast.token(flat.op));
+  if (flat.rest != FLAT_NONE)
+    e.rest = arena.make<Expr>(expr(flat.rest));
+  e.op_type = flat.op_type;
+  return e;
+}
+
+
+CallExpr Unflattener::call(const FlatExpr& e)
+{
+  CallExpr call;
+  call.fun_name = ast.token(e.token);
+  vector<Expr> args;
+  args.reserve(e.children.size());
+  for (FlatIndex i = e.children.begin; i < e.children.end; ++i)
+    args.push_back(expr(i));
+  call.args = arena.make_list(args);
+  return call;
+}
+
+
+VarDeclStmt Unflattener::var_decl(const FlatStmt& s)
+{
+  const FlatVar& var = ast.vars[s.var];
+  VarDeclStmt decl;
+  decl.var_def = {ast.data_type(var.type), ast.token(var.name)};
+  decl.expr = expr(s.expr);
+  return decl;
+}
+
+
+AssignStmt Unflattener::assign(const FlatStmt& s)
+{
+  AssignStmt assign;
+  assign.lvalue = path(s.path);
+  assign.expr = expr(s.expr);
+  return assign;
+}
+
+
+Stmt* Unflattener::stmt(FlatIndex i)
+{
+  const FlatStmt& s = ast.stmts[i];
+  switch (s.kind) {
+  case FlatStmtKind::VAR_DECL:
+    return arena.make<VarDeclStmt>(var_decl(s));
+  case FlatStmtKind::ASSIGN:
+    return arena.make<AssignStmt>(assign(s));
+  case FlatStmtKind::CALL:
+    return arena.make<CallExpr>(call(ast.exprs[s.expr]));
+  case FlatStmtKind::RETURN: {
+    ReturnStmt* r = arena.make<ReturnStmt>();
+    r->expr = expr(s.expr);
+    return r;
+  }
+  case FlatStmtKind::WHILE: {
+    WhileStmt* w = arena.make<WhileStmt>();
+    w->condition = expr(s.expr);
+    w->stmts = block(s.body);
+    return w;
+  }
+  case FlatStmtKind::FOR: {
+    ForStmt* f = arena.make<ForStmt>();
+    f->var_decl = var_decl(ast.stmts[s.init]);
+    f->condition = expr(s.expr);
+    f->assign_stmt = assign(ast.stmts[s.update]);
+    f->stmts = block(s.body);
+    return f;
+  }
+  case FlatStmtKind::IF: {
+    IfStmt* f = arena.make<IfStmt>();
+    vector<BasicIf> else_ifs;
+    for (FlatIndex b = s.body.begin; b < s.body.end; ++b) {
+      const FlatBranch& branch = ast.branches[b];
+      if (branch.condition == FLAT_NONE)
+        f->else_stmts = block(branch.body);
+      else if (b == s.body.begin)
+        f->if_part = {expr(branch.condition), block(branch.body)};
+      else
+        else_ifs.push_back({expr(branch.condition), block(branch.body)});
+    }
+    f->else_ifs = arena.make_list(else_ifs);
+    return f;
+  }
+  }
+  return nullptr;
+}
+
+
+ASTList<Stmt*> Unflattener::block(FlatRange range)
+{
+  vector<Stmt*> s;
+  s.reserve(range.size());
+  for (FlatIndex i = range.begin; i < range.end; ++i)
+    s.push_back(stmt(i));
+  return arena.make_list(s);
+}
+
+
+ASTList<VarRef> Unflattener::path(FlatRange range)
+{
+  vector<VarRef> path(range.size());
+  for (FlatIndex i = 0; i < range.size(); ++i) {
+    const FlatRef& ref = ast.refs[range.begin + i];
+    path[i].var_name = ast.token(ref.name);
+    if (ref.array_expr != FLAT_NONE)
+      path[i].array_expr = expr(ref.array_expr);
+    if (ref.array_expr_2D != FLAT_NONE)
+      path[i].array_expr_2D = expr(ref.array_expr_2D);
+  }
+  return arena.make_list(path);
+}
+
+
+
+}
+
+
+//----------------------------------------------------------------------
+// FlatAST
+//----------------------------------------------------------------------
+
+FlatAST::FlatAST(Program& p, bool record_nodes)
+  : record_nodes(record_nodes)
+{
+  Flattener flattener(*this);
+  p.accept(flattener);
+}
+
+
+const string& FlatAST::lexeme(FlatIndex token) const
+{
+  return names[tokens[token].name];
+}
+
+
+Token FlatAST::token(FlatIndex token) const
+{
+  const FlatToken& t = tokens[token];
+  return Token(t.type, names[t.name], t.line, t.column);
+}
+
+
+DataType FlatAST::data_type(const FlatType& type) const
+{
+  return {type.is_array, names[type.name]};
+}
+
+
+FlatIndex FlatAST::intern(string_view name)
+{
+  auto entry = name_indexes.find(name);
+  if (entry != name_indexes.end())
+    return entry->second;
+  names.emplace_back(name);
+  name_indexes.emplace(string(name), names.size() - 1);
+  return names.size() - 1;
+}
+
+
+FlatIndex FlatAST::add(StructDef& s)
+{
+  Flattener flattener(*this);
+  s.accept(flattener);
+  return struct_defs.size() - 1;
+}
+
+
+FlatIndex FlatAST::add(FunDef& f)
+{
+  Flattener flattener(*this);
+  f.accept(flattener);
+  return fun_defs.size() - 1;
+}
+
+
+FlatIndex FlatAST::add(Stmt& s)
+{
+  Flattener flattener(*this);
+  return flattener.stmt(s);
+}
+
+
+FlatIndex FlatAST::add(Expr& e)
+{
+  Flattener flattener(*this);
+  return flattener.expr(e);
+}
+
+
+FlatIndex FlatAST::add(ExprTerm& t)
+{
+  Flattener flattener(*this);
+  return flattener.term(t);
+}
+
+
+FlatIndex FlatAST::add(RValue& v)
+{
+  Flattener flattener(*this);
+  return flattener.term(v);
+}
+
+
+void FlatAST::annotate_tree() const
+{
+  for (FlatIndex i = 0; i < expr_nodes.size(); ++i) {
+    const FlatExpr& e = exprs[i];
+    if (e.op != FLAT_NONE)
+      expr_nodes[i]->op_type = e.op_type;
+    if (e.kind == FlatExprKind::CALL &&
+        call_nodes[i]->fun_name.lexeme() != lexeme(e.token))
+      call_nodes[i]->fun_name = token(e.token);
+  }
+}
+
+
+vector<VarDef> FlatAST::var_defs(FlatRange range) const
+{
+  vector<VarDef> defs;
+  defs.reserve(range.size());
+  for (FlatIndex i = range.begin; i < range.end; ++i)
+    defs.push_back({data_type(vars[i].type), token(vars[i].name)});
+  return defs;
+}
+
+
+StructDef FlatAST::struct_def(const FlatStructDef& s) const
+{
+  StructDef def;
+  def.struct_name = token(s.name);
+  def.fields = var_defs(s.fields);
+  return def;
+}
+
+
+FunDef FlatAST::fun_signature(const FlatFunDef& f) const
+{
+  FunDef def;
+  def.return_type = data_type(f.return_type);
+  def.fun_name = token(f.name);
+  def.params = var_defs(f.params);
+  return def;
+}
+
+
+Program FlatAST::to_program() const
+{
+  Program p;
+  Unflattener unflattener(*this, *p.arena);
+  for (const FlatStructDef& s : struct_defs)
+    p.struct_defs.push_back(struct_def(s));
+  for (const FlatFunDef& f : fun_defs) {
+    p.fun_defs.push_back(fun_signature(f));
+    p.fun_defs.back().stmts = unflattener.block(f.body);
+  }
+  return p;
+}
+
+
+ASTList<Stmt*> FlatAST::block(FlatRange body, ASTArena& arena) const
+{
+  return Unflattener(*this, arena).block(body);
+}
+
+
+Stmt* FlatAST::stmt(FlatIndex s, ASTArena& arena) const
+{
+  return Unflattener(*this, arena).stmt(s);
+}
+
+
+Expr FlatAST::expr(FlatIndex e, ASTArena& arena) const
+{
+  return Unflattener(*this, arena).expr(e);
+}
+
+
+void FlatAST::accept(Visitor& v)
+{
+  Program p = to_program();
+  p.accept(v);
+  *this = FlatAST(p, false);
+}
+
+
+//----------------------------------------------------------------------
+// ProgramVisitor
+//----------------------------------------------------------------------
+
+void ProgramVisitor::walk_node(Stmt& s)
+{
+  FlatAST ast;
+  FlatIndex i = ast.add(s);
+  walk_stmt(ast, i);
+}
+
+
+void ProgramVisitor::walk_node(Expr& e)
+{
+  FlatAST ast;
+  FlatIndex i = ast.add(e);
+  walk_expr(ast, i);
+}
+
+
+void ProgramVisitor::walk_node(ExprTerm& t)
+{
+  FlatAST ast;
+  FlatIndex i = ast.add(t);
+  walk_expr(ast, i);
+}
+
+
+void ProgramVisitor::walk_node(RValue& v)
+{
+  FlatAST ast;
+  FlatIndex i = ast.add(v);
+  walk_expr(ast, i);
+}
+
+
+void ProgramVisitor::visit(FunDef& f)
+{
+  FlatAST ast;
+  FlatIndex i = ast.add(f);
+  walk_fun_def(ast, i);
+}
+
+
+void ProgramVisitor::visit(StructDef& s)
+{
+  FlatAST ast;
+  FlatIndex i = ast.add(s);
+  walk_struct_def(ast, i);
+}
+
+
+void ProgramVisitor::visit(ReturnStmt& s) {walk_node(s);}
+void ProgramVisitor::visit(WhileStmt& s) {walk_node(s);}
+void ProgramVisitor::visit(ForStmt& s) {walk_node(s);}
+void ProgramVisitor::visit(IfStmt& s) {walk_node(s);}
+void ProgramVisitor::visit(VarDeclStmt& s) {walk_node(s);}
+void ProgramVisitor::visit(AssignStmt& s) {walk_node(s);}
+// (a call visited on its own is walked as an expression)
+void ProgramVisitor::visit(CallExpr& e) {walk_node(static_cast<RValue&>(e));}
+void ProgramVisitor::visit(Expr& e) {walk_node(e);}
+void ProgramVisitor::visit(SimpleTerm& t) {walk_node(t);}
+void ProgramVisitor::visit(ComplexTerm& t) {walk_node(t);}
+void ProgramVisitor::visit(SimpleRValue& v) {walk_node(v);}
+void ProgramVisitor::visit(NewRValue& v) {walk_node(v);}
+void ProgramVisitor::visit(VarRValue& v) {walk_node(v);}
@@ -0,0 +1,367 @@
+//----------------------------------------------------------------------
+// FILE: flat_ast.h
+// DATE: Spring 2023
+// AUTH: Nisa Meshal
+// DESC: Flat encoding of a MyPL program (nodes in typed arrays, with
+//       children as index ranges) for whole program passes
+//----------------------------------------------------------------------
+
+#ifndef FLAT_AST_H
+#define FLAT_AST_H
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "ast.h"
+#include "token.h"
+
+
+// an index into one of the arrays of a flat program
+using FlatIndex = uint32_t;
+
+// the index of a node that is not there
+const FlatIndex FLAT_NONE = UINT32_MAX;
+
+
+// the nodes [begin, end) of one of the arrays
+struct FlatRange {
+  FlatIndex begin = 0;
+  FlatIndex end = 0;
+  FlatIndex size() const {return end - begin;}
+  bool empty() const {return begin == end;}
+};
+
+
+// a token, with its lexeme interned in the program's names
+struct FlatToken {
+  TokenType type;
+  FlatIndex name;
+  int line;
+  int column;
+};
+
+
+// a data type (the type name is a name index)
+struct FlatType {
+  bool is_array = false;
+  FlatIndex name = FLAT_NONE;
+};
+
+
+// a variable, parameter, or field definition
+struct FlatVar {
+  FlatType type;
+  FlatIndex name;               // token
+};
+
+
+// an element of a variable path, with its (optional) index expressions
+struct FlatRef {
+  FlatIndex name;               // token
+  FlatIndex array_expr = FLAT_NONE;
+  FlatIndex array_expr_2D = FLAT_NONE;
+};
+
+
+// An expression is its first term (stored in the expression itself),
+// optionally followed by an operator and the rest of the expression.
+// By the kind of the term:
+//   VALUE  token is the value
+//   NEW    token is the type, children the array sizes (0 to 2 exprs)
+//   VAR    children the path (refs)
+//   CALL   token is the function name, children the arguments (exprs)
+//   PAREN  children the parenthesized expression (1 expr)
+enum class FlatExprKind : uint8_t {VALUE, NEW, VAR, CALL, PAREN};
+
+struct FlatExpr {
+  FlatExprKind kind = FlatExprKind::VALUE;
+  bool negated = false;
+  FlatIndex token = FLAT_NONE;
+  FlatRange children;
+  FlatIndex op = FLAT_NONE;     // token
+  FlatIndex rest = FLAT_NONE;   // expr
+  // the type of both operands of op (see Expr::op_type)
+  OpType op_type = OpType::NONE;
+};
+
+
+// By the kind of statement:
+//   VAR_DECL  var is the variable, expr its value
+//   ASSIGN    path is the lvalue (refs), expr the value
+//   CALL      expr is the call
+//   RETURN    expr is the returned value
+//   WHILE     expr is the condition, body the statements
+//   FOR       init and update are the var decl and assign statements,
+//             expr the condition, body the statements
+//   IF        body is the branches (the else part, if any, last)
+enum class FlatStmtKind : uint8_t {VAR_DECL, ASSIGN, CALL, RETURN, WHILE,
+  FOR, IF};
+
+struct FlatStmt {
+  FlatStmtKind kind = FlatStmtKind::CALL;
+  FlatIndex var = FLAT_NONE;
+  FlatIndex expr = FLAT_NONE;
+  FlatIndex init = FLAT_NONE;
+  FlatIndex update = FLAT_NONE;
+  FlatRange path;
+  FlatRange body;
+};
+
+
+// an if or elseif branch (or the else part, with no condition)
+struct FlatBranch {
+  FlatIndex condition = FLAT_NONE;
+  FlatRange body;               // stmts
+};
+
+
+struct FlatStructDef {
+  FlatIndex name;               // token
+  FlatRange fields;             // vars
+};
+
+
+struct FlatFunDef {
+  FlatType return_type;
+  FlatIndex name;               // token
+  FlatRange params;             // vars
+  FlatRange body;               // stmts
+};
+
+
+// A program with each kind of node in its own array, referring to
+// other nodes by index. The children of a node (a block's statements,
+// a call's arguments, a path's elements) are stored next to each other,
+// so they are a range of indexes, and each name is stored once, so
+// passes compare and look up names without copying lexemes.
+//
+// Existing visitors run over a flat program through accept(), which
+// visits the equivalent tree (see below). The semantic checker, code
+// generator, and printer walk flat programs directly, and visit trees
+// (or any node of one) by encoding them (see ProgramVisitor).
+class FlatAST
+{
+public:
+
+  // an empty program, or the flat encoding of the (parsed) program,
+  // recording its tree nodes (see expr_nodes) unless the tree is not
+  // kept
+  FlatAST() = default;
+  explicit FlatAST(Program& p, bool record_nodes = true);
+
+  std::vector<FlatStructDef> struct_defs;
+  std::vector<FlatFunDef> fun_defs;
+  std::vector<FlatStmt> stmts;
+  std::vector<FlatBranch> branches;
+  std::vector<FlatExpr> exprs;
+  std::vector<FlatRef> refs;
+  std::vector<FlatVar> vars;
+  std::vector<FlatToken> tokens;
+  // (a deque, so references to names stay valid as names are added)
+  std::deque<std::string> names;
+
+  // the tree nodes of the program encoded: the Expr of each expression
+  // (null for the call of a call statement), and the CallExpr of each
+  // call (null for the other kinds); both are empty if nodes are not
+  // recorded
+  std::vector<Expr*> expr_nodes;
+  std::vector<CallExpr*> call_nodes;
+  bool records_nodes() const {return record_nodes;}
+
+  // copy the operand types and call names recorded by the semantic
+  // checker back to the nodes of the program encoded
+  void annotate_tree() const;
+
+  // the lexeme of a token
+  const std::string& lexeme(FlatIndex token) const;
+
+  // the tree form of a token and a data type
+  Token token(FlatIndex token) const;
+  DataType data_type(const FlatType& type) const;
+
+  // the tree form of variable definitions, a struct def, and a function
+  // def's signature (without its statements)
+  std::vector<VarDef> var_defs(FlatRange range) const;
+  StructDef struct_def(const FlatStructDef& s) const;
+  FunDef fun_signature(const FlatFunDef& f) const;
+
+  // the index of the name (adding it if it is new)
+  FlatIndex intern(std::string_view name);
+
+  // encode a node on its own (after the nodes already here), returning
+  // the index of its flat node: a struct or function def, a statement,
+  // or an expression (a term or rvalue is encoded as an expression of
+  // just that term)
+  FlatIndex add(StructDef& s);
+  FlatIndex add(FunDef& f);
+  FlatIndex add(Stmt& s);
+  FlatIndex add(Expr& e);
+  FlatIndex add(ExprTerm& t);
+  FlatIndex add(RValue& v);
+
+  // the equivalent (tree) program, in its own arena
+  Program to_program() const;
+
+  // the tree form of a block, statement, and expression, with their
+  // nodes made in the arena
+  ASTList<Stmt*> block(FlatRange body, ASTArena& arena) const;
+  Stmt* stmt(FlatIndex s, ASTArena& arena) const;
+  Expr expr(FlatIndex e, ASTArena& arena) const;
+
+  // visit the equivalent program, then encode it again, so rewrites
+  // made by the visitor (e.g., constant folding) are kept (the
+  // equivalent program is then gone, so no tree nodes are recorded)
+  void accept(Visitor& v);
+
+private:
+
+  bool record_nodes = true;
+
+  // the index of each name (looked up by string view)
+  struct NameHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view name) const
+    {
+      return std::hash<std::string_view>{}(name);
+    }
+  };
+  std::unordered_map<std::string, FlatIndex, NameHash, std::equal_to<>>
+    name_indexes;
+
+};
+
+
+// A visitor for the passes that walk flat programs. Visiting a program
+// encodes it and walks the encoding (see each pass's visit(Program&)),
+// and visiting any other node encodes just that node (see FlatAST::add)
+// and walks it with the walk functions below, so passes can still be
+// run over part of a tree.
+class ProgramVisitor : public Visitor
+{
+public:
+  void visit(FunDef& f);
+  void visit(StructDef& s);
+  void visit(ReturnStmt& s);
+  void visit(WhileStmt& s);
+  void visit(ForStmt& s);
+  void visit(IfStmt& s);
+  void visit(VarDeclStmt& s);
+  void visit(AssignStmt& s);
+  void visit(CallExpr& e);
+  void visit(Expr& e);
+  void visit(SimpleTerm& t);
+  void visit(ComplexTerm& t);
+  void visit(SimpleRValue& v);
+  void visit(NewRValue& v);
+  void visit(VarRValue& v);
+
+protected:
+
+  // walk one node of a flat program (the node visited, encoded on its
+  // own)
+  virtual void walk_struct_def(FlatAST& ast, FlatIndex s) = 0;
+  virtual void walk_fun_def(FlatAST& ast, FlatIndex f) = 0;
+  virtual void walk_stmt(FlatAST& ast, FlatIndex s) = 0;
+  virtual void walk_expr(FlatAST& ast, FlatIndex e) = 0;
+
+private:
+
+  // encode a statement or expression (term, rvalue) and walk it
+  void walk_node(Stmt& s);
+  void walk_node(Expr& e);
+  void walk_node(ExprTerm& t);
+  void walk_node(RValue& v);
+};
+
+
+// Nested environments binding the names of a flat program (by name
+// index) to values, for the passes that walk it. A lookup goes straight
+// to the name's bindings, rather than hashing the lexeme in each
+// environment (as the symbol and var tables do).
+template<typename T>
+class FlatScopes
+{
+public:
+
+  // add a new environment, and remove the last added environment (and
+  // its bindings)
+  void push_environment()
+  {
+    if (env_count == 0)
+      max_count = count;
+    if (size_t(env_count) == environments.size())
+      environments.emplace_back();
+    ++env_count;
+  }
+
+  void pop_environment()
+  {
+    if (env_count == 0)
+      return;
+    std::vector<FlatIndex>& env = environments[--env_count];
+    for (FlatIndex name : env)
+      bindings[name].pop_back();
+    count -= int(env.size());
+    env.clear();
+  }
+
+  // bind the name in the current environment (if there is one)
+  void add(FlatIndex name, const T& value)
+  {
+    if (env_count == 0)
+      return;
+    if (name >= bindings.size())
+      bindings.resize(name + 1);
+    if (in_curr_env(name)) {
+      bindings[name].back().value = value;
+      return;
+    }
+    bindings[name].push_back({env_count, value});
+    environments[env_count - 1].push_back(name);
+    max_count = std::max(max_count, ++count);
+  }
+
+  // the most recent binding of the name (null if it has none)
+  const T* get(FlatIndex name) const
+  {
+    if (name >= bindings.size() || bindings[name].empty())
+      return nullptr;
+    return &bindings[name].back().value;
+  }
+
+  // true if the name is bound in the current environment
+  bool in_curr_env(FlatIndex name) const
+  {
+    return env_count > 0 && name < bindings.size() &&
+      !bindings[name].empty() && bindings[name].back().env == env_count;
+  }
+
+  // the number of bindings in scope, and the most in scope at once
+  // since there were no environments
+  int size() const {return count;}
+  int max_size() const {return max_count;}
+
+private:
+
+  struct Binding {
+    int env;
+    T value;
+  };
+
+  // the bindings of each name (most recent last), and the names bound
+  // in each environment (the first env_count are in use)
+  std::vector<std::vector<Binding>> bindings;
+  std::vector<std::vector<FlatIndex>> environments;
+  int env_count = 0;
+
+  int count = 0;
+  int max_count = 0;
+
+};
+
+
+#endif
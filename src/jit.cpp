@@ -0,0 +1,660 @@
+//----------------------------------------------------------------------
+// FILE: jit.cpp
+// DATE: Spring 2023
+// AUTH: Nisa Meshal
+// DESC: Baseline template JIT from vm frame instructions to x86-64
+//       machine code
+//----------------------------------------------------------------------
+
+#include <cstring>
+#include "jit.h"
+
+#if defined(__x86_64__) && defined(__unix__)
+#define MYPL_NATIVE_JIT
+#include <sys/mman.h>
+#endif
+
+using namespace std;
+
+
+//----------------------------------------------------------------------
+// Native code layout
+//
+// The code starts with a shared prologue, entered as
+//
+//   int code(void* vm, VMValue* variables, const uint8_t* target)
+//
+// that keeps vm in rbx and variables in r12 (both callee saved) and
+// jumps to target, the template of the first instruction to run. Every
+// exit loads the instruction index into eax and jumps to the shared
+// epilogue, which returns it. Variable v lives at [r12 + 16v] and
+// operand k (from the bottom of the operand stack) at
+// [r12 + 16(local_count + k)]; a value's payload is at offset 0 and its
+// one byte type tag at offset 8 (see VMValue). Templates keep nothing
+// in registers between instructions.
+//----------------------------------------------------------------------
+
+// VMValue::Type tags
+static const int INT_TAG = int(VMValue::Type::INT);
+static const int DOUBLE_TAG = int(VMValue::Type::DOUBLE);
+static const int BOOL_TAG = int(VMValue::Type::BOOL);
+static const int STRING_TAG = int(VMValue::Type::STRING);
+static const int NULL_TAG = int(VMValue::Type::NULLPTR);
+static const int TAG_OFFSET = 8;
+
+// x86 condition codes (the low nibble of jcc and setcc)
+enum Cond {AE = 0x3, E = 0x4, NE = 0x5, A = 0x7, L = 0xC,
+           GE = 0xD, LE = 0xE, G = 0xF};
+
+// comparison relations (of y to x)
+enum class Rel {LT, LE, GT, GE, EQ, NE};
+
+
+// Emits the handful of x86-64 instructions the templates use. Memory
+// operands are always [r12 + disp32].
+class Assembler
+{
+public:
+
+  vector<uint8_t> code;
+
+  int pos() const {return code.size();}
+
+  void byte(int b) {code.push_back(uint8_t(b));}
+
+  void bytes(initializer_list<int> bs)
+  {
+    for (int b : bs)
+      byte(b);
+  }
+
+  void dword(int32_t d)
+  {
+    for (int i = 0; i < 4; ++i)
+      byte((uint32_t(d) >> (8 * i)) & 0xFF);
+  }
+
+  void qword(uint64_t q)
+  {
+    for (int i = 0; i < 8; ++i)
+      byte((q >> (8 * i)) & 0xFF);
+  }
+
+  // ModRM and SIB bytes for [r12 + disp] with the given reg field
+  void mem(int reg, int disp)
+  {
+    byte(0x84 | ((reg & 7) << 3));
+    byte(0x24);
+    dword(disp);
+  }
+
+  // patch the rel32 at position at to jump to position to
+  void patch(int at, int to)
+  {
+    int32_t rel = to - (at + 4);
+    memcpy(&code[at], &rel, 4);
+  }
+
+  // jumps with a rel32 to be patched, returning its position
+  int jmp() {byte(0xE9); dword(0); return pos() - 4;}
+  int jcc(Cond c) {bytes({0x0F, 0x80 | c}); dword(0); return pos() - 4;}
+
+  // patch a forward jump to the current position
+  void bind(int at) {patch(at, pos());}
+
+  // tag tests and updates
+  void cmp_tag(int disp, int tag) {bytes({0x41, 0x80}); mem(7, disp + TAG_OFFSET); byte(tag);}
+  void set_tag(int disp, int tag) {bytes({0x41, 0xC6}); mem(0, disp + TAG_OFFSET); byte(tag);}
+
+  // 32 bit integer payloads (eax unless noted)
+  void load_eax(int disp) {bytes({0x41, 0x8B}); mem(0, disp);}
+  void load_ecx(int disp) {bytes({0x41, 0x8B}); mem(1, disp);}
+  void store_eax(int disp) {bytes({0x41, 0x89}); mem(0, disp);}
+  void add_eax(int disp) {bytes({0x41, 0x03}); mem(0, disp);}
+  void sub_eax(int disp) {bytes({0x41, 0x2B}); mem(0, disp);}
+  void imul_eax(int disp) {bytes({0x41, 0x0F, 0xAF}); mem(0, disp);}
+  void cmp_eax(int disp) {bytes({0x41, 0x3B}); mem(0, disp);}
+  void store_imm(int disp, int32_t imm) {bytes({0x41, 0xC7}); mem(0, disp); dword(imm);}
+  void add_imm(int disp, int32_t imm) {bytes({0x41, 0x81}); mem(0, disp); dword(imm);}
+
+  // bool payloads (al)
+  void load_al(int disp) {bytes({0x41, 0x8A}); mem(0, disp);}
+  void store_al(int disp) {bytes({0x41, 0x88}); mem(0, disp);}
+  void and_al(int disp) {bytes({0x41, 0x22}); mem(0, disp);}
+  void or_al(int disp) {bytes({0x41, 0x0A}); mem(0, disp);}
+  void xor_imm8(int disp, int imm) {bytes({0x41, 0x80}); mem(6, disp); byte(imm);}
+  void setcc_al(Cond c) {bytes({0x0F, 0x90 | c, 0xC0});}
+  void test_al() {bytes({0x84, 0xC0});}
+
+  // double payloads (xmm0)
+  void movsd_load(int disp) {bytes({0xF2, 0x41, 0x0F, 0x10}); mem(0, disp);}
+  void movsd_store(int disp) {bytes({0xF2, 0x41, 0x0F, 0x11}); mem(0, disp);}
+  void sse_op(int op, int disp) {bytes({0xF2, 0x41, 0x0F, op}); mem(0, disp);}
+  void ucomisd(int disp) {bytes({0x66, 0x41, 0x0F, 0x2E}); mem(0, disp);}
+
+  // whole 16 byte values (through xmm0)
+  void copy_value(int from, int to)
+  {
+    bytes({0xF3, 0x41, 0x0F, 0x6F});
+    mem(0, from);
+    bytes({0xF3, 0x41, 0x0F, 0x7F});
+    mem(0, to);
+  }
+
+  // 64 bit payloads (through rax)
+  void store_imm64(int disp, uint64_t imm)
+  {
+    bytes({0x48, 0xB8});
+    qword(imm);
+    bytes({0x49, 0x89});
+    mem(0, disp);
+  }
+
+};
+
+
+// Compiles one frame's instructions
+class Compiler
+{
+public:
+
+  Compiler(const VMFrameInfo& frame, const vector<int>& depths,
+           const NativeHelpers& helpers)
+    : frame(frame), depths(depths), helpers(helpers) {}
+
+  // generate the code, returning the number of instructions with a
+  // native template
+  int compile();
+
+  Assembler a;
+
+  // offset of each instruction's template
+  vector<int> entries;
+
+private:
+
+  const VMFrameInfo& frame;
+  const vector<int>& depths;
+  const NativeHelpers& helpers;
+
+  // jumps to patch once every template has been emitted, as (rel32
+  // position, instruction index) pairs
+  vector<pair<int,int>> branches;
+  vector<pair<int,int>> exits;
+  vector<int> epilogue_jumps;
+
+  // the instruction being compiled, and its entry depth
+  int pc = 0;
+  int depth = 0;
+
+  // address of variable v and of the operand i places below the top
+  int var(int v) const {return 16 * v;}
+  int operand(int i) const {return 16 * (frame.local_count + depth - 1 - i);}
+
+  // jump to the instruction's exit (leaving it to the interpreter)
+  // when the condition holds
+  void exit_if(Cond c) {exits.push_back({a.jcc(c), pc});}
+
+  // jump to instruction target when the condition holds, or always
+  void branch_if(Cond c, int target) {branches.push_back({a.jcc(c), target});}
+  void branch(int target) {branches.push_back({a.jmp(), target});}
+
+  // emit the template of the current instruction, returning false if
+  // it has none
+  bool emit(const VMInstr& instr);
+
+  // templates shared by several instructions
+  bool arithmetic(char op, bool ints, bool doubles);
+  bool compare(Rel rel, bool doubles);
+  bool compare_jump(Rel rel, bool doubles, int target);
+  bool call_helper(NativeHelper helper, int pops, bool var_arg, intptr_t arg);
+
+  // set al to (y rel x) for the top two operands, exiting unless both
+  // are ints (or, when allowed, both are doubles)
+  void condition(Rel rel, bool doubles);
+
+};
+
+
+int Compiler::compile()
+{
+  const vector<VMInstr>& instrs = frame.instructions;
+  int n = instrs.size();
+  // prologue: save rbx, r12, and r13 (r13 only keeps the stack 16
+  // byte aligned for helper calls), then jump to the target
+  a.bytes({0x53, 0x41, 0x54, 0x41, 0x55});
+  a.bytes({0x48, 0x89, 0xFB});          // mov rbx, rdi
+  a.bytes({0x49, 0x89, 0xF4});          // mov r12, rsi
+  a.bytes({0xFF, 0xE2});                // jmp rdx
+  int compiled = 0;
+  entries.assign(n + 1, 0);
+  for (pc = 0; pc < n; ++pc) {
+    entries[pc] = a.pos();
+    depth = depths[pc];
+    if (depth < 0 or !emit(instrs[pc])) {
+      // no template (or unreachable): leave it to the interpreter
+      a.code.resize(entries[pc]);
+      a.byte(0xB8);                     // mov eax, pc
+      a.dword(pc);
+      epilogue_jumps.push_back(a.jmp());
+    }
+    else
+      ++compiled;
+  }
+  // running off the end
+  entries[n] = a.pos();
+  a.byte(0xB8);
+  a.dword(n);
+  epilogue_jumps.push_back(a.jmp());
+  // exit stubs of the instructions with type guards
+  vector<int> stubs(n, -1);
+  for (auto [at, exit_pc] : exits) {
+    if (stubs[exit_pc] == -1) {
+      stubs[exit_pc] = a.pos();
+      a.byte(0xB8);
+      a.dword(exit_pc);
+      epilogue_jumps.push_back(a.jmp());
+    }
+    a.patch(at, stubs[exit_pc]);
+  }
+  // epilogue
+  for (int at : epilogue_jumps)
+    a.bind(at);
+  a.bytes({0x41, 0x5D, 0x41, 0x5C, 0x5B, 0xC3});
+  for (auto [at, target] : branches)
+    a.patch(at, entries[target]);
+  return compiled;
+}
+
+
+bool Compiler::emit(const VMInstr& instr)
+{
+  switch (instr.opcode()) {
+  case OpCode::PUSH: {
+    const VMValue& v = instr.operand().value();
+    int to = operand(-1);
+    if (v.is_int())
+      a.store_imm(to, v.as_int());
+    else if (v.is_double()) {
+      double d = v.as_double();
+      uint64_t bits;
+      memcpy(&bits, &d, 8);
+      a.store_imm64(to, bits);
+    }
+    else if (v.is_bool())
+      a.store_imm(to, v.as_bool());
+    else if (!v.is_null())
+      return false;
+    a.set_tag(to, int(v.type()));
+    return true;
+  }
+  case OpCode::POP:
+    a.cmp_tag(operand(0), STRING_TAG);
+    exit_if(E);
+    a.set_tag(operand(0), NULL_TAG);
+    return true;
+  case OpCode::LOAD: {
+    int v = var(instr.operand()->as_int());
+    a.cmp_tag(v, STRING_TAG);
+    exit_if(E);
+    a.copy_value(v, operand(-1));
+    return true;
+  }
+  case OpCode::STORE: {
+    // moves the value (so a string's count stays the same)
+    int v = var(instr.operand()->as_int());
+    a.cmp_tag(v, STRING_TAG);
+    exit_if(E);
+    a.copy_value(operand(0), v);
+    a.set_tag(operand(0), NULL_TAG);
+    return true;
+  }
+  case OpCode::LOADLOAD: {
+    int v = var(instr.operand()->as_int());
+    int w = var(instr.operand_2().value());
+    a.cmp_tag(v, STRING_TAG);
+    exit_if(E);
+    a.cmp_tag(w, STRING_TAG);
+    exit_if(E);
+    a.copy_value(v, operand(-1));
+    a.copy_value(w, operand(-2));
+    return true;
+  }
+  case OpCode::INCLOCAL: {
+    int v = var(instr.operand()->as_int());
+    a.cmp_tag(v, INT_TAG);
+    exit_if(NE);
+    a.add_imm(v, instr.operand_2().value());
+    return true;
+  }
+  case OpCode::DUP:
+    a.cmp_tag(operand(0), STRING_TAG);
+    exit_if(E);
+    a.copy_value(operand(0), operand(-1));
+    return true;
+  case OpCode::NOP:
+    return true;
+
+  case OpCode::ADD: case OpCode::ADD_II: return arithmetic('+', true, true);
+  case OpCode::SUB: case OpCode::SUB_II: return arithmetic('-', true, true);
+  case OpCode::MUL: case OpCode::MUL_II: return arithmetic('*', true, true);
+  case OpCode::DIV: case OpCode::DIV_II: return arithmetic('/', true, true);
+  case OpCode::IADD: return arithmetic('+', true, false);
+  case OpCode::ISUB: return arithmetic('-', true, false);
+  case OpCode::IMUL: return arithmetic('*', true, false);
+  case OpCode::IDIV: return arithmetic('/', true, false);
+  case OpCode::DADD: return arithmetic('+', false, true);
+  case OpCode::DSUB: return arithmetic('-', false, true);
+  case OpCode::DMUL: return arithmetic('*', false, true);
+  case OpCode::DDIV: return arithmetic('/', false, true);
+
+  case OpCode::AND: case OpCode::OR:
+    a.cmp_tag(operand(0), BOOL_TAG);
+    exit_if(NE);
+    a.cmp_tag(operand(1), BOOL_TAG);
+    exit_if(NE);
+    a.load_al(operand(1));
+    if (instr.opcode() == OpCode::AND)
+      a.and_al(operand(0));
+    else
+      a.or_al(operand(0));
+    a.store_al(operand(1));
+    a.set_tag(operand(0), NULL_TAG);
+    return true;
+  case OpCode::NOT:
+    a.cmp_tag(operand(0), BOOL_TAG);
+    exit_if(NE);
+    a.xor_imm8(operand(0), 1);
+    return true;
+
+  case OpCode::CMPLT: case OpCode::CMPLT_II: return compare(Rel::LT, true);
+  case OpCode::CMPLE: case OpCode::CMPLE_II: return compare(Rel::LE, true);
+  case OpCode::CMPGT: case OpCode::CMPGT_II: return compare(Rel::GT, true);
+  case OpCode::CMPGE: case OpCode::CMPGE_II: return compare(Rel::GE, true);
+  case OpCode::CMPEQ: case OpCode::ICMPEQ: return compare(Rel::EQ, false);
+  case OpCode::CMPNE: case OpCode::ICMPNE: return compare(Rel::NE, false);
+  case OpCode::ICMPLT: return compare(Rel::LT, false);
+  case OpCode::ICMPLE: return compare(Rel::LE, false);
+  case OpCode::ICMPGT: return compare(Rel::GT, false);
+  case OpCode::ICMPGE: return compare(Rel::GE, false);
+
+  case OpCode::JMP:
+    branch(instr.operand()->as_int());
+    return true;
+  case OpCode::JMPF:
+    a.cmp_tag(operand(0), BOOL_TAG);
+    exit_if(NE);
+    a.load_al(operand(0));
+    a.set_tag(operand(0), NULL_TAG);
+    a.test_al();
+    branch_if(E, instr.operand()->as_int());
+    return true;
+
+  case OpCode::CMPLT_JMPF: case OpCode::CMPLT_JMPF_II:
+    return compare_jump(Rel::LT, true, instr.operand()->as_int());
+  case OpCode::CMPLE_JMPF: case OpCode::CMPLE_JMPF_II:
+    return compare_jump(Rel::LE, true, instr.operand()->as_int());
+  case OpCode::CMPGT_JMPF: case OpCode::CMPGT_JMPF_II:
+    return compare_jump(Rel::GT, true, instr.operand()->as_int());
+  case OpCode::CMPGE_JMPF: case OpCode::CMPGE_JMPF_II:
+    return compare_jump(Rel::GE, true, instr.operand()->as_int());
+  case OpCode::CMPEQ_JMPF: case OpCode::ICMPEQ_JMPF:
+    return compare_jump(Rel::EQ, false, instr.operand()->as_int());
+  case OpCode::CMPNE_JMPF: case OpCode::ICMPNE_JMPF:
+    return compare_jump(Rel::NE, false, instr.operand()->as_int());
+  case OpCode::ICMPLT_JMPF:
+    return compare_jump(Rel::LT, false, instr.operand()->as_int());
+  case OpCode::ICMPLE_JMPF:
+    return compare_jump(Rel::LE, false, instr.operand()->as_int());
+  case OpCode::ICMPGT_JMPF:
+    return compare_jump(Rel::GT, false, instr.operand()->as_int());
+  case OpCode::ICMPGE_JMPF:
+    return compare_jump(Rel::GE, false, instr.operand()->as_int());
+
+  case OpCode::WRITE:
+    return call_helper(helpers.write, 1, false, 0);
+  case OpCode::GETI:
+    return call_helper(helpers.geti, 2, false, 0);
+  case OpCode::SETI:
+    return call_helper(helpers.seti, 3, false, 0);
+  case OpCode::GETI2D:
+    return call_helper(helpers.geti2d, 3, false, 0);
+  case OpCode::SETI2D:
+    return call_helper(helpers.seti2d, 4, false, 0);
+  case OpCode::GETFI:
+    return call_helper(helpers.getfi, 1, false, instr.operand()->as_int());
+  case OpCode::SETFI:
+    return call_helper(helpers.setfi, 2, false, instr.operand()->as_int());
+  case OpCode::LOAD_GETI:
+    return call_helper(helpers.load_geti, 1, true,
+                       var(instr.operand()->as_int()));
+
+  default:
+    // calls, returns, strings, allocation, and named fields
+    return false;
+  }
+}
+
+
+bool Compiler::arithmetic(char op, bool ints, bool doubles)
+{
+  int x = operand(0);
+  int y = operand(1);
+  int not_int = -1;
+  int done = -1;
+  if (ints) {
+    a.cmp_tag(x, INT_TAG);
+    if (doubles)
+      not_int = a.jcc(NE);
+    else
+      exit_if(NE);
+    a.cmp_tag(y, INT_TAG);
+    exit_if(NE);
+    if (op == '/') {
+      // division by zero is left to the interpreter
+      a.load_ecx(x);
+      a.bytes({0x85, 0xC9});            // test ecx, ecx
+      exit_if(E);
+      a.load_eax(y);
+      a.bytes({0x99, 0xF7, 0xF9});      // cdq; idiv ecx
+    }
+    else {
+      a.load_eax(y);
+      if (op == '+')
+        a.add_eax(x);
+      else if (op == '-')
+        a.sub_eax(x);
+      else
+        a.imul_eax(x);
+    }
+    a.store_eax(y);
+    if (doubles)
+      done = a.jmp();
+  }
+  if (doubles) {
+    if (not_int != -1)
+      a.bind(not_int);
+    a.cmp_tag(x, DOUBLE_TAG);
+    exit_if(NE);
+    a.cmp_tag(y, DOUBLE_TAG);
+    exit_if(NE);
+    a.movsd_load(y);
+    int sse = op == '+' ? 0x58 : op == '-' ? 0x5C : op == '*' ? 0x59 : 0x5E;
+    a.sse_op(sse, x);
+    a.movsd_store(y);
+    if (done != -1)
+      a.bind(done);
+  }
+  a.set_tag(x, NULL_TAG);
+  return true;
+}
+
+
+void Compiler::condition(Rel rel, bool doubles)
+{
+  int x = operand(0);
+  int y = operand(1);
+  int not_int = -1;
+  a.cmp_tag(x, INT_TAG);
+  if (doubles)
+    not_int = a.jcc(NE);
+  else
+    exit_if(NE);
+  a.cmp_tag(y, INT_TAG);
+  exit_if(NE);
+  a.load_eax(y);
+  a.cmp_eax(x);
+  static const Cond int_conds[] = {L, LE, G, GE, E, NE};
+  a.setcc_al(int_conds[int(rel)]);
+  if (!doubles)
+    return;
+  int done = a.jmp();
+  a.bind(not_int);
+  a.cmp_tag(x, DOUBLE_TAG);
+  exit_if(NE);
+  a.cmp_tag(y, DOUBLE_TAG);
+  exit_if(NE);
+  // compare so that an unordered (NaN) operand gives false
+  if (rel == Rel::LT or rel == Rel::LE) {
+    a.movsd_load(x);
+    a.ucomisd(y);
+  }
+  else {
+    a.movsd_load(y);
+    a.ucomisd(x);
+  }
+  a.setcc_al(rel == Rel::LT or rel == Rel::GT ? A : AE);
+  a.bind(done);
+}
+
+
+bool Compiler::compare(Rel rel, bool doubles)
+{
+  condition(rel, doubles);
+  a.store_al(operand(1));
+  a.set_tag(operand(1), BOOL_TAG);
+  a.set_tag(operand(0), NULL_TAG);
+  return true;
+}
+
+
+bool Compiler::compare_jump(Rel rel, bool doubles, int target)
+{
+  condition(rel, doubles);
+  a.set_tag(operand(0), NULL_TAG);
+  a.set_tag(operand(1), NULL_TAG);
+  a.test_al();
+  branch_if(E, target);
+  return true;
+}
+
+
+bool Compiler::call_helper(NativeHelper helper, int pops, bool var_arg,
+                           intptr_t arg)
+{
+  if (!helper)
+    return false;
+  a.bytes({0x48, 0x89, 0xDF});          // mov rdi, rbx
+  a.bytes({0x49, 0x8D});                // lea rsi, [first operand]
+  a.mem(6, operand(pops - 1));
+  if (var_arg) {
+    a.bytes({0x49, 0x8D});              // lea rdx, [variable]
+    a.mem(2, arg);
+  }
+  else {
+    a.bytes({0x48, 0xBA});              // mov rdx, arg
+    a.qword(arg);
+  }
+  a.bytes({0x48, 0xB8});                // mov rax, helper
+  a.qword(reinterpret_cast<uint64_t>(helper));
+  a.bytes({0xFF, 0xD0});                // call rax
+  a.test_al();
+  exit_if(E);
+  return true;
+}
+
+
+//----------------------------------------------------------------------
+// NativeCode
+//----------------------------------------------------------------------
+
+NativeCode::~NativeCode()
+{
+#ifdef MYPL_NATIVE_JIT
+  if (code)
+    munmap(code, size);
+#endif
+}
+
+
+int NativeCode::run(void* vm, VMValue* variables, int pc) const
+{
+  typedef int (*Entry)(void*, VMValue*, const uint8_t*);
+  Entry entry = reinterpret_cast<Entry>(code);
+  return entry(vm, variables, code + entries[pc]);
+}
+
+
+int NativeCode::stack_depth(int pc) const
+{
+  return depths[pc] < 0 ? 0 : depths[pc];
+}
+
+
+int NativeCode::compiled_count() const
+{
+  return compiled;
+}
+
+
+size_t NativeCode::code_size() const
+{
+  return size;
+}
+
+
+bool native_supported()
+{
+#ifdef MYPL_NATIVE_JIT
+  return true;
+#else
+  return false;
+#endif
+}
+
+
+shared_ptr<const NativeCode>
+compile_native(const VMFrameInfo& frame, const vector<int>& call_args,
+               const NativeHelpers& helpers)
+{
+#ifdef MYPL_NATIVE_JIT
+  bool exact;
+  vector<int> depths = stack_depths(frame, call_args, exact);
+  if (!exact)
+    return nullptr;
+  Compiler compiler(frame, depths, helpers);
+  int compiled = compiler.compile();
+  if (compiled == 0)
+    return nullptr;
+  // copy the code into its own pages, then make them executable
+  const vector<uint8_t>& bytes = compiler.a.code;
+  void* pages = mmap(nullptr, bytes.size(), PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (pages == MAP_FAILED)
+    return nullptr;
+  memcpy(pages, bytes.data(), bytes.size());
+  if (mprotect(pages, bytes.size(), PROT_READ | PROT_EXEC) != 0) {
+    munmap(pages, bytes.size());
+    return nullptr;
+  }
+  shared_ptr<NativeCode> native(new NativeCode());
+  native->code = static_cast<uint8_t*>(pages);
+  native->size = bytes.size();
+  native->entries = std::move(compiler.entries);
+  native->depths = std::move(depths);
+  native->compiled = compiled;
+  return native;
+#else
+  return nullptr;
+#endif
+}
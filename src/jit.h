@@ -0,0 +1,108 @@
+//----------------------------------------------------------------------
+// FILE: jit.h
+// DATE: Spring 2023
+// AUTH: Nisa Meshal
+// DESC: Baseline template JIT from vm frame instructions to x86-64
+//       machine code
+//----------------------------------------------------------------------
+
+#ifndef JIT_H
+#define JIT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "vm_frame.h"
+
+
+// A vm callback for an instruction the native code runs by calling
+// back into the vm. It is given the vm, the address of the deepest
+// value the instruction pops, and an instruction specific argument,
+// and returns false, having changed nothing, when the interpreter must
+// run the instruction instead (e.g., to report an error, since mypl
+// exceptions cannot unwind through native code).
+typedef bool (*NativeHelper)(void* vm, VMValue* operands, intptr_t arg);
+
+
+// The callbacks used by native code (instructions whose callback is
+// left null are always run by the interpreter)
+class NativeHelpers
+{
+public:
+  NativeHelper write = nullptr;
+  NativeHelper geti = nullptr;
+  NativeHelper seti = nullptr;
+  NativeHelper geti2d = nullptr;
+  NativeHelper seti2d = nullptr;
+  NativeHelper getfi = nullptr;       // arg is the field slot
+  NativeHelper setfi = nullptr;       // arg is the field slot
+  NativeHelper load_geti = nullptr;   // arg is the index variable's address
+};
+
+
+// The machine code of one function. Each instruction compiles to a
+// small template working on the frame's variables and operand stack in
+// place (the operand stack depth at each instruction is fixed, so
+// every operand has a fixed address). Instructions without a template,
+// and templates whose type guards fail, exit back to the interpreter,
+// which runs the instruction and may enter the native code again.
+class NativeCode
+{
+public:
+
+  NativeCode(const NativeCode&) = delete;
+  NativeCode& operator=(const NativeCode&) = delete;
+  ~NativeCode();
+
+  // run the code from instruction pc on the frame whose variables
+  // start at the given address (its operands follow the variables),
+  // returning the index of the instruction left to the interpreter
+  // (or the instruction count if the function ran off its end)
+  int run(void* vm, VMValue* variables, int pc) const;
+
+  // the operand stack depth on entry to instruction pc
+  int stack_depth(int pc) const;
+
+  // the number of instructions with a native template
+  int compiled_count() const;
+
+  // the size of the machine code in bytes
+  size_t code_size() const;
+
+private:
+
+  NativeCode() = default;
+
+  friend std::shared_ptr<const NativeCode>
+  compile_native(const VMFrameInfo&, const std::vector<int>&,
+                 const NativeHelpers&);
+
+  // executable code, and the offset of each instruction's template
+  uint8_t* code = nullptr;
+  size_t size = 0;
+  std::vector<int> entries;
+
+  // operand stack depth on entry to each instruction
+  std::vector<int> depths;
+
+  int compiled = 0;
+
+};
+
+
+// returns true if native code can be generated and run on this
+// machine (x86-64 with mmap)
+bool native_supported();
+
+// compile the frame's instructions given the argument count of each
+// function id (the frame must be linked and have its max_stack and
+// local_count set). Returns null if native code is not supported, the
+// operand stack depths are not fixed, or no instruction has a
+// template.
+std::shared_ptr<const NativeCode>
+compile_native(const VMFrameInfo& frame, const std::vector<int>& call_args,
+               const NativeHelpers& helpers);
+
+
+#endif
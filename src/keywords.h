@@ -0,0 +1,113 @@
+//----------------------------------------------------------------------
+// FILE: keywords.h
+// DATE: Spring 2023
+// AUTH: Nisa Meshal
+// DESC: Reserved word recognition by a perfect hash table built at
+//       compile time
+//----------------------------------------------------------------------
+
+#ifndef KEYWORDS_H
+#define KEYWORDS_H
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include "token.h"
+
+
+struct Keyword {
+  std::string_view word;
+  TokenType type;
+};
+
+
+// the reserved words (including type names and word values)
+constexpr std::array<Keyword, 21> KEYWORDS = {{
+  {"int", TokenType::INT_TYPE}, {"double", TokenType::DOUBLE_TYPE},
+  {"bool", TokenType::BOOL_TYPE}, {"string", TokenType::STRING_TYPE},
+  {"char", TokenType::CHAR_TYPE}, {"void", TokenType::VOID_TYPE},
+  {"struct", TokenType::STRUCT}, {"array", TokenType::ARRAY},
+  {"for", TokenType::FOR}, {"while", TokenType::WHILE},
+  {"if", TokenType::IF}, {"elseif", TokenType::ELSEIF},
+  {"else", TokenType::ELSE}, {"and", TokenType::AND},
+  {"or", TokenType::OR}, {"not", TokenType::NOT},
+  {"new", TokenType::NEW}, {"return", TokenType::RETURN},
+  {"null", TokenType::NULL_VAL}, {"true", TokenType::BOOL_VAL},
+  {"false", TokenType::BOOL_VAL}
+}};
+
+// the shortest and longest reserved words
+constexpr size_t KEYWORD_MIN_LENGTH = 2;
+constexpr size_t KEYWORD_MAX_LENGTH = 6;
+
+// the hash table size (a power of two, as the hash is the top bits of
+// a multiplicative hash)
+constexpr int KEYWORD_SLOTS = 64;
+constexpr int KEYWORD_SLOT_BITS = 6;
+
+
+// hashes a word of at least two characters from its length and its
+// first, second, and last characters (which together tell the
+// reserved words apart), using the seed as the multiplier
+constexpr unsigned keyword_hash(std::string_view word, unsigned seed)
+{
+  unsigned h = word.size();
+  h = h * seed + (unsigned char) word[0];
+  h = h * seed + (unsigned char) word[1];
+  h = h * seed + (unsigned char) word[word.size() - 1];
+  return (h * 2654435761u) >> (32 - KEYWORD_SLOT_BITS);
+}
+
+
+// the first seed for which no two reserved words share a slot (or the
+// search limit if there is none)
+constexpr unsigned KEYWORD_SEED_LIMIT = 1 << 12;
+
+constexpr unsigned find_keyword_seed()
+{
+  for (unsigned seed = 0; seed < KEYWORD_SEED_LIMIT; ++seed) {
+    std::array<bool, KEYWORD_SLOTS> used {};
+    bool perfect = true;
+    for (const Keyword& keyword : KEYWORDS) {
+      unsigned slot = keyword_hash(keyword.word, seed);
+      perfect = perfect and !used[slot];
+      used[slot] = true;
+    }
+    if (perfect)
+      return seed;
+  }
+  return KEYWORD_SEED_LIMIT;
+}
+
+constexpr unsigned KEYWORD_SEED = find_keyword_seed();
+static_assert(KEYWORD_SEED < KEYWORD_SEED_LIMIT, "no perfect keyword hash");
+
+
+// the index in KEYWORDS of the word hashing to each slot (-1 if none)
+constexpr std::array<int8_t, KEYWORD_SLOTS> KEYWORD_TABLE = [] {
+  std::array<int8_t, KEYWORD_SLOTS> table {};
+  table.fill(-1);
+  for (size_t i = 0; i < KEYWORDS.size(); ++i)
+    table[keyword_hash(KEYWORDS[i].word, KEYWORD_SEED)] = i;
+  return table;
+}();
+
+
+// returns the token type of a reserved word, or ID for any other word
+// (one hash and one comparison)
+constexpr TokenType keyword_type(std::string_view word)
+{
+  if (word.size() < KEYWORD_MIN_LENGTH or word.size() > KEYWORD_MAX_LENGTH)
+    return TokenType::ID;
+  int i = KEYWORD_TABLE[keyword_hash(word, KEYWORD_SEED)];
+  if (i < 0 or KEYWORDS[i].word != word)
+    return TokenType::ID;
+  return KEYWORDS[i].type;
+}
+
+static_assert(keyword_type("elseif") == TokenType::ELSEIF);
+static_assert(keyword_type("else") == TokenType::ELSE);
+static_assert(keyword_type("elsif") == TokenType::ID);
+
+
+#endif
@@ -6,26 +6,107 @@
 //----------------------------------------------------------------------
 
 #include "lexer.h"
+#include <algorithm>
 #include <iostream>
+#include "keywords.h"
+#include "lexer_scan.h"
 
 using namespace std;
 
 
 Lexer::Lexer(istream& input_stream)
-  : input {input_stream}, column {0}, line {1}
+  : input {&input_stream}, line {1}, column {0}
 {}
 
 
+Lexer::Lexer(const SourceBuffer& source)
+  : input {nullptr}, line {1}, column {0}
+{
+  string_view text = source.text();
+  next = text.data();
+  end = text.data() + text.size();
+}
+
+
 char Lexer::read()
 {
   ++column;
-  return input.get();
+  if (!input)
+    return next < end ? *next++ : EOF;
+  return input->get();
 }
 
 
 char Lexer::peek()
 {
-  return input.peek();
+  if (!input)
+    return next < end ? *next : EOF;
+  return input->peek();
+}
+
+
+void Lexer::extend_lexeme(char ch)
+{
+  if (input)
+    lexeme_chars.append(1, ch);
+  else if (lexeme_length++ == 0)
+    lexeme_start = next - 1;
+}
+
+
+void Lexer::extend_lexeme_to(const char* run_end)
+{
+  if (run_end == next)
+    return;
+  if (lexeme_length == 0)
+    lexeme_start = next;
+  lexeme_length += run_end - next;
+  column += run_end - next;
+  next = run_end;
+}
+
+
+void Lexer::skip_blanks()
+{
+  while (next < end) {
+    const char* run_end;
+    if (*next == '#') {
+      run_end = scan_comment(next + 1, end);
+      column += run_end - next;
+    }
+    else {
+      run_end = scan_spaces(next, end);
+      if (run_end == next)
+        return;
+      // the column restarts after the last newline
+      const char* line_start = run_end;
+      while (line_start > next and line_start[-1] != '\n')
+        --line_start;
+      if (line_start == next)
+        column += run_end - next;
+      else {
+        line += count(next, line_start, '\n');
+        column = run_end - line_start;
+      }
+    }
+    next = run_end;
+  }
+}
+
+
+string_view Lexer::lexeme() const
+{
+  if (input)
+    return lexeme_chars;
+  return string_view(lexeme_start, lexeme_length);
+}
+
+
+Token Lexer::lexeme_token(TokenType type, int line, int column) const
+{
+  if (input)
+    return Token(type, lexeme_chars, line, column);
+  return Token::in_source(type, lexeme(), line, column);
 }
 
 
@@ -38,9 +119,13 @@ void Lexer::error(const string& msg, int line, int column) const
 
 Token Lexer::next_token()
 {
+  // source buffers are scanned a run of characters at a time
+  if (!input)
+    skip_blanks();
   char currCh = read();
   int startCol = 0;
-  string buildstr = "";
+  lexeme_length = 0;
+  lexeme_chars.clear();
 
 
   //check for newline
@@ -198,7 +283,6 @@ Token Lexer::next_token()
 
   //strings
   if (currCh == '\"') {
-    buildstr = "";
     startCol = column;
 
     if(peek() == EOF) {
@@ -206,7 +290,8 @@ Token Lexer::next_token()
       error("found end-of-file in string", line, column);
     }
 
-    string buildstr = "";
+    if (!input)
+      extend_lexeme_to(scan_string(next, end));
     currCh = read(); //read the next value after "
     
     while(currCh != '\"') {
@@ -217,14 +302,13 @@ Token Lexer::next_token()
       } else if (currCh == EOF) {
         error("found end-of-file in string", line, column);
       }
-      buildstr.append(1, currCh);
+      extend_lexeme(currCh);
       currCh = read();
     }
-    return Token(TokenType::STRING_VAL, buildstr, line, startCol);
+    return lexeme_token(TokenType::STRING_VAL, line, startCol);
   }
 
   if(isdigit(currCh)) {
-    buildstr = "";
     startCol = column;
 
     if(currCh == '0' && isdigit(peek())) {
@@ -232,7 +316,9 @@ Token Lexer::next_token()
     }
 
     while(isdigit(currCh)) {
-      buildstr.append(string(1, currCh));
+      extend_lexeme(currCh);
+      if (!input)
+        extend_lexeme_to(scan_digits(next, end));
       if(isalpha(peek()) || peek() == ';' || peek() == ')' || peek() == '}' || peek() == ']' || peek() == '+' || peek() == '/' || peek() == '-' || peek() == '*') {
         break; 
       }
@@ -240,16 +326,18 @@ Token Lexer::next_token()
     }
 
     if(currCh == '.') {
-      buildstr.append(string(1, currCh));
+      extend_lexeme(currCh);
     
       if(!isdigit(peek())) 
       {
-        error("missing digit in '" + buildstr + "'", line, column + 1);
+        error("missing digit in '" + string(lexeme()) + "'", line, column + 1);
       } else {
         currCh = read();
         while(isdigit(currCh)) 
         {
-          buildstr.append(string(1, currCh));
+          extend_lexeme(currCh);
+          if (!input)
+            extend_lexeme_to(scan_digits(next, end));
           if(!isdigit(peek())) 
           {
             break; 
@@ -257,18 +345,19 @@ Token Lexer::next_token()
           currCh = read();
         }
       }
-      return Token(TokenType::DOUBLE_VAL, buildstr, line, startCol);
+      return lexeme_token(TokenType::DOUBLE_VAL, line, startCol);
     }
-    return Token(TokenType::INT_VAL, buildstr, line, startCol);
+    return lexeme_token(TokenType::INT_VAL, line, startCol);
   } 
   else if (isalpha(currCh)) 
   {
-    buildstr = "";
     startCol = column; 
 
     while(!isspace(currCh) && currCh != EOF) 
     {
-      buildstr.append(string(1, currCh));
+      extend_lexeme(currCh);
+      if (!input)
+        extend_lexeme_to(scan_word(next, end));
       if(peek() == '=' || peek() =='(' || peek() == ')' || peek() == '<' || peek() == '>' || 
       peek() == '[' || peek() == ',' || peek() == ';' || peek() == '}' || peek() == '{' || 
       peek() == '.' || peek() == ']' || peek() == '-' || peek() == '+' || peek() == '/' || peek() == '*') 
@@ -283,63 +372,6 @@ Token Lexer::next_token()
     error("unexpected character '" + string(1, currCh) + "'", line, column - 0);
   }
   
-
-  if(buildstr == "int") 
-  {
-    return Token(TokenType::INT_TYPE, "int", line, startCol);
-  } 
-  else if (buildstr == "double") 
-  {
-    return Token(TokenType::DOUBLE_TYPE, "double", line, startCol);
-  } 
-  else if (buildstr == "bool") 
-  {
-    return Token(TokenType::BOOL_TYPE, "bool", line, startCol);
-  } 
-  else if (buildstr == "string") 
-  {
-    return Token(TokenType::STRING_TYPE, "string", line, startCol);
-  } 
-  else if (buildstr == "char") 
-  {
-    return Token(TokenType::CHAR_TYPE, "char", line, startCol);
-  } 
-  else if (buildstr == "void") 
-  {
-    return Token(TokenType::VOID_TYPE, "void", line, startCol);
-  } 
-  else if (buildstr == "struct") 
-  {
-    return Token(TokenType::STRUCT, "struct", line, startCol);
-  } else if (buildstr == "array") {
-    return Token(TokenType::ARRAY, "array", line, startCol);
-  } else if (buildstr == "for") {
-    return Token(TokenType::FOR, "for", line, startCol);
-  } else if (buildstr == "while") {
-    return Token(TokenType::WHILE, "while", line, startCol);
-  } else if (buildstr == "if") {
-    return Token(TokenType::IF, "if", line, startCol);
-  } else if (buildstr == "elseif") {
-    return Token(TokenType::ELSEIF, "elseif", line, startCol);
-  } else if (buildstr == "else") {
-    return Token(TokenType::ELSE, "else", line, startCol);
-  } else if (buildstr == "and") {
-    return Token(TokenType::AND, "and", line, startCol);
-  } else if (buildstr == "or") {
-    return Token(TokenType::OR, "or", line, startCol);
-  } else if (buildstr == "not") {
-    return Token(TokenType::NOT, "not", line, startCol);
-  } else if (buildstr == "new") {
-    return Token(TokenType::NEW, "new", line, startCol);
-  } else if (buildstr == "return") {
-    return Token(TokenType::RETURN, "return", line, startCol);
-  } else if (buildstr == "null") {
-    return Token(TokenType::NULL_VAL, "null", line, startCol);
-  } else if (buildstr == "true") {
-    return Token(TokenType::BOOL_VAL, "true", line, startCol);
-  } else if (buildstr == "false") {
-    return Token(TokenType::BOOL_VAL, "false", line, startCol);
-  }
-
-  return Token(TokenType::ID, buildstr, line, startCol);
-}
\ No newline at end of file
+  // reserved words are told apart from identifiers by a perfect hash
+  return lexeme_token(keyword_type(lexeme()), line, startCol);
+}
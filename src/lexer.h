@@ -10,7 +10,9 @@
 
 #include <istream>
 #include <string>
+#include <string_view>
 #include "mypl_exception.h"
+#include "source_buffer.h"
 #include "token.h"
 
 
@@ -20,6 +22,11 @@ public:
   // Construct a new lexer from the given input stream
   Lexer(std::istream& input_stream);
 
+  // Construct a new lexer from the given source buffer. Identifier,
+  // number, and string tokens refer to their lexemes in the buffer
+  // (which must outlive them) rather than copying them.
+  Lexer(const SourceBuffer& source);
+
   char peek();
 
   // Return the next available token in the input stream. Returns the
@@ -29,8 +36,18 @@ public:
   
 private:
 
-  // input stream
-  std::istream& input;
+  // input stream (null when reading a source buffer)
+  std::istream* input;
+
+  // the source buffer's next character and end
+  const char* next = nullptr;
+  const char* end = nullptr;
+
+  // the lexeme being read: its start in the source buffer and length,
+  // or, when reading a stream, its characters
+  const char* lexeme_start = nullptr;
+  size_t lexeme_length = 0;
+  std::string lexeme_chars;
 
   // current line
   int line;
@@ -46,6 +63,22 @@ private:
   // without incrementing column number
 
 
+  // add the character just read to the lexeme
+  void extend_lexeme(char ch);
+
+  // add the source buffer characters up to run_end to the lexeme (as
+  // if read one at a time)
+  void extend_lexeme_to(const char* run_end);
+
+  // skip the whitespace and comments ahead in the source buffer
+  void skip_blanks();
+
+  // returns the lexeme read so far
+  std::string_view lexeme() const;
+
+  // returns a token for the lexeme read
+  Token lexeme_token(TokenType type, int line, int column) const;
+
   // create and throw a MyPLException object (exits lexer)
   void error(const std::string& msg, int line, int column) const;
   
@@ -0,0 +1,299 @@
+//----------------------------------------------------------------------
+// FILE: lexer_scan.cpp
+// DATE: Spring 2023
+// AUTH: Nisa Meshal
+// DESC: Scanner implementations (scalar, SSE2, and AVX2) and the run
+//       time choice between them
+//----------------------------------------------------------------------
+
+#include "lexer_scan.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define MYPL_SCAN_X86
+#endif
+
+using namespace std;
+
+
+//----------------------------------------------------------------------
+// Scalar scanners (also used for the tails of the vectorized ones)
+//----------------------------------------------------------------------
+
+// helper to check for a character in the range lo to hi
+static inline bool in_range(char c, unsigned char lo, unsigned char hi)
+{
+  return (unsigned char) (c - lo) <= hi - lo;
+}
+
+
+static inline bool is_space(char c)
+{
+  return c == ' ' or in_range(c, '\t', '\r');
+}
+
+
+// true for the characters that end an identifier: ( ) * + , - . / are
+// 0x28 to 0x2f, and ; < = > are 0x3b to 0x3e
+static inline bool ends_word(char c)
+{
+  return is_space(c) or c == '\xff' or in_range(c, '(', '/') or
+    in_range(c, ';', '>') or c == '[' or c == ']' or c == '{' or c == '}';
+}
+
+
+static const char* scan_spaces_scalar(const char* p, const char* end)
+{
+  while (p < end and is_space(*p))
+    ++p;
+  return p;
+}
+
+
+static const char* scan_comment_scalar(const char* p, const char* end)
+{
+  while (p < end and *p != '\n' and *p != '\xff')
+    ++p;
+  return p;
+}
+
+
+static const char* scan_string_scalar(const char* p, const char* end)
+{
+  while (p < end and *p != '"' and *p != '\n' and *p != '\xff')
+    ++p;
+  return p;
+}
+
+
+static const char* scan_word_scalar(const char* p, const char* end)
+{
+  while (p < end and !ends_word(*p))
+    ++p;
+  return p;
+}
+
+
+static const char* scan_digits_scalar(const char* p, const char* end)
+{
+  while (p < end and in_range(*p, '0', '9'))
+    ++p;
+  return p;
+}
+
+
+#ifdef MYPL_SCAN_X86
+
+//----------------------------------------------------------------------
+// SSE2 scanners (16 characters at a time)
+//----------------------------------------------------------------------
+
+static inline __m128i sse2_eq(__m128i v, char c)
+{
+  return _mm_cmpeq_epi8(v, _mm_set1_epi8(c));
+}
+
+
+// the characters in the range lo to hi (an unsigned compare of v - lo
+// against hi - lo, done as min(t, hi - lo) == t)
+static inline __m128i sse2_in_range(__m128i v, char lo, char hi)
+{
+  __m128i t = _mm_sub_epi8(v, _mm_set1_epi8(lo));
+  return _mm_cmpeq_epi8(_mm_min_epu8(t, _mm_set1_epi8(hi - lo)), t);
+}
+
+
+static inline __m128i sse2_space(__m128i v)
+{
+  return _mm_or_si128(sse2_eq(v, ' '), sse2_in_range(v, '\t', '\r'));
+}
+
+
+static inline __m128i sse2_ends_word(__m128i v)
+{
+  __m128i m = _mm_or_si128(sse2_space(v), sse2_eq(v, '\xff'));
+  m = _mm_or_si128(m, sse2_in_range(v, '(', '/'));
+  m = _mm_or_si128(m, sse2_in_range(v, ';', '>'));
+  m = _mm_or_si128(m, _mm_or_si128(sse2_eq(v, '['), sse2_eq(v, ']')));
+  return _mm_or_si128(m, _mm_or_si128(sse2_eq(v, '{'), sse2_eq(v, '}')));
+}
+
+
+// defines name_sse2, where bits is the bit mask (from v) of the
+// characters that end the run
+#define SSE2_SCANNER(name, bits)                                        \
+  static const char* name##_sse2(const char* p, const char* end)        \
+  {                                                                     \
+    for (; end - p >= 16; p += 16) {                                    \
+      __m128i v = _mm_loadu_si128((const __m128i*) p);                  \
+      unsigned mask = (bits);                                           \
+      if (mask)                                                         \
+        return p + __builtin_ctz(mask);                                 \
+    }                                                                   \
+    return name##_scalar(p, end);                                       \
+  }
+
+SSE2_SCANNER(scan_spaces, _mm_movemask_epi8(sse2_space(v)) ^ 0xffff)
+SSE2_SCANNER(scan_comment, _mm_movemask_epi8(
+  _mm_or_si128(sse2_eq(v, '\n'), sse2_eq(v, '\xff'))))
+SSE2_SCANNER(scan_string, _mm_movemask_epi8(
+  _mm_or_si128(_mm_or_si128(sse2_eq(v, '"'), sse2_eq(v, '\n')),
+               sse2_eq(v, '\xff'))))
+SSE2_SCANNER(scan_word, _mm_movemask_epi8(sse2_ends_word(v)))
+SSE2_SCANNER(scan_digits,
+             _mm_movemask_epi8(sse2_in_range(v, '0', '9')) ^ 0xffff)
+
+
+//----------------------------------------------------------------------
+// AVX2 scanners (32 characters at a time)
+//----------------------------------------------------------------------
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static inline __m256i avx2_eq(__m256i v, char c)
+{
+  return _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c));
+}
+
+
+AVX2 static inline __m256i avx2_in_range(__m256i v, char lo, char hi)
+{
+  __m256i t = _mm256_sub_epi8(v, _mm256_set1_epi8(lo));
+  return _mm256_cmpeq_epi8(_mm256_min_epu8(t, _mm256_set1_epi8(hi - lo)), t);
+}
+
+
+AVX2 static inline __m256i avx2_space(__m256i v)
+{
+  return _mm256_or_si256(avx2_eq(v, ' '), avx2_in_range(v, '\t', '\r'));
+}
+
+
+AVX2 static inline __m256i avx2_ends_word(__m256i v)
+{
+  __m256i m = _mm256_or_si256(avx2_space(v), avx2_eq(v, '\xff'));
+  m = _mm256_or_si256(m, avx2_in_range(v, '(', '/'));
+  m = _mm256_or_si256(m, avx2_in_range(v, ';', '>'));
+  m = _mm256_or_si256(m, _mm256_or_si256(avx2_eq(v, '['), avx2_eq(v, ']')));
+  return _mm256_or_si256(m,
+                         _mm256_or_si256(avx2_eq(v, '{'), avx2_eq(v, '}')));
+}
+
+
+// defines name_avx2 (as for SSE2_SCANNER)
+#define AVX2_SCANNER(name, bits)                                        \
+  AVX2 static const char* name##_avx2(const char* p, const char* end)   \
+  {                                                                     \
+    for (; end - p >= 32; p += 32) {                                    \
+      __m256i v = _mm256_loadu_si256((const __m256i*) p);               \
+      unsigned mask = (bits);                                           \
+      if (mask)                                                         \
+        return p + __builtin_ctz(mask);                                 \
+    }                                                                   \
+    return name##_scalar(p, end);                                       \
+  }
+
+AVX2_SCANNER(scan_spaces, ~unsigned(_mm256_movemask_epi8(avx2_space(v))))
+AVX2_SCANNER(scan_comment, _mm256_movemask_epi8(
+  _mm256_or_si256(avx2_eq(v, '\n'), avx2_eq(v, '\xff'))))
+AVX2_SCANNER(scan_string, _mm256_movemask_epi8(
+  _mm256_or_si256(_mm256_or_si256(avx2_eq(v, '"'), avx2_eq(v, '\n')),
+                  avx2_eq(v, '\xff'))))
+AVX2_SCANNER(scan_word, _mm256_movemask_epi8(avx2_ends_word(v)))
+AVX2_SCANNER(scan_digits,
+             ~unsigned(_mm256_movemask_epi8(avx2_in_range(v, '0', '9'))))
+
+#endif
+
+
+//----------------------------------------------------------------------
+// Dispatch
+//----------------------------------------------------------------------
+
+typedef const char* (*Scanner)(const char*, const char*);
+
+struct Scanners {
+  const char* isa;
+  Scanner spaces;
+  Scanner comment;
+  Scanner string;
+  Scanner word;
+  Scanner digits;
+};
+
+#define SCANNERS(isa) {#isa, scan_spaces_##isa, scan_comment_##isa, \
+      scan_string_##isa, scan_word_##isa, scan_digits_##isa}
+
+static const Scanners SCALAR_SCANNERS = SCANNERS(scalar);
+#ifdef MYPL_SCAN_X86
+static const Scanners SSE2_SCANNERS = SCANNERS(sse2);
+static const Scanners AVX2_SCANNERS = SCANNERS(avx2);
+#endif
+
+
+// helper to pick the widest scanners the cpu supports
+static const Scanners* best_scanners()
+{
+#ifdef MYPL_SCAN_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return &AVX2_SCANNERS;
+  return &SSE2_SCANNERS;
+#else
+  return &SCALAR_SCANNERS;
+#endif
+}
+
+static const Scanners* scanners = best_scanners();
+
+
+const char* scan_spaces(const char* begin, const char* end)
+{
+  return scanners->spaces(begin, end);
+}
+
+
+const char* scan_comment(const char* begin, const char* end)
+{
+  return scanners->comment(begin, end);
+}
+
+
+const char* scan_string(const char* begin, const char* end)
+{
+  return scanners->string(begin, end);
+}
+
+
+const char* scan_word(const char* begin, const char* end)
+{
+  return scanners->word(begin, end);
+}
+
+
+const char* scan_digits(const char* begin, const char* end)
+{
+  return scanners->digits(begin, end);
+}
+
+
+string scan_isa()
+{
+  return scanners->isa;
+}
+
+
+bool set_scan_isa(const string& isa)
+{
+  if (isa == "scalar")
+    scanners = &SCALAR_SCANNERS;
+#ifdef MYPL_SCAN_X86
+  else if (isa == "sse2")
+    scanners = &SSE2_SCANNERS;
+  else if (isa == "avx2" and __builtin_cpu_supports("avx2"))
+    scanners = &AVX2_SCANNERS;
+#endif
+  else
+    return false;
+  return true;
+}
@@ -0,0 +1,47 @@
+//----------------------------------------------------------------------
+// FILE: lexer_scan.h
+// DATE: Spring 2023
+// AUTH: Nisa Meshal
+// DESC: Vectorized scanning of character runs in a source buffer for
+//       the lexer (AVX2 or SSE2, chosen at run time, with a scalar
+//       fallback)
+//----------------------------------------------------------------------
+
+#ifndef LEXER_SCAN_H
+#define LEXER_SCAN_H
+
+#include <string>
+
+
+// Each scanner returns the first position in [begin, end) whose
+// character ends the run starting at begin (or end if none does),
+// checking 32 (AVX2) or 16 (SSE2) characters at a time. The '\xff'
+// character (EOF when read as a char) ends every run, as it ends the
+// lexer's reads of a stream.
+
+// whitespace (as isspace in the "C" locale)
+const char* scan_spaces(const char* begin, const char* end);
+
+// a comment body (up to the next newline or '\xff')
+const char* scan_comment(const char* begin, const char* end);
+
+// string contents (up to the closing quote, a newline, or '\xff')
+const char* scan_string(const char* begin, const char* end);
+
+// an identifier or reserved word (up to whitespace, '\xff', or one of
+// the punctuation characters that end it: = ( ) < > [ ] { } , ; . + -
+// * /)
+const char* scan_word(const char* begin, const char* end);
+
+// decimal digits
+const char* scan_digits(const char* begin, const char* end);
+
+// the instruction set the scanners use: "avx2", "sse2", or "scalar"
+std::string scan_isa();
+
+// use the given instruction set (e.g., to compare them), returning
+// false (and leaving the scanners as they are) if this cpu lacks it
+bool set_scan_isa(const std::string& isa);
+
+
+#endif
@@ -7,15 +7,22 @@
 
 #include <iostream>
 #include <fstream>
+#include <memory>
 #include <string>
+#include <vector>
 #include <lexer.h>
+#include <source_buffer.h>
 #include <token.h>  
 #include <simple_parser.h>
 #include <ast_parser.h>
+#include <flat_ast.h>
 #include <print_visitor.h>
 #include <semantic_checker.h>
 #include <vm.h>
 #include <code_generator.h>
+#include <reg_code_generator.h>
+#include <constant_folder.h>
+#include <cpp_emitter.h>
 
 using namespace std;
 
@@ -24,218 +31,131 @@ void print_one(istream* input);
 void print_two(istream* input);
 void print_first_word(istream* input);
 void print_first_line(istream* input);
-void lex_mode(istream* input);
-void parse_mode(istream* input); 
+void lex_mode(Lexer& lexer);
+void parse_mode(Lexer& lexer); 
+void print_mode(Lexer& lexer);
+void check_mode(Lexer& lexer);
+void ir_mode(Lexer& lexer, int opt_level, bool reg_vm);
+void run_mode(Lexer& lexer, int opt_level, bool reg_vm, bool jit);
+void emit_cpp_mode(Lexer& lexer, int opt_level);
+void profile_mode(Lexer& lexer, int opt_level);
+void sample_mode(Lexer& lexer, int opt_level, int interval, bool timer);
+FlatAST parse_flat(Lexer& lexer);
+FlatAST compile(Lexer& lexer, int opt_level);
 
 //argc gives the count of cmd arguments. 
 //argv is an array of argument values. argv[0] is the name of the command.
 int main(int argc, char* argv[])
 {
-  string args[argc];
-  istream* input = nullptr; 
+  vector<string> args;     //the arguments other than the settings
+  int opt_level = 0;       //the code generator optimization level
+  bool reg_vm = false;     //use the register vm instead of the stack vm
+  bool jit = false;        //compile the stack vm code to machine code
+  int sample_interval = 10000;  //instructions (or microseconds) per sample
+  bool sample_timer = false;    //sample on a cpu time timer
+
+  //take out the settings, which can be given anywhere
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    if (arg == "--opt-level") {
+      //the level must follow the option
+      string level = i + 1 < argc ? argv[++i] : "";
+      if (level == "" or level.find_first_not_of("0123456789") != string::npos) {
+        cout << "ERROR: --opt-level requires a numeric level\n";
+        return 1;
+      }
+      opt_level = stoi(level);
+    }
+    else if (arg == "--sample-every" or arg == "--sample-timer") {
+      //the interval must follow the option
+      string interval = i + 1 < argc ? argv[++i] : "";
+      if (interval == "" or interval == "0" or
+          interval.find_first_not_of("0123456789") != string::npos) {
+        cout << "ERROR: " << arg << " requires a positive interval\n";
+        return 1;
+      }
+      sample_interval = stoi(interval);
+      sample_timer = arg == "--sample-timer";
+    }
+    else if (arg == "--reg")
+      reg_vm = true;
+    else if (arg == "--jit")
+      jit = true;
+    else
+      args.push_back(arg);
+  }
 
   //if there are more than two arguments the program should terminate and the help flag is displayed
-  if (argc >  3){
+  if (args.size() > 2) {
     cout << "Too many arguments were passed in" << endl;
     displayOptions();
     return 1; 
   }
 
-  //converts all arguments into strings and omits the ./mypl argument
-  if(argc > 1) {
-    args[0] = string(argv[1]);
-  }
-
-  if (argc == 3) {
-    args[1] = string(argv[2]);
+  //a flag and a filename, a flag or a filename, or neither (normal mode
+  //on standard input)
+  string mode = "";
+  string file_name = "";
+  if (args.size() == 2) {
+    mode = args[0];
+    file_name = args[1];
   }
+  else if (args.size() == 1 and args[0][0] == '-')
+    mode = args[0];
+  else if (args.size() == 1)
+    file_name = args[0];
 
-  //if a flag and a filename is passed in 
-  if (argc == 3) {
-    //create an input filestream using the filename at index one.
-    input = new ifstream(args[1]);
-    //return an error message and list options if the file doesn't open
-    if(input->fail()) {
-      cout << "ERROR: Unable to open file '" + args[1] + "'\n";
-      return 1;
-    }
-
-    //print the first character in the file
-    if(args[0] == "--lex") {
-      cout << "[Lex Mode]\n";
-      lex_mode(input);
-    } 
-    //print the first two characters in the file
-    else if (args[0] == "--parse") {
-      cout << "[Parse Mode]\n";
-      parse_mode(input);
-    } 
-    //print the first word in the file
-    else if (args[0] == "--print") {
-      Lexer lexer = Lexer(*input);
-      
-      try {
-        ASTParser parser(lexer);
-        Program p = parser.parse();
-        PrintVisitor v(cout);
-        p.accept(v);
-        } catch (MyPLException& ex) {
-          cerr << ex.what() << endl;
-        }
-    } 
-    //print the first line of the file
-    else if (args[0] == "--check") {
-      Lexer lexer = Lexer(*input);
-      
-      try {
-        ASTParser parser(lexer);
-        Program p = parser.parse();
-        SemanticChecker v;
-        p.accept(v);
-      } catch (MyPLException& ex) {
-        cerr << ex.what() << endl;
-      }
-
-    } 
-    //print the first two lines of the file. 
-    else if (args[0] == "--ir") {
-      Lexer lexer = Lexer(*input); 
-
-      try {
-        ASTParser parser(lexer);
-        Program p = parser.parse();
-        SemanticChecker t;
-        p.accept(t);
-        VM vm;
-        CodeGenerator g(vm);
-        p.accept(g);
-        cout << to_string(vm) << endl;
-      } catch (MyPLException& ex) {
-        cerr << ex.what() << endl;
-      }
-    
-    }
-    //invalid command was passed in, output error message, options, and then terminate
-    else {
-      cout << "ERROR: Command not recognized\n";
-      displayOptions();
+  //read from the file if one was given (mapped into memory, so tokens
+  //refer to their lexemes in place), otherwise standard input
+  unique_ptr<SourceBuffer> source;
+  if (file_name != "") {
+    source = make_unique<SourceBuffer>(file_name);
+    //return an error message if the file doesn't open
+    if (source->fail()) {
+      cout << "ERROR: Unable to open file '" + file_name + "'\n";
       return 1;
     }
-    delete(input);
-  } else if (argc == 2) {
-    //create a standard input stream. 
-    input = &cin;
-
-    //print the first character in the stream
-    if(args[0] == "--lex") {
-      cout << "[Lex Mode]\n";
-      lex_mode(input);
-    } 
-    //print the first two characters in the file
-    else if (args[0] == "--parse") {
-      cout << "[Parse Mode]\n";
-      parse_mode(input);
-    } 
-    //print the first word in the file
-    else if (args[0] == "--print") {
-      Lexer lexer = Lexer(*input);
-      
-      try {
-        ASTParser parser(lexer);
-        Program p = parser.parse();
-        PrintVisitor v(cout);
-        p.accept(v);
-        } catch (MyPLException& ex) {
-        cerr << ex.what() << endl;
-      }
-    } 
-    //print the first line of the file
-    else if (args[0] == "--check") {
-      Lexer lexer = Lexer(*input);
-      
-      try {
-        ASTParser parser(lexer);
-        Program p = parser.parse();
-        SemanticChecker v;
-        p.accept(v);
-      } catch (MyPLException& ex) {
-        cerr << ex.what() << endl;
-      }
-    } 
-    //print the first two lines of the file. 
-    else if (args[0] == "--ir") {
-      cout << "[Intermediate Mode]\n";
-      Lexer lexer = Lexer(*input); 
-
-      try {
-        ASTParser parser(lexer);
-        Program p = parser.parse();
-        SemanticChecker t;
-        p.accept(t);
-        VM vm;
-        CodeGenerator g(vm);
-        p.accept(g);
-        cout << to_string(vm) << endl;
-      } catch (MyPLException& ex) {
-        cerr << ex.what() << endl;
-      }
-    }
-    else if (args[0] == "--help") {
-      displayOptions();
-    }
-    //invalid command was passed in, output error message, options, and then terminate
-    else {
-      string command = args[0];
-
-      //if the input doesn't lead with - it's a file
-      if(command[0] != '-'){
-        input = new ifstream(args[0]);
-        //return an error message and list options if the file doesn't open
-        if(input->fail()) {
-          cout << "ERROR: Unable to open file '" + args[1] + "'\n";
-          return 1;
-        } //if the file opens, then print entire file content
-        else {
-          cout << "[Normal Mode]\n";
-          Lexer lexer = Lexer(*input); 
-          try {
-            ASTParser parser(lexer);
-            Program p = parser.parse();
-            SemanticChecker t;
-            p.accept(t);
-            VM vm;
-            CodeGenerator g(vm);
-            p.accept(g);
-            vm.run();
-          } catch (MyPLException& ex) {
-            cerr << ex.what() << endl;
-          }
+  }
+  Lexer lexer = source ? Lexer(*source) : Lexer(cin);
 
-          delete(input);
-        }
-      } else {
-        cout << "ERROR: Command not recognized\n";
-        displayOptions();
-        return 1;
-      }
-    }
+  if (mode == "--help")
+    displayOptions();
+  else if (mode == "--lex") {
+    cout << "[Lex Mode]\n";
+    lex_mode(lexer);
   } 
-  //if only ./mypl is passed in as argument
-  else {
+  else if (mode == "--parse") {
+    cout << "[Parse Mode]\n";
+    parse_mode(lexer);
+  } 
+  else if (mode == "--print")
+    print_mode(lexer);
+  else if (mode == "--check")
+    check_mode(lexer);
+  else if (mode == "--ir") {
+    if (file_name == "")
+      cout << "[Intermediate Mode]\n";
+    ir_mode(lexer, opt_level, reg_vm);
+  }
+  else if (mode == "--emit-cpp")
+    emit_cpp_mode(lexer, opt_level);
+  else if (mode == "--profile") {
+    cout << "[Profile Mode]\n";
+    profile_mode(lexer, opt_level);
+  }
+  else if (mode == "--sample") {
+    cout << "[Sample Mode]\n";
+    sample_mode(lexer, opt_level, sample_interval, sample_timer);
+  }
+  else if (mode == "") {
     cout << "[Normal Mode]\n";
-    Lexer lexer = Lexer(*input); 
-    try {
-      ASTParser parser(lexer);
-      Program p = parser.parse();
-      SemanticChecker t;
-      p.accept(t);
-      VM vm;
-      CodeGenerator g(vm);
-      p.accept(g);
-      vm.run();
-    } catch (MyPLException& ex) {
-      cerr << ex.what() << endl;
-    }
+    run_mode(lexer, opt_level, reg_vm, jit);
+  }
+  //invalid command was passed in, output error message, options, and then terminate
+  else {
+    cout << "ERROR: Command not recognized\n";
+    displayOptions();
+    return 1;
   }
   
   return 0;
@@ -250,6 +170,26 @@ void displayOptions() {
   cout << " --print   pretty prints program\n";
   cout << " --check   statically checks program\n";
   cout << " --ir      print intermediate (code) representation\n";
+  cout << " --emit-cpp  print the program as C++ (build with the runtime\n";
+  cout << "             header, e.g., g++ -std=c++20 -O2 -pthread\n";
+  cout << "             -I src out.cpp)\n";
+  cout << " --profile run the program, then report (on standard error)\n";
+  cout << "           its hot functions and opcodes, and the --ir listing\n";
+  cout << "           with the number of times each instruction ran\n";
+  cout << " --sample  run the program, sampling its call stack, then\n";
+  cout << "           print the samples (on standard error) as folded\n";
+  cout << "           stacks for flamegraph.pl or speedscope\n";
+  cout << "Settings:\n";
+  cout << " --opt-level n  code optimization level (0 = none, the default,\n";
+  cout << "                1 = constant folding and peephole, 2 = also\n";
+  cout << "                superinstructions)\n";
+  cout << " --reg          generate code for (and run) the register vm\n";
+  cout << " --jit          run the stack vm code as x86-64 machine code\n";
+  cout << "                where possible (interpreting the rest)\n";
+  cout << " --sample-every n  sample every n instructions (the default,\n";
+  cout << "                   with n = 10000)\n";
+  cout << " --sample-timer n  sample about every n microseconds of cpu\n";
+  cout << "                   time\n";
 }
 
 //These are funtions that will print out the needed characters for each command.//
@@ -283,14 +223,12 @@ void print_first_line(istream* input) {
 }
 
 //lexer function
-void lex_mode(istream* input) {
-  Lexer lexer = Lexer(*input); 
-
+void lex_mode(Lexer& lexer) {
   try {
     Token t = lexer.next_token();
-    cout << to_string(t) << endl;
+    cout << to_string(t) << '\n';
     while(t.type() != TokenType::EOS) {
-      cout << to_string(t) << endl;
+      cout << to_string(t) << '\n';
       t = lexer.next_token();
     }
   } catch (MyPLException& ex) {
@@ -298,9 +236,7 @@ void lex_mode(istream* input) {
   }
 }
 
-void parse_mode(istream* input) {
-  Lexer lexer = Lexer(*input);
-
+void parse_mode(Lexer& lexer) {
   try 
   {
     SimpleParser parser(lexer);
@@ -308,4 +244,133 @@ void parse_mode(istream* input) {
   } catch (MyPLException& ex) {
     cerr << ex.what() << endl;
   }
-}
\ No newline at end of file
+}
+
+//parse the program into its flat encoding (the tree is gone once it is
+//encoded)
+FlatAST parse_flat(Lexer& lexer) {
+  ASTParser parser(lexer);
+  Program p = parser.parse();
+  return FlatAST(p, false);
+}
+
+//parse and check the program, and fold it at opt levels above 0 (the
+//passes share the one flat encoding)
+FlatAST compile(Lexer& lexer, int opt_level) {
+  FlatAST ast = parse_flat(lexer);
+  SemanticChecker t;
+  t.check(ast);
+  if (opt_level > 0) {
+    ConstantFolder f;
+    f.fold(ast);
+  }
+  return ast;
+}
+
+void print_mode(Lexer& lexer) {
+  try {
+    PrintVisitor v(cout);
+    v.print(parse_flat(lexer));
+  } catch (MyPLException& ex) {
+    cerr << ex.what() << endl;
+  }
+}
+
+void check_mode(Lexer& lexer) {
+  try {
+    compile(lexer, 0);
+  } catch (MyPLException& ex) {
+    cerr << ex.what() << endl;
+  }
+}
+
+//generate code and print it
+void ir_mode(Lexer& lexer, int opt_level, bool reg_vm) {
+  try {
+    FlatAST ast = compile(lexer, opt_level);
+    if (reg_vm) {
+      //the register code generator walks the tree form
+      Program p = ast.to_program();
+      RegVM vm;
+      RegCodeGenerator g(vm);
+      p.accept(g);
+      cout << to_string(vm) << endl;
+      return;
+    }
+    VM vm;
+    CodeGenerator g(vm, opt_level);
+    g.generate(ast);
+    cout << to_string(vm) << endl;
+  } catch (MyPLException& ex) {
+    cerr << ex.what() << endl;
+  }
+}
+
+//translate to C++ and print it
+void emit_cpp_mode(Lexer& lexer, int opt_level) {
+  try {
+    //the emitter walks the tree form
+    Program p = compile(lexer, opt_level).to_program();
+    CppEmitter e(cout);
+    p.accept(e);
+  } catch (MyPLException& ex) {
+    cerr << ex.what() << endl;
+  }
+}
+
+//run the program with profiling on and print the report
+void profile_mode(Lexer& lexer, int opt_level) {
+  VM vm;
+  vm.set_profiling(true);
+
+  try {
+    FlatAST ast = compile(lexer, opt_level);
+    CodeGenerator g(vm, opt_level);
+    g.generate(ast);
+    vm.run();
+  } catch (MyPLException& ex) {
+    cerr << ex.what() << endl;
+  }
+  cout.flush();
+  cerr << "\n" << to_string(vm.profile()) << "\nInstructions\n"
+       << to_string(vm) << endl;
+}
+
+//run the program, sampling its call stack, and print the samples
+void sample_mode(Lexer& lexer, int opt_level, int interval, bool timer) {
+  VM vm;
+  vm.set_sampling(interval, timer);
+
+  try {
+    FlatAST ast = compile(lexer, opt_level);
+    CodeGenerator g(vm, opt_level);
+    g.generate(ast);
+    vm.run();
+  } catch (MyPLException& ex) {
+    cerr << ex.what() << endl;
+  }
+  cout.flush();
+  cerr << vm.samples().folded();
+}
+
+//generate code and run it
+void run_mode(Lexer& lexer, int opt_level, bool reg_vm, bool jit) {
+  try {
+    FlatAST ast = compile(lexer, opt_level);
+    if (reg_vm) {
+      Program p = ast.to_program();
+      RegVM vm;
+      RegCodeGenerator g(vm);
+      p.accept(g);
+      vm.run();
+      return;
+    }
+    VM vm;
+    vm.set_jit(jit);
+    CodeGenerator g(vm, opt_level);
+    g.generate(ast);
+    vm.run();
+  } catch (MyPLException& ex) {
+    cerr << ex.what() << endl;
+  }
+}
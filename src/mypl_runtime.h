@@ -0,0 +1,465 @@
+//----------------------------------------------------------------------
+// FILE: mypl_runtime.h
+// DATE: Spring 2023
+// AUTH: Nisa Meshal
+// DESC: Runtime support for MyPL programs compiled to C++ (see
+//       cpp_emitter.h). Standalone: only needs the standard library
+//       (and POSIX threads, where available, for a deeper stack).
+//----------------------------------------------------------------------
+
+#ifndef MYPL_RUNTIME_H
+#define MYPL_RUNTIME_H
+
+#include <cctype>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#if __has_include(<pthread.h>)
+#include <pthread.h>
+#endif
+
+
+namespace mypl {
+
+
+// A mypl runtime error (reported like the vm's errors)
+class Error : public std::runtime_error
+{
+public:
+  Error(const std::string& msg) : std::runtime_error(msg) {}
+};
+
+[[noreturn]] inline void error(const std::string& msg)
+{
+  throw Error(msg);
+}
+
+[[noreturn]] inline void null_reference()
+{
+  error("null reference");
+}
+
+
+// the null literal
+class Null {};
+inline const Null null;
+
+
+// The value of an expression that is always a null reference error
+// (converts to any type)
+class Undefined
+{
+public:
+  template<typename T>
+  operator T() const {null_reference();}
+};
+
+
+// A primitive (int, double, bool, or string) value that may be null.
+// Values the compiler can prove are never null use the plain type.
+template<typename T>
+class Maybe
+{
+public:
+  Maybe() : is_null(true), value() {}
+  Maybe(Null) : Maybe() {}
+  Maybe(const T& value) : is_null(false), value(value) {}
+  bool is_null;
+  T value;
+};
+
+
+// Base of heap objects, numbered like the vm's objects (which is what
+// printing a reference shows)
+class Object
+{
+public:
+  Object() : oid(next_oid()++) {}
+  int oid;
+  static int& next_oid()
+  {
+    static int next = 2023;
+    return next;
+  }
+};
+
+
+// A (reference counted) reference to a struct or array object, which
+// may be null
+template<typename T>
+class Ref
+{
+public:
+  Ref() = default;
+  Ref(Null) {}
+  explicit Ref(std::shared_ptr<T> ptr) : ptr(std::move(ptr)) {}
+  T* operator->() const
+  {
+    if (!ptr)
+      null_reference();
+    return ptr.get();
+  }
+  bool operator==(const Ref& other) const {return ptr == other.ptr;}
+  std::shared_ptr<T> ptr;
+};
+
+
+// An array object (2D arrays are stored row by row)
+template<typename E>
+class Array : public Object
+{
+public:
+  std::vector<E> elements;
+  int columns = 0;
+};
+
+
+// allocation
+
+template<typename T>
+Ref<T> make()
+{
+  return Ref<T>(std::make_shared<T>());
+}
+
+
+// null tests and access to the value of a possibly null value (which
+// is an error if it is null)
+
+template<typename T>
+bool is_null(const T&) {return false;}
+
+inline bool is_null(Null) {return true;}
+
+template<typename T>
+bool is_null(const Maybe<T>& x) {return x.is_null;}
+
+template<typename T>
+bool is_null(const Ref<T>& x) {return !x.ptr;}
+
+template<typename T>
+const T& val(const T& x) {return x;}
+
+[[noreturn]] inline Undefined val(Null) {null_reference();}
+
+template<typename T>
+const T& val(const Maybe<T>& x)
+{
+  if (x.is_null)
+    null_reference();
+  return x.value;
+}
+
+template<typename T>
+const Ref<T>& val(const Ref<T>& x)
+{
+  if (!x.ptr)
+    null_reference();
+  return x;
+}
+
+
+// == and != (null is only equal to null)
+template<typename A, typename B>
+bool eq(const A& x, const B& y)
+{
+  if (is_null(x) or is_null(y))
+    return is_null(x) and is_null(y);
+  if constexpr (std::is_same_v<A, Null> or std::is_same_v<B, Null>)
+    return false;
+  else
+    return val(x) == val(y);
+}
+
+
+// arithmetic, comparison, and logical operators (both operands are
+// evaluated before a null one is an error, and int arithmetic wraps
+// around as in the vm)
+
+template<typename T>
+using value_t = std::decay_t<decltype(val(std::declval<const T&>()))>;
+
+// the type of the operands' values (either may be the null literal)
+template<typename A, typename B>
+using operand_t = value_t<std::conditional_t<std::is_same_v<A, Null>, B, A>>;
+
+template<typename R, typename A, typename B, typename F>
+R binary(const A& x, const B& y, F op)
+{
+  if constexpr (std::is_same_v<A, Null> or std::is_same_v<B, Null>)
+    null_reference();
+  else
+    return op(val(x), val(y));
+}
+
+template<typename A, typename B>
+operand_t<A, B> add(const A& x, const B& y)
+{
+  return binary<operand_t<A, B>>(x, y, [](const auto& a, const auto& b) {
+    if constexpr (std::is_same_v<std::decay_t<decltype(a)>, int>)
+      return int(unsigned(a) + unsigned(b));
+    else
+      return a + b;
+  });
+}
+
+template<typename A, typename B>
+operand_t<A, B> sub(const A& x, const B& y)
+{
+  return binary<operand_t<A, B>>(x, y, [](const auto& a, const auto& b) {
+    if constexpr (std::is_same_v<std::decay_t<decltype(a)>, int>)
+      return int(unsigned(a) - unsigned(b));
+    else
+      return a - b;
+  });
+}
+
+template<typename A, typename B>
+operand_t<A, B> mul(const A& x, const B& y)
+{
+  return binary<operand_t<A, B>>(x, y, [](const auto& a, const auto& b) {
+    if constexpr (std::is_same_v<std::decay_t<decltype(a)>, int>)
+      return int(unsigned(a) * unsigned(b));
+    else
+      return a * b;
+  });
+}
+
+template<typename A, typename B>
+operand_t<A, B> div(const A& x, const B& y)
+{
+  return binary<operand_t<A, B>>(x, y, [](const auto& a, const auto& b) {
+    return a / b;
+  });
+}
+
+template<typename A, typename B>
+bool less(const A& x, const B& y)
+{
+  return binary<bool>(x, y, [](const auto& a, const auto& b) {
+    return a < b;
+  });
+}
+
+template<typename A, typename B>
+bool less_eq(const A& x, const B& y)
+{
+  return binary<bool>(x, y, [](const auto& a, const auto& b) {
+    return a <= b;
+  });
+}
+
+template<typename A, typename B>
+bool greater(const A& x, const B& y)
+{
+  return binary<bool>(x, y, [](const auto& a, const auto& b) {
+    return a > b;
+  });
+}
+
+template<typename A, typename B>
+bool greater_eq(const A& x, const B& y)
+{
+  return binary<bool>(x, y, [](const auto& a, const auto& b) {
+    return a >= b;
+  });
+}
+
+template<typename A, typename B>
+bool logical_and(const A& x, const B& y)
+{
+  return binary<bool>(x, y, [](bool a, bool b) {return a and b;});
+}
+
+template<typename A, typename B>
+bool logical_or(const A& x, const B& y)
+{
+  return binary<bool>(x, y, [](bool a, bool b) {return a or b;});
+}
+
+template<typename T>
+bool logical_not(const T& x)
+{
+  return !bool(val(x));
+}
+
+
+// array elements
+template<typename E, typename I>
+E& at(const Ref<Array<E>>& array, const I& i)
+{
+  std::vector<E>& elements = array->elements;
+  int index = val(i);
+  if (index < 0 or index >= int(elements.size()))
+    error("out-of-bounds array index");
+  return elements[index];
+}
+
+template<typename E, typename R, typename C>
+E& at(const Ref<Array<E>>& array, const R& row, const C& column)
+{
+  Array<E>& obj = *array.operator->();
+  int index = val(column) + val(row) * obj.columns;
+  if (index < 0 or index >= int(obj.elements.size()))
+    error("out-of-bounds 2D array index");
+  return obj.elements[index];
+}
+
+template<typename E, typename N>
+Ref<Array<E>> new_array(const N& size)
+{
+  Ref<Array<E>> array = make<Array<E>>();
+  array->elements.resize(val(size));
+  return array;
+}
+
+template<typename E, typename R, typename C>
+Ref<Array<E>> new_array(const R& rows, const C& columns)
+{
+  Ref<Array<E>> array = make<Array<E>>();
+  array->elements.resize(val(rows) * val(columns));
+  array->columns = val(columns);
+  return array;
+}
+
+
+// string representations (as printed by the vm)
+
+inline std::string str(int x) {return std::to_string(x);}
+inline std::string str(double x) {return std::to_string(x);}
+inline std::string str(bool x) {return x ? "true" : "false";}
+inline std::string str(const std::string& x) {return x;}
+inline std::string str(Null) {return "null";}
+
+template<typename T>
+std::string str(const Maybe<T>& x)
+{
+  return x.is_null ? "null" : str(x.value);
+}
+
+template<typename T>
+std::string str(const Ref<T>& x)
+{
+  return x.ptr ? std::to_string(x.ptr->oid) : "null";
+}
+
+
+// built in functions
+
+template<typename T>
+void print(const T& x)
+{
+  std::cout << str(x);
+}
+
+inline std::string input()
+{
+  std::string line;
+  std::getline(std::cin, line);
+  return line;
+}
+
+template<typename T>
+std::string to_string(const T& x)
+{
+  return str(val(x));
+}
+
+template<typename T>
+int to_int(const T& x)
+{
+  const auto& v = val(x);
+  if constexpr (std::is_same_v<std::decay_t<decltype(v)>, std::string>) {
+    if (!isdigit(v[0]))
+      error("cannot convert string to int");
+    return std::stoi(v);
+  }
+  else
+    return int(v);
+}
+
+template<typename T>
+double to_double(const T& x)
+{
+  const auto& v = val(x);
+  if constexpr (std::is_same_v<std::decay_t<decltype(v)>, std::string>) {
+    if (!isdigit(v[0]))
+      error("cannot convert string to double");
+    return std::stod(v);
+  }
+  else
+    return double(v);
+}
+
+template<typename T>
+int length(const T& s)
+{
+  return val(s).size();
+}
+
+template<typename T>
+int length_array(const T& array)
+{
+  return array->elements.size();
+}
+
+template<typename I, typename S>
+std::string get(const I& i, const S& s)
+{
+  const std::string& str = val(s);
+  int index = val(i);
+  if (index < 0 or index >= int(str.size()))
+    error("out-of-bounds string index");
+  return std::string(1, str[index]);
+}
+
+template<typename A, typename B>
+std::string concat(const A& x, const B& y)
+{
+  return val(x) + val(y);
+}
+
+
+// the stack size of the thread running the program, so that recursion
+// goes about as deep as in the vm (its pages are only used as needed)
+const size_t STACK_SIZE = size_t(1) << 30;
+
+// run the program's main function, reporting errors like the vm
+template<typename F>
+int run(F main_function)
+{
+  auto body = [&]() {
+    try {
+      main_function();
+    } catch (const Error& ex) {
+      std::cout.flush();
+      std::cerr << "VM Error: " << ex.what() << std::endl;
+    }
+  };
+#if __has_include(<pthread.h>)
+  // on a thread of its own, with a larger stack than the main thread's
+  pthread_attr_t attr;
+  pthread_t thread;
+  auto entry = [](void* arg) -> void* {
+    (*static_cast<decltype(body)*>(arg))();
+    return nullptr;
+  };
+  if (pthread_attr_init(&attr) == 0 and
+      pthread_attr_setstacksize(&attr, STACK_SIZE) == 0 and
+      pthread_create(&thread, &attr, entry, &body) == 0) {
+    pthread_join(thread, nullptr);
+    return 0;
+  }
+#endif
+  body();
+  return 0;
+}
+
+
+}
+
+#endif
@@ -40,7 +40,8 @@ enum class OpCode {
   JMPF,         // [operand] pop x, if x is false jump to instruction v
 
   // functions
-  CALL,         // [operand] call function v (pop and push args)
+  CALL,         // [operand] call function v (pop and push args; v is
+                //   the function id once the vm is linked)
   RET,          // return from current function
 
   // built-ins
@@ -55,7 +56,8 @@ enum class OpCode {
   CONCAT,       // pop x, pop y, push y + x (string concat)
     
   // heap
-  ALLOCS,       // allocate struct obj, push oid x
+  ALLOCS,       // [operand] allocate struct obj with v null field slots,
+                //   push oid x
   ALLOCA,       // pop x, pop y, allocate array obj with y x values, push oid
   
   ALLOCA2D,      // pop x, pop y, pop z , allocate array obj with (y*z) x values, push oid
@@ -63,11 +65,66 @@ enum class OpCode {
   ADDF,         // [operand] pop x, add field named v to obj(x)
   SETF,         // [operand] pop x and y, set obj(y).v = x
   GETF,         // [operand] pop x, push value of obj(x).v 
+  SETFI,        // [operand] pop x and y, set field slot v of obj(y) = x
+  GETFI,        // [operand] pop x, push value of field slot v of obj(x)
   SETI,         // pop x, y, and z, set array obj(z)[y] = x
   SETI2D,       // pop value, column, row, id set array obj(id)[row][column] = value
   GETI,         // pop x and y, push array obj(y)[x] value
   GETI2D, 
 
+  // superinstructions (emitted by the optimizer for common sequences)
+  INCLOCAL,     // [operands] add constant int c to memory address v
+                //   (LOAD v; PUSH c; ADD; STORE v)
+  LOADLOAD,     // [operands] push values at memory addresses v and w
+  LOAD_GETI,    // [operand] pop array x, push obj(x)[value at address v]
+  CMPLT_JMPF,   // [operand] pop x and y, if not (y < x) jump to v
+  CMPLE_JMPF,   // [operand] pop x and y, if not (y <= x) jump to v
+  CMPGT_JMPF,   // [operand] pop x and y, if not (y > x) jump to v
+  CMPGE_JMPF,   // [operand] pop x and y, if not (y >= x) jump to v
+  CMPEQ_JMPF,   // [operand] pop x and y, if not (y == x) jump to v
+  CMPNE_JMPF,   // [operand] pop x and y, if not (y != x) jump to v
+
+  // typed operations (emitted when the semantic checker found both
+  // operands to be ints or doubles, which may still be null)
+  IADD,         // pop ints x and y off stack, push (y + x) onto stack
+  ISUB,         // pop ints x and y off stack, push (y - x) onto stack
+  IMUL,         // pop ints x and y off stack, push (y * x) onto stack
+  IDIV,         // pop ints x and y off stack, push (y / x) onto stack
+  DADD,         // pop doubles x and y off stack, push (y + x) onto stack
+  DSUB,         // pop doubles x and y off stack, push (y - x) onto stack
+  DMUL,         // pop doubles x and y off stack, push (y * x) onto stack
+  DDIV,         // pop doubles x and y off stack, push (y / x) onto stack
+  ICMPLT,       // pop ints x and y off stack, push (y < x)
+  ICMPLE,       // pop ints x and y off stack, push (y <= x)
+  ICMPGT,       // pop ints x and y off stack, push (y > x)
+  ICMPGE,       // pop ints x and y off stack, push (y >= x)
+  ICMPEQ,       // pop ints x and y off stack, push (y == x)
+  ICMPNE,       // pop ints x and y off stack, push (y != x)
+  ICMPLT_JMPF,  // [operand] pop ints x and y, if not (y < x) jump to v
+  ICMPLE_JMPF,  // [operand] pop ints x and y, if not (y <= x) jump to v
+  ICMPGT_JMPF,  // [operand] pop ints x and y, if not (y > x) jump to v
+  ICMPGE_JMPF,  // [operand] pop ints x and y, if not (y >= x) jump to v
+  ICMPEQ_JMPF,  // [operand] pop ints x and y, if not (y == x) jump to v
+  ICMPNE_JMPF,  // [operand] pop ints x and y, if not (y != x) jump to v
+
+  // quickened instructions (never generated: the vm rewrites generic
+  // instructions into these in place while running, and back again
+  // when the guarded operand types or object shape change)
+  ADD_II,       // ADD guarded for two int operands
+  SUB_II,       // SUB guarded for two int operands
+  MUL_II,       // MUL guarded for two int operands
+  DIV_II,       // DIV guarded for two int operands
+  CMPLT_II,     // CMPLT guarded for two int operands
+  CMPLE_II,     // CMPLE guarded for two int operands
+  CMPGT_II,     // CMPGT guarded for two int operands
+  CMPGE_II,     // CMPGE guarded for two int operands
+  CMPLT_JMPF_II, // CMPLT_JMPF guarded for two int operands
+  CMPLE_JMPF_II, // CMPLE_JMPF guarded for two int operands
+  CMPGT_JMPF_II, // CMPGT_JMPF guarded for two int operands
+  CMPGE_JMPF_II, // CMPGE_JMPF guarded for two int operands
+  GETF_IC,      // GETF with the field slot cached for one object shape
+  SETF_IC,      // SETF with the field slot cached for one object shape
+
   // special
   DUP,          // pop x, push x, push x
   NOP           // has no effect (for jumping over code segments)
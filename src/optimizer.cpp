@@ -0,0 +1,291 @@
+//----------------------------------------------------------------------
+// FILE: optimizer.cpp
+// DATE: Spring 2023
+// AUTH: Nisa Meshal
+// DESC: Peephole optimizer implementation
+//----------------------------------------------------------------------
+
+#include <climits>
+#include "optimizer.h"
+
+using namespace std;
+
+
+// helper to get a jump instruction's target
+static int target(const VMInstr& instr)
+{
+  return instr.operand()->as_int();
+}
+
+
+// helper to flag the instructions that are jump targets (index n, the
+// end of the frame, may be one too)
+static vector<bool> jump_targets(const vector<VMInstr>& instrs)
+{
+  vector<bool> is_target(instrs.size() + 1, false);
+  for (const VMInstr& instr : instrs)
+    if (instr.is_jump())
+      is_target[target(instr)] = true;
+  return is_target;
+}
+
+
+// helper to find the instruction a jump to index really lands on by
+// skipping NOPs and following unconditional jumps (a jump cycle leaves
+// the index as is)
+static int final_target(const vector<VMInstr>& instrs, int index)
+{
+  int n = instrs.size();
+  int start = index;
+  for (int hops = 0; index < n; ++hops) {
+    if (hops > n)
+      return start;
+    if (instrs[index].opcode() == OpCode::NOP)
+      ++index;
+    else if (instrs[index].opcode() == OpCode::JMP)
+      index = target(instrs[index]);
+    else
+      break;
+  }
+  return index;
+}
+
+
+// helper to drop the removed instructions (and any NOPs), retargeting
+// jumps into a removed range to the next remaining instruction
+static void compact(vector<VMInstr>& instrs, vector<bool>& removed)
+{
+  int n = instrs.size();
+  // new index of each old index (index n maps to the new end)
+  vector<int> new_index(n + 1);
+  int count = 0;
+  for (int i = 0; i < n; ++i) {
+    new_index[i] = count;
+    if (instrs[i].opcode() == OpCode::NOP)
+      removed[i] = true;
+    if (!removed[i])
+      ++count;
+  }
+  new_index[n] = count;
+  vector<VMInstr> result;
+  result.reserve(count);
+  for (int i = 0; i < n; ++i) {
+    if (removed[i])
+      continue;
+    if (instrs[i].is_jump())
+      instrs[i].set_operand(new_index[target(instrs[i])]);
+    result.push_back(std::move(instrs[i]));
+  }
+  instrs = std::move(result);
+  removed.assign(instrs.size(), false);
+}
+
+
+// helper to point every jump at where it really lands, returning true
+// if any jump changed
+static bool thread_jumps(vector<VMInstr>& instrs)
+{
+  bool changed = false;
+  for (VMInstr& instr : instrs) {
+    if (!instr.is_jump())
+      continue;
+    int index = final_target(instrs, target(instr));
+    if (index != target(instr)) {
+      instr.set_operand(index);
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+
+// helper to remove instructions that can't be reached from the start
+// of the frame, returning true if any were removed
+static bool remove_unreachable(const vector<VMInstr>& instrs,
+                               vector<bool>& removed)
+{
+  int n = instrs.size();
+  vector<bool> reached(n, false);
+  vector<int> work;
+  if (n > 0) {
+    reached[0] = true;
+    work.push_back(0);
+  }
+  while (!work.empty()) {
+    int i = work.back();
+    work.pop_back();
+    OpCode op = instrs[i].opcode();
+    int succs[2];
+    int count = 0;
+    if (op != OpCode::JMP and op != OpCode::RET)
+      succs[count++] = i + 1;
+    if (instrs[i].is_jump())
+      succs[count++] = target(instrs[i]);
+    for (int k = 0; k < count; ++k) {
+      if (succs[k] < n and !reached[succs[k]]) {
+        reached[succs[k]] = true;
+        work.push_back(succs[k]);
+      }
+    }
+  }
+  bool changed = false;
+  for (int i = 0; i < n; ++i) {
+    if (!reached[i] and !removed[i]) {
+      removed[i] = true;
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+
+// helper to rewrite jumps to the next instruction and the instruction
+// pairs listed in optimizer.h, returning true if anything changed
+static bool rewrite_pairs(vector<VMInstr>& instrs, vector<bool>& removed)
+{
+  int n = instrs.size();
+  vector<bool> is_target = jump_targets(instrs);
+  bool changed = false;
+  for (int i = 0; i < n; ++i) {
+    OpCode op = instrs[i].opcode();
+    // jumps to the next instruction (a conditional jump still pops)
+    if ((op == OpCode::JMP or op == OpCode::JMPF) and target(instrs[i]) == i + 1) {
+      if (op == OpCode::JMP)
+        removed[i] = true;
+      else
+        instrs[i] = VMInstr::POP();
+      changed = true;
+      continue;
+    }
+    if (i + 1 == n or is_target[i + 1])
+      continue;
+    OpCode next = instrs[i + 1].opcode();
+    if (next == OpCode::POP and (op == OpCode::PUSH or op == OpCode::LOAD or
+                                 op == OpCode::DUP)) {
+      removed[i] = true;
+      removed[i + 1] = true;
+      changed = true;
+      ++i;
+    }
+    else if (op == OpCode::PUSH and next == OpCode::JMPF and
+             instrs[i].operand()->is_bool()) {
+      // a constant condition either never jumps or always does
+      removed[i] = true;
+      if (instrs[i].operand()->as_bool())
+        removed[i + 1] = true;
+      else
+        instrs[i + 1] = VMInstr::JMP(target(instrs[i + 1]));
+      changed = true;
+      ++i;
+    }
+    else if (op == OpCode::STORE and next == OpCode::LOAD and
+             instrs[i].operand()->as_int() ==
+             instrs[i + 1].operand()->as_int()) {
+      instrs[i + 1] = instrs[i];
+      instrs[i] = VMInstr::DUP();
+      changed = true;
+      ++i;
+    }
+  }
+  return changed;
+}
+
+
+// helper to fuse a comparison with a following JMPF to index (empty if
+// the instruction isn't a comparison)
+static optional<VMInstr> compare_jump(OpCode op, int index)
+{
+  switch (op) {
+  case OpCode::CMPLT: return VMInstr::CMPLT_JMPF(index);
+  case OpCode::CMPLE: return VMInstr::CMPLE_JMPF(index);
+  case OpCode::CMPGT: return VMInstr::CMPGT_JMPF(index);
+  case OpCode::CMPGE: return VMInstr::CMPGE_JMPF(index);
+  case OpCode::CMPEQ: return VMInstr::CMPEQ_JMPF(index);
+  case OpCode::CMPNE: return VMInstr::CMPNE_JMPF(index);
+  case OpCode::ICMPLT: return VMInstr::ICMPLT_JMPF(index);
+  case OpCode::ICMPLE: return VMInstr::ICMPLE_JMPF(index);
+  case OpCode::ICMPGT: return VMInstr::ICMPGT_JMPF(index);
+  case OpCode::ICMPGE: return VMInstr::ICMPGE_JMPF(index);
+  case OpCode::ICMPEQ: return VMInstr::ICMPEQ_JMPF(index);
+  case OpCode::ICMPNE: return VMInstr::ICMPNE_JMPF(index);
+  default: return nullopt;
+  }
+}
+
+
+// helper to replace the instruction sequences listed in optimizer.h
+// by superinstructions (marking the rest of each sequence removed)
+static void fuse(vector<VMInstr>& instrs, vector<bool>& removed)
+{
+  int n = instrs.size();
+  vector<bool> is_target = jump_targets(instrs);
+  // true if the count instructions starting at i can be fused
+  auto fusable = [&](int i, int count) {
+    if (i + count > n)
+      return false;
+    for (int j = i + 1; j < i + count; ++j)
+      if (is_target[j])
+        return false;
+    return true;
+  };
+  auto op = [&](int i) {return instrs[i].opcode();};
+  auto arg = [&](int i) {return instrs[i].operand()->as_int();};
+  for (int i = 0; i < n; ++i) {
+    int length = 0;
+    if (fusable(i, 4) and op(i) == OpCode::LOAD and op(i + 1) == OpCode::PUSH
+        and instrs[i + 1].operand()->is_int() and op(i + 3) == OpCode::STORE
+        and arg(i) == arg(i + 3) and
+        (op(i + 2) == OpCode::ADD or op(i + 2) == OpCode::IADD or
+         ((op(i + 2) == OpCode::SUB or op(i + 2) == OpCode::ISUB) and
+          arg(i + 1) != INT_MIN))) {
+      bool adds = op(i + 2) == OpCode::ADD or op(i + 2) == OpCode::IADD;
+      int amount = adds ? arg(i + 1) : -arg(i + 1);
+      instrs[i] = VMInstr::INCLOCAL(arg(i), amount);
+      length = 4;
+    }
+    else if (fusable(i, 2) and op(i) == OpCode::LOAD and
+             op(i + 1) == OpCode::GETI) {
+      instrs[i] = VMInstr::LOAD_GETI(arg(i));
+      length = 2;
+    }
+    // leave the second load to pair with a following GETI
+    else if (fusable(i, 2) and op(i) == OpCode::LOAD and
+             op(i + 1) == OpCode::LOAD and
+             !(fusable(i + 1, 2) and op(i + 2) == OpCode::GETI)) {
+      instrs[i] = VMInstr::LOADLOAD(arg(i), arg(i + 1));
+      length = 2;
+    }
+    else if (fusable(i, 2) and op(i + 1) == OpCode::JMPF and
+             compare_jump(op(i), 0)) {
+      instrs[i] = *compare_jump(op(i), target(instrs[i + 1]));
+      length = 2;
+    }
+    for (int j = i + 1; j < i + length; ++j)
+      removed[j] = true;
+    if (length > 0)
+      i += length - 1;
+  }
+}
+
+
+void optimize(VMFrameInfo& frame, int level)
+{
+  if (level <= 0)
+    return;
+  vector<VMInstr>& instrs = frame.instructions;
+  vector<bool> removed(instrs.size(), false);
+  // each rewrite can expose more, so repeat until nothing changes
+  bool changed = true;
+  while (changed) {
+    changed = thread_jumps(instrs);
+    changed = remove_unreachable(instrs, removed) or changed;
+    compact(instrs, removed);
+    changed = rewrite_pairs(instrs, removed) or changed;
+    compact(instrs, removed);
+  }
+  if (level >= 2) {
+    fuse(instrs, removed);
+    compact(instrs, removed);
+  }
+  frame.max_stack = max_stack_depth(frame);
+}
@@ -0,0 +1,40 @@
+//----------------------------------------------------------------------
+// FILE: optimizer.h
+// DATE: Spring 2023
+// AUTH: Nisa Meshal
+// DESC: Peephole optimizer for VM frame instruction streams
+//----------------------------------------------------------------------
+
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "vm_frame.h"
+
+
+// Optimize the frame's instructions in place. Level 0 leaves the frame
+// unchanged. Level 1 threads jumps through NOPs and jump chains,
+// removes unreachable code, NOPs, and jumps to the next instruction
+// (a conditional one becomes a POP), and rewrites the following
+// instruction pairs (when the second instruction is not a jump target):
+//
+//   PUSH c; POP    ->  (removed)
+//   LOAD x; POP    ->  (removed)
+//   DUP; POP       ->  (removed)
+//   PUSH(true); JMPF t   ->  (removed)
+//   PUSH(false); JMPF t  ->  JMP t
+//   STORE x; LOAD x  ->  DUP; STORE x
+//
+// Level 2 then fuses common sequences into superinstructions (when no
+// instruction but the first is a jump target):
+//
+//   LOAD x; PUSH c; ADD; STORE x  ->  INCLOCAL(x, c)   (SUB uses -c,
+//                                      and IADD/ISUB work the same)
+//   LOAD x; GETI     ->  LOAD_GETI(x)
+//   LOAD x; LOAD y   ->  LOADLOAD(x, y)
+//   CMPxx; JMPF t    ->  CMPxx_JMPF(t)     (ICMPxx; JMPF t -> ICMPxx_JMPF(t))
+//
+// The frame's max_stack is recomputed afterward.
+void optimize(VMFrameInfo& frame, int level);
+
+
+#endif
@@ -37,308 +37,267 @@ void PrintVisitor::print_indent()
 
 void PrintVisitor::visit(Program& p)
 {
-  for (auto struct_def : p.struct_defs)
-    struct_def.accept(*this);
-  for (auto fun_def : p.fun_defs)
-    fun_def.accept(*this);
+  print(FlatAST(p));
 }
 
-// TODO: Finish the visitor functions
 
-void PrintVisitor::visit(FunDef& f) {
-  print_data_type_helper(f.return_type);  
-
-  out << f.fun_name.lexeme() << "(";
-
-  //print params
-  if(!f.params.empty()) {
-    for (auto param : f.params) {
-      if(&param == &f.params.back()) { //reached second from last of params
-        break; 
-      }
+//-------------------HELPERS------------------------
 
-      print_data_type_helper(param.data_type);
-      out << param.var_name.lexeme() << ", ";
-    }
-      //print last param
-    print_data_type_helper(f.params.back().data_type);
-    out << f.params.back().var_name.lexeme();
+void PrintVisitor::print_value(TokenType type, const string& lexeme) {
+  if(type == TokenType::STRING_VAL) {
+    out << "\"" << lexeme << "\"";
   }
+  else if(type == TokenType::CHAR_VAL) {
+    out << "'" << lexeme << "'";
+  }
+  else {
+    out << lexeme;
+  }
+}
 
-  out << ") {" << endl;
-   
-  inc_indent(); 
-
-  for(auto st : f.stmts) {
-    print_indent();
-    st->accept(*this); 
-    out << endl;
+void PrintVisitor::print_data_type_helper(const DataType& d) {
+  if(d.is_array == true) {
+    out << "array ";
   }
-  dec_indent(); 
 
-  out << "}" << endl; 
-  out << endl; 
+  out << d.type_name << " ";
 }
 
-void PrintVisitor::visit(StructDef& s) {
-  out << "struct " << s.struct_name.lexeme() << " {" << endl;
+bool PrintVisitor::compare(TokenType t) {
+  if(t == TokenType::INT_VAL ||
+      t == TokenType::DOUBLE_VAL ||
+      t == TokenType::BOOL_VAL ||
+      t == TokenType::CHAR_VAL ||
+      t == TokenType::STRING_VAL ||
+      t == TokenType::NULL_VAL ||
+      t == TokenType::ID) {
+    return true; 
+  }
 
-  if(!s.fields.empty()) {
-    inc_indent();
-    for (auto field : s.fields) {
-      if(&field == &s.fields.back()) {
-        break;
-      }
+  return false;
+}
 
-      print_indent();
-      print_data_type_helper(field.data_type);
-      out << field.var_name.lexeme() << "," << endl; 
-    }
+//-------------------FLAT PROGRAMS------------------------
 
-    print_indent();
-    print_data_type_helper(s.fields.back().data_type);
-    out << s.fields.back().var_name.lexeme() << endl;
+void PrintVisitor::print(const FlatAST& ast) {
+  flat = &ast;
 
-    dec_indent();
+  for (const FlatStructDef& s : ast.struct_defs) {
+    print_struct(s);
   }
-  out << "}" << endl << endl;
-}
-
-void PrintVisitor::visit(ReturnStmt& s) {
-  out << "return ";
-  s.expr.accept(*this);  
-}
-
-void PrintVisitor::visit(WhileStmt& s) {
-  out << "while (";
-  s.condition.accept(*this);
-  out << ") {" << endl;
 
-  inc_indent(); 
-  for(auto stmt : s.stmts) {
-    print_indent(); 
-    stmt->accept(*this); 
-    out << endl; 
+  for (const FlatFunDef& f : ast.fun_defs) {
+    print_fun(f);
   }
-  dec_indent(); 
-  
-  print_indent(); 
-  out << "}" << endl;
 }
 
-void PrintVisitor::visit(ForStmt& s) {
-  out << "for ("; 
-  s.var_decl.accept(*this); 
-  out << "; ";
-  s.condition.accept(*this); 
-  out << "; ";
-  s.var_decl.accept(*this);
-  out << ") {" << endl; 
-
+void PrintVisitor::print_struct(const FlatStructDef& s) {
+  out << "struct " << flat->lexeme(s.name) << " {" << endl;
   inc_indent();
-  for(auto stmt : s.stmts) {
+  for (FlatIndex i = s.fields.begin; i < s.fields.end; ++i) {
     print_indent();
-    stmt->accept(*this);
+    print_data_type_helper(flat->data_type(flat->vars[i].type));
+    out << flat->lexeme(flat->vars[i].name);
+    if(i + 1 != s.fields.end) {
+      out << ",";
+    }
     out << endl;
   }
   dec_indent();
-
-  print_indent();
-  out << "}" << endl;
+  out << "}" << endl << endl;
 }
 
-void PrintVisitor::visit(IfStmt& s) {
-  out << "if (";
-  s.if_part.condition.accept(*this); 
-  out << ") {" << endl; 
-  
-  inc_indent();
-  for(auto stmt : s.if_part.stmts) {
-    print_indent();
-    stmt->accept(*this); 
-    out << endl;
-  }
-  dec_indent(); 
-  
-  print_indent();
-  out << "}" << endl; 
-
-  if(!s.else_ifs.empty()) {
-    for(auto elif : s.else_ifs) {
-      print_indent();
-      out << "elseif (";
-      elif.condition.accept(*this);
-      out << ") {" << endl ;
-      
-      inc_indent();
-      for(auto stmt : elif.stmts) {
-        print_indent();
-        stmt->accept(*this); 
-        out << endl; 
-      }
-      dec_indent();
-
-      print_indent();
-      out << "}" << endl;
+void PrintVisitor::print_fun(const FlatFunDef& f) {
+  print_data_type_helper(flat->data_type(f.return_type));
+  out << flat->lexeme(f.name) << "(";
+  for (FlatIndex i = f.params.begin; i < f.params.end; ++i) {
+    if(i != f.params.begin) {
+      out << ", ";
     }
+    print_data_type_helper(flat->data_type(flat->vars[i].type));
+    out << flat->lexeme(flat->vars[i].name);
   }
+  out << ") {" << endl;
 
-  if(!s.else_stmts.empty()) {
-    print_indent();
-    out << "else {" << endl;
+  inc_indent();
+  print_block(f.body);
+  dec_indent();
 
-    inc_indent(); 
-    for(auto stmt : s.else_stmts) {  
-      print_indent();
-      stmt->accept(*this);
-      out << endl; 
-    }
-    dec_indent();
+  out << "}" << endl;
+  out << endl;
+}
 
+void PrintVisitor::print_block(FlatRange body) {
+  for (FlatIndex i = body.begin; i < body.end; ++i) {
     print_indent();
-    out << "}";
+    print_stmt(i);
+    out << endl;
   }
 }
 
-void PrintVisitor::visit(VarDeclStmt& s) {
-  print_data_type_helper(s.var_def.data_type);
-  out << s.var_def.var_name.lexeme() << " = ";
-  s.expr.accept(*this); 
-}
-
-void PrintVisitor::visit(AssignStmt& s) {
-  for(auto lval  : s.lvalue) {
-    out << lval.var_name.lexeme();
-    if(lval.array_expr.has_value()) {
-      out << "[";
-      lval.array_expr->accept(*this); 
-      out << "]"; 
-      if(lval.array_expr_2D.has_value()) {
-        out << "[";
-        lval.array_expr_2D->accept(*this);
-        out << "]"; 
-      }
+void PrintVisitor::print_stmt(FlatIndex i) {
+  const FlatStmt& s = flat->stmts[i];
+
+  switch (s.kind) {
+  case FlatStmtKind::VAR_DECL:
+    print_data_type_helper(flat->data_type(flat->vars[s.var].type));
+    out << flat->lexeme(flat->vars[s.var].name) << " = ";
+    print_expr(s.expr);
+    break;
+  case FlatStmtKind::ASSIGN:
+    print_path(s.path);
+    out << " = ";
+    print_expr(s.expr);
+    break;
+  case FlatStmtKind::CALL:
+    print_expr(s.expr);
+    break;
+  case FlatStmtKind::RETURN:
+    out << "return ";
+    print_expr(s.expr);
+    break;
+  case FlatStmtKind::WHILE:
+  case FlatStmtKind::FOR:
+    if(s.kind == FlatStmtKind::WHILE) {
+      out << "while (";
+      print_expr(s.expr);
     }
-    if(lval.var_name.lexeme() != s.lvalue.front().var_name.lexeme() && lval.var_name.lexeme() != s.lvalue.back().var_name.lexeme()) {
-      out << ".";
+    else {
+      out << "for (";
+      print_stmt(s.init);
+      out << "; ";
+      print_expr(s.expr);
+      out << "; ";
+      print_stmt(s.update);
     }
-  }
-
-  out << " = ";
-  s.expr.accept(*this);
-}
+    out << ") {" << endl;
 
-void PrintVisitor::visit(CallExpr& e) {
-  out << e.fun_name.lexeme() << "(";
+    inc_indent();
+    print_block(s.body);
+    dec_indent();
 
-  if(e.args.size() > 1) {
-    for(auto arg : e.args) {
-      if(&arg == &e.args.back()) {
-        break;
+    print_indent();
+    out << "}" << endl;
+    break;
+  case FlatStmtKind::IF:
+    for (FlatIndex b = s.body.begin; b < s.body.end; ++b) {
+      const FlatBranch& branch = flat->branches[b];
+      if(b == s.body.begin) {
+        out << "if (";
+      }
+      else {
+        print_indent();
+        out << (branch.condition == FLAT_NONE ? "else {" : "elseif (");
+      }
+      if(branch.condition != FLAT_NONE) {
+        print_expr(branch.condition);
+        out << ") {";
       }
+      out << endl;
 
-      arg.accept(*this);
-      out << ", ";
+      inc_indent();
+      print_block(branch.body);
+      dec_indent();
+
+      print_indent();
+      out << "}";
+      //the else part is the last branch, ending the statement
+      if(branch.condition != FLAT_NONE) {
+        out << endl;
+      }
     }
+    break;
   }
-
-  e.args.back().accept(*this);
-  out << ")"; 
 }
 
-void PrintVisitor::visit(Expr& e) {
-  e.first->accept(*this);
+void PrintVisitor::print_expr(FlatIndex i) {
+  const FlatExpr& e = flat->exprs[i];
 
-  if(e.op != nullopt) {
-    Token t = *e.op; 
-    out << " " << t.lexeme() << " "; 
+  if(e.negated) {
+    out << "not ";
   }
 
-  if(e.rest != nullptr) {
-    e.rest->accept(*this); 
+  switch (e.kind) {
+  case FlatExprKind::VALUE:
+    print_value(flat->tokens[e.token].type, flat->lexeme(e.token));
+    break;
+  case FlatExprKind::NEW:
+    out << "new " << flat->lexeme(e.token);
+    for (FlatIndex size = e.children.begin; size < e.children.end; ++size) {
+      out << "[";
+      print_expr(size);
+      out << "]";
+    }
+    break;
+  case FlatExprKind::VAR:
+    print_path(e.children);
+    break;
+  case FlatExprKind::CALL:
+    out << flat->lexeme(e.token) << "(";
+    for (FlatIndex arg = e.children.begin; arg < e.children.end; ++arg) {
+      if(arg != e.children.begin) {
+        out << ", ";
+      }
+      print_expr(arg);
+    }
+    out << ")";
+    break;
+  case FlatExprKind::PAREN:
+    out << "(";
+    print_expr(e.children.begin);
+    out << ")";
+    break;
   }
-}
 
-void PrintVisitor::visit(SimpleTerm& t) {
-  if(t.first_token().type() == TokenType::NOT) {
-    out << "not ";
+  if(e.op != FLAT_NONE) {
+    out << " " << flat->lexeme(e.op) << " ";
   }
 
-  t.rvalue->accept(*this); 
-}
-
-void PrintVisitor::visit(ComplexTerm& t) {
-  out << "(";
-  t.expr.accept(*this); 
-  out << ")"; 
-}
-
-void PrintVisitor::visit(SimpleRValue& v) {
-  if(v.value.type() == TokenType::STRING_VAL) {
-    out << "\"" << v.value.lexeme() << "\"";
-  }
-  else {
-      out << v.value.lexeme() ; 
+  if(e.rest != FLAT_NONE) {
+    print_expr(e.rest);
   }
 }
 
-void PrintVisitor::visit(NewRValue& v) {
-  out << "new " << v.type.lexeme();
-  if(v.array_expr.has_value()) {
-    out << "[";
-    v.array_expr->accept(*this); 
-    out << "]"; 
-    if(v.array_expr_2D.has_value()) {
-      out << "[";
-      v.array_expr_2D->accept(*this);
-      out << "]";
+void PrintVisitor::print_path(FlatRange path) {
+  for (FlatIndex i = path.begin; i < path.end; ++i) {
+    const FlatRef& ref = flat->refs[i];
+    if(i != path.begin) {
+      out << ".";
     }
-  }
-}
+    out << flat->lexeme(ref.name);
 
-void PrintVisitor::visit(VarRValue& v) {
-  for(auto var : v.path) {
-    out << var.var_name.lexeme();
-
-    if(var.array_expr.has_value()) {
+    if(ref.array_expr != FLAT_NONE) {
       out << "[";
-      var.array_expr->accept(*this); 
+      print_expr(ref.array_expr);
       out << "]";
-      
-      if(var.array_expr_2D.has_value()) {
-        out <<"[";
-        var.array_expr_2D->accept(*this);
+
+      if(ref.array_expr_2D != FLAT_NONE) {
+        out << "[";
+        print_expr(ref.array_expr_2D);
         out << "]";
       }
     }
-
-    if(var.var_name.lexeme() != v.path[0].var_name.lexeme() && var.var_name.lexeme() != v.path.back().var_name.lexeme()) {
-      out << ".";
-    }
   }
-} 
-
+}
 
-//-------------------HELPERS------------------------
+//-------------------NODES VISITED ON THEIR OWN------------------------
 
-void PrintVisitor::print_data_type_helper(DataType& d) {
-  if(d.is_array == true) {
-    out << "array ";
-  }
+void PrintVisitor::walk_struct_def(FlatAST& ast, FlatIndex s) {
+  flat = &ast;
+  print_struct(ast.struct_defs[s]);
+}
 
-  out << d.type_name << " ";
+void PrintVisitor::walk_fun_def(FlatAST& ast, FlatIndex f) {
+  flat = &ast;
+  print_fun(ast.fun_defs[f]);
 }
 
-bool PrintVisitor::compare(TokenType t) {
-  if(t == TokenType::INT_VAL ||
-      t == TokenType::DOUBLE_VAL ||
-      t == TokenType::BOOL_VAL ||
-      t == TokenType::CHAR_VAL ||
-      t == TokenType::STRING_VAL ||
-      t == TokenType::NULL_VAL ||
-      t == TokenType::ID) {
-    return true; 
-  }
+void PrintVisitor::walk_stmt(FlatAST& ast, FlatIndex s) {
+  flat = &ast;
+  print_stmt(s);
+}
 
-  return false;
-}
\ No newline at end of file
+void PrintVisitor::walk_expr(FlatAST& ast, FlatIndex e) {
+  flat = &ast;
+  print_expr(e);
+}
@@ -11,29 +11,20 @@
 
 #include <ostream>
 #include "ast.h"
+#include "flat_ast.h"
 
 
-class PrintVisitor : public Visitor {
+class PrintVisitor : public ProgramVisitor {
 public:
   PrintVisitor(std::ostream& output);
+
+  // print a program (through its flat encoding)
   void visit(Program& p);
-  void visit(FunDef& f);
-  void visit(StructDef& s);
-  void visit(ReturnStmt& s);
-  void visit(WhileStmt& s);
-  void visit(ForStmt& s);
-  void visit(IfStmt& s);
-  void visit(VarDeclStmt& s);
-  void visit(AssignStmt& s);
-  void visit(CallExpr& e);
-  void visit(Expr& e);
-  void visit(SimpleTerm& t); 
-  void visit(ComplexTerm& t);
-  void visit(SimpleRValue& v);
-  void visit(NewRValue& v);
-  void visit(VarRValue& v);    
-
-  void print_data_type_helper(DataType& d); 
+
+  // print a flat program
+  void print(const FlatAST& ast);
+
+  void print_data_type_helper(const DataType& d); 
   bool compare(TokenType t);
 private:
   std::ostream& out;  
@@ -43,6 +34,24 @@ private:
   void inc_indent();
   void dec_indent();
   void print_indent();
+
+  // print a literal value (quoting strings and characters)
+  void print_value(TokenType type, const std::string& lexeme);
+
+  // flat program walk
+  const FlatAST* flat = nullptr;
+  void print_struct(const FlatStructDef& s);
+  void print_fun(const FlatFunDef& f);
+  void print_block(FlatRange body);
+  void print_stmt(FlatIndex s);
+  void print_expr(FlatIndex e);
+  void print_path(FlatRange path);
+
+  // print a node visited on its own (see ProgramVisitor)
+  void walk_struct_def(FlatAST& ast, FlatIndex s);
+  void walk_fun_def(FlatAST& ast, FlatIndex f);
+  void walk_stmt(FlatAST& ast, FlatIndex s);
+  void walk_expr(FlatAST& ast, FlatIndex e);
   
 };
 
@@ -0,0 +1,511 @@
+//----------------------------------------------------------------------
+// FILE: reg_code_generator.cpp
+// DATE: Spring 2023
+// AUTH: Nisa Meshal
+// DESC: Code generator for the register vm
+//----------------------------------------------------------------------
+
+#include <algorithm>
+#include <cstdio>
+#include "code_generator.h"
+#include "reg_code_generator.h"
+
+using namespace std;
+
+
+// helper to count the variable declarations in the statements (an upper
+// bound on the var table indexes the statements use)
+static int count_decls(ASTList<Stmt*> stmts)
+{
+  int count = 0;
+  for (Stmt* stmt : stmts) {
+    if (dynamic_cast<VarDeclStmt*>(stmt))
+      ++count;
+    else if (auto s = dynamic_cast<WhileStmt*>(stmt))
+      count += count_decls(s->stmts);
+    else if (auto s = dynamic_cast<ForStmt*>(stmt))
+      count += 1 + count_decls(s->stmts);
+    else if (auto s = dynamic_cast<IfStmt*>(stmt)) {
+      count += count_decls(s->if_part.stmts);
+      for (const BasicIf& else_if : s->else_ifs)
+        count += count_decls(else_if.stmts);
+      count += count_decls(s->else_stmts);
+    }
+  }
+  return count;
+}
+
+
+RegCodeGenerator::RegCodeGenerator(RegVM& vm)
+  : vm(vm)
+{
+}
+
+
+int RegCodeGenerator::emit(RegOpCode op, int a, int b, int c)
+{
+  curr_frame.instructions.push_back(RegInstr(op, a, b, c));
+  return curr_frame.instructions.size() - 1;
+}
+
+
+int RegCodeGenerator::new_temp()
+{
+  int reg = var_count + temp_count++;
+  curr_frame.register_count = max(curr_frame.register_count, reg + 1);
+  return reg;
+}
+
+
+int RegCodeGenerator::constant(const VMValue& value)
+{
+  // keyed by type and value (doubles exactly, since to_string rounds)
+  string key = to_string(value);
+  if (value.is_double()) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "d%a", value.as_double());
+    key = buffer;
+  }
+  else if (value.is_int())
+    key = "i" + key;
+  else if (value.is_bool())
+    key = "b" + key;
+  else if (value.is_string())
+    key = "s" + key;
+  auto [entry, added] = constant_regs.try_emplace(
+    key, -int(curr_frame.constants.size() + 1));
+  if (added)
+    curr_frame.constants.push_back(value);
+  return entry->second;
+}
+
+
+int RegCodeGenerator::gen(Expr& e)
+{
+  e.accept(*this);
+  return curr_reg;
+}
+
+
+void RegCodeGenerator::gen_into(Expr& e, int dst)
+{
+  vector<RegInstr>& instrs = curr_frame.instructions;
+  int start = instrs.size();
+  int reg = gen(e);
+  // write the result straight to dst when it was computed into a new
+  // temporary by the last instruction
+  if (reg >= var_count and instrs.size() > start and
+      instrs.back().writes_a() and instrs.back().a == reg)
+    instrs.back().a = dst;
+  else if (reg != dst)
+    emit(RegOpCode::MOVE, dst, reg);
+}
+
+
+int RegCodeGenerator::gen_jump_false(Expr& condition)
+{
+  static const unordered_map<TokenType, RegOpCode> jumps = {
+    {TokenType::LESS, RegOpCode::JMPF_LT},
+    {TokenType::LESS_EQ, RegOpCode::JMPF_LE},
+    {TokenType::GREATER, RegOpCode::JMPF_GT},
+    {TokenType::GREATER_EQ, RegOpCode::JMPF_GE},
+    {TokenType::EQUAL, RegOpCode::JMPF_EQ},
+    {TokenType::NOT_EQUAL, RegOpCode::JMPF_NE}
+  };
+  // compare and jump in one instruction when the condition is a
+  // (non-negated) comparison
+  if (!condition.negated and condition.rest and
+      jumps.contains(condition.op->type())) {
+    condition.first->accept(*this);
+    int x = curr_reg;
+    int y = gen(*condition.rest);
+    return emit(jumps.at(condition.op->type()), x, y, -1);
+  }
+  int reg = gen(condition);
+  return emit(RegOpCode::JMPF, reg, 0, -1);
+}
+
+
+void RegCodeGenerator::gen_block(ASTList<Stmt*> stmts)
+{
+  var_table.push_environment();
+  for (Stmt* stmt : stmts) {
+    // temporaries never outlive a statement
+    temp_count = 0;
+    stmt->accept(*this);
+  }
+  var_table.pop_environment();
+}
+
+
+void RegCodeGenerator::add_var(const VarDef& var_def)
+{
+  var_table.add(var_def.var_name.lexeme());
+  int index = var_table.get(var_def.var_name.lexeme());
+  if (index >= var_types.size())
+    var_types.resize(index + 1);
+  var_types[index] = var_def.data_type.type_name;
+}
+
+
+int RegCodeGenerator::field_slot(const string& type, const string& field) const
+{
+  auto entry = struct_defs.find(type);
+  if (entry == struct_defs.end())
+    return -1;
+  const vector<VarDef>& fields = entry->second->fields;
+  for (int i = 0; i < fields.size(); ++i)
+    if (fields[i].var_name.lexeme() == field)
+      return i;
+  return -1;
+}
+
+
+int RegCodeGenerator::get_field(int obj, string& type, const string& field)
+{
+  int slot = field_slot(type, field);
+  int reg = new_temp();
+  if (slot < 0) {
+    emit(RegOpCode::GETF, reg, obj, constant(field));
+    type = "";
+    return reg;
+  }
+  emit(RegOpCode::GETFI, reg, obj, slot);
+  type = struct_defs.at(type)->fields[slot].data_type.type_name;
+  return reg;
+}
+
+
+int RegCodeGenerator::get_element(int obj, VarRef& var)
+{
+  if (var.array_expr_2D.has_value()) {
+    int row = new_temp();
+    int column = new_temp();
+    gen_into(*var.array_expr, row);
+    gen_into(*var.array_expr_2D, column);
+    int reg = new_temp();
+    emit(RegOpCode::GETI2D, reg, obj, row);
+    return reg;
+  }
+  int index = gen(*var.array_expr);
+  int reg = new_temp();
+  emit(RegOpCode::GETI, reg, obj, index);
+  return reg;
+}
+
+
+void RegCodeGenerator::visit(Program& p)
+{
+  for (auto& struct_def : p.struct_defs)
+    struct_def.accept(*this);
+  for (auto& fun_def : p.fun_defs)
+    fun_def.accept(*this);
+}
+
+
+void RegCodeGenerator::visit(FunDef& f)
+{
+  curr_frame = RegFrameInfo();
+  curr_frame.function_name = f.fun_name.lexeme();
+  curr_frame.arg_count = f.params.size();
+  constant_regs.clear();
+  var_count = f.params.size() + count_decls(f.stmts);
+  curr_frame.register_count = var_count;
+
+  // the parameters are the first variables (so the caller's arguments
+  // are copied straight into them)
+  var_table.push_environment();
+  for (const VarDef& param : f.params)
+    add_var(param);
+  for (Stmt* stmt : f.stmts) {
+    temp_count = 0;
+    stmt->accept(*this);
+  }
+  if (f.return_type.type_name == "void")
+    emit(RegOpCode::RET, constant(nullptr));
+  var_table.pop_environment();
+
+  vm.add(curr_frame);
+}
+
+
+void RegCodeGenerator::visit(StructDef& s)
+{
+  struct_defs[s.struct_name.lexeme()] = &s;
+}
+
+
+void RegCodeGenerator::visit(ReturnStmt& s)
+{
+  emit(RegOpCode::RET, gen(s.expr));
+}
+
+
+void RegCodeGenerator::visit(WhileStmt& s)
+{
+  int start = curr_frame.instructions.size();
+  int jump = gen_jump_false(s.condition);
+  gen_block(s.stmts);
+  emit(RegOpCode::JMP, start);
+  curr_frame.instructions[jump].set_target(curr_frame.instructions.size());
+}
+
+
+void RegCodeGenerator::visit(ForStmt& s)
+{
+  var_table.push_environment();
+  s.var_decl.accept(*this);
+  int start = curr_frame.instructions.size();
+  temp_count = 0;
+  int jump = gen_jump_false(s.condition);
+  gen_block(s.stmts);
+  temp_count = 0;
+  s.assign_stmt.accept(*this);
+  var_table.pop_environment();
+  emit(RegOpCode::JMP, start);
+  curr_frame.instructions[jump].set_target(curr_frame.instructions.size());
+}
+
+
+void RegCodeGenerator::visit(IfStmt& s)
+{
+  // jumps from the end of each taken branch to the end of the statement
+  vector<int> end_jumps;
+  bool more = !s.else_ifs.empty() or !s.else_stmts.empty();
+  int jump = gen_jump_false(s.if_part.condition);
+  gen_block(s.if_part.stmts);
+  if (more)
+    end_jumps.push_back(emit(RegOpCode::JMP, -1));
+  curr_frame.instructions[jump].set_target(curr_frame.instructions.size());
+  for (int i = 0; i < s.else_ifs.size(); ++i) {
+    temp_count = 0;
+    jump = gen_jump_false(s.else_ifs[i].condition);
+    gen_block(s.else_ifs[i].stmts);
+    if (i + 1 < s.else_ifs.size() or !s.else_stmts.empty())
+      end_jumps.push_back(emit(RegOpCode::JMP, -1));
+    curr_frame.instructions[jump].set_target(curr_frame.instructions.size());
+  }
+  gen_block(s.else_stmts);
+  for (int end_jump : end_jumps)
+    curr_frame.instructions[end_jump].set_target(curr_frame.instructions.size());
+}
+
+
+void RegCodeGenerator::visit(VarDeclStmt& s)
+{
+  add_var(s.var_def);
+  gen_into(s.expr, var_table.get(s.var_def.var_name.lexeme()));
+}
+
+
+void RegCodeGenerator::visit(AssignStmt& s)
+{
+  int index = var_table.get(s.lvalue[0].var_name.lexeme());
+  VarRef& first = s.lvalue[0];
+
+  // a plain variable is just computed into
+  if (s.lvalue.size() == 1 and !first.array_expr.has_value()) {
+    gen_into(s.expr, index);
+    return;
+  }
+
+  if (s.lvalue.size() == 1) {
+    if (first.array_expr_2D.has_value()) {
+      int row = new_temp();
+      int column = new_temp();
+      gen_into(*first.array_expr, row);
+      gen_into(*first.array_expr_2D, column);
+      emit(RegOpCode::SETI2D, index, row, gen(s.expr));
+    }
+    else {
+      int element = gen(*first.array_expr);
+      emit(RegOpCode::SETI, index, element, gen(s.expr));
+    }
+    return;
+  }
+
+  // follow the path up to the last field (tracking the struct type to
+  // resolve field slots)
+  int obj = index;
+  if (first.array_expr.has_value())
+    obj = get_element(obj, first);
+  string type = index >= 0 ? var_types[index] : "";
+  for (int i = 1; i < s.lvalue.size() - 1; ++i) {
+    obj = get_field(obj, type, s.lvalue[i].var_name.lexeme());
+    if (s.lvalue[i].array_expr.has_value())
+      obj = get_element(obj, s.lvalue[i]);
+  }
+
+  VarRef& last = s.lvalue.back();
+  if (last.array_expr.has_value()) {
+    obj = get_field(obj, type, last.var_name.lexeme());
+    // the stack code generator evaluates a trailing 2D index with the
+    // second index as the row
+    if (last.array_expr_2D.has_value()) {
+      int row = new_temp();
+      int column = new_temp();
+      gen_into(*last.array_expr_2D, row);
+      gen_into(*last.array_expr, column);
+      emit(RegOpCode::SETI2D, obj, row, gen(s.expr));
+    }
+    else {
+      int element = gen(*last.array_expr);
+      emit(RegOpCode::SETI, obj, element, gen(s.expr));
+    }
+  }
+  else {
+    int value = gen(s.expr);
+    int slot = field_slot(type, last.var_name.lexeme());
+    if (slot < 0)
+      emit(RegOpCode::SETF, obj, constant(last.var_name.lexeme()), value);
+    else
+      emit(RegOpCode::SETFI, obj, slot, value);
+  }
+}
+
+
+void RegCodeGenerator::visit(CallExpr& e)
+{
+  static const unordered_map<string, RegOpCode> unary_built_ins = {
+    {"to_string", RegOpCode::TOSTR}, {"to_int", RegOpCode::TOINT},
+    {"to_double", RegOpCode::TODBL}, {"length", RegOpCode::SLEN},
+    {"length@array", RegOpCode::ALEN}
+  };
+  string fun_name = e.fun_name.lexeme();
+  if (fun_name == "print") {
+    curr_reg = gen(e.args[0]);
+    emit(RegOpCode::WRITE, curr_reg);
+  }
+  else if (fun_name == "input") {
+    curr_reg = new_temp();
+    emit(RegOpCode::READ, curr_reg);
+  }
+  else if (unary_built_ins.contains(fun_name)) {
+    int x = gen(e.args[0]);
+    curr_reg = new_temp();
+    emit(unary_built_ins.at(fun_name), curr_reg, x);
+  }
+  else if (fun_name == "concat" or fun_name == "get") {
+    int x = gen(e.args[0]);
+    int y = gen(e.args[1]);
+    curr_reg = new_temp();
+    emit(fun_name == "concat" ? RegOpCode::CONCAT : RegOpCode::GETC,
+         curr_reg, x, y);
+  }
+  else {
+    // the arguments go in consecutive temporaries
+    int args = var_count + temp_count;
+    for (int i = 0; i < e.args.size(); ++i)
+      new_temp();
+    for (int i = 0; i < e.args.size(); ++i)
+      gen_into(e.args[i], args + i);
+    curr_reg = new_temp();
+    emit(RegOpCode::CALL, curr_reg, vm.function_id(fun_name), args);
+  }
+}
+
+
+void RegCodeGenerator::visit(Expr& e)
+{
+  static const unordered_map<TokenType, RegOpCode> ops = {
+    {TokenType::PLUS, RegOpCode::ADD}, {TokenType::MINUS, RegOpCode::SUB},
+    {TokenType::TIMES, RegOpCode::MUL}, {TokenType::DIVIDE, RegOpCode::DIV},
+    {TokenType::EQUAL, RegOpCode::CMPEQ},
+    {TokenType::NOT_EQUAL, RegOpCode::CMPNE},
+    {TokenType::LESS, RegOpCode::CMPLT},
+    {TokenType::GREATER, RegOpCode::CMPGT},
+    {TokenType::LESS_EQ, RegOpCode::CMPLE},
+    {TokenType::GREATER_EQ, RegOpCode::CMPGE},
+    {TokenType::AND, RegOpCode::AND}, {TokenType::OR, RegOpCode::OR}
+  };
+  e.first->accept(*this);
+  int reg = curr_reg;
+  if (e.rest != nullptr) {
+    int x = reg;
+    int y = gen(*e.rest);
+    reg = new_temp();
+    emit(ops.at(e.op->type()), reg, x, y);
+  }
+  // negate the expression at the end, once everything is computed
+  if (e.negated) {
+    int x = reg;
+    reg = new_temp();
+    emit(RegOpCode::NOT, reg, x);
+  }
+  curr_reg = reg;
+}
+
+
+void RegCodeGenerator::visit(SimpleTerm& t)
+{
+  t.rvalue->accept(*this);
+}
+
+
+void RegCodeGenerator::visit(ComplexTerm& t)
+{
+  t.expr.accept(*this);
+}
+
+
+void RegCodeGenerator::visit(SimpleRValue& v)
+{
+  TokenType type = v.value.type();
+  if (type == TokenType::INT_VAL)
+    curr_reg = constant(stoi(v.value.lexeme()));
+  else if (type == TokenType::DOUBLE_VAL)
+    curr_reg = constant(stod(v.value.lexeme()));
+  else if (type == TokenType::NULL_VAL)
+    curr_reg = constant(nullptr);
+  else if (type == TokenType::BOOL_VAL)
+    curr_reg = constant(v.value.lexeme() == "true");
+  else {
+    string s = v.value.lexeme();
+    replace_all(s, "\\n", "\n");
+    replace_all(s, "\\t", "\t");
+    replace_all(s, "\\'", "\'");
+    curr_reg = constant(s);
+  }
+}
+
+
+void RegCodeGenerator::visit(NewRValue& v)
+{
+  if (v.array_expr.has_value()) {
+    // the stack code generator evaluates the column count first
+    if (v.array_expr_2D.has_value()) {
+      int columns = gen(*v.array_expr_2D);
+      int rows = gen(*v.array_expr);
+      curr_reg = new_temp();
+      emit(RegOpCode::ALLOCA2D, curr_reg, rows, columns);
+    }
+    else {
+      int size = gen(*v.array_expr);
+      curr_reg = new_temp();
+      emit(RegOpCode::ALLOCA, curr_reg, size);
+    }
+  }
+  else {
+    auto entry = struct_defs.find(v.type.lexeme());
+    int field_count = entry == struct_defs.end() ? 0 :
+      entry->second->fields.size();
+    curr_reg = new_temp();
+    emit(RegOpCode::ALLOCS, curr_reg, field_count);
+  }
+}
+
+
+void RegCodeGenerator::visit(VarRValue& v)
+{
+  int index = var_table.get(v.path[0].var_name.lexeme());
+  int reg = index;
+  if (v.path[0].array_expr.has_value())
+    reg = get_element(reg, v.path[0]);
+  string type = index >= 0 ? var_types[index] : "";
+  for (int i = 1; i < v.path.size(); ++i) {
+    reg = get_field(reg, type, v.path[i].var_name.lexeme());
+    if (v.path[i].array_expr.has_value())
+      reg = get_element(reg, v.path[i]);
+  }
+  curr_reg = reg;
+}
@@ -0,0 +1,109 @@
+//----------------------------------------------------------------------
+// FILE: reg_code_generator.h
+// DATE: Spring 2023
+// AUTH: Nisa Meshal
+// DESC: Code generator visitor for the register vm
+//----------------------------------------------------------------------
+
+#ifndef REG_CODE_GENERATOR_H
+#define REG_CODE_GENERATOR_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ast.h"
+#include "reg_vm.h"
+#include "var_table.h"
+
+
+// Generates register vm code. Each variable has its own register (its
+// var table index), literals are constant registers, and expression
+// results go in temporary registers numbered after the variables. The
+// generated code has the same behavior as the stack code generator's,
+// including the order expressions are evaluated in.
+class RegCodeGenerator : public Visitor {
+public:
+  RegCodeGenerator(RegVM& vm);
+  void visit(Program& p);
+  void visit(FunDef& f);
+  void visit(StructDef& s);
+  void visit(ReturnStmt& s);
+  void visit(WhileStmt& s);
+  void visit(ForStmt& s);
+  void visit(IfStmt& s);
+  void visit(VarDeclStmt& s);
+  void visit(AssignStmt& s);
+  void visit(CallExpr& e);
+  void visit(Expr& e);
+  void visit(SimpleTerm& t);
+  void visit(ComplexTerm& t);
+  void visit(SimpleRValue& v);
+  void visit(NewRValue& v);
+  void visit(VarRValue& v);
+
+private:
+
+  RegVM& vm;
+  RegFrameInfo curr_frame;
+  VarTable var_table;
+  std::unordered_map<std::string,const StructDef*> struct_defs;
+
+  // type names of the variables in scope, by var table index (for
+  // arrays, the element type name)
+  std::vector<std::string> var_types;
+
+  // the register holding the value of the last visited expression
+  int curr_reg = 0;
+
+  // the number of variable registers of the current function (the
+  // temporaries start after them)
+  int var_count = 0;
+
+  // the temporaries in use by the current statement
+  int temp_count = 0;
+
+  // constant register of each literal of the current function, keyed
+  // by its type and value
+  std::unordered_map<std::string, int> constant_regs;
+
+  // add an instruction to the current frame, returning its index
+  int emit(RegOpCode op, int a = 0, int b = 0, int c = 0);
+
+  // returns a new temporary register
+  int new_temp();
+
+  // returns the constant register holding the value
+  int constant(const VMValue& value);
+
+  // generate an expression, returning the register holding its value
+  int gen(Expr& e);
+
+  // generate an expression whose value must end up in register dst
+  void gen_into(Expr& e, int dst);
+
+  // generate a jump taken when the condition is false, returning the
+  // jump's index so its target can be set
+  int gen_jump_false(Expr& condition);
+
+  // generate the statements of a block (in a new environment)
+  void gen_block(ASTList<Stmt*> stmts);
+
+  // add a variable to the var table, recording its type name
+  void add_var(const VarDef& var_def);
+
+  // returns the slot of the field in the struct type (or -1 if the
+  // struct or field is not known)
+  int field_slot(const std::string& type, const std::string& field) const;
+
+  // generate a read of the field of obj (of the given struct type,
+  // which is then updated to the field's type), returning the register
+  // holding the value
+  int get_field(int obj, std::string& type, const std::string& field);
+
+  // generate an element read of the array in register obj, returning
+  // the register holding the value
+  int get_element(int obj, VarRef& var);
+
+};
+
+#endif
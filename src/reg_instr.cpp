@@ -0,0 +1,93 @@
+//----------------------------------------------------------------------
+// FILE: reg_instr.cpp
+// DATE: Spring 2023
+// AUTH: Nisa Meshal
+// DESC: Register VM instructions
+//----------------------------------------------------------------------
+
+#include <unordered_map>
+#include "reg_instr.h"
+
+using namespace std;
+
+
+bool RegInstr::is_jump() const
+{
+  return op >= RegOpCode::JMP and op <= RegOpCode::JMPF_NE;
+}
+
+
+bool RegInstr::writes_a() const
+{
+  switch (op) {
+  case RegOpCode::JMP: case RegOpCode::JMPF: case RegOpCode::JMPF_LT:
+  case RegOpCode::JMPF_LE: case RegOpCode::JMPF_GT: case RegOpCode::JMPF_GE:
+  case RegOpCode::JMPF_EQ: case RegOpCode::JMPF_NE: case RegOpCode::RET:
+  case RegOpCode::WRITE: case RegOpCode::SETF: case RegOpCode::SETFI:
+  case RegOpCode::SETI: case RegOpCode::SETI2D: case RegOpCode::NOP:
+    return false;
+  default:
+    return true;
+  }
+}
+
+
+void RegInstr::set_target(int index)
+{
+  if (op == RegOpCode::JMP)
+    a = index;
+  else
+    c = index;
+}
+
+
+string to_string(const RegInstr& instr)
+{
+  static const unordered_map<RegOpCode, string> names = {
+    {RegOpCode::MOVE, "MOVE"}, {RegOpCode::ADD, "ADD"},
+    {RegOpCode::SUB, "SUB"}, {RegOpCode::MUL, "MUL"},
+    {RegOpCode::DIV, "DIV"}, {RegOpCode::AND, "AND"},
+    {RegOpCode::OR, "OR"}, {RegOpCode::NOT, "NOT"},
+    {RegOpCode::CMPLT, "CMPLT"}, {RegOpCode::CMPLE, "CMPLE"},
+    {RegOpCode::CMPGT, "CMPGT"}, {RegOpCode::CMPGE, "CMPGE"},
+    {RegOpCode::CMPEQ, "CMPEQ"}, {RegOpCode::CMPNE, "CMPNE"},
+    {RegOpCode::JMP, "JMP"}, {RegOpCode::JMPF, "JMPF"},
+    {RegOpCode::JMPF_LT, "JMPF_LT"}, {RegOpCode::JMPF_LE, "JMPF_LE"},
+    {RegOpCode::JMPF_GT, "JMPF_GT"}, {RegOpCode::JMPF_GE, "JMPF_GE"},
+    {RegOpCode::JMPF_EQ, "JMPF_EQ"}, {RegOpCode::JMPF_NE, "JMPF_NE"},
+    {RegOpCode::CALL, "CALL"}, {RegOpCode::RET, "RET"},
+    {RegOpCode::WRITE, "WRITE"}, {RegOpCode::READ, "READ"},
+    {RegOpCode::SLEN, "SLEN"}, {RegOpCode::ALEN, "ALEN"},
+    {RegOpCode::GETC, "GETC"}, {RegOpCode::TOINT, "TOINT"},
+    {RegOpCode::TODBL, "TODBL"}, {RegOpCode::TOSTR, "TOSTR"},
+    {RegOpCode::CONCAT, "CONCAT"}, {RegOpCode::ALLOCS, "ALLOCS"},
+    {RegOpCode::ALLOCA, "ALLOCA"}, {RegOpCode::ALLOCA2D, "ALLOCA2D"},
+    {RegOpCode::SETF, "SETF"}, {RegOpCode::GETF, "GETF"},
+    {RegOpCode::SETFI, "SETFI"}, {RegOpCode::GETFI, "GETFI"},
+    {RegOpCode::SETI, "SETI"}, {RegOpCode::SETI2D, "SETI2D"},
+    {RegOpCode::GETI, "GETI"}, {RegOpCode::GETI2D, "GETI2D"},
+    {RegOpCode::NOP, "NOP"}
+  };
+  // only print the operands the instruction uses
+  string operands;
+  switch (instr.op) {
+  case RegOpCode::NOP:
+    break;
+  case RegOpCode::JMP: case RegOpCode::RET: case RegOpCode::WRITE:
+  case RegOpCode::READ:
+    operands = to_string(instr.a);
+    break;
+  case RegOpCode::JMPF:
+    operands = to_string(instr.a) + ", " + to_string(instr.c);
+    break;
+  case RegOpCode::MOVE: case RegOpCode::NOT: case RegOpCode::SLEN:
+  case RegOpCode::ALEN: case RegOpCode::TOINT: case RegOpCode::TODBL:
+  case RegOpCode::TOSTR: case RegOpCode::ALLOCS: case RegOpCode::ALLOCA:
+    operands = to_string(instr.a) + ", " + to_string(instr.b);
+    break;
+  default:
+    operands = to_string(instr.a) + ", " + to_string(instr.b) + ", " +
+      to_string(instr.c);
+  }
+  return names.at(instr.op) + "(" + operands + ")";
+}
@@ -0,0 +1,118 @@
+//----------------------------------------------------------------------
+// FILE: reg_instr.h
+// DATE: Spring 2023
+// AUTH: Nisa Meshal
+// DESC: Register VM instructions
+//----------------------------------------------------------------------
+
+#ifndef REG_INSTR_H
+#define REG_INSTR_H
+
+#include <string>
+
+
+// Register operands index the frame's registers: the function's
+// variables and temporaries from 0 up and its constants from -1 down
+// (constant k is register -(k + 1)). R[x] is the value of register x.
+enum class RegOpCode {
+
+  // moves
+  MOVE,         // R[a] = R[b]
+
+  // arithmetic ops
+  ADD,          // R[a] = R[b] + R[c]
+  SUB,          // R[a] = R[b] - R[c]
+  MUL,          // R[a] = R[b] * R[c]
+  DIV,          // R[a] = R[b] / R[c]
+
+  // logical operators
+  AND,          // R[a] = R[b] and R[c]
+  OR,           // R[a] = R[b] or R[c]
+  NOT,          // R[a] = not R[b]
+
+  // comparators
+  CMPLT,        // R[a] = R[b] < R[c]
+  CMPLE,        // R[a] = R[b] <= R[c]
+  CMPGT,        // R[a] = R[b] > R[c]
+  CMPGE,        // R[a] = R[b] >= R[c]
+  CMPEQ,        // R[a] = R[b] == R[c]
+  CMPNE,        // R[a] = R[b] != R[c]
+
+  // jump
+  JMP,          // jump to instruction a
+  JMPF,         // if R[a] is false jump to instruction c
+  JMPF_LT,      // if not (R[a] < R[b]) jump to instruction c
+  JMPF_LE,      // if not (R[a] <= R[b]) jump to instruction c
+  JMPF_GT,      // if not (R[a] > R[b]) jump to instruction c
+  JMPF_GE,      // if not (R[a] >= R[b]) jump to instruction c
+  JMPF_EQ,      // if not (R[a] == R[b]) jump to instruction c
+  JMPF_NE,      // if not (R[a] != R[b]) jump to instruction c
+
+  // functions
+  CALL,         // R[a] = function b called with R[c] ... R[c + n - 1]
+  RET,          // return R[a] from the current function
+
+  // built-ins
+  WRITE,        // write R[a] to stdout
+  READ,         // R[a] = line read from stdin
+  SLEN,         // R[a] = length of string R[b]
+  ALEN,         // R[a] = length of array obj(R[b])
+  GETC,         // R[a] = R[c][R[b]] (a string of one char)
+  TOINT,        // R[a] = R[b] as an integer
+  TODBL,        // R[a] = R[b] as a double
+  TOSTR,        // R[a] = R[b] as a string
+  CONCAT,       // R[a] = R[b] + R[c] (string concat)
+
+  // heap
+  ALLOCS,       // R[a] = new struct obj with b null field slots
+  ALLOCA,       // R[a] = new array obj with R[b] null values
+  ALLOCA2D,     // R[a] = new array obj with R[b] rows of R[c] null values
+  SETF,         // obj(R[a]).R[b] = R[c] (field named by string R[b])
+  GETF,         // R[a] = obj(R[b]).R[c] (field named by string R[c])
+  SETFI,        // field slot b of obj(R[a]) = R[c]
+  GETFI,        // R[a] = field slot c of obj(R[b])
+  SETI,         // obj(R[a])[R[b]] = R[c]
+  SETI2D,       // obj(R[a])[R[b]][R[b + 1]] = R[c]
+  GETI,         // R[a] = obj(R[b])[R[c]]
+  GETI2D,       // R[a] = obj(R[b])[R[c]][R[c + 1]]
+
+  // special
+  NOP           // has no effect
+
+};
+
+
+// A three operand register instruction (what each operand means
+// depends on the opcode, see above)
+class RegInstr
+{
+public:
+
+  RegInstr(RegOpCode op, int a = 0, int b = 0, int c = 0)
+    : op(op), a(a), b(b), c(c)
+  {}
+
+  RegOpCode op;
+  int a;
+  int b;
+  int c;
+
+  // returns true for instructions that jump (to c, or a for JMP)
+  bool is_jump() const;
+
+  // returns true for instructions that write their result to R[a]
+  bool writes_a() const;
+
+  // the jump target of a jump instruction
+  int target() const {return op == RegOpCode::JMP ? a : c;}
+
+  // set the jump target of a jump instruction
+  void set_target(int index);
+
+  // pretty print the instruction
+  friend std::string to_string(const RegInstr& instr);
+
+};
+
+
+#endif
@@ -0,0 +1,693 @@
+//----------------------------------------------------------------------
+// FILE: reg_vm.cpp
+// DATE: Spring 2023
+// AUTH: Nisa Meshal
+// DESC: Register VM implementation
+//----------------------------------------------------------------------
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include "reg_vm.h"
+#include "mypl_exception.h"
+
+
+using namespace std;
+
+
+//----------------------------------------------------------------------
+// Instruction dispatch (direct threaded where supported, as in vm.cpp)
+//----------------------------------------------------------------------
+
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(MYPL_SWITCH_DISPATCH)
+#define MYPL_THREADED_DISPATCH
+#endif
+
+// fetch the next instruction into instr (returning from run once the
+// call stack is exhausted or the frame runs out of instructions)
+#define FETCH()                                                         \
+  if (call_stack.empty() or frame->pc >= frame->info->instructions.size()) { \
+    retired_count += retired;                                           \
+    return;                                                             \
+  }                                                                     \
+  instr = &frame->info->instructions[frame->pc];                         \
+  ++frame->pc;                                                          \
+  ++retired;                                                            \
+  if (DEBUG)                                                            \
+    trace(*frame, *instr);
+
+#ifdef MYPL_THREADED_DISPATCH
+
+#define DISPATCH_BEGIN                                                  \
+  static void* const dispatch_table[] = {                               \
+    &&op_MOVE, &&op_ADD, &&op_SUB, &&op_MUL, &&op_DIV, &&op_AND,        \
+    &&op_OR, &&op_NOT, &&op_CMPLT, &&op_CMPLE, &&op_CMPGT, &&op_CMPGE,  \
+    &&op_CMPEQ, &&op_CMPNE, &&op_JMP, &&op_JMPF, &&op_JMPF_LT,          \
+    &&op_JMPF_LE, &&op_JMPF_GT, &&op_JMPF_GE, &&op_JMPF_EQ,             \
+    &&op_JMPF_NE, &&op_CALL, &&op_RET, &&op_WRITE, &&op_READ,           \
+    &&op_SLEN, &&op_ALEN, &&op_GETC, &&op_TOINT, &&op_TODBL,            \
+    &&op_TOSTR, &&op_CONCAT, &&op_ALLOCS, &&op_ALLOCA, &&op_ALLOCA2D,   \
+    &&op_SETF, &&op_GETF, &&op_SETFI, &&op_GETFI, &&op_SETI,            \
+    &&op_SETI2D, &&op_GETI, &&op_GETI2D, &&op_NOP                       \
+  };                                                                    \
+  static_assert(sizeof(dispatch_table) / sizeof(void*) ==               \
+                int(RegOpCode::NOP) + 1, "dispatch table out of sync"); \
+  NEXT();
+#define DISPATCH_END
+#define CASE(op) op_##op:
+#define NEXT() do { FETCH(); goto *dispatch_table[int(instr->op)]; } while (0)
+
+#else
+
+#define DISPATCH_BEGIN for (;;) { FETCH(); switch (instr->op) {
+#define DISPATCH_END                                                    \
+    default:                                                            \
+      error("unsupported operation " + to_string(*instr));              \
+  } }
+#define CASE(op) case RegOpCode::op:
+#define NEXT() continue
+
+#endif
+
+// the instruction's register operands
+#define RA frame->registers[instr->a]
+#define RB frame->registers[instr->b]
+#define RC frame->registers[instr->c]
+
+
+//----------------------------------------------------------------------
+// Operations (with the same semantics as the stack vm's)
+//----------------------------------------------------------------------
+
+static VMValue add(const VMValue& x, const VMValue& y)
+{
+  if (x.is_int())
+    return x.as_int() + y.as_int();
+  return x.as_double() + y.as_double();
+}
+
+
+static VMValue sub(const VMValue& x, const VMValue& y)
+{
+  if (x.is_int())
+    return x.as_int() - y.as_int();
+  return x.as_double() - y.as_double();
+}
+
+
+static VMValue mul(const VMValue& x, const VMValue& y)
+{
+  if (x.is_int())
+    return x.as_int() * y.as_int();
+  return x.as_double() * y.as_double();
+}
+
+
+static VMValue div(const VMValue& x, const VMValue& y)
+{
+  if (x.is_int())
+    return x.as_int() / y.as_int();
+  return x.as_double() / y.as_double();
+}
+
+
+static bool eq(const VMValue& x, const VMValue& y)
+{
+  if (x.is_null() or y.is_null())
+    return x.is_null() and y.is_null();
+  else if (x.is_int())
+    return x.as_int() == y.as_int();
+  else if (x.is_double())
+    return x.as_double() == y.as_double();
+  else if (x.is_string())
+    return x.as_string() == y.as_string();
+  else if (x.is_ref())
+    return x.as_ref() == y.as_ref();
+  return x.as_bool() == y.as_bool();
+}
+
+
+// helper to order two (non-null) values of the same type
+template<typename Compare>
+static bool compare(const VMValue& x, const VMValue& y, Compare cmp)
+{
+  if (x.is_int())
+    return cmp(x.as_int(), y.as_int());
+  else if (x.is_double())
+    return cmp(x.as_double(), y.as_double());
+  else if (x.is_string())
+    return cmp(x.as_string(), y.as_string());
+  return cmp(x.as_bool(), y.as_bool());
+}
+
+
+static bool lt(const VMValue& x, const VMValue& y)
+{
+  return compare(x, y, less<>());
+}
+
+
+static bool le(const VMValue& x, const VMValue& y)
+{
+  return compare(x, y, less_equal<>());
+}
+
+
+static bool gt(const VMValue& x, const VMValue& y)
+{
+  return compare(x, y, greater<>());
+}
+
+
+static bool ge(const VMValue& x, const VMValue& y)
+{
+  return compare(x, y, greater_equal<>());
+}
+
+
+void RegVM::error(string msg) const
+{
+  throw MyPLException::VMError(msg);
+}
+
+
+void RegVM::error(string msg, const RegFrame& frame) const
+{
+  int pc = frame.pc - 1;
+  msg += " (in " + frame.info->function_name + " at " + to_string(pc) +
+    ": " + to_string(frame.info->instructions[pc]) + ")";
+  throw MyPLException::VMError(msg);
+}
+
+
+string to_string(const RegVM& vm)
+{
+  string s = "";
+  for (const RegFrameInfo& frame : vm.frame_info) {
+    s += "\nFrame '" + frame.function_name + "' (" +
+      to_string(frame.register_count) + " registers)\n";
+    for (int k = 0; k < frame.constants.size(); ++k)
+      s += "  " + to_string(-(k + 1)) + " = " +
+        to_string(frame.constants[k]) + "\n";
+    for (int i = 0; i < frame.instructions.size(); ++i)
+      s += "  " + to_string(i) + ": " + to_string(frame.instructions[i]) +
+        "\n";
+  }
+  return s;
+}
+
+
+int RegVM::function_id(const string& name)
+{
+  auto [entry, added] = frame_ids.try_emplace(name, frame_info.size());
+  if (added) {
+    frame_info.emplace_back();
+    frame_info.back().function_name = name;
+    defined.push_back(false);
+  }
+  return entry->second;
+}
+
+
+void RegVM::add(const RegFrameInfo& frame)
+{
+  int id = function_id(frame.function_name);
+  frame_info[id] = frame;
+  defined[id] = true;
+}
+
+
+void RegVM::run(bool DEBUG)
+{
+  if (!frame_ids.contains("main"))
+    error("No 'main' function");
+  for (const auto& [name, id] : frame_ids)
+    if (!defined[id])
+      error("undefined function '" + name + "'");
+  call_stack.clear();
+  value_stack.clear();
+  push_frame(frame_info[frame_ids["main"]]);
+  RegFrame* frame = &call_stack.back();
+
+  // the instruction being executed and the number executed so far
+  const RegInstr* instr = nullptr;
+  uint64_t retired = 0;
+
+  DISPATCH_BEGIN
+
+    CASE(MOVE) {
+      RA = RB;
+      NEXT();
+    }
+
+    //----------------------------------------------------------------------
+    // Operations
+    //----------------------------------------------------------------------
+
+    CASE(ADD) {
+      ensure_not_null(*frame, RC);
+      ensure_not_null(*frame, RB);
+      RA = ::add(RB, RC);
+      NEXT();
+    }
+
+    CASE(SUB) {
+      ensure_not_null(*frame, RC);
+      ensure_not_null(*frame, RB);
+      RA = sub(RB, RC);
+      NEXT();
+    }
+
+    CASE(MUL) {
+      ensure_not_null(*frame, RC);
+      ensure_not_null(*frame, RB);
+      RA = mul(RB, RC);
+      NEXT();
+    }
+
+    CASE(DIV) {
+      ensure_not_null(*frame, RC);
+      ensure_not_null(*frame, RB);
+      RA = div(RB, RC);
+      NEXT();
+    }
+
+    CASE(AND) {
+      ensure_not_null(*frame, RC);
+      ensure_not_null(*frame, RB);
+      RA = RB.as_bool() and RC.as_bool();
+      NEXT();
+    }
+
+    CASE(OR) {
+      ensure_not_null(*frame, RC);
+      ensure_not_null(*frame, RB);
+      RA = RB.as_bool() or RC.as_bool();
+      NEXT();
+    }
+
+    CASE(NOT) {
+      ensure_not_null(*frame, RB);
+      RA = !RB.as_bool();
+      NEXT();
+    }
+
+    CASE(CMPLT) {
+      ensure_not_null(*frame, RC);
+      ensure_not_null(*frame, RB);
+      RA = lt(RB, RC);
+      NEXT();
+    }
+
+    CASE(CMPLE) {
+      ensure_not_null(*frame, RC);
+      ensure_not_null(*frame, RB);
+      RA = le(RB, RC);
+      NEXT();
+    }
+
+    CASE(CMPGT) {
+      ensure_not_null(*frame, RC);
+      ensure_not_null(*frame, RB);
+      RA = gt(RB, RC);
+      NEXT();
+    }
+
+    CASE(CMPGE) {
+      ensure_not_null(*frame, RC);
+      ensure_not_null(*frame, RB);
+      RA = ge(RB, RC);
+      NEXT();
+    }
+
+    CASE(CMPEQ) {
+      RA = eq(RB, RC);
+      NEXT();
+    }
+
+    CASE(CMPNE) {
+      RA = !eq(RB, RC);
+      NEXT();
+    }
+
+    //----------------------------------------------------------------------
+    // Branching
+    //----------------------------------------------------------------------
+
+    CASE(JMP) {
+      frame->pc = instr->a;
+      NEXT();
+    }
+
+    CASE(JMPF) {
+      if (!RA.as_bool())
+        frame->pc = instr->c;
+      NEXT();
+    }
+
+    CASE(JMPF_LT) {
+      ensure_not_null(*frame, RB);
+      ensure_not_null(*frame, RA);
+      if (!lt(RA, RB))
+        frame->pc = instr->c;
+      NEXT();
+    }
+
+    CASE(JMPF_LE) {
+      ensure_not_null(*frame, RB);
+      ensure_not_null(*frame, RA);
+      if (!le(RA, RB))
+        frame->pc = instr->c;
+      NEXT();
+    }
+
+    CASE(JMPF_GT) {
+      ensure_not_null(*frame, RB);
+      ensure_not_null(*frame, RA);
+      if (!gt(RA, RB))
+        frame->pc = instr->c;
+      NEXT();
+    }
+
+    CASE(JMPF_GE) {
+      ensure_not_null(*frame, RB);
+      ensure_not_null(*frame, RA);
+      if (!ge(RA, RB))
+        frame->pc = instr->c;
+      NEXT();
+    }
+
+    CASE(JMPF_EQ) {
+      if (!eq(RA, RB))
+        frame->pc = instr->c;
+      NEXT();
+    }
+
+    CASE(JMPF_NE) {
+      if (eq(RA, RB))
+        frame->pc = instr->c;
+      NEXT();
+    }
+
+    //----------------------------------------------------------------------
+    // Functions
+    //----------------------------------------------------------------------
+
+    CASE(CALL) {
+      push_frame(frame_info[instr->b]);
+      // the push may have moved the call stack
+      RegFrame* caller = &call_stack[call_stack.size() - 2];
+      frame = &call_stack.back();
+      for (int i = 0; i < frame->info->arg_count; ++i)
+        frame->registers[i] = caller->registers[instr->c + i];
+      NEXT();
+    }
+
+    CASE(RET) {
+      VMValue v = RA;
+      // release the frame's values before its block is reused
+      int first = -int(frame->info->constants.size());
+      for (int i = first; i < frame->info->register_count; ++i)
+        frame->registers[i] = nullptr;
+      value_stack.pop(frame->registers + first);
+      call_stack.pop_back();
+      if (!call_stack.empty()) {
+        frame = &call_stack.back();
+        // the result goes where the CALL asked for it
+        int result = frame->info->instructions[frame->pc - 1].a;
+        frame->registers[result] = std::move(v);
+      }
+      NEXT();
+    }
+
+    //----------------------------------------------------------------------
+    // Built in functions
+    //----------------------------------------------------------------------
+
+    CASE(WRITE) {
+      cout << to_string(RA);
+      NEXT();
+    }
+
+    CASE(READ) {
+      string val = "";
+      getline(cin, val);
+      RA = std::move(val);
+      NEXT();
+    }
+
+    CASE(SLEN) {
+      ensure_not_null(*frame, RB);
+      RA = int(RB.as_string().size());
+      NEXT();
+    }
+
+    CASE(ALEN) {
+      ensure_not_null(*frame, RB);
+      RA = int(heap[RB.as_ref()].elements.size());
+      NEXT();
+    }
+
+    CASE(GETC) {
+      ensure_not_null(*frame, RC);
+      ensure_not_null(*frame, RB);
+      int y = RB.as_int();
+      if (y >= RC.as_string().length())
+        error("out-of-bounds string index", *frame);
+      RA = string(1, RC.as_string()[y]);
+      NEXT();
+    }
+
+    CASE(TOINT) {
+      ensure_not_null(*frame, RB);
+      if (RB.is_double())
+        RA = int(RB.as_double());
+      else if (isdigit(RB.as_string()[0]))
+        RA = stoi(RB.as_string());
+      else
+        error("cannot convert string to int", *frame);
+      NEXT();
+    }
+
+    CASE(TODBL) {
+      ensure_not_null(*frame, RB);
+      if (RB.is_int())
+        RA = double(RB.as_int());
+      else if (isdigit(RB.as_string()[0]))
+        RA = stod(RB.as_string());
+      else
+        error("cannot convert string to double", *frame);
+      NEXT();
+    }
+
+    CASE(TOSTR) {
+      ensure_not_null(*frame, RB);
+      RA = to_string(RB);
+      NEXT();
+    }
+
+    CASE(CONCAT) {
+      ensure_not_null(*frame, RC);
+      ensure_not_null(*frame, RB);
+      RA = RB.as_string() + RC.as_string();
+      NEXT();
+    }
+
+    //----------------------------------------------------------------------
+    // heap
+    //----------------------------------------------------------------------
+
+    // allocations first collect garbage if the heap has grown past the
+    // trigger point
+
+    CASE(ALLOCS) {
+      if (heap.bytes() >= next_gc)
+        collect();
+      RA = VMValue::ref(heap.allocate(instr->b));
+      NEXT();
+    }
+
+    CASE(ALLOCA) {
+      if (heap.bytes() >= next_gc)
+        collect();
+      RA = VMValue::ref(heap.allocate(RB.as_int()));
+      NEXT();
+    }
+
+    CASE(ALLOCA2D) {
+      if (heap.bytes() >= next_gc)
+        collect();
+      int rows = RB.as_int();
+      int columns = RC.as_int();
+      int oid = heap.allocate(columns * rows);
+      heap[oid].columns = columns;
+      RA = VMValue::ref(oid);
+      NEXT();
+    }
+
+    CASE(SETF) {
+      ensure_not_null(*frame, RA);
+      VMObject& obj = heap[RA.as_ref()];
+      int slot = heap.field_slot(obj.shape, RB.as_string());
+      if (slot < 0)
+        slot = heap.add_field(obj, RB.as_string());
+      obj.fields[slot] = RC;
+      NEXT();
+    }
+
+    CASE(GETF) {
+      ensure_not_null(*frame, RB);
+      const VMObject& obj = heap[RB.as_ref()];
+      int slot = heap.field_slot(obj.shape, RC.as_string());
+      RA = slot < 0 ? VMValue() : VMValue(obj.fields[slot]);
+      NEXT();
+    }
+
+    CASE(SETFI) {
+      ensure_not_null(*frame, RA);
+      heap[RA.as_ref()].elements[instr->b] = RC;
+      NEXT();
+    }
+
+    CASE(GETFI) {
+      ensure_not_null(*frame, RB);
+      RA = VMValue(heap[RB.as_ref()].elements[instr->c]);
+      NEXT();
+    }
+
+    CASE(SETI) {
+      ensure_not_null(*frame, RA);
+      vector<VMValue>& elements = heap[RA.as_ref()].elements;
+      if (RB.as_int() >= elements.size())
+        error("out-of-bounds array index", *frame);
+      elements[RB.as_int()] = RC;
+      NEXT();
+    }
+
+    CASE(SETI2D) {
+      ensure_not_null(*frame, RA);
+      VMObject& array = heap[RA.as_ref()];
+      //for arr[i][j], the math for 1D is j + i*total columns
+      int row = RB.as_int();
+      int column = frame->registers[instr->b + 1].as_int();
+      int index = column + row * array.columns;
+      if (index >= array.elements.size())
+        error("out-of-bounds 2D array index", *frame);
+      array.elements[index] = RC;
+      NEXT();
+    }
+
+    CASE(GETI) {
+      ensure_not_null(*frame, RB);
+      const vector<VMValue>& elements = heap[RB.as_ref()].elements;
+      if (RC.as_int() >= elements.size())
+        error("out-of-bounds array index", *frame);
+      RA = VMValue(elements[RC.as_int()]);
+      NEXT();
+    }
+
+    CASE(GETI2D) {
+      ensure_not_null(*frame, RB);
+      const VMObject& array = heap[RB.as_ref()];
+      int row = RC.as_int();
+      int column = frame->registers[instr->c + 1].as_int();
+      int index = column + row * array.columns;
+      if (index >= array.elements.size())
+        error("out-of-bounds 2D array index", *frame);
+      RA = VMValue(array.elements[index]);
+      NEXT();
+    }
+
+    //----------------------------------------------------------------------
+    // special
+    //----------------------------------------------------------------------
+
+    CASE(NOP) {
+      // do nothing
+      NEXT();
+    }
+
+  DISPATCH_END
+}
+
+
+void RegVM::push_frame(const RegFrameInfo& info)
+{
+  int constant_count = info.constants.size();
+  VMValue* base = value_stack.push(constant_count + info.register_count);
+  if (!base) {
+    if (call_stack.empty())
+      error("stack overflow");
+    error("stack overflow", call_stack.back());
+  }
+  call_stack.emplace_back();
+  RegFrame& frame = call_stack.back();
+  frame.info = &info;
+  frame.registers = base + constant_count;
+  for (int k = 0; k < constant_count; ++k)
+    frame.registers[-(k + 1)] = info.constants[k];
+}
+
+
+void RegVM::trace(const RegFrame& frame, const RegInstr& instr) const
+{
+  cerr << endl << endl;
+  cerr << "\t FRAME.........: " << frame.info->function_name << endl;
+  cerr << "\t PC............: " << (frame.pc - 1) << endl;
+  cerr << "\t INSTR.........: " << to_string(instr) << endl;
+  cerr << "\t REGISTERS.....:";
+  for (int i = 0; i < frame.info->register_count; ++i)
+    cerr << " " << to_string(frame.registers[i]);
+  cerr << endl;
+}
+
+
+uint64_t RegVM::instructions_retired() const
+{
+  return retired_count;
+}
+
+
+void RegVM::set_gc_threshold(size_t bytes, double growth)
+{
+  gc_threshold = bytes;
+  gc_growth = growth;
+  next_gc = max(gc_threshold, heap.bytes());
+}
+
+
+void RegVM::collect()
+{
+  auto start = chrono::steady_clock::now();
+  // the roots are the registers of every running frame
+  for (const RegFrame& frame : call_stack)
+    for (int i = 0; i < frame.info->register_count; ++i)
+      heap.mark(frame.registers[i]);
+  heap.sweep(gc);
+  next_gc = max(gc_threshold, size_t(heap.bytes() * gc_growth));
+  double pause = chrono::duration<double, milli>(
+    chrono::steady_clock::now() - start).count();
+  ++gc.collections;
+  gc.total_pause += pause;
+  gc.max_pause = max(gc.max_pause, pause);
+}
+
+
+const VMGCStats& RegVM::gc_stats() const
+{
+  return gc;
+}
+
+
+void RegVM::set_stack_limit(size_t values)
+{
+  value_stack.set_limit(values);
+}
+
+
+void RegVM::ensure_not_null(const RegFrame& f, const VMValue& x) const
+{
+  if (x.is_null())
+    error("null reference", f);
+}
@@ -0,0 +1,139 @@
+//----------------------------------------------------------------------
+// FILE: reg_vm.h
+// DATE: Spring 2023
+// AUTH: Nisa Meshal
+// DESC: Register based alternative to the mypl (stack) virtual machine
+//----------------------------------------------------------------------
+
+#ifndef REG_VM_H
+#define REG_VM_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "reg_instr.h"
+#include "vm_frame.h"
+#include "vm_heap.h"
+#include "vm_value.h"
+
+
+// The code and register layout of a function
+class RegFrameInfo
+{
+public:
+
+  // the name of the function associated with the frame
+  std::string function_name;
+
+  // the number of parameters (passed in registers 0 to arg_count - 1)
+  int arg_count = 0;
+
+  // the program instructions
+  std::vector<RegInstr> instructions;
+
+  // the constants (constant k is register -(k + 1))
+  std::vector<VMValue> constants;
+
+  // the number of variable and temporary registers
+  int register_count = 0;
+
+};
+
+
+// A running function: registers points at register 0 of the frame's
+// block of the vm's shared value stack (its constants are just below)
+class RegFrame
+{
+public:
+
+  const RegFrameInfo* info = nullptr;
+
+  // the program counter
+  int pc = 0;
+
+  VMValue* registers = nullptr;
+
+};
+
+
+// Interprets RegFrameInfo code. Values, heap objects, and the garbage
+// collector work as in the stack vm (see vm.h), which remains the
+// reference implementation.
+class RegVM
+{
+public:
+
+  // returns the function id of the named function, reserving one if
+  // the function has not been added yet
+  int function_id(const std::string& name);
+
+  // add a new function (or replace one with the same name)
+  void add(const RegFrameInfo& frame);
+
+  // run the main function (throws a mypl exception if a called
+  // function was never added)
+  void run(bool DEBUG = false);
+
+  // to print the instructions for each function
+  friend std::string to_string(const RegVM& vm);
+
+  // total number of instructions executed by completed runs
+  uint64_t instructions_retired() const;
+
+  // garbage collection settings and statistics (as in the stack vm)
+  void set_gc_threshold(size_t bytes, double growth = 2.0);
+  void collect();
+  const VMGCStats& gc_stats() const;
+
+  // the most values (constants and registers) the running frames may
+  // hold together, as in the stack vm
+  void set_stack_limit(size_t values);
+
+private:
+
+  // struct and array objects indexed by oid
+  VMHeap heap;
+
+  // garbage collection settings, trigger point, and statistics
+  size_t gc_threshold = 1 << 20;
+  double gc_growth = 2.0;
+  size_t next_gc = 1 << 20;
+  VMGCStats gc;
+
+  // functions indexed by function id
+  std::vector<RegFrameInfo> frame_info;
+
+  // function name to function id
+  std::unordered_map<std::string, int> frame_ids;
+
+  // true for the function ids that have been added
+  std::vector<bool> defined;
+
+  // running functions (reused in place, as in the stack vm)
+  std::vector<RegFrame> call_stack;
+
+  // the constants and registers of every active frame, each frame's
+  // block starting just above its caller's
+  VMValueStack value_stack;
+
+  // instructions executed so far (updated when run returns)
+  uint64_t retired_count = 0;
+
+  // helper function to push a frame for the given function, loading
+  // its constants (throws a mypl exception on stack overflow)
+  void push_frame(const RegFrameInfo& info);
+
+  // helper function to print the debug state before an instruction
+  void trace(const RegFrame& frame, const RegInstr& instr) const;
+
+  // helper functions to report VM errors
+  void error(std::string msg) const;
+  void error(std::string msg, const RegFrame& f) const;
+
+  // helper function to check for null values (throws mypl exception)
+  void ensure_not_null(const RegFrame& f, const VMValue& x) const;
+
+};
+
+#endif
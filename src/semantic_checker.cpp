@@ -21,10 +21,12 @@ const unordered_set<string> BUILT_INS {"print", "input", "to_string",  "to_int",
 
 // helper functions
 
-optional<VarDef> SemanticChecker::get_field(const StructDef& struct_def,
+optional<VarDef> SemanticChecker::get_field(const StructDef* struct_def,
                                             const string& field_name)
 {
-  for (const VarDef& var_def : struct_def.fields)
+  if (!struct_def)
+    return nullopt;
+  for (const VarDef& var_def : struct_def->fields)
     if (var_def.var_name.lexeme() == field_name)
       return var_def;
   return nullopt;
@@ -49,19 +51,19 @@ void SemanticChecker::error(const string& msg)
 // visitor functions
 
 
-void SemanticChecker::visit(Program& p)
+void SemanticChecker::declare(vector<StructDef>& structs, vector<FunDef>& funs)
 {
   // record each struct def
-  for (StructDef& d : p.struct_defs) {
+  for (StructDef& d : structs) {
     string name = d.struct_name.lexeme();
     if (struct_defs.contains(name))
       error("multiple definitions of '" + name + "'", d.struct_name);
-    struct_defs[name] = d;
+    struct_defs[name] = &d;
   }
 
   // record each function def (need a main function)
   bool found_main = false;
-  for (FunDef& f : p.fun_defs) {
+  for (FunDef& f : funs) {
     string name = f.fun_name.lexeme();
     if (BUILT_INS.contains(name))
       error("redefining built-in function '" + name + "'", f.fun_name);
@@ -74,98 +76,87 @@ void SemanticChecker::visit(Program& p)
         error("main function cannot have parameters", f.params[0].var_name);
       found_main = true;
     }
-    fun_defs[name] = f;
+    fun_defs[name] = &f;
   }
 
   if (!found_main)
     error("program missing main function");
-  // check each struct
-  for (StructDef& d : p.struct_defs)
-    d.accept(*this);
-  // check each function
-  for (FunDef& d : p.fun_defs)
-    d.accept(*this);
 }
 
 
-void SemanticChecker::visit(SimpleRValue& v)
+void SemanticChecker::visit(Program& p)
+{
+  FlatAST ast(p);
+  check(ast);
+  ast.annotate_tree();
+}
+
+
+void SemanticChecker::check_value(TokenType value)
 {
-  if (v.value.type() == TokenType::INT_VAL)
+  if (value == TokenType::INT_VAL)
     curr_type = DataType {false, "int"};
-  else if (v.value.type() == TokenType::DOUBLE_VAL)
+  else if (value == TokenType::DOUBLE_VAL)
     curr_type = DataType {false,  "double"};    
-  else if (v.value.type() == TokenType::CHAR_VAL)
+  else if (value == TokenType::CHAR_VAL)
     curr_type = DataType {false, "char"};    
-  else if (v.value.type() == TokenType::STRING_VAL)
+  else if (value == TokenType::STRING_VAL)
     curr_type = DataType {false, "string"};    
-  else if (v.value.type() == TokenType::BOOL_VAL)
+  else if (value == TokenType::BOOL_VAL)
     curr_type = DataType {false, "bool"};    
-  else if (v.value.type() == TokenType::NULL_VAL)
+  else if (value == TokenType::NULL_VAL)
     curr_type = DataType {false, "void"};    
 }
 
 
-// TODO: Implement the rest of the visitor functions (stubbed out below)
-
-void SemanticChecker::visit(FunDef& f)
+void SemanticChecker::begin_function(const FlatFunDef& f)
 {
   //first function environment
   symbol_table.push_environment(); 
 
   //check if the return type is a base type, if not then check that it's in struct defs
-  if(BASE_TYPES.contains(f.return_type.type_name) || f.return_type.type_name == "void") {
-    curr_type = f.return_type;
-    symbol_table.add("return", curr_type); 
-  }
-  else {
-    if(!struct_defs.contains(f.return_type.type_name)) {
-      error("struct return type is undefined"); 
+  const string& return_name = flat->names[f.return_type.name];
+  if(!BASE_TYPES.contains(return_name) && return_name != "void" &&
+     !struct_defs.contains(return_name)) {
+    error("struct return type is undefined"); 
+  }
+  return_type = flat->data_type(f.return_type);
+
+  for (FlatIndex p = f.params.begin; p < f.params.end; ++p) {
+    const FlatVar& v = flat->vars[p];
+    FlatIndex name = flat->tokens[v.name].name;
+    curr_type = flat->data_type(v.type);
+    if(symbol_table.in_curr_env(name)) {
+      error("paramater name already exists"); 
     }
-    else {
-      curr_type = f.return_type;
-      symbol_table.add("return", curr_type); 
+    else if (!BASE_TYPES.contains(curr_type.type_name) &&!struct_defs.contains(curr_type.type_name)) {
+      error("reference to undefined struct in function params"); 
     }
-  }
-
-  if(!f.params.empty()) {
-    for(auto v : f.params) {
-      curr_type = v.data_type;
-      if(symbol_table.name_exists_in_curr_env(v.var_name.lexeme())) {
-        error("paramater name already exists"); 
-      }
-      else if (!BASE_TYPES.contains(curr_type.type_name) &&!struct_defs.contains(v.data_type.type_name)) {
-        error("reference to undefined struct in function params"); 
-      }
-      else {
-        symbol_table.add(v.var_name.lexeme(), curr_type);
-      }
+    else {
+      symbol_table.add(name, curr_type);
     }
   }
-
-  for(auto s : f.stmts) {
-    s->accept(*this);
-  }
-
-  symbol_table.pop_environment();
 }
 
 
-void SemanticChecker::visit(StructDef& s)
+void SemanticChecker::check_struct(const StructDef& s)
 {
-  symbol_table.push_environment();
+  //the struct's names are checked in a table of their own
+  SymbolTable struct_names;
+  struct_names.push_environment();
 
   if(struct_defs.contains(s.struct_name.lexeme())) {
     DataType dt = {false, "struct"}; 
-    symbol_table.add(s.struct_name.lexeme(), dt);  
+    struct_names.add(s.struct_name.lexeme(), dt);  
 
     for(VarDef v : s.fields) {
       //check if the field is a base type
       if(BASE_TYPES.contains(v.data_type.type_name)) {
-        if(symbol_table.name_exists_in_curr_env(v.var_name.lexeme()))
+        if(struct_names.name_exists_in_curr_env(v.var_name.lexeme()))
           error("varible name already exists in struct fields"); 
 
         curr_type = v.data_type;
-        symbol_table.add(v.var_name.lexeme(), curr_type);
+        struct_names.add(v.var_name.lexeme(), curr_type);
       } 
       else { //if not a base type, then it must be a stuct
         if(!struct_defs.contains(v.data_type.type_name)) {
@@ -173,234 +164,54 @@ void SemanticChecker::visit(StructDef& s)
         } 
         else {
           curr_type = v.data_type; 
-          symbol_table.add(v.var_name.lexeme(), curr_type); 
+          struct_names.add(v.var_name.lexeme(), curr_type); 
         } 
       }
     } 
   }
 
-  symbol_table.pop_environment();
+  struct_names.pop_environment();
 }
 
 
-void SemanticChecker::visit(ReturnStmt& s)
-{
-  s.expr.accept(*this);
-
-  DataType d = symbol_table.get("return").value(); 
-
-  if(curr_type.type_name != d.type_name &&  curr_type.type_name != "void") {
-    error("return statement does not match function return in " + curr_type.type_name + " " + d.type_name); 
-  }
-}
-
-
-void SemanticChecker::visit(WhileStmt& s)
-{
-  symbol_table.push_environment(); 
-  s.condition.accept(*this); 
-
-  if(curr_type.type_name != "bool") {
-    error("while condition is not of type bool"); 
-  }
-
-  for(auto st : s.stmts) {
-    st->accept(*this); 
-  }
-
-  symbol_table.pop_environment(); 
-}
-
-
-void SemanticChecker::visit(ForStmt& s)
-{
-  symbol_table.push_environment(); 
-
-  s.var_decl.accept(*this);
-  if(curr_type.type_name != "int") {
-    error("loop counter is not an integer");
-  }
-
-  s.condition.accept(*this);
-  if(curr_type.type_name != "bool") {
-    error("loop condition is not a bool"); 
-  }
-
-  s.assign_stmt.accept(*this); 
-  if(curr_type.type_name != "int") {
-    error("loop increment is not an integer"); 
-  }
-   
-  for(auto st : s.stmts) {
-    st->accept(*this); 
-  }
-  
-  symbol_table.pop_environment(); 
-}
-
-
-void SemanticChecker::visit(IfStmt& s)
-{
-  //if part in its own environment
-  symbol_table.push_environment();
-
-  s.if_part.condition.accept(*this);
-  if(curr_type.type_name != "bool" || curr_type.is_array == true) {
-    error("if condition not a bool"); 
-  }
-
-  for(auto st : s.if_part.stmts) {
-    st->accept(*this); 
-  }
-
-  symbol_table.pop_environment(); //???? do i pop this here?
-
-  //else ifs
-  if(!s.else_ifs.empty()) {
-    for(auto elif : s.else_ifs) {
-      //new environment for every else if block
-      symbol_table.push_environment(); 
-
-      elif.condition.accept(*this); 
-      if(curr_type.type_name != "bool") {
-        error("else if condition is not a bool"); 
-      }
-
-      for(auto st : elif.stmts) {
-        st->accept(*this); 
-      }
-
-      symbol_table.pop_environment();
-    }
-  }
-
-  //else statements
-  if(!s.else_stmts.empty()) {
-    symbol_table.push_environment();
-    for(auto st : s.else_stmts) {
-      st->accept(*this);
-    }
-    symbol_table.pop_environment();
-  }
-}
-
-
-void SemanticChecker::visit(VarDeclStmt& s)
-{
-  //grab the data type of the var decl
-  DataType d = s.var_def.data_type; 
-  //if the name of the variable dne, then add it with its data type
-  if(!symbol_table.name_exists_in_curr_env(s.var_def.var_name.lexeme())) {
-    symbol_table.add(s.var_def.var_name.lexeme(), d);
-  } else {
-    error("name is already previously declared");
-  }
-
-  //check the expression, sets currtype
-  s.expr.accept(*this);
-
-  if(d.type_name != curr_type.type_name && curr_type.type_name != "void")
-    error("mismatched types in variable declaration");
-}
-
-
-void SemanticChecker::visit(AssignStmt& s)
-{
-  //check that the first value is in symbol table
-  if(!symbol_table.name_exists(s.lvalue[0].var_name.lexeme()))
-    error("reference to undefined variable: " + s.lvalue[0].var_name.lexeme()); 
-
-  //if the first value is an array, then check the array expression 
-  if(s.lvalue[0].array_expr.has_value()) {
-    //check the array expression
-    DataType array_type = symbol_table.get(s.lvalue[0].var_name.lexeme()).value(); 
-
-    s.lvalue[0].array_expr->accept(*this); 
-    if(curr_type.type_name != "int")
-      error("array expression does not contain int"); 
-    
-    if(s.lvalue[0].array_expr_2D.has_value()){
-      s.lvalue[0].array_expr_2D->accept(*this);
-      if(curr_type.type_name != "int")
-        error("array expression does not contain int");
-    }
-    
-    curr_type = array_type; 
-  }
-  else { //single variable case. 
-    curr_type = symbol_table.get(s.lvalue[0].var_name.lexeme()).value();
-  }
-
-  //if the path is greater than one, the first value type must be in struct def
-  if(s.lvalue.size() > 1) {
-    //get the type of the variable
-    DataType var_type = symbol_table.get(s.lvalue[0].var_name.lexeme()).value(); 
-
-    //graq the first struct def
-    StructDef sd = struct_defs[var_type.type_name]; 
-
-    //iterate through te rest of the path
-    for(int i = 1; i < s.lvalue.size(); i++) {
-      //check that the field is in the previous struct def
-      if(!get_field(sd, s.lvalue[i].var_name.lexeme()))
-        error("field does not exist in struct");
-
-      //set the current type
-      curr_type = get_field(sd, s.lvalue[i].var_name.lexeme()).value().data_type;
-
-      //set struct def again. 
-      sd = struct_defs[curr_type.type_name]; 
-    }
-  }
-
-  DataType assign_lval = curr_type; 
-
-  //rhs of assign statement 
-  s.expr.accept(*this); 
-
-  if(assign_lval.type_name != curr_type.type_name && curr_type.type_name != "void") {
-    error("mismatched type in assign statement"); 
-  }
-}
-
-
-void SemanticChecker::visit(CallExpr& e)
+string SemanticChecker::check_call(const string& name, int arg_count,
+                                   const function<void(int)>& check_arg)
 { 
   //check that the function is built in or not
-  if(BUILT_INS.contains(e.fun_name.lexeme())) {
+  if(BUILT_INS.contains(name)) {
     //check for concat
-    if(e.fun_name.lexeme() == "concat") { //since concat is the only one that takes more than one argument
-      if(e.args.size() != 2)
+    if(name == "concat") { //since concat is the only one that takes more than one argument
+      if(arg_count != 2)
         error("need two args for concat");
 
-      e.args[0].accept(*this);
+      check_arg(0);
       if(curr_type.type_name != "string")
         error("need string in concat");
 
-      e.args[1].accept(*this);
+      check_arg(1);
       if(curr_type.type_name != "string")
         error("need string in concat"); 
 
       curr_type = DataType {false, "string"}; 
     } 
     //input function
-    else if(e.fun_name.lexeme() == "input") {
-      if(e.args.size() != 0) {
+    else if(name == "input") {
+      if(arg_count != 0) {
         error("too many arguments in input funtion"); 
       }
 
       curr_type = DataType {false, "string"}; 
     }
     //get function
-    else if (e.fun_name.lexeme() == "get") {
-      if(e.args.size() != 2)
+    else if (name == "get") {
+      if(arg_count != 2)
         error("get function requires two arguments"); 
 
-      e.args[0].accept(*this);
+      check_arg(0);
       if(curr_type.type_name != "int")
         error("first get argument must be an int"); 
 
-      e.args[1].accept(*this);
+      check_arg(1);
       if(curr_type.type_name != "string")
         error("need string for second argument"); 
 
@@ -408,15 +219,19 @@ void SemanticChecker::visit(CallExpr& e)
     }
     //other built ins that only take one argument
     else {
-      if(e.args.size() > 1) { //these functions must have only one argument. 
-        error("too many function arguments for " + e.fun_name.lexeme()); 
+      if(arg_count > 1) { //these functions must have only one argument. 
+        error("too many function arguments for " + name); 
+      }
+
+      if(arg_count == 0) {
+        error("missing function argument for " + name); 
       }
 
       //evaluate the expression and 
-      e.args[0].accept(*this); 
+      check_arg(0); 
 
       //print built in function
-      if(e.fun_name.lexeme() == "print") {
+      if(name == "print") {
         //print can only be base type and can't be an array
         if(!BASE_TYPES.contains(curr_type.type_name)) {  //i took out array check 
           error("a base type must be used in the built in print function " + curr_type.type_name); 
@@ -425,7 +240,7 @@ void SemanticChecker::visit(CallExpr& e)
         curr_type = DataType {false, "void"}; 
       }
       //to_string built on me function
-      else if(e.fun_name.lexeme() == "to_string") {
+      else if(name == "to_string") {
         unordered_set<string> TO_STRING_TYPES = {"int", "double", "char"};
         
         if(!TO_STRING_TYPES.contains(curr_type.type_name) || curr_type.is_array) {
@@ -435,29 +250,29 @@ void SemanticChecker::visit(CallExpr& e)
         curr_type = DataType {false, "string"}; 
       }
       //to_int built in funciton
-      else if(e.fun_name.lexeme() == "to_int") {
+      else if(name == "to_int") {
         if(curr_type.type_name != "string" && curr_type.type_name != "double") {
           error("invalid argument for to_int function");
         }
 
         curr_type = DataType {false, "int"}; 
       }
-      else if(e.fun_name.lexeme() == "to_double") {
+      else if(name == "to_double") {
         if(curr_type.type_name != "int" && curr_type.type_name != "string") {
           error("invalid argument for to_double function");
         }
 
         curr_type = DataType {false, "double"}; 
       }
-      else if(e.fun_name.lexeme() == "length") {
+      else if(name == "length") {
         //length function must be passed a string or an array
         if(curr_type.type_name != "string" && !curr_type.is_array)
           error("invalid argument for length function"); 
 
         //if you find an array, then must chnage the function name for proper call in code gen
         if(curr_type.is_array) {
-          curr_type = DataType {true, "int"};
-          e.fun_name = Token(e.fun_name.type(), "length@array", e.fun_name.line(), e.fun_name.column());
+          curr_type = DataType {false, "int"};
+          return "length@array";
         }
         else
           curr_type = DataType {false, "int"};
@@ -465,19 +280,19 @@ void SemanticChecker::visit(CallExpr& e)
     }
 
   }
-  else if(!fun_defs.contains(e.fun_name.lexeme())) { //check if function exists in current environment
+  else if(!fun_defs.contains(name)) { //check if function exists in current environment
     error("function does not exist in this environment");
   }
   else { //function is in fun_defs, so check for arguments. 
     //check if function call has proper number of arguments
-    if(e.args.size() != fun_defs[e.fun_name.lexeme()].params.size()) {
+    if(arg_count != fun_defs[name]->params.size()) {
       error("incorrect number of arguments passed in function call"); 
     }
     else { //check argument types match
-      FunDef f = fun_defs[e.fun_name.lexeme()];
+      const FunDef& f = *fun_defs[name];
       
       for(int i = 0; i < f.params.size(); i++) {
-        e.args[i].accept(*this); //set curr_token type
+        check_arg(i); //set curr_token type
         if(curr_type.type_name != f.params[i].data_type.type_name && curr_type.type_name != "void") { //check taht paramater types match
           error("parameter type mismatch in function call"); 
         }
@@ -486,152 +301,313 @@ void SemanticChecker::visit(CallExpr& e)
       curr_type = f.return_type; 
     }
   }
+
+  return name;
 }
 
 
-void SemanticChecker::visit(Expr& e)
+OpType SemanticChecker::check_op(TokenType op, const DataType& lhs,
+                                 const DataType& rhs)
 {
-  e.first->accept(*this);
-  DataType lhs = curr_type;
-
-  if(e.op.has_value()) {
-    
-    e.rest->accept(*this); 
-    DataType rhs = curr_type;
-    Token op = e.op.value();
-
-    //arithmetic ops
-    if (op.type() == TokenType::PLUS || op.type() == TokenType::MINUS || op.type() == TokenType::TIMES || op.type() == TokenType::DIVIDE) {
-      if(lhs.type_name != "int" && lhs.type_name != "double") {
-        error("type incompatible with arithmatic expresssion");
-      }
+  //arithmetic ops
+  if (op == TokenType::PLUS || op == TokenType::MINUS || op == TokenType::TIMES || op == TokenType::DIVIDE) {
+    if(lhs.type_name != "int" && lhs.type_name != "double") {
+      error("type incompatible with arithmatic expresssion");
+    }
 
-      if(rhs.type_name != "int" && rhs.type_name != "double") {
-        error("type incompatible with arithmetic expression"); 
-      }
+    if(rhs.type_name != "int" && rhs.type_name != "double") {
+      error("type incompatible with arithmetic expression"); 
+    }
 
-      if(lhs.type_name == "int" && rhs.type_name == "int") {
-        curr_type = DataType {false, "int"}; 
-      }
-      else {
-        curr_type = DataType {false, "double"}; 
-      }
+    if(lhs.type_name == "int" && rhs.type_name == "int") {
+      curr_type = DataType {false, "int"}; 
     }
-    //equality ops
-    else if (op.type() == TokenType::EQUAL || op.type() == TokenType::NOT_EQUAL) { 
-      if(!(lhs.type_name == rhs.type_name || lhs.type_name == "void" || rhs.type_name == "void")) {
-        error("types incompatible in boolean expression");
-      }
-      curr_type = DataType {false, "bool"}; 
+    else {
+      curr_type = DataType {false, "double"}; 
     }
-    //comparators 
-    else if (op.type() == TokenType::LESS || op.type() == TokenType::GREATER || op.type() == TokenType::LESS_EQ || op.type() == TokenType::GREATER_EQ) {
-      if(lhs.type_name != "int" && lhs.type_name != "double" && lhs.type_name != "string" && lhs.type_name != "char") {
-        error("lhs type incompatible in comparison expression"); 
-      }
-
-      if(rhs.type_name != "int" && rhs.type_name != "double" && rhs.type_name != "string" && rhs.type_name != "char") {
-        error("rhs type incompatible in comparison expression"); 
-      }
-      curr_type = DataType {false, "bool"}; 
+  }
+  //equality ops
+  else if (op == TokenType::EQUAL || op == TokenType::NOT_EQUAL) { 
+    if(!(lhs.type_name == rhs.type_name || lhs.type_name == "void" || rhs.type_name == "void")) {
+      error("types incompatible in boolean expression");
     }
-    else if (op.type() == TokenType::AND || op.type() == TokenType::OR) {
-      if(!(lhs.type_name == "bool" && rhs.type_name == "bool")) {
-        error("values incompatible with and/or expression"); 
-      }
-      curr_type = DataType {false, "bool"}; 
+    curr_type = DataType {false, "bool"}; 
+  }
+  //comparators 
+  else if (op == TokenType::LESS || op == TokenType::GREATER || op == TokenType::LESS_EQ || op == TokenType::GREATER_EQ) {
+    if(lhs.type_name != "int" && lhs.type_name != "double" && lhs.type_name != "string" && lhs.type_name != "char") {
+      error("lhs type incompatible in comparison expression"); 
+    }
+
+    if(rhs.type_name != "int" && rhs.type_name != "double" && rhs.type_name != "string" && rhs.type_name != "char") {
+      error("rhs type incompatible in comparison expression"); 
     }
+    curr_type = DataType {false, "bool"}; 
   }
+  else if (op == TokenType::AND || op == TokenType::OR) {
+    if(!(lhs.type_name == "bool" && rhs.type_name == "bool")) {
+      error("values incompatible with and/or expression"); 
+    }
+    curr_type = DataType {false, "bool"}; 
+  }
+
+  if (lhs.is_array or rhs.is_array or lhs.type_name != rhs.type_name)
+    return OpType::NONE;
+  if (lhs.type_name == "int")
+    return OpType::INT;
+  if (lhs.type_name == "double")
+    return OpType::DOUBLE;
+  if (lhs.type_name == "bool")
+    return OpType::BOOL;
+  if (lhs.type_name == "char")
+    return OpType::CHAR;
+  if (lhs.type_name == "string")
+    return OpType::STRING;
+  if (lhs.type_name == "void")
+    return OpType::NONE;
+  return OpType::STRUCT;
+}
+
+
+//----------------------------------------------------------------------
+// Flat program walk
+//----------------------------------------------------------------------
+
+void SemanticChecker::check(FlatAST& ast)
+{
+  flat = &ast;
+  for (const FlatStructDef& d : ast.struct_defs)
+    flat_structs.push_back(ast.struct_def(d));
+  for (const FlatFunDef& f : ast.fun_defs)
+    flat_funs.push_back(ast.fun_signature(f));
 
-  if(e.negated == true && curr_type.type_name != "bool") {
-    error("type mismatch in negated statement"); 
+  declare(flat_structs, flat_funs);
+  // check each struct
+  for (const StructDef& d : flat_structs)
+    check_struct(d);
+  // check each function
+  for (const FlatFunDef& f : ast.fun_defs) {
+    begin_function(f);
+    check_block(f.body);
+    symbol_table.pop_environment();
   }
+}
+
 
+void SemanticChecker::walk_struct_def(FlatAST& ast, FlatIndex s)
+{
+  check_struct(ast.struct_def(ast.struct_defs[s]));
 }
 
 
-void SemanticChecker::visit(SimpleTerm& t)
+void SemanticChecker::walk_fun_def(FlatAST& ast, FlatIndex f)
 {
-  t.rvalue->accept(*this); 
-} 
+  flat = &ast;
+  begin_function(ast.fun_defs[f]);
+  check_block(ast.fun_defs[f].body);
+  symbol_table.pop_environment();
+  ast.annotate_tree();
+}
 
 
-void SemanticChecker::visit(ComplexTerm& t)
+void SemanticChecker::walk_stmt(FlatAST& ast, FlatIndex s)
 {
-  t.expr.accept(*this); 
+  flat = &ast;
+  check_stmt(s);
+  ast.annotate_tree();
 }
 
 
-void SemanticChecker::visit(NewRValue& v)
+void SemanticChecker::walk_expr(FlatAST& ast, FlatIndex e)
 {
-  if(v.array_expr.has_value()) {
-    v.array_expr->accept(*this);
-    if(curr_type.type_name != "int")
-      error("array expr is not an int"); 
-    
-    if(v.array_expr_2D.has_value()) {
-      v.array_expr_2D->accept(*this);
-      if(curr_type.type_name != "int")
-        error("array expr is not an int");
-    }
+  flat = &ast;
+  check_expr(e);
+  ast.annotate_tree();
+}
 
-    curr_type = DataType {true, v.type.lexeme()}; 
-  }
-  else {
-    curr_type = DataType {false, v.type.lexeme()};
-  }
+
+void SemanticChecker::check_block(FlatRange body)
+{
+  for (FlatIndex i = body.begin; i < body.end; ++i)
+    check_stmt(i);
 }
 
 
-void SemanticChecker::visit(VarRValue& v)
+void SemanticChecker::check_stmt(FlatIndex i)
 {
-  //check that the first value is in symbol table
-  if(!symbol_table.name_exists(v.path[0].var_name.lexeme())) 
-    error("reference to undefined variable var_rval " + v.path[0].var_name.lexeme() + " in "); 
+  const FlatStmt& s = flat->stmts[i];
+  switch (s.kind) {
+  case FlatStmtKind::VAR_DECL: {
+    const FlatVar& var = flat->vars[s.var];
+    DataType d = flat->data_type(var.type);
+    FlatIndex name = flat->tokens[var.name].name;
+    if (!symbol_table.in_curr_env(name))
+      symbol_table.add(name, d);
+    else
+      error("name is already previously declared");
+    check_expr(s.expr);
+    if (d.type_name != curr_type.type_name && curr_type.type_name != "void")
+      error("mismatched types in variable declaration");
+    break;
+  }
+  case FlatStmtKind::ASSIGN: {
+    check_path(s.path, true);
+    DataType assign_lval = curr_type;
+    check_expr(s.expr);
+    if (assign_lval.type_name != curr_type.type_name &&
+        curr_type.type_name != "void")
+      error("mismatched type in assign statement");
+    break;
+  }
+  case FlatStmtKind::CALL:
+    check_expr(s.expr);
+    break;
+  case FlatStmtKind::RETURN: {
+    check_expr(s.expr);
+    if (curr_type.type_name != return_type.type_name &&
+        curr_type.type_name != "void")
+      error("return statement does not match function return in " +
+            curr_type.type_name + " " + return_type.type_name);
+    break;
+  }
+  case FlatStmtKind::WHILE:
+    symbol_table.push_environment();
+    check_expr(s.expr);
+    if (curr_type.type_name != "bool")
+      error("while condition is not of type bool");
+    check_block(s.body);
+    symbol_table.pop_environment();
+    break;
+  case FlatStmtKind::FOR:
+    symbol_table.push_environment();
+    check_stmt(s.init);
+    if (curr_type.type_name != "int")
+      error("loop counter is not an integer");
+    check_expr(s.expr);
+    if (curr_type.type_name != "bool")
+      error("loop condition is not a bool");
+    check_stmt(s.update);
+    if (curr_type.type_name != "int")
+      error("loop increment is not an integer");
+    check_block(s.body);
+    symbol_table.pop_environment();
+    break;
+  case FlatStmtKind::IF:
+    // each branch in its own environment
+    for (FlatIndex b = s.body.begin; b < s.body.end; ++b) {
+      const FlatBranch& branch = flat->branches[b];
+      symbol_table.push_environment();
+      if (b == s.body.begin) {
+        check_expr(branch.condition);
+        if (curr_type.type_name != "bool" || curr_type.is_array)
+          error("if condition not a bool");
+      }
+      else if (branch.condition != FLAT_NONE) {
+        check_expr(branch.condition);
+        if (curr_type.type_name != "bool")
+          error("else if condition is not a bool");
+      }
+      check_block(branch.body);
+      symbol_table.pop_environment();
+    }
+    break;
+  }
+}
 
-  //if the first value is an array, then check the array expression 
-  if(v.path[0].array_expr.has_value() && v.path[0].array_expr_2D.has_value()) {
-    //check the array expression
-    DataType array_type = symbol_table.get(v.path[0].var_name.lexeme()).value(); 
 
-    v.path[0].array_expr->accept(*this); 
+void SemanticChecker::check_expr(FlatIndex i)
+{
+  FlatExpr& e = flat->exprs[i];
+  switch (e.kind) {
+  case FlatExprKind::VALUE:
+    check_value(flat->tokens[e.token].type);
+    break;
+  case FlatExprKind::NEW: {
+    const string& type = flat->lexeme(e.token);
+    if (!e.children.empty()) {
+      for (FlatIndex size = e.children.begin; size < e.children.end; ++size) {
+        check_expr(size);
+        if (curr_type.type_name != "int")
+          error("array expr is not an int");
+      }
+      curr_type = DataType {true, type};
+    }
+    else
+      curr_type = DataType {false, type};
+    break;
+  }
+  case FlatExprKind::VAR:
+    check_path(e.children, false);
+    break;
+  case FlatExprKind::CALL: {
+    const string& name = flat->lexeme(e.token);
+    string call_name = check_call(name, e.children.size(), [&](int a) {
+      check_expr(e.children.begin + a);
+    });
+    //array lengths call a different built in in code gen
+    if (call_name != name)
+      flat->tokens[e.token].name = flat->intern(call_name);
+    break;
+  }
+  case FlatExprKind::PAREN:
+    check_expr(e.children.begin);
+    break;
+  }
+
+  if (e.op != FLAT_NONE) {
+    DataType lhs = curr_type;
+    check_expr(e.rest);
+    DataType rhs = curr_type;
+    e.op_type = check_op(flat->tokens[e.op].type, lhs, rhs);
+  }
 
-    if(curr_type.type_name != "int")
-      error("array expression does not contain int"); 
+  if (e.negated && curr_type.type_name != "bool")
+    error("type mismatch in negated statement");
+}
 
-    if(v.path[0].array_expr_2D.has_value()) {
-      v.path[0].array_expr_2D->accept(*this);
 
-      if(curr_type.type_name != "int")
+void SemanticChecker::check_path(FlatRange path, bool lvalue)
+{
+  //check that the first value is in symbol table
+  const FlatRef& first = flat->refs[path.begin];
+  const DataType* type = symbol_table.get(flat->tokens[first.name].name);
+  if (!type) {
+    const string& name = flat->lexeme(first.name);
+    if (lvalue)
+      error("reference to undefined variable: " + name);
+    error("reference to undefined variable var_rval " + name + " in ");
+  }
+
+  //check the array expressions of an indexed first value
+  DataType var_type = *type;
+  if (first.array_expr != FLAT_NONE) {
+    check_expr(first.array_expr);
+    if (curr_type.type_name != "int")
+      error("array expression does not contain int");
+    if (first.array_expr_2D != FLAT_NONE) {
+      check_expr(first.array_expr_2D);
+      if (curr_type.type_name != "int")
         error("array expression does not contain int");
     }
-    
-    curr_type = array_type; 
-  }
-  else { //single variable case. 
-    curr_type = symbol_table.get(v.path[0].var_name.lexeme()).value();
   }
 
-  //if the path is greater than one, the first value type must be in struct def
-  if(v.path.size() > 1) {
-    //get the type of the variable
-    DataType var_type = symbol_table.get(v.path[0].var_name.lexeme()).value(); 
+  //an indexed array holds a single element (an lvalue's type is only
+  //compared by name, so this is the same for both)
+  curr_type = var_type;
+  if (first.array_expr != FLAT_NONE)
+    curr_type.is_array = false;
 
-    //graq the first struct def
-    StructDef sd = struct_defs[var_type.type_name]; 
-
-    //iterate through te rest of the path
-    for(int i = 1; i < v.path.size(); i++) {
-      //check that the field is in the previous struct def
-      if(!get_field(sd, v.path[i].var_name.lexeme()))
+  //the rest of the path are fields of the struct before them
+  if (path.size() > 1) {
+    const StructDef* sd = struct_defs[var_type.type_name];
+    for (FlatIndex i = path.begin + 1; i < path.end; ++i) {
+      optional<VarDef> field = get_field(sd, flat->lexeme(flat->refs[i].name));
+      if (!field)
         error("field does not exist in struct");
-
-      //set the current type
-      curr_type = get_field(sd, v.path[i].var_name.lexeme()).value().data_type;
-
-      //set struct def again. 
-      sd = struct_defs[curr_type.type_name]; 
+      curr_type = field->data_type;
+      if (flat->refs[i].array_expr != FLAT_NONE)
+        curr_type.is_array = false;
+      sd = struct_defs[curr_type.type_name];
     }
   }
-}    
-
+}
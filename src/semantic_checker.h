@@ -8,51 +8,89 @@
 #ifndef SEMANTIC_CHECKER_H
 #define SEMANTIC_CHECKER_H
 
+#include <functional>
 #include <unordered_map>
+#include <vector>
 #include "ast.h"
+#include "flat_ast.h"
 #include "symbol_table.h"
 
 
-class SemanticChecker : public Visitor
+class SemanticChecker : public ProgramVisitor
 {
 public:
 
-  // visitor functions
+  // check a program (through its flat encoding), recording the operand
+  // types and call names the code generators use in its nodes
   void visit(Program& p);
-  void visit(FunDef& f);
-  void visit(StructDef& s);
-  void visit(ReturnStmt& s);
-  void visit(WhileStmt& s);
-  void visit(ForStmt& s);
-  void visit(IfStmt& s);
-  void visit(VarDeclStmt& s);
-  void visit(AssignStmt& s);
-  void visit(CallExpr& e);
-  void visit(Expr& e);
-  void visit(SimpleTerm& t); 
-  void visit(ComplexTerm& t);
-  void visit(SimpleRValue& v);
-  void visit(NewRValue& v);
-  void visit(VarRValue& v);    
+
+  // check a flat program, recording the operand types and call names
+  // in it
+  void check(FlatAST& ast);
 
 private:
 
-  // symbol table
-  SymbolTable symbol_table;
+  // the variables in scope (by name index) and their types, and the
+  // return type of the function being checked
+  FlatScopes<DataType> symbol_table;
+  DataType return_type;
 
   // current inferred type
   DataType curr_type;
 
-  // mapping from struct names to corresponding ast objects
-  std::unordered_map<std::string, StructDef> struct_defs;
+  // mapping from struct names to corresponding ast objects (null for
+  // names looked up that are not structs)
+  std::unordered_map<std::string, const StructDef*> struct_defs;
   
   // mapping from function names to corresponding ast objects
-  std::unordered_map<std::string, FunDef> fun_defs;
+  std::unordered_map<std::string, const FunDef*> fun_defs;
 
-  // helper function to get field in struct def
-  std::optional<VarDef> get_field(const StructDef& struct_def,
+  // helper function to get field in struct def (if any)
+  std::optional<VarDef> get_field(const StructDef* struct_def,
                                   const std::string& field_name);
 
+  // record the structs and functions of the program (checking for
+  // duplicate definitions and for the main function)
+  void declare(std::vector<StructDef>& structs, std::vector<FunDef>& funs);
+
+  // check a struct's fields
+  void check_struct(const StructDef& s);
+
+  // start a function's environment (with its return type and params)
+  void begin_function(const FlatFunDef& f);
+
+  // set the current type to the type of the literal value
+  void check_value(TokenType value);
+
+  // set the current type to the type of an operation, returning the
+  // type of its operands if they have the same non-array type
+  OpType check_op(TokenType op, const DataType& lhs, const DataType& rhs);
+
+  // set the current type to the return type of a call, using
+  // check_arg(i) to check the i-th argument, and returning the name
+  // the code generator calls (length@array for array lengths)
+  std::string check_call(const std::string& name, int arg_count,
+                         const std::function<void(int)>& check_arg);
+
+  // the flat program being checked, and the tree definitions (with
+  // no function bodies) standing for its structs and functions
+  FlatAST* flat = nullptr;
+  std::vector<StructDef> flat_structs;
+  std::vector<FunDef> flat_funs;
+
+  // flat program walk
+  void check_block(FlatRange body);
+  void check_stmt(FlatIndex s);
+  void check_expr(FlatIndex e);
+  void check_path(FlatRange path, bool lvalue);
+
+  // check a node visited on its own (see ProgramVisitor), recording the
+  // operand types and call names in its tree nodes
+  void walk_struct_def(FlatAST& ast, FlatIndex s);
+  void walk_fun_def(FlatAST& ast, FlatIndex f);
+  void walk_stmt(FlatAST& ast, FlatIndex s);
+  void walk_expr(FlatAST& ast, FlatIndex e);
+
   // error helper functions
   void error(const std::string& msg, const Token& token);
   void error(const std::string& msg);
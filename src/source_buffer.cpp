@@ -0,0 +1,107 @@
+//----------------------------------------------------------------------
+// FILE: source_buffer.cpp
+// DATE: Spring 2023
+// AUTH: Nisa Meshal
+// DESC: Source buffer implementation (mmap on POSIX systems, reading
+//       the file elsewhere or if mapping fails)
+//----------------------------------------------------------------------
+
+#include <fstream>
+#include <sstream>
+#include "source_buffer.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MYPL_MMAP
+#endif
+
+using namespace std;
+
+
+SourceBuffer::SourceBuffer(const string& file_name)
+{
+#ifdef MYPL_MMAP
+  int fd = open(file_name.c_str(), O_RDONLY);
+  if (fd < 0) {
+    failed = true;
+    return;
+  }
+  struct stat info;
+  // empty files (and non-regular ones) cannot be mapped
+  if (fstat(fd, &info) == 0 and S_ISREG(info.st_mode) and
+      info.st_size > 0) {
+    void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data != MAP_FAILED) {
+      start = static_cast<const char*>(data);
+      size = info.st_size;
+      is_mapped = true;
+      madvise(data, size, MADV_SEQUENTIAL);
+    }
+  }
+  close(fd);
+  if (is_mapped)
+    return;
+#endif
+  ifstream file(file_name, ios::binary);
+  if (file.fail()) {
+    failed = true;
+    return;
+  }
+  stringstream contents;
+  contents << file.rdbuf();
+  copy = contents.str();
+  start = copy.data();
+  size = copy.size();
+}
+
+
+SourceBuffer SourceBuffer::from_string(const string& text)
+{
+  SourceBuffer buffer;
+  buffer.copy = text;
+  buffer.start = buffer.copy.data();
+  buffer.size = buffer.copy.size();
+  return buffer;
+}
+
+
+SourceBuffer::SourceBuffer(SourceBuffer&& other)
+  : start(other.start), size(other.size), is_mapped(other.is_mapped),
+    failed(other.failed), copy(std::move(other.copy))
+{
+  if (!is_mapped)
+    start = copy.data();
+  other.start = nullptr;
+  other.size = 0;
+  other.is_mapped = false;
+}
+
+
+SourceBuffer::~SourceBuffer()
+{
+#ifdef MYPL_MMAP
+  if (is_mapped)
+    munmap(const_cast<char*>(start), size);
+#endif
+}
+
+
+bool SourceBuffer::fail() const
+{
+  return failed;
+}
+
+
+bool SourceBuffer::mapped() const
+{
+  return is_mapped;
+}
+
+
+string_view SourceBuffer::text() const
+{
+  return string_view(start, size);
+}
@@ -0,0 +1,60 @@
+//----------------------------------------------------------------------
+// FILE: source_buffer.h
+// DATE: Spring 2023
+// AUTH: Nisa Meshal
+// DESC: Read only, memory mapped view of a MyPL source file
+//----------------------------------------------------------------------
+
+#ifndef SOURCE_BUFFER_H
+#define SOURCE_BUFFER_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+
+// The contents of a source file, mapped into memory where possible
+// (and otherwise read in), for a lexer that refers to its lexemes in
+// place. The buffer must outlive the tokens (and so the ASTs) lexed
+// from it.
+class SourceBuffer
+{
+public:
+
+  // map (or read) the file, leaving the buffer empty and failed if it
+  // cannot be opened
+  SourceBuffer(const std::string& file_name);
+
+  // use the given text (e.g., for tests)
+  static SourceBuffer from_string(const std::string& text);
+
+  SourceBuffer(SourceBuffer&& other);
+  SourceBuffer(const SourceBuffer&) = delete;
+  SourceBuffer& operator=(const SourceBuffer&) = delete;
+  ~SourceBuffer();
+
+  // true if the file could not be opened
+  bool fail() const;
+
+  // true if the contents are memory mapped (rather than copied)
+  bool mapped() const;
+
+  // the contents
+  std::string_view text() const;
+
+private:
+
+  SourceBuffer() = default;
+
+  const char* start = nullptr;
+  size_t size = 0;
+  bool is_mapped = false;
+  bool failed = false;
+
+  // the contents when they are not mapped
+  std::string copy;
+
+};
+
+
+#endif
@@ -19,6 +19,15 @@ Token::Token(TokenType type, const std::string& lexeme, int line, int column)
     token_column {column}
 {}
 
+Token Token::in_source(TokenType type, std::string_view lexeme, int line,
+                       int column)
+{
+  Token token(type, "", line, column);
+  token.token_source = lexeme;
+  token.borrowed = true;
+  return token;
+}
+
 TokenType Token::type() const
 {
   return token_type;
@@ -26,7 +35,12 @@ TokenType Token::type() const
 
 std::string Token::lexeme() const
 {
-  return token_lexeme;
+  return std::string(lexeme_view());
+}
+
+std::string_view Token::lexeme_view() const
+{
+  return borrowed ? token_source : std::string_view(token_lexeme);
 }
 
 int Token::line() const
@@ -41,7 +55,7 @@ int Token::column() const
 
 std::string to_string(const Token& token)
 {
-  std::unordered_map<TokenType,std::string> ts = {
+  static const std::unordered_map<TokenType,std::string> ts = {
     // end-of-stream
     {TokenType::EOS, "EOS"}, {TokenType::ID, "ID"},
     // punctuation
@@ -76,5 +90,5 @@ std::string to_string(const Token& token)
   };
   return std::to_string(token.line()) + ", "
     + std::to_string(token.column()) + ": "
-    + ts[token.type()] + " '" +  token.lexeme() + "'";
+    + ts.at(token.type()) + " '" +  token.lexeme() + "'";
 }
@@ -9,6 +9,7 @@
 #define TOKEN_H
 
 #include <string>
+#include <string_view>
 
 
 enum class TokenType {
@@ -37,10 +38,16 @@ public:
   Token();
   // constructor
   Token(TokenType type, const std::string& lexeme, int line, int colum);
+  // returns a token whose lexeme refers to the source text in place
+  // (which must outlive the token)
+  static Token in_source(TokenType type, std::string_view lexeme, int line,
+                         int column);
   // returns the type of the token
   TokenType type() const;
   // returns the lexeme of the token
   std::string lexeme() const;
+  // returns the lexeme of the token without copying it
+  std::string_view lexeme_view() const;
   // returns the line of the token
   int line() const;
   // returns the column of the token
@@ -52,8 +59,11 @@ private:
 
   // the type of the token
   TokenType token_type;
-  // the token's lexeme
+  // the token's lexeme (unless it refers to the source)
   std::string token_lexeme;
+  // the lexeme in the source, if borrowed
+  std::string_view token_source;
+  bool borrowed = false;
   // line the token occurs on
   int token_line;
   // starting column of the token
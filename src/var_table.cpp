@@ -5,6 +5,7 @@
 // DESC: Var table implementation
 //----------------------------------------------------------------------
 
+#include <algorithm>
 #include "var_table.h"
 
 
@@ -13,6 +14,8 @@ using namespace std;
 
 void VarTable::push_environment()
 {
+  if (empty())
+    max_index = next_index;
   environments.push_back(unordered_map<string,int>());
 }
 
@@ -34,8 +37,10 @@ bool VarTable::empty() const
 
 void VarTable::add(const string& name)
 {
-  if (!empty())
+  if (!empty()) {
     environments.back()[name] = next_index++;
+    max_index = max(max_index, next_index);
+  }
 }
 
 
@@ -49,6 +54,12 @@ int VarTable::get(const string& name) const
 }
 
 
+int VarTable::max_size() const
+{
+  return max_index;
+}
+
+
 string to_string(const VarTable& var_table)
 {
   string str = "";
@@ -32,6 +32,10 @@ public:
   // return index for most recent name (or -1 if the name doesn't exist)
   int get(const std::string& name) const;
 
+  // return the most indexes in use at once since the table was last
+  // empty (i.e., the number of variable slots a function needs)
+  int max_size() const;
+
   // pretty print the table for debugging
   friend std::string to_string(const VarTable& var_table);
 
@@ -41,6 +45,8 @@ private:
   std::vector<std::unordered_map<std::string,int>> environments;
 
   int next_index = 0;
+
+  int max_index = 0;
   
 };
 
@@ -5,14 +5,228 @@
 // DESC: VM instructions
 //----------------------------------------------------------------------
 
+#include <algorithm>
+#include <chrono>
+#include <csignal>
 #include <iostream>
 #include "vm.h"
 #include "mypl_exception.h"
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/time.h>
+#define MYPL_SAMPLE_TIMER
+#endif
+
 
 using namespace std;
 
 
+//----------------------------------------------------------------------
+// Instruction dispatch
+//
+// On GCC/Clang the run loop is direct threaded: every handler ends by
+// fetching the next instruction and jumping straight to its handler
+// through a table of label addresses (computed goto), so there is no
+// central branch for the predictor to share. Other compilers, or a
+// build with MYPL_SWITCH_DISPATCH defined, use a portable switch.
+//----------------------------------------------------------------------
+
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(MYPL_SWITCH_DISPATCH)
+#define MYPL_THREADED_DISPATCH
+#endif
+
+// fetch the next instruction into instr (returning from run once the
+// call stack is exhausted or the frame runs out of instructions)
+#define FETCH()                                                         \
+  if (call_stack.empty() or frame->pc >= frame->info->instructions.size()) { \
+    retired_count += retired;                                           \
+    if (profiled)                                                       \
+      profile_counts.finish();                                          \
+    return;                                                             \
+  }                                                                     \
+  instr = &frame->info->instructions[frame->pc];                         \
+  ++frame->pc;                                                          \
+  ++retired;                                                            \
+  if (DEBUG)                                                            \
+    trace(*frame, *instr);                                              \
+  if (profiled)                                                         \
+    ++instruction_counts[frame->pc - 1];                                \
+  if (sampled and --sample_countdown == 0)                              \
+    sample();
+
+#ifdef MYPL_THREADED_DISPATCH
+
+#define DISPATCH_BEGIN                                                  \
+  static void* const dispatch_table[] = {                               \
+    &&op_PUSH, &&op_POP, &&op_LOAD, &&op_STORE, &&op_ADD, &&op_SUB,     \
+    &&op_MUL, &&op_DIV, &&op_AND, &&op_OR, &&op_NOT, &&op_CMPLT,        \
+    &&op_CMPLE, &&op_CMPGT, &&op_CMPGE, &&op_CMPEQ, &&op_CMPNE,         \
+    &&op_JMP, &&op_JMPF, &&op_CALL, &&op_RET, &&op_WRITE, &&op_READ,    \
+    &&op_SLEN, &&op_ALEN, &&op_GETC, &&op_TOINT, &&op_TODBL,            \
+    &&op_TOSTR, &&op_CONCAT, &&op_ALLOCS, &&op_ALLOCA, &&op_ALLOCA2D,   \
+    &&op_ADDF, &&op_SETF, &&op_GETF, &&op_SETFI, &&op_GETFI,            \
+    &&op_SETI, &&op_SETI2D, &&op_GETI, &&op_GETI2D, &&op_INCLOCAL,      \
+    &&op_LOADLOAD, &&op_LOAD_GETI, &&op_CMPLT_JMPF, &&op_CMPLE_JMPF,    \
+    &&op_CMPGT_JMPF, &&op_CMPGE_JMPF, &&op_CMPEQ_JMPF, &&op_CMPNE_JMPF, \
+    &&op_IADD, &&op_ISUB, &&op_IMUL, &&op_IDIV, &&op_DADD, &&op_DSUB,   \
+    &&op_DMUL, &&op_DDIV, &&op_ICMPLT, &&op_ICMPLE, &&op_ICMPGT,        \
+    &&op_ICMPGE, &&op_ICMPEQ, &&op_ICMPNE, &&op_ICMPLT_JMPF,            \
+    &&op_ICMPLE_JMPF, &&op_ICMPGT_JMPF, &&op_ICMPGE_JMPF,               \
+    &&op_ICMPEQ_JMPF, &&op_ICMPNE_JMPF, &&op_ADD_II, &&op_SUB_II,       \
+    &&op_MUL_II, &&op_DIV_II, &&op_CMPLT_II, &&op_CMPLE_II,             \
+    &&op_CMPGT_II, &&op_CMPGE_II, &&op_CMPLT_JMPF_II, &&op_CMPLE_JMPF_II, \
+    &&op_CMPGT_JMPF_II, &&op_CMPGE_JMPF_II, &&op_GETF_IC, &&op_SETF_IC, \
+    &&op_DUP, &&op_NOP                                                  \
+  };                                                                    \
+  static_assert(sizeof(dispatch_table) / sizeof(void*) ==               \
+                int(OpCode::NOP) + 1, "dispatch table out of sync");    \
+  NEXT();
+#define DISPATCH_END
+#define CASE(op) op_##op:
+#define NEXT() do { FETCH(); goto *dispatch_table[int(instr->opcode())]; } while (0)
+
+#else
+
+#define DISPATCH_BEGIN for (;;) { FETCH(); switch (instr->opcode()) {
+#define DISPATCH_END                                                    \
+    default:                                                            \
+      error("unsupported operation " + to_string(*instr));              \
+  } }
+#define CASE(op) case OpCode::op:
+#define NEXT() continue
+
+#endif
+
+// typed operations set y (just below the top) to the value of expr and
+// pop x, or pop both and jump to the operand unless cond holds. The
+// operand types were checked statically, leaving only the null test.
+
+#define TYPED_BINARY(set, expr)                                         \
+  {                                                                     \
+    VMValue& x = frame->operand_stack.top();                            \
+    VMValue& y = frame->operand_stack.below_top();                      \
+    ensure_not_null(*frame, x, y);                                      \
+    y.set(expr);                                                        \
+    frame->operand_stack.drop();                                        \
+    NEXT();                                                             \
+  }
+
+#define TYPED_COMPARE_JUMP(cond)                                        \
+  {                                                                     \
+    const VMValue& x = frame->operand_stack.top();                      \
+    const VMValue& y = frame->operand_stack.below_top();                \
+    ensure_not_null(*frame, x, y);                                      \
+    bool taken = !(cond);                                               \
+    frame->operand_stack.drop();                                        \
+    frame->operand_stack.drop();                                        \
+    if (taken)                                                          \
+      frame->pc = instr->operand()->as_int();                           \
+    NEXT();                                                             \
+  }
+
+// quickened operations run their fast path when the guard holds, and
+// otherwise put the generic instruction back and run it instead (a
+// retried instruction is only counted once)
+
+#define RETRY()                                                         \
+  {                                                                     \
+    --frame->pc;                                                        \
+    --retired;                                                          \
+    if (profiled)                                                       \
+      --instruction_counts[frame->pc];                                  \
+    NEXT();                                                             \
+  }
+
+// with the jit on, continue in the current frame's machine code (if
+// it was compiled) until it reaches an instruction it leaves to the
+// interpreter
+
+#define ENTER_NATIVE()                                                  \
+  if (native and frame->info->native)                                   \
+    run_native(*frame);
+
+#define QUICK_BINARY(generic, set, expr)                                \
+  {                                                                     \
+    VMValue& x = frame->operand_stack.top();                            \
+    VMValue& y = frame->operand_stack.below_top();                      \
+    if (x.is_int() and y.is_int()) {                                    \
+      y.set(expr);                                                      \
+      frame->operand_stack.drop();                                      \
+      NEXT();                                                           \
+    }                                                                   \
+    deoptimize(*instr, OpCode::generic);                                \
+    RETRY();                                                            \
+  }
+
+#define QUICK_COMPARE_JUMP(generic, cond)                               \
+  {                                                                     \
+    const VMValue& x = frame->operand_stack.top();                      \
+    const VMValue& y = frame->operand_stack.below_top();                \
+    if (x.is_int() and y.is_int()) {                                    \
+      bool taken = !(cond);                                             \
+      frame->operand_stack.drop();                                      \
+      frame->operand_stack.drop();                                      \
+      if (taken)                                                        \
+        frame->pc = instr->operand()->as_int();                         \
+      NEXT();                                                           \
+    }                                                                   \
+    deoptimize(*instr, OpCode::generic);                                \
+    RETRY();                                                            \
+  }
+
+
+//----------------------------------------------------------------------
+// Sampling timer
+//
+// With timed sampling, a cpu time interval timer raises SIGPROF, whose
+// handler only sets a flag. The run loop polls the flag every
+// TIMER_POLL instructions and samples the call stack when it is set.
+//----------------------------------------------------------------------
+
+static volatile sig_atomic_t sample_timer_fired = 0;
+
+static void on_sample_timer(int)
+{
+  sample_timer_fired = 1;
+}
+
+// Runs the sampling timer (every given number of microseconds, if
+// any) for as long as it exists
+class SampleTimer
+{
+public:
+  SampleTimer(uint64_t microseconds) : running(microseconds > 0)
+  {
+    sample_timer_fired = 0;
+#ifdef MYPL_SAMPLE_TIMER
+    if (running) {
+      signal(SIGPROF, on_sample_timer);
+      set(microseconds);
+    }
+#endif
+  }
+  ~SampleTimer()
+  {
+#ifdef MYPL_SAMPLE_TIMER
+    if (running)
+      set(0);
+#endif
+  }
+private:
+  bool running;
+#ifdef MYPL_SAMPLE_TIMER
+  static void set(uint64_t microseconds)
+  {
+    itimerval timer {};
+    timer.it_interval.tv_sec = microseconds / 1000000;
+    timer.it_interval.tv_usec = microseconds % 1000000;
+    timer.it_value = timer.it_interval;
+    setitimer(ITIMER_PROF, &timer, nullptr);
+  }
+#endif
+};
+
+
 void VM::error(string msg) const
 {
   throw MyPLException::VMError(msg);
@@ -22,8 +236,8 @@ void VM::error(string msg) const
 void VM::error(string msg, const VMFrame& frame) const
 {
   int pc = frame.pc - 1;
-  VMInstr instr = frame.info.instructions[pc];
-  string name = frame.info.function_name;
+  VMInstr instr = frame.info->instructions[pc];
+  string name = frame.info->function_name;
   msg += " (in " + name + " at " + to_string(pc) + ": " +
     to_string(instr) + ")";
   throw MyPLException::VMError(msg);
@@ -32,14 +246,26 @@ void VM::error(string msg, const VMFrame& frame) const
 
 string to_string(const VM& vm)
 {
+  // after a profiled run, each instruction is prefixed by its count
+  const vector<VMFunctionProfile>& counts =
+    vm.profile_counts.function_profiles();
+  bool profiled = vm.profiling and counts.size() == vm.frame_info.size();
   string s = "";
-  for (const auto& entry : vm.frame_info) {
-    const string& name = entry.first;
-    s += "\nFrame '" + name + "'\n";
-    const VMFrameInfo& frame = entry.second;
+  for (int f = 0; f < vm.frame_info.size(); ++f) {
+    const VMFrameInfo& frame = vm.frame_info[f];
+    s += "\nFrame '" + frame.function_name + "'";
+    if (profiled)
+      s += " (" + to_string(counts[f].calls) + " calls, " +
+        to_string(counts[f].retired()) + " instructions)";
+    s += "\n";
     for (int i = 0; i < frame.instructions.size(); ++i) {
       VMInstr instr = frame.instructions[i];
-      s += "  " + to_string(i) + ": " + to_string(instr) + "\n"; 
+      string count = "";
+      if (profiled and i < counts[f].hits.size()) {
+        count = to_string(counts[f].hits[i]);
+        count = string(max(0, 12 - int(count.size())), ' ') + count + " ";
+      }
+      s += count + "  " + to_string(i) + ": " + to_string(instr) + "\n"; 
     }
   }
   return s;
@@ -48,79 +274,114 @@ string to_string(const VM& vm)
 
 void VM::add(const VMFrameInfo& frame)
 {
-  frame_info[frame.function_name] = frame;
+  auto [entry, added] = frame_ids.try_emplace(frame.function_name,
+                                              frame_info.size());
+  if (added)
+    frame_info.push_back(frame);
+  else
+    frame_info[entry->second] = frame;
+  VMFrameInfo& info = frame_info[entry->second];
+  if (info.max_stack < 0)
+    info.max_stack = max_stack_depth(info);
+  if (info.local_count < 0)
+    info.local_count = count_locals(info);
+  info.native = nullptr;
+  linked = false;
+}
+
+
+void VM::link()
+{
+  for (VMFrameInfo& frame : frame_info) {
+    for (int i = 0; i < frame.instructions.size(); ++i) {
+      VMInstr& instr = frame.instructions[i];
+      if (instr.opcode() != OpCode::CALL or !instr.operand()->is_string())
+        continue;
+      string name = instr.operand()->as_string();
+      auto entry = frame_ids.find(name);
+      if (entry == frame_ids.end())
+        error("undefined function '" + name + "' (in " +
+              frame.function_name + " at " + to_string(i) + ": " +
+              to_string(instr) + ")");
+      instr.set_operand(entry->second);
+      instr.set_comment(name);
+    }
+  }
+  linked = true;
 }
 
 
 void VM::run(bool DEBUG)
 {
   // grab the "main" frame if it exists
-  if (!frame_info.contains("main"))
+  if (!frame_ids.contains("main"))
     error("No 'main' function");
-  shared_ptr<VMFrame> frame = make_shared<VMFrame>();
-  frame->info = frame_info["main"];
-  call_stack.push(frame);
+  if (!linked)
+    link();
+  // machine code is not traced or profiled
+  bool profiled = profiling;
+  bool sampled = sample_interval > 0;
+  bool native = jit and !DEBUG and !profiled and !sampled and
+    native_supported();
+  if (native)
+    compile_native_frames();
+  vector<string> names;
+  vector<int> sizes;
+  for (const VMFrameInfo& info : frame_info) {
+    names.push_back(info.function_name);
+    sizes.push_back(info.instructions.size());
+  }
+  if (profiled)
+    profile_counts.reset(names, sizes);
+  if (sampled) {
+    stack_samples.reset(names);
+    sample_countdown = sample_timer ? TIMER_POLL : sample_interval;
+  }
+  SampleTimer timer(sampled and sample_timer ? sample_interval : 0);
+  call_stack.clear();
+  value_stack.clear();
+  push_frame(frame_info[frame_ids["main"]]);
+  VMFrame* frame = &call_stack.back();
+
+  // with profiling on, the counters of the current function's
+  // instructions
+  uint64_t* instruction_counts = nullptr;
+  if (profiled) {
+    profile_counts.enter(frame_ids["main"]);
+    instruction_counts =
+      profile_counts.instruction_counters(frame_ids["main"]);
+  }
+  ENTER_NATIVE();
 
-  // run loop (keep going until we run out of instructions)
-  while (!call_stack.empty() and frame->pc < frame->info.instructions.size()) {
-
-    // get the next instruction
-    VMInstr& instr = frame->info.instructions[frame->pc];
-
-    // increment the program counter
-    ++frame->pc;
-
-    // for debugging
-    if (DEBUG) {
-      // TODO
-      cerr << endl << endl;
-      cerr << "\t FRAME.........: " << frame->info.function_name << endl;
-      cerr << "\t PC............: " << (frame->pc - 1) << endl;
-      cerr << "\t INSTR.........: " << to_string(instr) << endl;
-      cerr << "\t NEXT OPERAND..: ";
-      if (!frame->operand_stack.empty())
-        cerr << to_string(frame->operand_stack.top()) << endl;
-      else
-        cerr << "empty" << endl;
-      cerr << "\t NEXT FUNCTION.: ";
-      if (!call_stack.empty())
-        cerr << call_stack.top()->info.function_name << endl;
-      else
-        cerr << "empty" << endl;
-    }
+  // the instruction being executed (which may be quickened in place)
+  // and the number executed so far
+  VMInstr* instr = nullptr;
+  uint64_t retired = 0;
 
-    //----------------------------------------------------------------------
-    // Literals and Variables
-    //----------------------------------------------------------------------
+  // run loop (keep going until we run out of instructions)
+  DISPATCH_BEGIN
 
-    if (instr.opcode() == OpCode::PUSH) {
-      frame->operand_stack.push(instr.operand().value());
+    CASE(PUSH) {
+      frame->operand_stack.push(instr->operand().value());
+      NEXT();
     }
 
-    else if (instr.opcode() == OpCode::POP) {
+    CASE(POP) {
       frame->operand_stack.pop();
+      NEXT();
     }
 
     // TODO: Finish LOAD and STORE
 
-    else if (instr.opcode() == OpCode::LOAD) {
-      frame->operand_stack.push(frame->variables[get<int>(instr.operand().value())]); 
+    CASE(LOAD) {
+      frame->operand_stack.push(frame->variables[instr->operand()->as_int()]);
+      NEXT();
     }
 
-    else if (instr.opcode() == OpCode::STORE) {  
-      if(!frame->variables.empty()) {
-        if(get<int>(instr.operand().value()) >= frame->variables.size()) {
-          frame->variables.push_back(frame->operand_stack.top());
-        }
-        else {
-          frame->variables[get<int>(instr.operand().value())] = frame->operand_stack.top();
-        } 
-      }
-      else {
-        frame->variables.push_back(frame->operand_stack.top());
-      }
-
-      frame->operand_stack.pop(); 
+    CASE(STORE) {  
+      frame->variables[instr->operand()->as_int()] =
+        frame->operand_stack.pop_value();
+      NEXT();
     }
 
 
@@ -128,130 +389,134 @@ void VM::run(bool DEBUG)
     // Operations
     //----------------------------------------------------------------------
 
-    else if (instr.opcode() == OpCode::ADD) {
-      VMValue x = frame->operand_stack.top();
+    CASE(ADD) {
+      VMValue x = frame->operand_stack.pop_value();
       ensure_not_null(*frame, x);
-      frame->operand_stack.pop();
-      VMValue y = frame->operand_stack.top();
+      VMValue y = frame->operand_stack.pop_value();
       ensure_not_null(*frame, y);
-      frame->operand_stack.pop();
+      if (x.is_int() and y.is_int())
+        quicken(*instr, OpCode::ADD_II);
       frame->operand_stack.push(add(y, x));
+      NEXT();
     }
 
     // TODO: Finish SUB, MUL, DIV, AND, OR, NOT, COMPLT, COMPLE,
     // CMPGT, CMPGE, CMPEQ, CMPNE
     
-    else if (instr.opcode() == OpCode::SUB) {
-      VMValue x = frame->operand_stack.top(); 
+    CASE(SUB) {
+      VMValue x = frame->operand_stack.pop_value();
       ensure_not_null(*frame, x);
-      frame->operand_stack.pop(); 
-      VMValue y = frame->operand_stack.top(); 
-      ensure_not_null(*frame, y); 
-      frame->operand_stack.pop(); 
-      frame->operand_stack.push(sub(y, x)); 
+      VMValue y = frame->operand_stack.pop_value();
+      ensure_not_null(*frame, y);
+      if (x.is_int() and y.is_int())
+        quicken(*instr, OpCode::SUB_II);
+      frame->operand_stack.push(sub(y, x));
+      NEXT();
     }
 
-    else if (instr.opcode() == OpCode::MUL) {
-      VMValue x = frame->operand_stack.top(); 
+    CASE(MUL) {
+      VMValue x = frame->operand_stack.pop_value();
       ensure_not_null(*frame, x);
-      frame->operand_stack.pop(); 
-      VMValue y = frame->operand_stack.top(); 
-      ensure_not_null(*frame, y); 
-      frame->operand_stack.pop(); 
-      frame->operand_stack.push(mul(y, x)); 
+      VMValue y = frame->operand_stack.pop_value();
+      ensure_not_null(*frame, y);
+      if (x.is_int() and y.is_int())
+        quicken(*instr, OpCode::MUL_II);
+      frame->operand_stack.push(mul(y, x));
+      NEXT();
     }
 
-    else if (instr.opcode() == OpCode::DIV) {
-      VMValue x = frame->operand_stack.top(); 
+    CASE(DIV) {
+      VMValue x = frame->operand_stack.pop_value();
       ensure_not_null(*frame, x);
-      frame->operand_stack.pop(); 
-      VMValue y = frame->operand_stack.top(); 
-      ensure_not_null(*frame, y); 
-      frame->operand_stack.pop(); 
-      frame->operand_stack.push(div(y, x)); 
+      VMValue y = frame->operand_stack.pop_value();
+      ensure_not_null(*frame, y);
+      if (x.is_int() and y.is_int())
+        quicken(*instr, OpCode::DIV_II);
+      frame->operand_stack.push(div(y, x));
+      NEXT();
     }
 
-    else if (instr.opcode() == OpCode::AND) {
-      VMValue x = frame->operand_stack.top(); 
+    CASE(AND) {
+      VMValue x = frame->operand_stack.pop_value();
       ensure_not_null(*frame, x);
-      frame->operand_stack.pop(); 
-      VMValue y = frame->operand_stack.top(); 
+      VMValue y = frame->operand_stack.pop_value();
       ensure_not_null(*frame, y); 
-      frame->operand_stack.pop(); 
-      frame->operand_stack.push(get<bool>(y) && get<bool>(x)); 
+      frame->operand_stack.push(y.as_bool() && x.as_bool()); 
+      NEXT();
     }
 
-    else if (instr.opcode() == OpCode::OR) {
-      VMValue x = frame->operand_stack.top(); 
+    CASE(OR) {
+      VMValue x = frame->operand_stack.pop_value();
       ensure_not_null(*frame, x);
-      frame->operand_stack.pop(); 
-      VMValue y = frame->operand_stack.top(); 
+      VMValue y = frame->operand_stack.pop_value();
       ensure_not_null(*frame, y); 
-      frame->operand_stack.pop(); 
-      frame->operand_stack.push(get<bool>(y) || get<bool>(x)); 
+      frame->operand_stack.push(y.as_bool() || x.as_bool()); 
+      NEXT();
     }
 
-    else if (instr.opcode() == OpCode::NOT) {
-      VMValue x = frame->operand_stack.top(); 
+    CASE(NOT) {
+      VMValue x = frame->operand_stack.pop_value();
       ensure_not_null(*frame, x);
-      frame->operand_stack.pop(); 
-      frame->operand_stack.push(!get<bool>(x)); 
-    }    
+      frame->operand_stack.push(!x.as_bool()); 
+      NEXT();
+    }
     
-    else if (instr.opcode() == OpCode::CMPLT) {
-      VMValue x = frame->operand_stack.top(); 
+    CASE(CMPLT) {
+      VMValue x = frame->operand_stack.pop_value();
       ensure_not_null(*frame, x);
-      frame->operand_stack.pop(); 
-      VMValue y = frame->operand_stack.top(); 
-      ensure_not_null(*frame, y); 
-      frame->operand_stack.pop(); 
-      frame->operand_stack.push(get<bool>(lt(y, x))); 
+      VMValue y = frame->operand_stack.pop_value();
+      ensure_not_null(*frame, y);
+      if (x.is_int() and y.is_int())
+        quicken(*instr, OpCode::CMPLT_II);
+      frame->operand_stack.push(lt(y, x).as_bool());
+      NEXT();
     }
 
-    else if (instr.opcode() == OpCode::CMPLE) {
-      VMValue x = frame->operand_stack.top(); 
+    CASE(CMPLE) {
+      VMValue x = frame->operand_stack.pop_value();
       ensure_not_null(*frame, x);
-      frame->operand_stack.pop(); 
-      VMValue y = frame->operand_stack.top(); 
-      ensure_not_null(*frame, y); 
-      frame->operand_stack.pop(); 
-      frame->operand_stack.push(get<bool>(le(y, x))); 
+      VMValue y = frame->operand_stack.pop_value();
+      ensure_not_null(*frame, y);
+      if (x.is_int() and y.is_int())
+        quicken(*instr, OpCode::CMPLE_II);
+      frame->operand_stack.push(le(y, x).as_bool());
+      NEXT();
     }
 
-    else if (instr.opcode() == OpCode::CMPGT) {
-      VMValue x = frame->operand_stack.top(); 
+    CASE(CMPGT) {
+      VMValue x = frame->operand_stack.pop_value();
       ensure_not_null(*frame, x);
-      frame->operand_stack.pop(); 
-      VMValue y = frame->operand_stack.top(); 
-      ensure_not_null(*frame, y); 
-      frame->operand_stack.pop(); 
-      frame->operand_stack.push(get<bool>(gt(y, x))); 
+      VMValue y = frame->operand_stack.pop_value();
+      ensure_not_null(*frame, y);
+      if (x.is_int() and y.is_int())
+        quicken(*instr, OpCode::CMPGT_II);
+      frame->operand_stack.push(gt(y, x).as_bool());
+      NEXT();
     }
 
-    else if (instr.opcode() == OpCode::CMPGE) {
-      VMValue x = frame->operand_stack.top(); 
+    CASE(CMPGE) {
+      VMValue x = frame->operand_stack.pop_value();
       ensure_not_null(*frame, x);
-      frame->operand_stack.pop(); 
-      VMValue y = frame->operand_stack.top(); 
-      ensure_not_null(*frame, y); 
-      frame->operand_stack.pop(); 
-      frame->operand_stack.push(get<bool>(ge(y, x))); 
+      VMValue y = frame->operand_stack.pop_value();
+      ensure_not_null(*frame, y);
+      if (x.is_int() and y.is_int())
+        quicken(*instr, OpCode::CMPGE_II);
+      frame->operand_stack.push(ge(y, x).as_bool());
+      NEXT();
     }
 
-    else if (instr.opcode() == OpCode::CMPEQ) {
-      VMValue x = frame->operand_stack.top(); 
-      frame->operand_stack.pop(); 
-      VMValue y = frame->operand_stack.top(); 
-      frame->operand_stack.pop(); 
-      frame->operand_stack.push(get<bool>(eq(y, x))); 
+    CASE(CMPEQ) {
+      VMValue x = frame->operand_stack.pop_value();
+      VMValue y = frame->operand_stack.pop_value();
+      frame->operand_stack.push(eq(y, x).as_bool()); 
+      NEXT();
     }
 
-    else if (instr.opcode() == OpCode::CMPNE) {
-      VMValue x = frame->operand_stack.top(); 
-      frame->operand_stack.pop(); 
-      VMValue y = frame->operand_stack.top(); 
-      frame->operand_stack.pop(); 
-      frame->operand_stack.push(!get<bool>(eq(y, x))); 
+    CASE(CMPNE) {
+      VMValue x = frame->operand_stack.pop_value();
+      VMValue y = frame->operand_stack.pop_value();
+      frame->operand_stack.push(!eq(y, x).as_bool()); 
+      NEXT();
     }
 
     //----------------------------------------------------------------------
@@ -259,15 +524,21 @@ void VM::run(bool DEBUG)
     //----------------------------------------------------------------------
 
     // TODO: Finish JMP and JMPF
-    else if (instr.opcode() == OpCode::JMP) {
-      frame->pc = get<int>(instr.operand().value());
+    CASE(JMP) {
+      int target = instr->operand().value().as_int();
+      bool back_edge = target < frame->pc;
+      frame->pc = target;
+      if (back_edge)
+        ENTER_NATIVE();
+      NEXT();
     }
 
-    else if (instr.opcode() == OpCode::JMPF) {
-      if(!get<bool>(frame->operand_stack.top())) {
-        frame->pc = get<int>(instr.operand().value()); 
+    CASE(JMPF) {
+      if(!frame->operand_stack.top().as_bool()) {
+        frame->pc = instr->operand().value().as_int(); 
       }
       frame->operand_stack.pop(); 
+      NEXT();
     }
     
     //----------------------------------------------------------------------
@@ -276,27 +547,41 @@ void VM::run(bool DEBUG)
 
 
     // TODO: Finish CALL, RET
-    else if (instr.opcode() == OpCode::CALL) {
-      string g = get<string>(instr.operand().value()); 
-      shared_ptr<VMFrame> new_frame = make_shared<VMFrame>();
-      new_frame->info = frame_info[g]; 
-      call_stack.push(new_frame); 
-      for (int i = 0; i < new_frame->info.arg_count; ++i) {
-        VMValue x = frame->operand_stack.top(); 
-        new_frame->operand_stack.push(x); 
-        frame->operand_stack.pop();       
+    CASE(CALL) {
+      push_frame(frame_info[instr->operand()->as_int()]);
+      // the push may have moved the call stack
+      VMFrame* caller = &call_stack[call_stack.size() - 2];
+      frame = &call_stack.back();
+      for (int i = 0; i < frame->info->arg_count; ++i)
+        frame->operand_stack.push(caller->operand_stack.pop_value());
+      if (profiled) {
+        profile_counts.enter(instr->operand()->as_int());
+        instruction_counts =
+          profile_counts.instruction_counters(instr->operand()->as_int());
       }
-
-      frame = new_frame; 
+      ENTER_NATIVE();
+      NEXT();
     }
     
-    else if (instr.opcode() == OpCode::RET) {
-      VMValue v = frame->operand_stack.top(); 
-      call_stack.pop(); 
+    CASE(RET) {
+      VMValue v = frame->operand_stack.pop_value(); 
+      // release the frame's values before its block is reused
+      frame->operand_stack.clear();
+      for (int i = 0; i < frame->info->local_count; ++i)
+        frame->variables[i] = nullptr;
+      value_stack.pop(frame->variables);
+      call_stack.pop_back();
+      if (profiled)
+        profile_counts.exit();
       if(call_stack.size() != 0) {
-        frame = call_stack.top(); 
-        frame->operand_stack.push(v); 
+        frame = &call_stack.back();
+        if (profiled)
+          instruction_counts = profile_counts.instruction_counters(
+            frame->info - frame_info.data());
+        frame->operand_stack.push(std::move(v)); 
+        ENTER_NATIVE();
       }
+      NEXT();
     }
 
     //----------------------------------------------------------------------
@@ -304,101 +589,104 @@ void VM::run(bool DEBUG)
     //----------------------------------------------------------------------
 
 
-    else if (instr.opcode() == OpCode::WRITE) {
-      VMValue x = frame->operand_stack.top();
-      frame->operand_stack.pop();
+    CASE(WRITE) {
+      VMValue x = frame->operand_stack.pop_value();
       cout << to_string(x);
+      NEXT();
     }
 
-    else if (instr.opcode() == OpCode::READ) {
+    CASE(READ) {
       string val = "";
       getline(cin, val);
       frame->operand_stack.push(val);
+      NEXT();
     }
 
     // TODO: Finish SLEN, ALEN, GETC, TODBL, TOSTR, CONCAT
     
-    else if (instr.opcode() == OpCode::SLEN) {
+    CASE(SLEN) {
       ensure_not_null(*frame, frame->operand_stack.top());
-      int x = get<string>(frame->operand_stack.top()).size();
+      int x = frame->operand_stack.top().as_string().size();
       frame->operand_stack.pop();
       frame->operand_stack.push(x); 
+      NEXT();
     }
 
-    else if (instr.opcode() == OpCode::ALEN) {
+    CASE(ALEN) {
       ensure_not_null(*frame, frame->operand_stack.top()); 
-      int x = array_heap[get<int>(frame->operand_stack.top())].size(); 
+      int x = heap[frame->operand_stack.top().as_ref()].elements.size(); 
       frame->operand_stack.pop();
       frame->operand_stack.push(x); 
+      NEXT();
     }
 
-    else if (instr.opcode() == OpCode::GETC) {
+    CASE(GETC) {
       ensure_not_null(*frame, frame->operand_stack.top()); 
-      string x = get<string>(frame->operand_stack.top()); 
-      frame->operand_stack.pop();
+      VMValue x = frame->operand_stack.pop_value();
       ensure_not_null(*frame, frame->operand_stack.top()); 
-      int y = get<int>(frame->operand_stack.top()); 
+      int y = frame->operand_stack.top().as_int(); 
       frame->operand_stack.pop();  
 
-      if(y >= x.length()) {
+      if(y >= x.as_string().length()) {
         error("out-of-bounds string index", *frame); 
       }
 
-      frame->operand_stack.push(string(1, x[y])); 
+      frame->operand_stack.push(string(1, x.as_string()[y])); 
+      NEXT();
     }
 
-    else if (instr.opcode() == OpCode::TOINT) {
+    CASE(TOINT) {
       ensure_not_null(*frame, frame->operand_stack.top()); 
-      VMValue x = frame->operand_stack.top(); 
-      frame->operand_stack.pop();
+      VMValue x = frame->operand_stack.pop_value();
 
-      if(holds_alternative<double>(x)) {
-        frame->operand_stack.push(int(get<double>(x))); 
+      if(x.is_double()) {
+        frame->operand_stack.push(int(x.as_double())); 
       }
       else {
-        if(isdigit(get<string>(x)[0])) {
-          frame->operand_stack.push(stoi(get<string>(x))); 
+        if(isdigit(x.as_string()[0])) {
+          frame->operand_stack.push(stoi(x.as_string())); 
         }
         else {
           error("cannot convert string to int", *frame); 
         }
       }
+      NEXT();
     }
 
-    else if (instr.opcode() == OpCode::TODBL) {
+    CASE(TODBL) {
       ensure_not_null(*frame, frame->operand_stack.top()); 
-      VMValue x = frame->operand_stack.top(); 
-      frame->operand_stack.pop();
+      VMValue x = frame->operand_stack.pop_value();
 
-      if(holds_alternative<int>(x)) {
-        frame->operand_stack.push(double(get<int>(x))); 
+      if(x.is_int()) {
+        frame->operand_stack.push(double(x.as_int())); 
       }
       else {
-        if(isdigit(get<string>(x)[0])) {
-          frame->operand_stack.push(stod(get<string>(x))); 
+        if(isdigit(x.as_string()[0])) {
+          frame->operand_stack.push(stod(x.as_string())); 
         }
         else {
           error("cannot convert string to double", *frame); 
         }
       }
+      NEXT();
     }
 
-    else if (instr.opcode() == OpCode::TOSTR) {
+    CASE(TOSTR) {
       ensure_not_null(*frame, frame->operand_stack.top()); 
       string x = to_string(frame->operand_stack.top());
       frame->operand_stack.pop();
       frame->operand_stack.push(x); 
+      NEXT();
     }
     
-    else if (instr.opcode() == OpCode::CONCAT) {
+    CASE(CONCAT) {
       ensure_not_null(*frame, frame->operand_stack.top());
-      string x = get<string>(frame->operand_stack.top()); 
-      frame->operand_stack.pop(); 
+      VMValue x = frame->operand_stack.pop_value();
       ensure_not_null(*frame, frame->operand_stack.top()); 
-      string y = get<string>(frame->operand_stack.top());
-      frame->operand_stack.pop(); 
+      VMValue y = frame->operand_stack.pop_value();
 
-      frame->operand_stack.push(y + x); 
+      frame->operand_stack.push(y.as_string() + x.as_string()); 
+      NEXT();
     }
     //----------------------------------------------------------------------
     // heap
@@ -406,129 +694,365 @@ void VM::run(bool DEBUG)
 
     // TODO: Finish ALLOCS, ALLOCA, ADDF, SETF, GETF, SETI, GETI
 
-    else if (instr.opcode() == OpCode::ALLOCS) {
-      struct_heap[next_obj_id] = {};
-      frame->operand_stack.push(next_obj_id);
-      next_obj_id++;
+    // allocations first collect garbage if the heap has grown past the
+    // trigger point (while their operands are still on the stack)
+
+    CASE(ALLOCS) {
+      if (heap.bytes() >= next_gc)
+        collect();
+      int oid = heap.allocate(instr->operand()->as_int());
+      frame->operand_stack.push(VMValue::ref(oid));
+      NEXT();
     }
 
-    else if (instr.opcode() == OpCode::ALLOCA) {
-      VMValue x = frame->operand_stack.top();
+    CASE(ALLOCA) {
+      if (heap.bytes() >= next_gc)
+        collect();
+      VMValue x = frame->operand_stack.pop_value();
+      int y = frame->operand_stack.top().as_int();
       frame->operand_stack.pop();
-      int y = get<int>(frame->operand_stack.top());
-      frame->operand_stack.pop();
-      array_heap[next_obj_id] = vector<VMValue>(y, x); 
-      frame->operand_stack.push(next_obj_id);
-      next_obj_id++;
+      frame->operand_stack.push(VMValue::ref(heap.allocate(y, x)));
+      NEXT();
     }
 
-    else if (instr.opcode() == OpCode::ADDF) {
-      VMValue x = frame->operand_stack.top();
+    // fields added by name are found through the object's shape, and
+    // a SETF or GETF of an existing field caches the shape and slot
+
+    CASE(ADDF) {
+      VMValue x = frame->operand_stack.pop_value();
       ensure_not_null(*frame, x);
-      frame->operand_stack.pop();
-      struct_heap[get<int>(x)][get<string>(instr.operand().value())] = nullptr;
+      VMObject& obj = heap[x.as_ref()];
+      const string& name = instr->operand()->as_string();
+      int slot = heap.field_slot(obj.shape, name);
+      if (slot < 0)
+        heap.add_field(obj, name);
+      else
+        obj.fields[slot] = nullptr;
+      NEXT();
     }
     
-    else if (instr.opcode() == OpCode::SETF) {
+    CASE(SETF) {
       //value 
-      VMValue x = frame->operand_stack.top();
-      frame->operand_stack.pop();
+      VMValue x = frame->operand_stack.pop_value();
       //struct object
-      VMValue y = frame->operand_stack.top();
+      VMValue y = frame->operand_stack.pop_value();
       ensure_not_null(*frame, y);
-      frame->operand_stack.pop();
-      struct_heap[get<int>(y)][get<string>(instr.operand().value())] = x; 
+      VMObject& obj = heap[y.as_ref()];
+      const string& name = instr->operand()->as_string();
+      int slot = heap.field_slot(obj.shape, name);
+      if (slot < 0)
+        slot = heap.add_field(obj, name);
+      else if (quicken(*instr, OpCode::SETF_IC))
+        instr->set_field_cache(obj.shape, slot);
+      obj.fields[slot] = std::move(x);
+      NEXT();
     }
 
-    else if (instr.opcode() == OpCode::GETF) {
-      VMValue x = frame->operand_stack.top();
+    CASE(GETF) {
+      VMValue x = frame->operand_stack.pop_value();
       ensure_not_null(*frame, x);
-      frame->operand_stack.pop();
-      frame->operand_stack.push(struct_heap[get<int>(x)][get<string>(instr.operand().value())]);
+      const VMObject& obj = heap[x.as_ref()];
+      int slot = heap.field_slot(obj.shape, instr->operand()->as_string());
+      if (slot < 0)
+        frame->operand_stack.push(nullptr);
+      else {
+        if (quicken(*instr, OpCode::GETF_IC))
+          instr->set_field_cache(obj.shape, slot);
+        frame->operand_stack.push(obj.fields[slot]);
+      }
+      NEXT();
     }
 
-    else if (instr.opcode() == OpCode::SETI) {
-      VMValue x = frame->operand_stack.top();
-      frame->operand_stack.pop();
-      VMValue y = frame->operand_stack.top();
-      frame->operand_stack.pop();
-      VMValue z = frame->operand_stack.top();
+    CASE(SETFI) {
+      VMValue x = frame->operand_stack.pop_value();
+      VMValue y = frame->operand_stack.pop_value();
+      ensure_not_null(*frame, y);
+      heap[y.as_ref()].elements[instr->operand()->as_int()] = std::move(x);
+      NEXT();
+    }
+
+    CASE(GETFI) {
+      ensure_not_null(*frame, frame->operand_stack.top());
+      int oid = frame->operand_stack.top().as_ref();
+      frame->operand_stack.top() = heap[oid].elements[instr->operand()->as_int()];
+      NEXT();
+    }
+
+    CASE(SETI) {
+      VMValue x = frame->operand_stack.pop_value();
+      VMValue y = frame->operand_stack.pop_value();
+      VMValue z = frame->operand_stack.pop_value();
       ensure_not_null(*frame, z);
-      frame->operand_stack.pop();
+      vector<VMValue>& elements = heap[z.as_ref()].elements;
 
-      if(get<int>(y) >= array_heap[get<int>(z)].size())
+      if(y.as_int() >= elements.size())
         error("out-of-bounds array index", *frame); 
 
-      array_heap[get<int>(z)][get<int>(y)] = x; 
+      elements[y.as_int()] = std::move(x);
+      NEXT();
     }
     
-    else if (instr.opcode() == OpCode::GETI) {
-      VMValue x = frame->operand_stack.top();
-      frame->operand_stack.pop();
-      VMValue y = frame->operand_stack.top();
+    CASE(GETI) {
+      VMValue x = frame->operand_stack.pop_value();
+      VMValue y = frame->operand_stack.pop_value();
       ensure_not_null(*frame, y);
-      frame->operand_stack.pop();
+      const vector<VMValue>& elements = heap[y.as_ref()].elements;
 
-      if(get<int>(x) >= array_heap[get<int>(y)].size()){
+      if(x.as_int() >= elements.size())
         error("out-of-bounds array index", *frame);
-      }
-      else {
-        frame->operand_stack.push(array_heap[get<int>(y)][get<int>(x)]);
-      }
+
+      frame->operand_stack.push(elements[x.as_int()]);
+      NEXT();
     }
 
-    else if (instr.opcode() == OpCode::SETI2D) {
+    CASE(SETI2D) {
       //grab and pop all values from frame op stack
-      VMValue value = frame->operand_stack.top(); 
-      frame->operand_stack.pop(); 
-      VMValue column = frame->operand_stack.top(); 
-      frame->operand_stack.pop(); 
-      VMValue row = frame->operand_stack.top(); 
-      frame->operand_stack.pop(); 
-      VMValue id = frame->operand_stack.top(); 
-      frame->operand_stack.pop(); 
+      VMValue value = frame->operand_stack.pop_value();
+      VMValue column = frame->operand_stack.pop_value();
+      VMValue row = frame->operand_stack.pop_value();
+      VMValue id = frame->operand_stack.pop_value();
+      VMObject& array = heap[id.as_ref()];
 
       //for arr[i][j], the math for 1D is j + i*total columns
-      if((get<int>(column)) + (get<int>(row) * col_sizes_2D[get<int>(id)]) >= array_heap[get<int>(id)].size())
-        error("out-of-bounds 2D array index" + col_sizes_2D[get<int>(id)], *frame);
+      int index = column.as_int() + row.as_int() * array.columns;
+      if(index >= array.elements.size())
+        error("out-of-bounds 2D array index", *frame);
       
-      //assign value to 1D array heap in frame
-      array_heap[get<int>(id)][get<int>(column) + (get<int>(row) * col_sizes_2D[get<int>(id)])] = value;
+      //assign value to 1D array in the heap
+      array.elements[index] = std::move(value);
+      NEXT();
     }
 
-    else if (instr.opcode() == OpCode::GETI2D) {
+    CASE(GETI2D) {
       //grab all values from operand stack
-      VMValue column = frame->operand_stack.top(); 
-      frame->operand_stack.pop(); 
-      VMValue row = frame->operand_stack.top(); 
-      frame->operand_stack.pop(); 
-      VMValue id = frame->operand_stack.top(); 
-      frame->operand_stack.pop(); 
+      VMValue column = frame->operand_stack.pop_value();
+      VMValue row = frame->operand_stack.pop_value();
+      VMValue id = frame->operand_stack.pop_value();
+      const VMObject& array = heap[id.as_ref()];
 
       //check index in bound
-      if(get<int>(column) + (get<int>(row) * col_sizes_2D[get<int>(id)]) >= array_heap[get<int>(id)].size()) 
-        error("  out-of-bounds 2D array index" + col_sizes_2D[get<int>(id)], *frame); 
+      int index = column.as_int() + row.as_int() * array.columns;
+      if(index >= array.elements.size()) 
+        error("out-of-bounds 2D array index", *frame); 
       
-      //puhs on the frame op stack the value from arr[row][column]
-      frame->operand_stack.push(array_heap[get<int>(id)][get<int>(column) + (get<int>(row) * col_sizes_2D[get<int>(id)])]);
+      //push on the frame op stack the value from arr[row][column]
+      frame->operand_stack.push(array.elements[index]);
+      NEXT();
     }
 
     //for 2d array allocation
-    else if (instr.opcode() == OpCode::ALLOCA2D) {
+    CASE(ALLOCA2D) {
+      if (heap.bytes() >= next_gc)
+        collect();
       //grab 
-      VMValue x = frame->operand_stack.top(); 
-      frame->operand_stack.pop(); 
-      int rows = get<int>(frame->operand_stack.top()); 
+      VMValue x = frame->operand_stack.pop_value();
+      int rows = frame->operand_stack.top().as_int(); 
       frame->operand_stack.pop(); 
-      int columns = get<int>(frame->operand_stack.top()); 
+      int columns = frame->operand_stack.top().as_int(); 
       frame->operand_stack.pop(); 
 
-      //allocate a space of rows*columns in stack
-      array_heap[next_obj_id] = vector<VMValue>((columns*rows), x); 
-      //map of column sizes for a specific 2d array oid
-      col_sizes_2D[next_obj_id] = columns; 
-      frame->operand_stack.push(next_obj_id); 
-      next_obj_id++; 
+      //allocate a space of rows*columns in the heap, remembering the
+      //column count for indexing
+      int oid = heap.allocate(columns * rows, x);
+      heap[oid].columns = columns;
+      frame->operand_stack.push(VMValue::ref(oid)); 
+      NEXT();
+    }
+
+
+    //----------------------------------------------------------------------
+    // superinstructions
+    //----------------------------------------------------------------------
+
+    CASE(INCLOCAL) {
+      VMValue& x = frame->variables[instr->operand()->as_int()];
+      ensure_not_null(*frame, x);
+      x = x.as_int() + instr->operand_2().value();
+      NEXT();
+    }
+
+    CASE(LOADLOAD) {
+      frame->operand_stack.push(frame->variables[instr->operand()->as_int()]);
+      frame->operand_stack.push(frame->variables[instr->operand_2().value()]);
+      NEXT();
+    }
+
+    CASE(LOAD_GETI) {
+      ensure_not_null(*frame, frame->operand_stack.top());
+      int x = frame->variables[instr->operand()->as_int()].as_int();
+      const vector<VMValue>& elements =
+        heap[frame->operand_stack.top().as_ref()].elements;
+
+      if(x >= elements.size())
+        error("out-of-bounds array index", *frame);
+
+      frame->operand_stack.top() = elements[x];
+      NEXT();
+    }
+
+    CASE(CMPLT_JMPF) {
+      VMValue x = frame->operand_stack.pop_value();
+      ensure_not_null(*frame, x);
+      VMValue y = frame->operand_stack.pop_value();
+      ensure_not_null(*frame, y);
+      if (x.is_int() and y.is_int())
+        quicken(*instr, OpCode::CMPLT_JMPF_II);
+      if (!lt(y, x).as_bool())
+        frame->pc = instr->operand()->as_int();
+      NEXT();
+    }
+
+    CASE(CMPLE_JMPF) {
+      VMValue x = frame->operand_stack.pop_value();
+      ensure_not_null(*frame, x);
+      VMValue y = frame->operand_stack.pop_value();
+      ensure_not_null(*frame, y);
+      if (x.is_int() and y.is_int())
+        quicken(*instr, OpCode::CMPLE_JMPF_II);
+      if (!le(y, x).as_bool())
+        frame->pc = instr->operand()->as_int();
+      NEXT();
+    }
+
+    CASE(CMPGT_JMPF) {
+      VMValue x = frame->operand_stack.pop_value();
+      ensure_not_null(*frame, x);
+      VMValue y = frame->operand_stack.pop_value();
+      ensure_not_null(*frame, y);
+      if (x.is_int() and y.is_int())
+        quicken(*instr, OpCode::CMPGT_JMPF_II);
+      if (!gt(y, x).as_bool())
+        frame->pc = instr->operand()->as_int();
+      NEXT();
+    }
+
+    CASE(CMPGE_JMPF) {
+      VMValue x = frame->operand_stack.pop_value();
+      ensure_not_null(*frame, x);
+      VMValue y = frame->operand_stack.pop_value();
+      ensure_not_null(*frame, y);
+      if (x.is_int() and y.is_int())
+        quicken(*instr, OpCode::CMPGE_JMPF_II);
+      if (!ge(y, x).as_bool())
+        frame->pc = instr->operand()->as_int();
+      NEXT();
+    }
+
+    CASE(CMPEQ_JMPF) {
+      VMValue x = frame->operand_stack.pop_value();
+      VMValue y = frame->operand_stack.pop_value();
+      if (!eq(y, x).as_bool())
+        frame->pc = instr->operand()->as_int();
+      NEXT();
+    }
+
+    CASE(CMPNE_JMPF) {
+      VMValue x = frame->operand_stack.pop_value();
+      VMValue y = frame->operand_stack.pop_value();
+      if (eq(y, x).as_bool())
+        frame->pc = instr->operand()->as_int();
+      NEXT();
+    }
+
+
+    //----------------------------------------------------------------------
+    // typed operations
+    //----------------------------------------------------------------------
+
+    CASE(IADD) TYPED_BINARY(set_int, y.as_int() + x.as_int())
+    CASE(ISUB) TYPED_BINARY(set_int, y.as_int() - x.as_int())
+    CASE(IMUL) TYPED_BINARY(set_int, y.as_int() * x.as_int())
+    CASE(IDIV) TYPED_BINARY(set_int, y.as_int() / x.as_int())
+    CASE(DADD) TYPED_BINARY(set_double, y.as_double() + x.as_double())
+    CASE(DSUB) TYPED_BINARY(set_double, y.as_double() - x.as_double())
+    CASE(DMUL) TYPED_BINARY(set_double, y.as_double() * x.as_double())
+    CASE(DDIV) TYPED_BINARY(set_double, y.as_double() / x.as_double())
+    CASE(ICMPLT) TYPED_BINARY(set_bool, y.as_int() < x.as_int())
+    CASE(ICMPLE) TYPED_BINARY(set_bool, y.as_int() <= x.as_int())
+    CASE(ICMPGT) TYPED_BINARY(set_bool, y.as_int() > x.as_int())
+    CASE(ICMPGE) TYPED_BINARY(set_bool, y.as_int() >= x.as_int())
+    CASE(ICMPLT_JMPF) TYPED_COMPARE_JUMP(y.as_int() < x.as_int())
+    CASE(ICMPLE_JMPF) TYPED_COMPARE_JUMP(y.as_int() <= x.as_int())
+    CASE(ICMPGT_JMPF) TYPED_COMPARE_JUMP(y.as_int() > x.as_int())
+    CASE(ICMPGE_JMPF) TYPED_COMPARE_JUMP(y.as_int() >= x.as_int())
+
+    // null is a valid operand of == and !=
+
+    CASE(ICMPEQ) {
+      VMValue& y = frame->operand_stack.below_top();
+      y.set_bool(int_eq(y, frame->operand_stack.top()));
+      frame->operand_stack.drop();
+      NEXT();
+    }
+
+    CASE(ICMPNE) {
+      VMValue& y = frame->operand_stack.below_top();
+      y.set_bool(!int_eq(y, frame->operand_stack.top()));
+      frame->operand_stack.drop();
+      NEXT();
+    }
+
+    CASE(ICMPEQ_JMPF) {
+      bool taken = !int_eq(frame->operand_stack.below_top(),
+                           frame->operand_stack.top());
+      frame->operand_stack.drop();
+      frame->operand_stack.drop();
+      if (taken)
+        frame->pc = instr->operand()->as_int();
+      NEXT();
+    }
+
+    CASE(ICMPNE_JMPF) {
+      bool taken = int_eq(frame->operand_stack.below_top(),
+                          frame->operand_stack.top());
+      frame->operand_stack.drop();
+      frame->operand_stack.drop();
+      if (taken)
+        frame->pc = instr->operand()->as_int();
+      NEXT();
+    }
+
+
+    //----------------------------------------------------------------------
+    // quickened operations
+    //----------------------------------------------------------------------
+
+    CASE(ADD_II) QUICK_BINARY(ADD, set_int, y.as_int() + x.as_int())
+    CASE(SUB_II) QUICK_BINARY(SUB, set_int, y.as_int() - x.as_int())
+    CASE(MUL_II) QUICK_BINARY(MUL, set_int, y.as_int() * x.as_int())
+    CASE(DIV_II) QUICK_BINARY(DIV, set_int, y.as_int() / x.as_int())
+    CASE(CMPLT_II) QUICK_BINARY(CMPLT, set_bool, y.as_int() < x.as_int())
+    CASE(CMPLE_II) QUICK_BINARY(CMPLE, set_bool, y.as_int() <= x.as_int())
+    CASE(CMPGT_II) QUICK_BINARY(CMPGT, set_bool, y.as_int() > x.as_int())
+    CASE(CMPGE_II) QUICK_BINARY(CMPGE, set_bool, y.as_int() >= x.as_int())
+    CASE(CMPLT_JMPF_II) QUICK_COMPARE_JUMP(CMPLT_JMPF, y.as_int() < x.as_int())
+    CASE(CMPLE_JMPF_II) QUICK_COMPARE_JUMP(CMPLE_JMPF, y.as_int() <= x.as_int())
+    CASE(CMPGT_JMPF_II) QUICK_COMPARE_JUMP(CMPGT_JMPF, y.as_int() > x.as_int())
+    CASE(CMPGE_JMPF_II) QUICK_COMPARE_JUMP(CMPGE_JMPF, y.as_int() >= x.as_int())
+
+    CASE(GETF_IC) {
+      VMValue& x = frame->operand_stack.top();
+      ensure_not_null(*frame, x);
+      const VMObject& obj = heap[x.as_ref()];
+      if (obj.shape != instr->cached_shape()) {
+        deoptimize(*instr, OpCode::GETF);
+        RETRY();
+      }
+      x = obj.fields[instr->cached_slot()];
+      NEXT();
+    }
+
+    CASE(SETF_IC) {
+      VMValue& y = frame->operand_stack.below_top();
+      ensure_not_null(*frame, y);
+      VMObject& obj = heap[y.as_ref()];
+      if (obj.shape != instr->cached_shape()) {
+        deoptimize(*instr, OpCode::SETF);
+        RETRY();
+      }
+      obj.fields[instr->cached_slot()] = frame->operand_stack.pop_value();
+      frame->operand_stack.pop();
+      NEXT();
     }
 
 
@@ -537,131 +1061,486 @@ void VM::run(bool DEBUG)
     //----------------------------------------------------------------------
 
     
-    else if (instr.opcode() == OpCode::DUP) {
-      VMValue x = frame->operand_stack.top();
-      frame->operand_stack.pop();
+    CASE(DUP) {
+      VMValue x = frame->operand_stack.pop_value();
       frame->operand_stack.push(x);
       frame->operand_stack.push(x);      
+      NEXT();
     }
 
-    else if (instr.opcode() == OpCode::NOP) {
+    CASE(NOP) {
       // do nothing
+      NEXT();
     }
     
-    else {
-      error("unsupported operation " + to_string(instr));
-    }
+  DISPATCH_END
+}
+
+
+void VM::push_frame(VMFrameInfo& info)
+{
+  VMValue* base = value_stack.push(info.local_count + info.max_stack);
+  if (!base) {
+    if (call_stack.empty())
+      error("stack overflow");
+    error("stack overflow", call_stack.back());
+  }
+  call_stack.emplace_back();
+  VMFrame& frame = call_stack.back();
+  frame.info = &info;
+  frame.variables = base;
+  frame.operand_stack.bind(base + info.local_count, info.max_stack);
+}
+
+
+void VM::set_stack_limit(size_t values)
+{
+  value_stack.set_limit(values);
+}
+
+
+void VM::set_jit(bool enabled)
+{
+  jit = enabled;
+}
+
+
+int VM::native_instructions() const
+{
+  return native_count;
+}
+
+
+void VM::set_profiling(bool enabled)
+{
+  profiling = enabled;
+}
+
+
+VMProfile VM::profile() const
+{
+  // the opcodes are counted as the run left the instructions
+  VMProfile profile = profile_counts;
+  const vector<VMFunctionProfile>& counts = profile.function_profiles();
+  if (counts.size() != frame_info.size())
+    return profile;
+  for (int f = 0; f < frame_info.size(); ++f) {
+    const vector<VMInstr>& instructions = frame_info[f].instructions;
+    for (int i = 0; i < counts[f].hits.size(); ++i)
+      profile.count_opcode(instructions[i].opcode(), counts[f].hits[i]);
+  }
+  return profile;
+}
+
+
+void VM::compile_native_frames()
+{
+  vector<int> call_args;
+  for (const VMFrameInfo& info : frame_info)
+    call_args.push_back(info.arg_count);
+  NativeHelpers helpers;
+  helpers.write = native_write;
+  helpers.geti = native_geti;
+  helpers.seti = native_seti;
+  helpers.geti2d = native_geti2d;
+  helpers.seti2d = native_seti2d;
+  helpers.getfi = native_getfi;
+  helpers.setfi = native_setfi;
+  helpers.load_geti = native_load_geti;
+  native_count = 0;
+  for (VMFrameInfo& info : frame_info) {
+    if (!info.native)
+      info.native = compile_native(info, call_args, helpers);
+    if (info.native)
+      native_count += info.native->compiled_count();
+  }
+}
+
+
+void VM::run_native(VMFrame& frame)
+{
+  const NativeCode& code = *frame.info->native;
+  assert(frame.operand_stack.size() == code.stack_depth(frame.pc));
+  frame.pc = code.run(this, frame.variables, frame.pc);
+  frame.operand_stack.set_size(code.stack_depth(frame.pc));
+}
+
+
+// the native callbacks mirror the interpreter's instructions, but
+// return false (leaving the instruction to the interpreter) where it
+// would report an error
+
+bool VM::native_write(void*, VMValue* operands, intptr_t)
+{
+  cout << to_string(operands[0]);
+  operands[0] = nullptr;
+  return true;
+}
+
+
+bool VM::native_geti(void* vm, VMValue* operands, intptr_t)
+{
+  VMHeap& heap = static_cast<VM*>(vm)->heap;
+  VMValue& y = operands[0];
+  const VMValue& x = operands[1];
+  if (!y.is_ref() or !x.is_int())
+    return false;
+  const vector<VMValue>& elements = heap[y.as_ref()].elements;
+  if (x.as_int() < 0 or x.as_int() >= elements.size())
+    return false;
+  y = elements[x.as_int()];
+  operands[1] = nullptr;
+  return true;
+}
+
+
+bool VM::native_seti(void* vm, VMValue* operands, intptr_t)
+{
+  VMHeap& heap = static_cast<VM*>(vm)->heap;
+  const VMValue& z = operands[0];
+  const VMValue& y = operands[1];
+  if (!z.is_ref() or !y.is_int())
+    return false;
+  vector<VMValue>& elements = heap[z.as_ref()].elements;
+  if (y.as_int() < 0 or y.as_int() >= elements.size())
+    return false;
+  elements[y.as_int()] = std::move(operands[2]);
+  operands[1] = nullptr;
+  operands[0] = nullptr;
+  return true;
+}
+
+
+bool VM::native_geti2d(void* vm, VMValue* operands, intptr_t)
+{
+  VMHeap& heap = static_cast<VM*>(vm)->heap;
+  VMValue& id = operands[0];
+  const VMValue& row = operands[1];
+  const VMValue& column = operands[2];
+  if (!id.is_ref() or !row.is_int() or !column.is_int())
+    return false;
+  const VMObject& array = heap[id.as_ref()];
+  int index = column.as_int() + row.as_int() * array.columns;
+  if (index < 0 or index >= array.elements.size())
+    return false;
+  id = array.elements[index];
+  operands[2] = nullptr;
+  operands[1] = nullptr;
+  return true;
+}
+
+
+bool VM::native_seti2d(void* vm, VMValue* operands, intptr_t)
+{
+  VMHeap& heap = static_cast<VM*>(vm)->heap;
+  const VMValue& id = operands[0];
+  const VMValue& row = operands[1];
+  const VMValue& column = operands[2];
+  if (!id.is_ref() or !row.is_int() or !column.is_int())
+    return false;
+  VMObject& array = heap[id.as_ref()];
+  int index = column.as_int() + row.as_int() * array.columns;
+  if (index < 0 or index >= array.elements.size())
+    return false;
+  array.elements[index] = std::move(operands[3]);
+  operands[2] = nullptr;
+  operands[1] = nullptr;
+  operands[0] = nullptr;
+  return true;
+}
+
+
+bool VM::native_getfi(void* vm, VMValue* operands, intptr_t arg)
+{
+  VMHeap& heap = static_cast<VM*>(vm)->heap;
+  VMValue& x = operands[0];
+  if (!x.is_ref())
+    return false;
+  x = heap[x.as_ref()].elements[arg];
+  return true;
+}
+
+
+bool VM::native_setfi(void* vm, VMValue* operands, intptr_t arg)
+{
+  VMHeap& heap = static_cast<VM*>(vm)->heap;
+  VMValue& y = operands[0];
+  if (!y.is_ref())
+    return false;
+  heap[y.as_ref()].elements[arg] = std::move(operands[1]);
+  y = nullptr;
+  return true;
+}
+
+
+bool VM::native_load_geti(void* vm, VMValue* operands, intptr_t arg)
+{
+  VMHeap& heap = static_cast<VM*>(vm)->heap;
+  VMValue& y = operands[0];
+  const VMValue& x = *reinterpret_cast<const VMValue*>(arg);
+  if (!y.is_ref() or !x.is_int())
+    return false;
+  const vector<VMValue>& elements = heap[y.as_ref()].elements;
+  if (x.as_int() < 0 or x.as_int() >= elements.size())
+    return false;
+  y = elements[x.as_int()];
+  return true;
+}
+
+
+void VM::set_sampling(uint64_t interval, bool timer)
+{
+  sample_interval = interval;
+  sample_timer = timer;
+}
+
+
+const VMStackSamples& VM::samples() const
+{
+  return stack_samples;
+}
+
+
+void VM::sample()
+{
+  sample_countdown = sample_timer ? TIMER_POLL : sample_interval;
+  if (sample_timer) {
+    if (!sample_timer_fired)
+      return;
+    sample_timer_fired = 0;
   }
+  // each frame's pc is just past its running (or calling) instruction
+  vector<pair<int, int>> stack;
+  for (const VMFrame& frame : call_stack)
+    stack.push_back({int(frame.info - frame_info.data()), frame.pc - 1});
+  stack_samples.add(stack);
+}
+
+
+void VM::trace(const VMFrame& frame, const VMInstr& instr) const
+{
+  cerr << endl << endl;
+  cerr << "\t FRAME.........: " << frame.info->function_name << endl;
+  cerr << "\t PC............: " << (frame.pc - 1) << endl;
+  cerr << "\t INSTR.........: " << to_string(instr) << endl;
+  cerr << "\t NEXT OPERAND..: ";
+  if (!frame.operand_stack.empty())
+    cerr << to_string(frame.operand_stack.top()) << endl;
+  else
+    cerr << "empty" << endl;
+  cerr << "\t NEXT FUNCTION.: ";
+  if (!call_stack.empty())
+    cerr << call_stack.back().info->function_name << endl;
+  else
+    cerr << "empty" << endl;
+}
+
+
+uint64_t VM::instructions_retired() const
+{
+  return retired_count;
+}
+
+
+void VM::set_gc_threshold(size_t bytes, double growth)
+{
+  gc_threshold = bytes;
+  gc_growth = growth;
+  next_gc = max(gc_threshold, heap.bytes());
+}
+
+
+void VM::collect()
+{
+  auto start = chrono::steady_clock::now();
+  // the roots are the variables and operands of every running frame
+  for (const VMFrame& frame : call_stack) {
+    for (int i = 0; i < frame.info->local_count; ++i)
+      heap.mark(frame.variables[i]);
+    for (int i = 0; i < frame.operand_stack.size(); ++i)
+      heap.mark(frame.operand_stack[i]);
+  }
+  heap.sweep(gc);
+  next_gc = max(gc_threshold, size_t(heap.bytes() * gc_growth));
+  double pause = chrono::duration<double, milli>(
+    chrono::steady_clock::now() - start).count();
+  ++gc.collections;
+  gc.total_pause += pause;
+  gc.max_pause = max(gc.max_pause, pause);
+}
+
+
+const VMGCStats& VM::gc_stats() const
+{
+  return gc;
+}
+
+
+bool VM::quicken(VMInstr& instr, OpCode op)
+{
+  if (!quickening or instr.deopt_count() >= MAX_DEOPTS)
+    return false;
+  instr.set_opcode(op);
+  ++quicken_counts.quickened;
+  return true;
+}
+
+
+void VM::deoptimize(VMInstr& instr, OpCode op)
+{
+  instr.set_opcode(op);
+  instr.count_deopt();
+  ++quicken_counts.deoptimized;
+}
+
+
+void VM::set_quickening(bool enabled)
+{
+  quickening = enabled;
+}
+
+
+const VMQuickenStats& VM::quicken_stats() const
+{
+  return quicken_counts;
+}
+
+
+int VM::quickened_sites() const
+{
+  int count = 0;
+  for (const VMFrameInfo& frame : frame_info)
+    for (const VMInstr& instr : frame.instructions)
+      if (instr.opcode() >= OpCode::ADD_II and instr.opcode() <= OpCode::SETF_IC)
+        ++count;
+  return count;
 }
 
 
 void VM::ensure_not_null(const VMFrame& f, const VMValue& x) const
 {
-  if (holds_alternative<nullptr_t>(x))
+  if (x.is_null())
+    error("null reference", f);
+}
+
+
+void VM::ensure_not_null(const VMFrame& f, const VMValue& x,
+                         const VMValue& y) const
+{
+  if (x.is_null() or y.is_null())
     error("null reference", f);
 }
 
 
 VMValue VM::add(const VMValue& x, const VMValue& y) const
 {
-  if (holds_alternative<int>(x)) 
-    return get<int>(x) + get<int>(y);
+  if (x.is_int()) 
+    return x.as_int() + y.as_int();
   else
-    return get<double>(x) + get<double>(y);
+    return x.as_double() + y.as_double();
 }
 
 // TODO: Finish the rest of the following arithmetic operators
 
 VMValue VM::sub(const VMValue& x, const VMValue& y) const
 {
-  if (holds_alternative<int>(x))
-    return get<int>(x) - get<int>(y);
+  if (x.is_int())
+    return x.as_int() - y.as_int();
   else 
-    return get<double>(x) - get<double>(y); 
+    return x.as_double() - y.as_double(); 
 }
 
 VMValue VM::mul(const VMValue& x, const VMValue& y) const
 {
-  if (holds_alternative<int>(x))
-    return get<int>(x) * get<int>(y);
+  if (x.is_int())
+    return x.as_int() * y.as_int();
   else 
-    return get<double>(x) * get<double>(y); 
+    return x.as_double() * y.as_double(); 
 }
 
 VMValue VM::div(const VMValue& x, const VMValue& y) const
 {
-  if (holds_alternative<int>(x))
-    return get<int>(x) / get<int>(y);
+  if (x.is_int())
+    return x.as_int() / y.as_int();
   else 
-    return get<double>(x) / get<double>(y); 
+    return x.as_double() / y.as_double(); 
 }
 
 
 VMValue VM::eq(const VMValue& x, const VMValue& y) const
 {
-  if (holds_alternative<nullptr_t>(x) and not holds_alternative<nullptr_t>(y)) 
+  if (x.is_null() and not y.is_null()) 
     return false;
-  else if (not holds_alternative<nullptr_t>(x) and holds_alternative<nullptr_t>(y))
+  else if (not x.is_null() and y.is_null())
     return false;
-  else if (holds_alternative<nullptr_t>(x) and holds_alternative<nullptr_t>(y))
+  else if (x.is_null() and y.is_null())
     return true;
-  else if (holds_alternative<int>(x)) 
-    return get<int>(x) == get<int>(y);
-  else if (holds_alternative<double>(x))
-    return get<double>(x) == get<double>(y);
-  else if (holds_alternative<string>(x))
-    return get<string>(x) == get<string>(y);
+  else if (x.is_int()) 
+    return x.as_int() == y.as_int();
+  else if (x.is_double())
+    return x.as_double() == y.as_double();
+  else if (x.is_string())
+    return x.as_string() == y.as_string();
+  else if (x.is_ref())
+    return x.as_ref() == y.as_ref();
   else
-    return get<bool>(x) == get<bool>(y);
+    return x.as_bool() == y.as_bool();
+}
+
+bool VM::int_eq(const VMValue& x, const VMValue& y) const
+{
+  if (x.is_null() or y.is_null())
+    return x.is_null() and y.is_null();
+  return x.as_int() == y.as_int();
 }
 
 // TODO: Finish the rest of the comparison operators
 
 VMValue VM::lt(const VMValue& x, const VMValue& y) const
 {
-  if (holds_alternative<int>(x)) 
-    return get<int>(x) < get<int>(y);
-  else if (holds_alternative<double>(x))
-    return get<double>(x) < get<double>(y);
-  else if (holds_alternative<string>(x))
-    return get<string>(x) < get<string>(y);
+  if (x.is_int()) 
+    return x.as_int() < y.as_int();
+  else if (x.is_double())
+    return x.as_double() < y.as_double();
+  else if (x.is_string())
+    return x.as_string() < y.as_string();
   else
-    return get<bool>(x) < get<bool>(y);
+    return x.as_bool() < y.as_bool();
 }
 
 VMValue VM::le(const VMValue& x, const VMValue& y) const
 {
-  if (holds_alternative<int>(x)) 
-    return get<int>(x) <= get<int>(y);
-  else if (holds_alternative<double>(x))
-    return get<double>(x) <= get<double>(y);
-  else if (holds_alternative<string>(x))
-    return get<string>(x) <= get<string>(y);
+  if (x.is_int()) 
+    return x.as_int() <= y.as_int();
+  else if (x.is_double())
+    return x.as_double() <= y.as_double();
+  else if (x.is_string())
+    return x.as_string() <= y.as_string();
   else
-    return get<bool>(x) <= get<bool>(y);
+    return x.as_bool() <= y.as_bool();
 }
 
 VMValue VM::gt(const VMValue& x, const VMValue& y) const
 {
-  if (holds_alternative<int>(x)) 
-    return get<int>(x) > get<int>(y);
-  else if (holds_alternative<double>(x))
-    return get<double>(x) > get<double>(y);
-  else if (holds_alternative<string>(x))
-    return get<string>(x) > get<string>(y);
+  if (x.is_int()) 
+    return x.as_int() > y.as_int();
+  else if (x.is_double())
+    return x.as_double() > y.as_double();
+  else if (x.is_string())
+    return x.as_string() > y.as_string();
   else
-    return get<bool>(x) > get<bool>(y);
+    return x.as_bool() > y.as_bool();
 }
 
 VMValue VM::ge(const VMValue& x, const VMValue& y) const
 {
-  if (holds_alternative<int>(x)) 
-    return get<int>(x) >= get<int>(y);
-  else if (holds_alternative<double>(x))
-    return get<double>(x) >= get<double>(y);
-  else if (holds_alternative<string>(x))
-    return get<string>(x) >= get<string>(y);
+  if (x.is_int()) 
+    return x.as_int() >= y.as_int();
+  else if (x.is_double())
+    return x.as_double() >= y.as_double();
+  else if (x.is_string())
+    return x.as_string() >= y.as_string();
   else
-    return get<bool>(x) >= get<bool>(y);
+    return x.as_bool() >= y.as_bool();
 }
 
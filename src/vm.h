@@ -8,13 +8,25 @@
 #ifndef VM_H
 #define VM_H
 
-#include <memory>
-#include <stack>
+#include <cstdint>
 #include <string>
 #include <unordered_map>
 #include <vector>
 #include "vm_instr.h"
 #include "vm_frame.h"
+#include "vm_heap.h"
+#include "jit.h"
+#include "vm_profile.h"
+
+
+// Runtime quickening statistics: the number of times an instruction
+// was rewritten into a quickened form, and back to its generic form
+class VMQuickenStats
+{
+public:
+  uint64_t quickened = 0;
+  uint64_t deoptimized = 0;
+};
 
 
 class VM
@@ -24,31 +36,162 @@ public:
   // add a new frame type to the vm
   void add(const VMFrameInfo& frame);
 
-  // run the virtual machine
+  // resolve each CALL operand from a function name to a function id
+  // (throws a mypl exception for undefined functions)
+  void link();
+
+  // run the virtual machine (linking first if needed)
   void run(bool DEBUG = false);
 
   // to print the instructions for each VM frame
   friend std::string to_string(const VM& vm);
 
-  
-private:
+  // total number of instructions executed by completed runs
+  uint64_t instructions_retired() const;
+
+  // collect garbage once the heap has grown to bytes, and after each
+  // collection wait until it reaches growth times the bytes still in
+  // use (or bytes, whichever is larger)
+  void set_gc_threshold(size_t bytes, double growth = 2.0);
+
+  // free every heap object the running frames can no longer reach
+  void collect();
 
-  // heap for struct objects mapping oid's to field values
-  std::unordered_map<int, std::unordered_map<std::string, VMValue>> struct_heap;
+  // garbage collection statistics
+  const VMGCStats& gc_stats() const;
 
-  // heap for array objects
-  std::unordered_map<int, std::vector<VMValue>> array_heap;
+  // turn runtime quickening on or off (it is on by default)
+  void set_quickening(bool enabled);
 
-  std::unordered_map<int, int> col_sizes_2D;  //size of 2d column sizes
+  // quickening statistics, and the number of instructions currently
+  // in quickened form
+  const VMQuickenStats& quicken_stats() const;
+  int quickened_sites() const;
 
-  // next available object id 
-  int next_obj_id = 2023;
+  // turn the jit on or off (it is off by default). With the jit on,
+  // run compiles each function to machine code where supported, and
+  // the interpreter enters it at calls, returns, and loop back edges.
+  // Instructions run as machine code are not counted as retired.
+  void set_jit(bool enabled);
 
-  // collection of frame "templates" identified by function name
-  std::unordered_map<std::string, VMFrameInfo> frame_info;
+  // the number of instructions compiled to machine code by the last
+  // run
+  int native_instructions() const;
 
-  // VM function call stack
-  std::stack<std::shared_ptr<VMFrame>> call_stack;
+  // turn profiling on or off (it is off by default). With profiling
+  // on, run counts the instructions, opcodes, and calls it executes
+  // and times each function, and the instruction listing shows how
+  // often each instruction ran. Profiled runs do not use the jit.
+  void set_profiling(bool enabled);
+
+  // the counts of the last profiled run
+  VMProfile profile() const;
+
+  // turn call stack sampling on or off (with an interval of 0, the
+  // default). Run samples the call stack every interval instructions,
+  // or with timer set, about every interval microseconds of cpu time.
+  // Sampled runs do not use the jit.
+  void set_sampling(uint64_t interval, bool timer = false);
+
+  // the call stacks sampled by the last sampled run
+  const VMStackSamples& samples() const;
+
+  // the most values (variables and operands) the running frames may
+  // hold together (VMValueStack::DEFAULT_LIMIT unless set), past which
+  // a call is a stack overflow
+  void set_stack_limit(size_t values);
+
+private:
+
+  // struct and array objects indexed by oid
+  VMHeap heap;
+
+  // garbage collection settings, trigger point, and statistics
+  size_t gc_threshold = 1 << 20;
+  double gc_growth = 2.0;
+  size_t next_gc = 1 << 20;
+  VMGCStats gc;
+
+  // quickening setting and statistics (an instruction deoptimized
+  // MAX_DEOPTS times stays generic)
+  bool quickening = true;
+  static const int MAX_DEOPTS = 2;
+  VMQuickenStats quicken_counts;
+
+  // jit setting, and the number of instructions compiled
+  bool jit = false;
+  int native_count = 0;
+
+  // profiling setting, and the counts of the last profiled run
+  bool profiling = false;
+  VMProfile profile_counts;
+
+  // sampling settings, the instructions left until the next sample
+  // (or, with the timer, until the timer is next checked), and the
+  // samples of the last sampled run
+  uint64_t sample_interval = 0;
+  bool sample_timer = false;
+  static const int TIMER_POLL = 1000;
+  uint64_t sample_countdown = 0;
+  VMStackSamples stack_samples;
+
+  // collection of frame "templates" indexed by function id in the
+  // order added (frames are not added while running, so running
+  // frames point directly at them)
+  std::vector<VMFrameInfo> frame_info;
+
+  // function name to function id
+  std::unordered_map<std::string, int> frame_ids;
+
+  // true if every CALL operand is a function id
+  bool linked = false;
+
+  // VM function call stack (frames are reused in place, so calls and
+  // returns do not allocate once the stack has reached its deepest)
+  std::vector<VMFrame> call_stack;
+
+  // the variables and operand stack of every active frame, with each
+  // new frame's block starting just above its caller's operands
+  VMValueStack value_stack;
+
+  // instructions executed so far (updated when run returns)
+  uint64_t retired_count = 0;
+
+  // helper function to push a new frame for the given function onto
+  // the call stack (throws a mypl exception on stack overflow)
+  void push_frame(VMFrameInfo& info);
+
+  // helper functions to rewrite a generic instruction in place to the
+  // quickened op (returning false if quickening is off or the
+  // instruction has been deoptimized too often), and to restore the
+  // generic op when a quickened instruction's guard fails
+  bool quicken(VMInstr& instr, OpCode op);
+  void deoptimize(VMInstr& instr, OpCode op);
+
+  // helper function to compile every frame to machine code
+  void compile_native_frames();
+
+  // helper function to run the frame's machine code from its pc,
+  // leaving the frame at the instruction the code exited at
+  void run_native(VMFrame& frame);
+
+  // the callbacks of the native code (see jit.h), which run an
+  // instruction on its operands in place
+  static bool native_write(void* vm, VMValue* operands, intptr_t arg);
+  static bool native_geti(void* vm, VMValue* operands, intptr_t arg);
+  static bool native_seti(void* vm, VMValue* operands, intptr_t arg);
+  static bool native_geti2d(void* vm, VMValue* operands, intptr_t arg);
+  static bool native_seti2d(void* vm, VMValue* operands, intptr_t arg);
+  static bool native_getfi(void* vm, VMValue* operands, intptr_t arg);
+  static bool native_setfi(void* vm, VMValue* operands, intptr_t arg);
+  static bool native_load_geti(void* vm, VMValue* operands, intptr_t arg);
+
+  // helper function to sample the call stack (if the timer, when
+  // used, has fired) and restart the countdown
+  void sample();
+
+  // helper function to print the debug state before an instruction
+  void trace(const VMFrame& frame, const VMInstr& instr) const;
 
   // helper functions to report VM errors
   void error(std::string msg) const;
@@ -56,6 +199,8 @@ private:
 
   // helper function to check for null values (throws mypl exception)
   void ensure_not_null(const VMFrame& f, const VMValue& x) const;
+  void ensure_not_null(const VMFrame& f, const VMValue& x,
+                       const VMValue& y) const;
 
   // operation support helper functions
   VMValue add(const VMValue& x, const VMValue& y) const;
@@ -68,6 +213,9 @@ private:
   VMValue ge(const VMValue& x, const VMValue& y) const;  
   VMValue eq(const VMValue& x, const VMValue& y) const;  
 
+  // equality of int (or null) values, for the typed comparisons
+  bool int_eq(const VMValue& x, const VMValue& y) const;
+
 };
 
 #endif
@@ -0,0 +1,232 @@
+//----------------------------------------------------------------------
+// FILE: vm_frame.cpp
+// DATE: Spring 2023
+// AUTH: Nisa Meshal
+// DESC: VM frame helpers (operand stack depth and variable analysis)
+//----------------------------------------------------------------------
+
+#include <algorithm>
+#include "vm_frame.h"
+
+using namespace std;
+
+
+void stack_effect(OpCode op, int& pops, int& pushes)
+{
+  pops = 0;
+  pushes = 0;
+  switch (op) {
+  case OpCode::PUSH: case OpCode::LOAD: case OpCode::READ:
+  case OpCode::ALLOCS: case OpCode::CALL:
+    pushes = 1;
+    break;
+  case OpCode::LOADLOAD:
+    pushes = 2;
+    break;
+  case OpCode::POP: case OpCode::STORE: case OpCode::JMPF:
+  case OpCode::RET: case OpCode::WRITE: case OpCode::ADDF:
+    pops = 1;
+    break;
+  case OpCode::NOT: case OpCode::SLEN: case OpCode::ALEN:
+  case OpCode::TOINT: case OpCode::TODBL: case OpCode::TOSTR:
+  case OpCode::GETF: case OpCode::GETFI: case OpCode::LOAD_GETI:
+  case OpCode::GETF_IC:
+    pops = 1;
+    pushes = 1;
+    break;
+  case OpCode::ADD: case OpCode::SUB: case OpCode::MUL: case OpCode::DIV:
+  case OpCode::AND: case OpCode::OR: case OpCode::CMPLT:
+  case OpCode::CMPLE: case OpCode::CMPGT: case OpCode::CMPGE:
+  case OpCode::CMPEQ: case OpCode::CMPNE: case OpCode::GETC:
+  case OpCode::CONCAT: case OpCode::ALLOCA: case OpCode::GETI:
+  case OpCode::IADD: case OpCode::ISUB: case OpCode::IMUL: case OpCode::IDIV:
+  case OpCode::DADD: case OpCode::DSUB: case OpCode::DMUL: case OpCode::DDIV:
+  case OpCode::ICMPLT: case OpCode::ICMPLE: case OpCode::ICMPGT:
+  case OpCode::ICMPGE: case OpCode::ICMPEQ: case OpCode::ICMPNE:
+  case OpCode::ADD_II: case OpCode::SUB_II: case OpCode::MUL_II:
+  case OpCode::DIV_II: case OpCode::CMPLT_II: case OpCode::CMPLE_II:
+  case OpCode::CMPGT_II: case OpCode::CMPGE_II:
+    pops = 2;
+    pushes = 1;
+    break;
+  case OpCode::ALLOCA2D: case OpCode::GETI2D:
+    pops = 3;
+    pushes = 1;
+    break;
+  case OpCode::SETF: case OpCode::SETFI: case OpCode::CMPLT_JMPF:
+  case OpCode::CMPLE_JMPF: case OpCode::CMPGT_JMPF: case OpCode::CMPGE_JMPF:
+  case OpCode::CMPEQ_JMPF: case OpCode::CMPNE_JMPF: case OpCode::ICMPLT_JMPF:
+  case OpCode::ICMPLE_JMPF: case OpCode::ICMPGT_JMPF: case OpCode::ICMPGE_JMPF:
+  case OpCode::ICMPEQ_JMPF: case OpCode::ICMPNE_JMPF: case OpCode::SETF_IC:
+  case OpCode::CMPLT_JMPF_II: case OpCode::CMPLE_JMPF_II:
+  case OpCode::CMPGT_JMPF_II: case OpCode::CMPGE_JMPF_II:
+    pops = 2;
+    break;
+  case OpCode::SETI:
+    pops = 3;
+    break;
+  case OpCode::SETI2D:
+    pops = 4;
+    break;
+  case OpCode::DUP:
+    pops = 1;
+    pushes = 2;
+    break;
+  case OpCode::JMP: case OpCode::NOP: case OpCode::INCLOCAL:
+    break;
+  }
+}
+
+
+vector<int> stack_depths(const VMFrameInfo& frame,
+                         const vector<int>& call_args, bool& exact)
+{
+  const vector<VMInstr>& instrs = frame.instructions;
+  int n = instrs.size();
+  // code from the generator reaches each instruction at a single
+  // depth, so only the first visit is followed
+  vector<int> depth(n + 1, -1);
+  vector<int> work;
+  exact = true;
+  depth[0] = frame.arg_count;
+  if (n > 0)
+    work.push_back(0);
+  while (!work.empty()) {
+    int pc = work.back();
+    work.pop_back();
+    const VMInstr& instr = instrs[pc];
+    int pops, pushes;
+    stack_effect(instr.opcode(), pops, pushes);
+    if (instr.opcode() == OpCode::CALL and !call_args.empty() and
+        instr.operand()->is_int())
+      pops = call_args[instr.operand()->as_int()];
+    if (pops > depth[pc])
+      exact = false;
+    int after = max(depth[pc] - pops, 0) + pushes;
+    // successors of the instruction
+    int succs[2];
+    int count = 0;
+    if (instr.opcode() == OpCode::JMP)
+      succs[count++] = instr.operand().value().as_int();
+    else if (instr.opcode() != OpCode::RET) {
+      succs[count++] = pc + 1;
+      if (instr.is_jump())
+        succs[count++] = instr.operand().value().as_int();
+    }
+    for (int i = 0; i < count; ++i) {
+      int next = succs[i];
+      if (next < 0 or next > n)
+        continue;
+      if (depth[next] == -1) {
+        depth[next] = after;
+        if (next < n)
+          work.push_back(next);
+      }
+      else if (depth[next] != after)
+        exact = false;
+    }
+  }
+  return depth;
+}
+
+
+int max_stack_depth(const VMFrameInfo& frame)
+{
+  bool exact;
+  vector<int> depth = stack_depths(frame, {}, exact);
+  int max_depth = frame.arg_count;
+  for (int pc = 0; pc < frame.instructions.size(); ++pc) {
+    if (depth[pc] == -1)
+      continue;
+    int pops, pushes;
+    stack_effect(frame.instructions[pc].opcode(), pops, pushes);
+    max_depth = max(max_depth, max(depth[pc] - pops, 0) + pushes);
+  }
+  return max_depth;
+}
+
+
+int count_locals(const VMFrameInfo& frame)
+{
+  int count = 0;
+  for (const VMInstr& instr : frame.instructions) {
+    OpCode op = instr.opcode();
+    if (op == OpCode::LOAD or op == OpCode::STORE or op == OpCode::INCLOCAL or
+        op == OpCode::LOADLOAD or op == OpCode::LOAD_GETI)
+      count = max(count, instr.operand().value().as_int() + 1);
+    if (op == OpCode::LOADLOAD)
+      count = max(count, instr.operand_2().value() + 1);
+  }
+  return count;
+}
+
+
+void VMValueStack::set_limit(size_t values)
+{
+  max_values = values;
+}
+
+
+size_t VMValueStack::limit() const
+{
+  return max_values;
+}
+
+
+VMValue* VMValueStack::push(int size)
+{
+  if (current >= 0 and top + size <= chunks[current].values.data() +
+      chunks[current].values.size()) {
+    VMValue* block = top;
+    top += size;
+    return block;
+  }
+  // continue in the next chunk, replacing it if the block is too big
+  int next = current + 1;
+  int count = chunks.size();
+  if (next < count and chunks[next].values.size() < size_t(size)) {
+    for (int i = next; i < count; ++i)
+      reserved_values -= chunks[i].values.size();
+    chunks.resize(next);
+  }
+  if (next == int(chunks.size())) {
+    if (reserved_values >= max_values)
+      return nullptr;
+    size_t chunk_size = max(size_t(size), min(CHUNK_SIZE,
+                                              max_values - reserved_values));
+    if (reserved_values + chunk_size > max_values)
+      return nullptr;
+    chunks.emplace_back();
+    chunks.back().values.resize(chunk_size);
+    reserved_values += chunk_size;
+  }
+  if (current >= 0)
+    chunks[current].resume = top;
+  current = next;
+  top = chunks[current].values.data() + size;
+  return chunks[current].values.data();
+}
+
+
+void VMValueStack::pop(VMValue* block)
+{
+  if (current > 0 and block == chunks[current].values.data()) {
+    --current;
+    top = chunks[current].resume;
+  }
+  else
+    top = block;
+}
+
+
+void VMValueStack::clear()
+{
+  current = -1;
+  top = nullptr;
+}
+
+
+size_t VMValueStack::reserved() const
+{
+  return reserved_values;
+}
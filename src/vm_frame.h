@@ -9,12 +9,17 @@
 #ifndef VM_FRAME_H
 #define VM_FRAME_H
 
-#include <stack>
+#include <cassert>
+#include <cstddef>
+#include <memory>
 #include <string>
 #include <vector>
 #include "vm_instr.h"
 
 
+// native (machine) code compiled from a frame's instructions (see jit.h)
+class NativeCode;
+
 // The following are plain-old-data classes
 
 
@@ -31,6 +36,166 @@ public:
   // the program instructions
   std::vector<VMInstr> instructions;  
 
+  // the maximum operand stack depth reached by the instructions
+  // (computed when the frame is added to the vm if left negative)
+  int max_stack = -1;
+
+  // the number of variable slots used by the instructions (computed
+  // when the frame is added to the vm if left negative)
+  int local_count = -1;
+
+  // the instructions compiled to machine code (set by the vm when
+  // running with the jit on, otherwise null)
+  std::shared_ptr<const NativeCode> native;
+
+};
+
+
+// Fixed capacity operand stack sized from VMFrameInfo::max_stack. The
+// values live in the vm's shared value stack; the operand stack only
+// records where its block starts. Bounds are only checked (by assert)
+// in debug builds.
+class VMOperandStack
+{
+public:
+
+  // use the capacity values starting at base as the (empty) stack
+  void bind(VMValue* base, int capacity)
+  {
+    values = base;
+    count = 0;
+    limit = capacity;
+  }
+
+  void push(const VMValue& value)
+  {
+    assert(count < limit);
+    values[count++] = value;
+  }
+
+  void push(VMValue&& value)
+  {
+    assert(count < limit);
+    values[count++] = std::move(value);
+  }
+
+  VMValue& top()
+  {
+    assert(count > 0);
+    return values[count - 1];
+  }
+
+  const VMValue& top() const
+  {
+    assert(count > 0);
+    return values[count - 1];
+  }
+
+  void pop()
+  {
+    assert(count > 0);
+    values[--count] = nullptr;
+  }
+
+  // pop the top value and return it (without copying it)
+  VMValue pop_value()
+  {
+    assert(count > 0);
+    return std::move(values[--count]);
+  }
+
+  // pop a top value known not to hold a string
+  void drop()
+  {
+    assert(count > 0);
+    values[--count].set_null();
+  }
+
+  // pop every remaining value
+  void clear()
+  {
+    while (count > 0)
+      values[--count] = nullptr;
+  }
+
+  // the value just below the top
+  VMValue& below_top()
+  {
+    assert(count > 1);
+    return values[count - 2];
+  }
+
+  // the value i places up from the bottom of the stack
+  const VMValue& operator[](int i) const
+  {
+    assert(i >= 0 and i < count);
+    return values[i];
+  }
+
+  // set the number of values on the stack (for native code, which
+  // pushes and pops the values in place without updating the count)
+  void set_size(int size)
+  {
+    assert(size >= 0 and size <= limit);
+    count = size;
+  }
+
+  bool empty() const {return count == 0;}
+
+  int size() const {return count;}
+
+private:
+
+  VMValue* values = nullptr;
+  int count = 0;
+  int limit = 0;
+
+};
+
+
+// The values of every running frame, handed out in blocks that are
+// released in the reverse order. The stack grows a chunk at a time (a
+// block never spans two chunks) up to a limit, and never moves a block,
+// so frames point directly at their values.
+class VMValueStack
+{
+public:
+
+  // the default limit (in values), and the values per chunk
+  static constexpr size_t DEFAULT_LIMIT = size_t(1) << 25;
+  static constexpr size_t CHUNK_SIZE = size_t(1) << 16;
+
+  // the most values the chunks may hold in total
+  void set_limit(size_t values);
+  size_t limit() const;
+
+  // the block of size values above the last block pushed (null if the
+  // stack would grow past its limit)
+  VMValue* push(int size);
+
+  // release the last block pushed (block), and every block, without
+  // freeing any chunks
+  void pop(VMValue* block);
+  void clear();
+
+  // the number of values allocated for the chunks
+  size_t reserved() const;
+
+private:
+
+  // (the values of a chunk stay in place as chunks are added)
+  struct Chunk {
+    std::vector<VMValue> values;
+    // the top of the stack when the next chunk was started
+    VMValue* resume = nullptr;
+  };
+
+  std::vector<Chunk> chunks;
+  int current = -1;
+  VMValue* top = nullptr;
+  size_t max_values = DEFAULT_LIMIT;
+  size_t reserved_values = 0;
+
 };
 
 
@@ -38,18 +203,44 @@ class VMFrame
 {
 public:
 
-  // the type of the current frame
-  VMFrameInfo info;
+  // the type of the current frame (shared with every other frame of
+  // the same function and owned by the vm, which may quicken its
+  // instructions in place)
+  VMFrameInfo* info = nullptr;
   
   // the program counter
   int pc = 0;
 
-  // the internal memory of the function
-  std::vector<VMValue> variables;
+  // the internal memory of the function (VMFrameInfo::local_count
+  // slots of the vm's shared value stack, just below the operands)
+  VMValue* variables = nullptr;
 
   // the operand stack
-  std::stack<VMValue> operand_stack;
+  VMOperandStack operand_stack;
 
 };
 
+
+// gets the number of values an instruction pops and pushes (calls are
+// treated as popping nothing, which can only overestimate)
+void stack_effect(OpCode op, int& pops, int& pushes);
+
+// returns the operand stack depth on entry to each instruction, and
+// past the last one (-1 if unreachable), where a CALL of function id f
+// pops call_args[f] values (or nothing if call_args is empty). Sets
+// exact to false if an instruction pops more values than the stack
+// holds or is reached at two different depths (only the first of
+// which is kept).
+std::vector<int> stack_depths(const VMFrameInfo& frame,
+                              const std::vector<int>& call_args,
+                              bool& exact);
+
+// returns the maximum operand stack depth the frame's instructions can
+// reach, starting from the arguments pushed by the caller
+int max_stack_depth(const VMFrameInfo& frame);
+
+// returns the number of variable slots the frame's instructions use
+// (one past the largest variable address an instruction uses)
+int count_locals(const VMFrameInfo& frame);
+
 #endif
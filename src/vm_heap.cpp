@@ -0,0 +1,135 @@
+//----------------------------------------------------------------------
+// FILE: vm_heap.cpp
+// DATE: Spring 2023
+// AUTH: Nisa Meshal
+// DESC: Object table and mark and sweep collector implementation
+//----------------------------------------------------------------------
+
+#include <algorithm>
+#include "vm_heap.h"
+
+using namespace std;
+
+
+int VMHeap::allocate(int size, const VMValue& fill)
+{
+  int oid;
+  if (!free_oids.empty()) {
+    oid = free_oids.back();
+    free_oids.pop_back();
+  }
+  else {
+    objects.emplace_back();
+    oid = BASE_OID + objects.size() - 1;
+  }
+  VMObject& obj = (*this)[oid];
+  obj.elements.assign(size, fill);
+  obj.live = true;
+  used_bytes += object_bytes(obj);
+  return oid;
+}
+
+
+void VMHeap::free(int oid)
+{
+  // replace with an empty object to give back the storage
+  used_bytes -= min(used_bytes, object_bytes((*this)[oid]));
+  (*this)[oid] = VMObject();
+  free_oids.push_back(oid);
+}
+
+
+int VMHeap::field_slot(int shape, const string& name) const
+{
+  // structs have few fields, so a scan is as fast as a lookup
+  const vector<string>& names = shapes[shape].names;
+  for (int i = 0; i < names.size(); ++i)
+    if (names[i] == name)
+      return i;
+  return -1;
+}
+
+
+int VMHeap::add_field(VMObject& obj, const string& name)
+{
+  auto [entry, added] = shapes[obj.shape].transitions.try_emplace(name,
+                                                                  shapes.size());
+  int next = entry->second;
+  if (added) {
+    VMShape shape;
+    shape.names = shapes[obj.shape].names;
+    shape.names.push_back(name);
+    shapes.push_back(std::move(shape));
+  }
+  obj.shape = next;
+  obj.fields.push_back(nullptr);
+  used_bytes += sizeof(VMValue);
+  return obj.fields.size() - 1;
+}
+
+
+int VMHeap::size() const
+{
+  return objects.size() - free_oids.size();
+}
+
+
+size_t VMHeap::bytes() const
+{
+  return used_bytes;
+}
+
+
+void VMHeap::mark(const VMValue& value)
+{
+  if (!value.is_ref() or (*this)[value.as_ref()].marked)
+    return;
+  (*this)[value.as_ref()].marked = true;
+  mark_stack.push_back(value.as_ref());
+  // mark iteratively so long lists don't overflow the native stack
+  while (!mark_stack.empty()) {
+    VMObject& obj = (*this)[mark_stack.back()];
+    mark_stack.pop_back();
+    for (const VMValue& val : obj.elements) {
+      if (val.is_ref() and !(*this)[val.as_ref()].marked) {
+        (*this)[val.as_ref()].marked = true;
+        mark_stack.push_back(val.as_ref());
+      }
+    }
+    for (const VMValue& val : obj.fields) {
+      if (val.is_ref() and !(*this)[val.as_ref()].marked) {
+        (*this)[val.as_ref()].marked = true;
+        mark_stack.push_back(val.as_ref());
+      }
+    }
+  }
+}
+
+
+void VMHeap::sweep(VMGCStats& stats)
+{
+  used_bytes = 0;
+  for (int i = 0; i < objects.size(); ++i) {
+    VMObject& obj = objects[i];
+    if (!obj.live)
+      continue;
+    size_t obj_bytes = object_bytes(obj);
+    if (obj.marked) {
+      obj.marked = false;
+      used_bytes += obj_bytes;
+    }
+    else {
+      obj = VMObject();
+      free_oids.push_back(BASE_OID + i);
+      ++stats.objects_freed;
+      stats.bytes_freed += obj_bytes;
+    }
+  }
+}
+
+
+size_t VMHeap::object_bytes(const VMObject& obj)
+{
+  return sizeof(VMObject) +
+    (obj.elements.capacity() + obj.fields.capacity()) * sizeof(VMValue);
+}
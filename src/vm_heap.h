@@ -0,0 +1,153 @@
+//----------------------------------------------------------------------
+// FILE: vm_heap.h
+// DATE: Spring 2023
+// AUTH: Nisa Meshal
+// DESC: Object table for MyPL VM struct and array objects
+//----------------------------------------------------------------------
+
+#ifndef VM_HEAP_H
+#define VM_HEAP_H
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "vm_value.h"
+
+
+// A heap object. Arrays use the elements (2D arrays are stored row
+// major and record their column count), as do structs allocated with
+// a fixed layout (one element per field slot). Fields added by name
+// (ADDF) are kept separately.
+class VMObject
+{
+public:
+
+  // array elements or struct field slots
+  std::vector<VMValue> elements;
+
+  // number of columns of a 2D array (0 for other objects)
+  int columns = 0;
+
+  // the shape giving the names of the fields added by name
+  int shape = 0;
+
+  // struct field values added by name (in the shape's slot order)
+  std::vector<VMValue> fields;
+
+  // true if the slot holds an allocated object
+  bool live = false;
+
+  // true if the object was reached during the current collection
+  bool marked = false;
+
+};
+
+
+// The names of the fields a struct object added by name, in slot
+// order. Objects that added the same names in the same order share a
+// shape, so a field's slot only has to be looked up once per shape.
+class VMShape
+{
+public:
+
+  std::vector<std::string> names;
+
+  // the shape reached by adding each (new) name
+  std::unordered_map<std::string, int> transitions;
+
+};
+
+
+// Garbage collection statistics (pause times are in milliseconds)
+class VMGCStats
+{
+public:
+  uint64_t collections = 0;
+  uint64_t objects_freed = 0;
+  uint64_t bytes_freed = 0;
+  double total_pause = 0;
+  double max_pause = 0;
+};
+
+
+// Slot table of heap objects indexed by oid - BASE_OID. Freed slots
+// are kept on a free list and reused by later allocations. Objects are
+// reclaimed by mark and sweep: the vm marks every value it can reach
+// directly, then sweeps away the objects left unmarked.
+class VMHeap
+{
+public:
+
+  // the oid of the first object allocated
+  static const int BASE_OID = 2023;
+
+  // create a new object with size elements set to fill and return its
+  // oid (references to objects are invalidated by an allocation)
+  int allocate(int size = 0, const VMValue& fill = nullptr);
+
+  // release the object's storage and make its oid available for reuse
+  void free(int oid);
+
+  // the object with the given (allocated) oid
+  VMObject& operator[](int oid)
+  {
+    assert(oid >= BASE_OID and oid - BASE_OID < objects.size());
+    return objects[oid - BASE_OID];
+  }
+
+  const VMObject& operator[](int oid) const
+  {
+    assert(oid >= BASE_OID and oid - BASE_OID < objects.size());
+    return objects[oid - BASE_OID];
+  }
+
+  // the slot of the named field in objects of the given shape (-1 if
+  // the shape has no such field)
+  int field_slot(int shape, const std::string& name) const;
+
+  // add a null field with the given (new) name to the object, moving
+  // it to the next shape, and return the field's slot
+  int add_field(VMObject& obj, const std::string& name);
+
+  // the number of allocated objects
+  int size() const;
+
+  // estimate of the bytes used by allocated objects (exact as of the
+  // last sweep, and counting only initial elements since)
+  size_t bytes() const;
+
+  // mark the object the value refers to (if any) and every object
+  // reachable from it
+  void mark(const VMValue& value);
+
+  // free every unmarked object and clear the marks of the rest,
+  // adding the number of objects and bytes freed to the statistics
+  void sweep(VMGCStats& stats);
+
+private:
+
+  // object slots (including freed ones)
+  std::vector<VMObject> objects;
+
+  // oids of freed slots
+  std::vector<int> free_oids;
+
+  // shapes indexed by id (shape 0 has no fields)
+  std::vector<VMShape> shapes = {VMShape()};
+
+  // running estimate of the bytes used by allocated objects
+  size_t used_bytes = 0;
+
+  // marked objects whose values have not been marked yet
+  std::vector<int> mark_stack;
+
+  // estimate of the bytes used by an object
+  static size_t object_bytes(const VMObject& obj);
+
+};
+
+
+#endif
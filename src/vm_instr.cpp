@@ -22,6 +22,11 @@ VMInstr::VMInstr(OpCode opcode, const VMValue& operand)
 {}
 
 
+VMInstr::VMInstr(OpCode opcode, int operand, int operand_2)
+  : instr_opcode(opcode), instr_operand(operand), instr_operand_2(operand_2)
+{}
+
+
 void VMInstr::set_comment(const std::string& comment)
 {
   instr_comment = comment;
@@ -40,7 +45,7 @@ OpCode VMInstr::opcode() const
 }
 
 
-std::optional<VMValue> VMInstr::operand() const
+const std::optional<VMValue>& VMInstr::operand() const
 {
   return instr_operand;
 }
@@ -52,6 +57,25 @@ void VMInstr::set_operand(VMValue value)
 }
 
 
+bool VMInstr::is_jump() const
+{
+  switch (instr_opcode) {
+  case OpCode::JMP: case OpCode::JMPF:
+  case OpCode::CMPLT_JMPF: case OpCode::CMPLE_JMPF:
+  case OpCode::CMPGT_JMPF: case OpCode::CMPGE_JMPF:
+  case OpCode::CMPEQ_JMPF: case OpCode::CMPNE_JMPF:
+  case OpCode::ICMPLT_JMPF: case OpCode::ICMPLE_JMPF:
+  case OpCode::ICMPGT_JMPF: case OpCode::ICMPGE_JMPF:
+  case OpCode::ICMPEQ_JMPF: case OpCode::ICMPNE_JMPF:
+  case OpCode::CMPLT_JMPF_II: case OpCode::CMPLE_JMPF_II:
+  case OpCode::CMPGT_JMPF_II: case OpCode::CMPGE_JMPF_II:
+    return true;
+  default:
+    return false;
+  }
+}
+
+
 VMInstr VMInstr::PUSH(const VMValue& value)
 {
   return VMInstr(OpCode::PUSH, value);
@@ -232,9 +256,9 @@ VMInstr VMInstr::CONCAT()
 }
 
 
-VMInstr VMInstr::ALLOCS()
+VMInstr VMInstr::ALLOCS(int field_count)
 {
-  return VMInstr(OpCode::ALLOCS);  
+  return VMInstr(OpCode::ALLOCS, field_count);  
 }
 
 
@@ -267,6 +291,18 @@ VMInstr VMInstr::GETF(const string& field)
 }
 
 
+VMInstr VMInstr::SETFI(int field_slot)
+{
+  return VMInstr(OpCode::SETFI, field_slot);
+}
+
+
+VMInstr VMInstr::GETFI(int field_slot)
+{
+  return VMInstr(OpCode::GETFI, field_slot);
+}
+
+
 VMInstr VMInstr::SETI()
 {
   return VMInstr(OpCode::SETI);      
@@ -288,6 +324,180 @@ VMInstr VMInstr::GETI2D()
   return VMInstr(OpCode::GETI2D); 
 }
 
+VMInstr VMInstr::INCLOCAL(int mem_addr, int amount)
+{
+  return VMInstr(OpCode::INCLOCAL, mem_addr, amount);
+}
+
+
+VMInstr VMInstr::LOADLOAD(int mem_addr_1, int mem_addr_2)
+{
+  return VMInstr(OpCode::LOADLOAD, mem_addr_1, mem_addr_2);
+}
+
+
+VMInstr VMInstr::LOAD_GETI(int mem_addr)
+{
+  return VMInstr(OpCode::LOAD_GETI, mem_addr);
+}
+
+
+VMInstr VMInstr::CMPLT_JMPF(int instruction_index)
+{
+  return VMInstr(OpCode::CMPLT_JMPF, instruction_index);
+}
+
+
+VMInstr VMInstr::CMPLE_JMPF(int instruction_index)
+{
+  return VMInstr(OpCode::CMPLE_JMPF, instruction_index);
+}
+
+
+VMInstr VMInstr::CMPGT_JMPF(int instruction_index)
+{
+  return VMInstr(OpCode::CMPGT_JMPF, instruction_index);
+}
+
+
+VMInstr VMInstr::CMPGE_JMPF(int instruction_index)
+{
+  return VMInstr(OpCode::CMPGE_JMPF, instruction_index);
+}
+
+
+VMInstr VMInstr::CMPEQ_JMPF(int instruction_index)
+{
+  return VMInstr(OpCode::CMPEQ_JMPF, instruction_index);
+}
+
+
+VMInstr VMInstr::CMPNE_JMPF(int instruction_index)
+{
+  return VMInstr(OpCode::CMPNE_JMPF, instruction_index);
+}
+
+
+VMInstr VMInstr::IADD()
+{
+  return VMInstr(OpCode::IADD);
+}
+
+
+VMInstr VMInstr::ISUB()
+{
+  return VMInstr(OpCode::ISUB);
+}
+
+
+VMInstr VMInstr::IMUL()
+{
+  return VMInstr(OpCode::IMUL);
+}
+
+
+VMInstr VMInstr::IDIV()
+{
+  return VMInstr(OpCode::IDIV);
+}
+
+
+VMInstr VMInstr::DADD()
+{
+  return VMInstr(OpCode::DADD);
+}
+
+
+VMInstr VMInstr::DSUB()
+{
+  return VMInstr(OpCode::DSUB);
+}
+
+
+VMInstr VMInstr::DMUL()
+{
+  return VMInstr(OpCode::DMUL);
+}
+
+
+VMInstr VMInstr::DDIV()
+{
+  return VMInstr(OpCode::DDIV);
+}
+
+
+VMInstr VMInstr::ICMPLT()
+{
+  return VMInstr(OpCode::ICMPLT);
+}
+
+
+VMInstr VMInstr::ICMPLE()
+{
+  return VMInstr(OpCode::ICMPLE);
+}
+
+
+VMInstr VMInstr::ICMPGT()
+{
+  return VMInstr(OpCode::ICMPGT);
+}
+
+
+VMInstr VMInstr::ICMPGE()
+{
+  return VMInstr(OpCode::ICMPGE);
+}
+
+
+VMInstr VMInstr::ICMPEQ()
+{
+  return VMInstr(OpCode::ICMPEQ);
+}
+
+
+VMInstr VMInstr::ICMPNE()
+{
+  return VMInstr(OpCode::ICMPNE);
+}
+
+
+VMInstr VMInstr::ICMPLT_JMPF(int instruction_index)
+{
+  return VMInstr(OpCode::ICMPLT_JMPF, instruction_index);
+}
+
+
+VMInstr VMInstr::ICMPLE_JMPF(int instruction_index)
+{
+  return VMInstr(OpCode::ICMPLE_JMPF, instruction_index);
+}
+
+
+VMInstr VMInstr::ICMPGT_JMPF(int instruction_index)
+{
+  return VMInstr(OpCode::ICMPGT_JMPF, instruction_index);
+}
+
+
+VMInstr VMInstr::ICMPGE_JMPF(int instruction_index)
+{
+  return VMInstr(OpCode::ICMPGE_JMPF, instruction_index);
+}
+
+
+VMInstr VMInstr::ICMPEQ_JMPF(int instruction_index)
+{
+  return VMInstr(OpCode::ICMPEQ_JMPF, instruction_index);
+}
+
+
+VMInstr VMInstr::ICMPNE_JMPF(int instruction_index)
+{
+  return VMInstr(OpCode::ICMPNE_JMPF, instruction_index);
+}
+
+
 VMInstr VMInstr::DUP()
 {
   return VMInstr(OpCode::DUP);      
@@ -301,24 +511,26 @@ VMInstr VMInstr::NOP()
 
 
 string to_string(const VMValue& val) {
-  if (holds_alternative<int>(val))
-    return to_string(get<int>(val));
-  else if (holds_alternative<double>(val))
-    return to_string(get<double>(val));
-  else if (holds_alternative<bool>(val) and get<bool>(val))
+  if (val.is_int())
+    return to_string(val.as_int());
+  else if (val.is_double())
+    return to_string(val.as_double());
+  else if (val.is_bool() and val.as_bool())
     return "true";
-  else if (holds_alternative<bool>(val) and !get<bool>(val))
+  else if (val.is_bool() and !val.as_bool())
     return "false";
-  else if (holds_alternative<string>(val))
-    return get<string>(val);
+  else if (val.is_string())
+    return val.as_string();
+  else if (val.is_ref())
+    return to_string(val.as_ref());
   else
     return "null";
 }
 
 
-std::string to_string(const VMInstr& instr)
+std::string to_string(OpCode op)
 {
-  std::unordered_map<OpCode, string> os = {
+  static const std::unordered_map<OpCode, string> os = {
     {OpCode::PUSH, "PUSH"}, {OpCode::POP, "POP"},
     {OpCode::LOAD, "LOAD"}, {OpCode::STORE, "STORE"},
     {OpCode::ADD, "ADD"}, {OpCode::SUB, "SUB"},
@@ -336,16 +548,47 @@ std::string to_string(const VMInstr& instr)
     {OpCode::TOSTR, "TOSTR"}, {OpCode::CONCAT, "CONCAT"},
     {OpCode::ALLOCS, "ALLOCS"}, {OpCode::ALLOCA, "ALLOCA"},
     {OpCode::ADDF, "ADDF"}, {OpCode::GETF, "GETF"},
-    {OpCode::SETF, "SETF"}, {OpCode::GETI, "GETI"},
+    {OpCode::SETF, "SETF"}, {OpCode::GETFI, "GETFI"},
+    {OpCode::SETFI, "SETFI"}, {OpCode::GETI, "GETI"},
     {OpCode::SETI, "SETI"}, {OpCode::DUP, "DUP"},
     {OpCode::NOP, "NOP"},
-    {OpCode::ALLOCA2D, "ALLOCA2D"}, {OpCode::GETI2D, "GETI2D"}, {OpCode::SETI2D, "SETI2D"}
+    {OpCode::ALLOCA2D, "ALLOCA2D"}, {OpCode::GETI2D, "GETI2D"}, {OpCode::SETI2D, "SETI2D"},
+    {OpCode::INCLOCAL, "INCLOCAL"}, {OpCode::LOADLOAD, "LOADLOAD"},
+    {OpCode::LOAD_GETI, "LOAD_GETI"}, {OpCode::CMPLT_JMPF, "CMPLT_JMPF"},
+    {OpCode::CMPLE_JMPF, "CMPLE_JMPF"}, {OpCode::CMPGT_JMPF, "CMPGT_JMPF"},
+    {OpCode::CMPGE_JMPF, "CMPGE_JMPF"}, {OpCode::CMPEQ_JMPF, "CMPEQ_JMPF"},
+    {OpCode::CMPNE_JMPF, "CMPNE_JMPF"},
+    {OpCode::IADD, "IADD"}, {OpCode::ISUB, "ISUB"},
+    {OpCode::IMUL, "IMUL"}, {OpCode::IDIV, "IDIV"},
+    {OpCode::DADD, "DADD"}, {OpCode::DSUB, "DSUB"},
+    {OpCode::DMUL, "DMUL"}, {OpCode::DDIV, "DDIV"},
+    {OpCode::ICMPLT, "ICMPLT"}, {OpCode::ICMPLE, "ICMPLE"},
+    {OpCode::ICMPGT, "ICMPGT"}, {OpCode::ICMPGE, "ICMPGE"},
+    {OpCode::ICMPEQ, "ICMPEQ"}, {OpCode::ICMPNE, "ICMPNE"},
+    {OpCode::ICMPLT_JMPF, "ICMPLT_JMPF"}, {OpCode::ICMPLE_JMPF, "ICMPLE_JMPF"},
+    {OpCode::ICMPGT_JMPF, "ICMPGT_JMPF"}, {OpCode::ICMPGE_JMPF, "ICMPGE_JMPF"},
+    {OpCode::ICMPEQ_JMPF, "ICMPEQ_JMPF"}, {OpCode::ICMPNE_JMPF, "ICMPNE_JMPF"},
+    {OpCode::ADD_II, "ADD_II"}, {OpCode::SUB_II, "SUB_II"},
+    {OpCode::MUL_II, "MUL_II"}, {OpCode::DIV_II, "DIV_II"},
+    {OpCode::CMPLT_II, "CMPLT_II"}, {OpCode::CMPLE_II, "CMPLE_II"},
+    {OpCode::CMPGT_II, "CMPGT_II"}, {OpCode::CMPGE_II, "CMPGE_II"},
+    {OpCode::CMPLT_JMPF_II, "CMPLT_JMPF_II"}, {OpCode::CMPLE_JMPF_II, "CMPLE_JMPF_II"},
+    {OpCode::CMPGT_JMPF_II, "CMPGT_JMPF_II"}, {OpCode::CMPGE_JMPF_II, "CMPGE_JMPF_II"},
+    {OpCode::GETF_IC, "GETF_IC"}, {OpCode::SETF_IC, "SETF_IC"}
   };
+  return os.at(op);
+}
+
+
+std::string to_string(const VMInstr& instr)
+{
   string vstr = "";
   if (instr.operand().has_value()) {
     vstr = to_string(instr.operand().value());
   }
-  string s = os[instr.opcode()] + "(" + vstr + ")";
+  if (instr.operand_2().has_value())
+    vstr += ", " + to_string(instr.operand_2().value());
+  string s = to_string(instr.opcode()) + "(" + vstr + ")";
   if (instr.instr_comment != "")
     s += "  // " + instr.instr_comment;
   return s;
@@ -9,17 +9,10 @@
 #ifndef VM_INSTR_H
 #define VM_INSTR_H
 
-#include <variant>
 #include <optional>
 #include <string>
 #include "op_code.h"
-
-
-// vm values are one of int, double, bool, string, or nullptr_t
-typedef std::variant<int, double, bool, std::string, std::nullptr_t> VMValue;
-
-// function to get a string representation of a vm_value
-std::string to_string(const VMValue& val);
+#include "vm_value.h"
 
 
 class VMInstr
@@ -57,16 +50,47 @@ public:
   static VMInstr TODBL();  
   static VMInstr TOSTR();
   static VMInstr CONCAT();
-  static VMInstr ALLOCS();
+  static VMInstr ALLOCS(int field_count = 0);
   static VMInstr ALLOCA();
   static VMInstr ALLOCA2D();
   static VMInstr ADDF(const std::string& field);
   static VMInstr SETF(const std::string& field);
   static VMInstr GETF(const std::string& field);
+  static VMInstr SETFI(int field_slot);
+  static VMInstr GETFI(int field_slot);
   static VMInstr SETI();
   static VMInstr SETI2D(); 
   static VMInstr GETI();  
   static VMInstr GETI2D(); 
+  static VMInstr INCLOCAL(int mem_addr, int amount);
+  static VMInstr LOADLOAD(int mem_addr_1, int mem_addr_2);
+  static VMInstr LOAD_GETI(int mem_addr);
+  static VMInstr CMPLT_JMPF(int instruction_index);
+  static VMInstr CMPLE_JMPF(int instruction_index);
+  static VMInstr CMPGT_JMPF(int instruction_index);
+  static VMInstr CMPGE_JMPF(int instruction_index);
+  static VMInstr CMPEQ_JMPF(int instruction_index);
+  static VMInstr CMPNE_JMPF(int instruction_index);
+  static VMInstr IADD();
+  static VMInstr ISUB();
+  static VMInstr IMUL();
+  static VMInstr IDIV();
+  static VMInstr DADD();
+  static VMInstr DSUB();
+  static VMInstr DMUL();
+  static VMInstr DDIV();
+  static VMInstr ICMPLT();
+  static VMInstr ICMPLE();
+  static VMInstr ICMPGT();
+  static VMInstr ICMPGE();
+  static VMInstr ICMPEQ();
+  static VMInstr ICMPNE();
+  static VMInstr ICMPLT_JMPF(int instruction_index);
+  static VMInstr ICMPLE_JMPF(int instruction_index);
+  static VMInstr ICMPGT_JMPF(int instruction_index);
+  static VMInstr ICMPGE_JMPF(int instruction_index);
+  static VMInstr ICMPEQ_JMPF(int instruction_index);
+  static VMInstr ICMPNE_JMPF(int instruction_index);
   static VMInstr DUP();
   static VMInstr NOP();
 
@@ -80,10 +104,32 @@ public:
   OpCode opcode() const;
 
   // returns the operand for those instructions with operands
-  std::optional<VMValue> operand() const;
+  const std::optional<VMValue>& operand() const;
 
   // set the operand value
   void set_operand(VMValue value);
+
+  // returns the second operand of the superinstructions that take two
+  // (INCLOCAL and LOADLOAD)
+  const std::optional<int>& operand_2() const {return instr_operand_2;}
+
+  // returns true for instructions that (may) jump to their operand
+  bool is_jump() const;
+
+  // runtime quickening state (see VM::run): the vm rewrites the opcode
+  // in place, counts the times the instruction fell back to its
+  // generic form, and caches the object shape and slot of a field
+  // access
+  void set_opcode(OpCode opcode) {instr_opcode = opcode;}
+  int deopt_count() const {return instr_deopts;}
+  void count_deopt() {++instr_deopts;}
+  void set_field_cache(int shape, int slot)
+  {
+    instr_cached_shape = shape;
+    instr_cached_slot = slot;
+  }
+  int cached_shape() const {return instr_cached_shape;}
+  int cached_slot() const {return instr_cached_slot;}
   
   // pretty print the instruction
   friend std::string to_string(const VMInstr& instr);
@@ -96,16 +142,31 @@ private:
   // some instructions have operands
   std::optional<VMValue> instr_operand;
 
+  // and a few superinstructions have a second one
+  std::optional<int> instr_operand_2;
+
   // comments can be optionally added
   std::string instr_comment;
 
+  // quickening state
+  int instr_deopts = 0;
+  int instr_cached_shape = -1;
+  int instr_cached_slot = -1;
+
   // no operand constructor (helper) for use by static construction methods
   VMInstr(OpCode opcode);
 
   // operand constructor (helper) for use by static construction methods
   VMInstr(OpCode opcode, const VMValue& value);
 
+  // two operand constructor (helper) for the superinstructions
+  VMInstr(OpCode opcode, int value, int value_2);
+
 };
 
 
+// the name of an opcode (as printed in instructions)
+std::string to_string(OpCode op);
+
+
 #endif
@@ -0,0 +1,160 @@
+//----------------------------------------------------------------------
+// FILE: vm_profile.cpp
+// DATE: Spring 2023
+// AUTH: Nisa Meshal
+// DESC: Profile counter and stack sample implementation and reports
+//----------------------------------------------------------------------
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdarg>
+#include <cstdio>
+#include "vm_profile.h"
+#include "vm_instr.h"
+
+using namespace std;
+
+
+uint64_t VMFunctionProfile::retired() const
+{
+  uint64_t count = 0;
+  for (uint64_t n : hits)
+    count += n;
+  return count;
+}
+
+
+void VMProfile::reset(const vector<string>& names, const vector<int>& sizes)
+{
+  opcodes.assign(int(OpCode::NOP) + 1, 0);
+  functions.assign(names.size(), VMFunctionProfile());
+  for (int i = 0; i < names.size(); ++i) {
+    functions[i].name = names[i];
+    functions[i].hits.assign(sizes[i], 0);
+  }
+  calls.clear();
+  depths.assign(names.size(), 0);
+}
+
+
+void VMProfile::finish()
+{
+  while (!calls.empty())
+    exit();
+}
+
+
+void VMProfile::count_opcode(OpCode op, uint64_t count)
+{
+  opcodes[int(op)] += count;
+}
+
+
+const vector<VMFunctionProfile>& VMProfile::function_profiles() const
+{
+  return functions;
+}
+
+
+uint64_t VMProfile::opcode_count(OpCode op) const
+{
+  return opcodes.empty() ? 0 : opcodes[int(op)];
+}
+
+
+// helper to format a row of the report tables
+static string row(const char* format, ...)
+{
+  char buffer[160];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+  return buffer;
+}
+
+
+// helper to get a count as a percentage of a total
+static double percent(uint64_t count, uint64_t total)
+{
+  return total ? 100.0 * count / total : 0.0;
+}
+
+
+string to_string(const VMProfile& profile)
+{
+  uint64_t retired = 0;
+  uint64_t cycles = 0;
+  vector<const VMFunctionProfile*> functions;
+  for (const VMFunctionProfile& f : profile.functions) {
+    retired += f.retired();
+    cycles += f.exclusive;
+    if (f.calls)
+      functions.push_back(&f);
+  }
+  sort(functions.begin(), functions.end(),
+       [](auto f1, auto f2) {return f1->exclusive > f2->exclusive;});
+  string s = "Functions (times in cycles, hottest first)\n";
+  s += row("  %-20s %10s %14s %16s %16s %7s\n", "function", "calls",
+           "instructions", "inclusive", "exclusive", "excl%");
+  for (const VMFunctionProfile* f : functions)
+    s += row("  %-20s %10" PRIu64 " %14" PRIu64 " %16" PRIu64 " %16" PRIu64
+             " %6.1f%%\n", f->name.c_str(), f->calls, f->retired(),
+             f->inclusive, f->exclusive, percent(f->exclusive, cycles));
+  vector<int> opcodes;
+  for (int op = 0; op < profile.opcodes.size(); ++op)
+    if (profile.opcodes[op])
+      opcodes.push_back(op);
+  stable_sort(opcodes.begin(), opcodes.end(), [&](int op1, int op2) {
+    return profile.opcodes[op1] > profile.opcodes[op2];
+  });
+  s += "\nOpcodes (" + to_string(retired) + " instructions)\n";
+  for (int op : opcodes)
+    s += row("  %-20s %14" PRIu64 " %6.1f%%\n",
+             to_string(OpCode(op)).c_str(), profile.opcodes[op],
+             percent(profile.opcodes[op], retired));
+  return s;
+}
+
+
+void VMStackSamples::reset(const vector<string>& function_names)
+{
+  names = function_names;
+  stacks.clear();
+  total = 0;
+}
+
+
+void VMStackSamples::add(const vector<pair<int, int>>& stack)
+{
+  ++stacks[stack];
+  ++total;
+}
+
+
+uint64_t VMStackSamples::count() const
+{
+  return total;
+}
+
+
+string VMStackSamples::folded(bool pcs) const
+{
+  // without indexes, stacks that differ only in them are merged
+  map<string, uint64_t> lines;
+  for (const auto& [stack, count] : stacks) {
+    string line = "";
+    for (const auto& [function, pc] : stack) {
+      if (line != "")
+        line += ";";
+      line += names[function];
+      if (pcs)
+        line += ":" + to_string(pc);
+    }
+    lines[line] += count;
+  }
+  string s = "";
+  for (const auto& [line, count] : lines)
+    s += line + " " + to_string(count) + "\n";
+  return s;
+}
@@ -0,0 +1,173 @@
+//----------------------------------------------------------------------
+// FILE: vm_profile.h
+// DATE: Spring 2023
+// AUTH: Nisa Meshal
+// DESC: Opcode, function, and instruction counters for profiled vm
+//       runs, and sampled call stacks
+//----------------------------------------------------------------------
+
+#ifndef VM_PROFILE_H
+#define VM_PROFILE_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "op_code.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+
+// returns the current value of a cheap, monotonic cycle counter (the
+// time stamp counter on x86, otherwise a steady clock in nanoseconds)
+inline uint64_t cycle_count()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  auto now = std::chrono::steady_clock::now().time_since_epoch();
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+#endif
+}
+
+
+// The counts of one function. Times are in cycle_count() ticks:
+// inclusive time covers the function's calls (outermost calls only,
+// for recursive functions), and exclusive time leaves out the time
+// spent in the functions it called.
+class VMFunctionProfile
+{
+public:
+  std::string name;
+  uint64_t calls = 0;
+  uint64_t inclusive = 0;
+  uint64_t exclusive = 0;
+
+  // executions of each instruction, by instruction index
+  std::vector<uint64_t> hits;
+
+  // the number of instructions executed
+  uint64_t retired() const;
+};
+
+
+// Counters filled in by VM::run when profiling is on. The vm only
+// counts instructions by index (and times calls), so the opcode counts
+// are added afterwards from the instructions as the run left them
+// (i.e., under their quickened opcodes). Calls still active when an
+// error stops the run are not timed.
+class VMProfile
+{
+public:
+
+  // clear the counts for a run of functions with the given names and
+  // instruction counts (indexed by function id)
+  void reset(const std::vector<std::string>& names,
+             const std::vector<int>& sizes);
+
+  // the counters of the function's instructions, by instruction index
+  uint64_t* instruction_counters(int function)
+  {
+    return functions[function].hits.data();
+  }
+
+  // a call to the function starts
+  void enter(int function)
+  {
+    ++functions[function].calls;
+    ++depths[function];
+    calls.push_back({function, cycle_count(), 0});
+  }
+
+  // the innermost call returns
+  void exit()
+  {
+    Call call = calls.back();
+    calls.pop_back();
+    uint64_t elapsed = cycle_count() - call.start;
+    VMFunctionProfile& f = functions[call.function];
+    f.exclusive += elapsed - std::min(elapsed, call.callees);
+    // only the outermost call of a recursive function adds its time
+    if (--depths[call.function] == 0)
+      f.inclusive += elapsed;
+    if (!calls.empty())
+      calls.back().callees += elapsed;
+  }
+
+  // the run ended: time the calls still active
+  void finish();
+
+  // add count executions of instructions with the opcode
+  void count_opcode(OpCode op, uint64_t count);
+
+  // the counts of each function by function id
+  const std::vector<VMFunctionProfile>& function_profiles() const;
+
+  // the number of times instructions with the opcode ran
+  uint64_t opcode_count(OpCode op) const;
+
+  // the function and opcode tables (hottest first)
+  friend std::string to_string(const VMProfile& profile);
+
+private:
+
+  // counts by opcode
+  std::vector<uint64_t> opcodes;
+
+  std::vector<VMFunctionProfile> functions;
+
+  // the active calls, innermost last, with their start time and the
+  // time spent in their callees
+  struct Call {
+    int function;
+    uint64_t start;
+    uint64_t callees;
+  };
+  std::vector<Call> calls;
+
+  // the number of active calls of each function
+  std::vector<int> depths;
+
+};
+
+
+// Call stacks sampled by VM::run, each a list of (function id,
+// instruction index) pairs from main to the running instruction (the
+// callers' indexes are their CALL instructions), with the number of
+// times each was seen
+class VMStackSamples
+{
+public:
+
+  // clear the samples for a run of functions with the given names
+  // (indexed by function id)
+  void reset(const std::vector<std::string>& names);
+
+  // count one sample of the stack
+  void add(const std::vector<std::pair<int, int>>& stack);
+
+  // the number of samples taken
+  uint64_t count() const;
+
+  // the samples in folded stack form, one "main:4;fib:9;fib:13 42"
+  // line per distinct stack (as read by flamegraph.pl and speedscope),
+  // with or without the instruction indexes
+  std::string folded(bool pcs = true) const;
+
+private:
+
+  std::vector<std::string> names;
+
+  std::map<std::vector<std::pair<int, int>>, uint64_t> stacks;
+
+  uint64_t total = 0;
+
+};
+
+
+#endif
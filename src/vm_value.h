@@ -0,0 +1,141 @@
+//----------------------------------------------------------------------
+// FILE: vm_value.h
+// DATE: Spring 2023
+// AUTH: Nisa Meshal
+// DESC: Compact tagged representation of MyPL VM values
+//----------------------------------------------------------------------
+
+#ifndef VM_VALUE_H
+#define VM_VALUE_H
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+
+// Reference counted string storage shared by every value holding the
+// same string (the VM is single threaded, so the count is not atomic).
+class VMString
+{
+public:
+  VMString(std::string str) : refs(1), str(std::move(str)) {}
+  uint32_t refs;
+  const std::string str;
+};
+
+
+// A vm value is one of int, double, bool, string, object reference
+// (oid), or null. Values are 16 bytes: an 8 byte payload plus a type
+// tag. Copying a string value only bumps the reference count of its
+// shared storage.
+class VMValue
+{
+public:
+
+  enum class Type : uint8_t {INT, DOUBLE, BOOL, STRING, REF, NULLPTR};
+
+  // constructors (the default value is null)
+  VMValue() : tag(Type::NULLPTR) {data.i = 0;}
+  VMValue(std::nullptr_t) : VMValue() {}
+  VMValue(int val) : tag(Type::INT) {data.i = val;}
+  VMValue(double val) : tag(Type::DOUBLE) {data.d = val;}
+  VMValue(bool val) : tag(Type::BOOL) {data.b = val;}
+  VMValue(const std::string& val) : tag(Type::STRING) {data.s = new VMString(val);}
+  VMValue(std::string&& val) : tag(Type::STRING) {data.s = new VMString(std::move(val));}
+  VMValue(const char* val) : VMValue(std::string(val)) {}
+
+  // a reference to the heap object with the given oid
+  static VMValue ref(int oid)
+  {
+    VMValue val;
+    val.tag = Type::REF;
+    val.data.i = oid;
+    return val;
+  }
+
+  // copy and move
+  VMValue(const VMValue& other) : data(other.data), tag(other.tag) {retain();}
+  VMValue(VMValue&& other) noexcept : data(other.data), tag(other.tag)
+  {
+    other.tag = Type::NULLPTR;
+  }
+  VMValue& operator=(const VMValue& other)
+  {
+    if (this != &other) {
+      other.retain();
+      release();
+      data = other.data;
+      tag = other.tag;
+    }
+    return *this;
+  }
+  VMValue& operator=(VMValue&& other) noexcept
+  {
+    if (this != &other) {
+      release();
+      data = other.data;
+      tag = other.tag;
+      other.tag = Type::NULLPTR;
+    }
+    return *this;
+  }
+  ~VMValue() {release();}
+
+  // type tests
+  Type type() const {return tag;}
+  bool is_int() const {return tag == Type::INT;}
+  bool is_double() const {return tag == Type::DOUBLE;}
+  bool is_bool() const {return tag == Type::BOOL;}
+  bool is_string() const {return tag == Type::STRING;}
+  bool is_ref() const {return tag == Type::REF;}
+  bool is_null() const {return tag == Type::NULLPTR;}
+
+  // payload access (the value must hold the requested type)
+  int as_int() const {assert(is_int()); return data.i;}
+  double as_double() const {assert(is_double()); return data.d;}
+  bool as_bool() const {assert(is_bool()); return data.b;}
+  const std::string& as_string() const {assert(is_string()); return data.s->str;}
+  int as_ref() const {assert(is_ref()); return data.i;}
+
+  // overwrite a value known not to hold a string, skipping the release
+  // (for the typed operations, whose operands are numbers or null)
+  void set_int(int val) {assert(!is_string()); tag = Type::INT; data.i = val;}
+  void set_double(double val) {assert(!is_string()); tag = Type::DOUBLE; data.d = val;}
+  void set_bool(bool val) {assert(!is_string()); tag = Type::BOOL; data.b = val;}
+  void set_null() {assert(!is_string()); tag = Type::NULLPTR;}
+
+private:
+
+  union {
+    int i;
+    double d;
+    bool b;
+    VMString* s;
+  } data;
+
+  Type tag;
+
+  void retain() const
+  {
+    if (tag == Type::STRING)
+      ++data.s->refs;
+  }
+
+  void release()
+  {
+    if (tag == Type::STRING and --data.s->refs == 0)
+      delete data.s;
+  }
+
+};
+
+static_assert(sizeof(VMValue) == 16, "VMValue should be 16 bytes");
+
+
+// function to get a string representation of a vm_value
+std::string to_string(const VMValue& val);
+
+
+#endif
@@ -5,17 +5,29 @@
 // DESC: 2D array language extension
 //----------------------------------------------------------------------
 
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
 #include <sstream>
+#include <stdexcept>
 #include <string>
 #include <gtest/gtest.h>
 #include "mypl_exception.h"
 #include "simple_parser.h"
+#include "keywords.h"
 #include "lexer.h"
+#include "lexer_scan.h"
+#include "source_buffer.h"
 #include "ast_parser.h"
+#include "flat_ast.h"
+#include "print_visitor.h"
 #include "vm.h"
 #include "code_generator.h"
 #include "semantic_checker.h"
+#include "optimizer.h"
+#include "constant_folder.h"
+#include "reg_code_generator.h"
+#include "cpp_emitter.h"
 
 using namespace std;
 
@@ -43,6 +55,146 @@ string build_string(initializer_list<string> strs)
 }
 
 
+//----------------------------------------------------------------------
+// Lexer Tests
+//----------------------------------------------------------------------
+
+const string LEXER_SOURCE = build_string({
+  "# a comment",
+  "struct Node {int val, Node next}",
+  "void main() {",
+  "  array double xs = new double[2][3]",
+  "  xs[1][2] = 12.75",
+  "  string s = \"hi\\tthere\"",
+  "  char c = '\\n'",
+  "  if ((s != null) and (c == 'x')) {print(s)}",
+  "  while (not false) {bool b = 4 >= 03}",
+  "}"
+});
+
+TEST(LexerTests, SourceBufferMatchesStream) {
+  stringstream in(LEXER_SOURCE);
+  Lexer stream_lexer(in);
+  SourceBuffer source = SourceBuffer::from_string(LEXER_SOURCE);
+  Lexer buffer_lexer(source);
+  int count = 0;
+  string stream_error;
+  try {
+    while (true) {
+      Token t = stream_lexer.next_token();
+      EXPECT_EQ(to_string(t), to_string(buffer_lexer.next_token()));
+      ++count;
+    }
+  } catch (MyPLException& ex) {
+    stream_error = ex.what();
+  }
+  // both stop at the leading zero
+  EXPECT_LT(60, count);
+  EXPECT_NE(string::npos, stream_error.find("leading zero"));
+  try {
+    buffer_lexer.next_token();
+    FAIL();
+  } catch (MyPLException& ex) {
+    EXPECT_EQ(stream_error, ex.what());
+  }
+}
+
+TEST(LexerTests, LexemesReferToSource) {
+  SourceBuffer source = SourceBuffer::from_string("abc 12.5 \"x\\ty\"");
+  string_view text = source.text();
+  Lexer lexer(source);
+  Token id = lexer.next_token();
+  Token num = lexer.next_token();
+  Token str = lexer.next_token();
+  EXPECT_EQ(text.data(), id.lexeme_view().data());
+  EXPECT_EQ(text.data() + 4, num.lexeme_view().data());
+  EXPECT_EQ("12.5", num.lexeme());
+  // escapes are left in place (and handled by the code generators)
+  EXPECT_EQ("x\\ty", str.lexeme_view());
+  EXPECT_EQ(text.data() + 10, str.lexeme_view().data());
+  EXPECT_EQ(TokenType::EOS, lexer.next_token().type());
+}
+
+TEST(LexerTests, MappedFile) {
+  string name = testing::TempDir() + "mypl_source_test.mypl";
+  ofstream(name) << "void main() {print(1)}";
+  SourceBuffer source(name);
+  ASSERT_FALSE(source.fail());
+  EXPECT_EQ("void main() {print(1)}", source.text());
+  Lexer lexer(source);
+  EXPECT_EQ("void", lexer.next_token().lexeme());
+  EXPECT_EQ("main", lexer.next_token().lexeme());
+  EXPECT_TRUE(SourceBuffer(name + ".missing").fail());
+}
+
+// helper to lex all of the source, giving each token (and the error
+// that stopped the lexer, if any)
+vector<string> lex_all(Lexer& lexer)
+{
+  vector<string> tokens;
+  try {
+    Token t = lexer.next_token();
+    while (t.type() != TokenType::EOS) {
+      tokens.push_back(to_string(t));
+      t = lexer.next_token();
+    }
+    tokens.push_back(to_string(t));
+  } catch (MyPLException& ex) {
+    tokens.push_back(ex.what());
+  }
+  return tokens;
+}
+
+TEST(LexerTests, ScannersMatchStream) {
+  string long_id = "a_rather_long_identifier_that_spans_vectors_" +
+    string(40, 'x');
+  vector<string> sources = {
+    LEXER_SOURCE,
+    "  \t\r\n\n" + string(50, ' ') + long_id + "(12345678901234567890)" +
+      "# " + string(70, '-') + "\n\n  " + long_id + "!x{y}",
+    "x = 1234567890123456789012345678901234.5678901234567890123456789",
+    "string s = \"" + string(100, 'q') + "\" t = \"\"\n",
+    "print(\"unterminated " + string(40, 'z') + "\n\")",
+    "print(\"end of file " + string(40, 'z'),
+    "# a comment ending the file " + string(40, '#'),
+    "abc\xff def\n# \xff\nghi",
+    "x" + string(33, '\xff'),
+    long_id + "$%&|~" + long_id + " a.b.c[d]"
+  };
+  string best_isa = scan_isa();
+  for (string isa : {"scalar", "sse2", "avx2"}) {
+    if (!set_scan_isa(isa))
+      continue;
+    for (const string& text : sources) {
+      stringstream in(text);
+      Lexer stream_lexer(in);
+      SourceBuffer source = SourceBuffer::from_string(text);
+      Lexer buffer_lexer(source);
+      EXPECT_EQ(lex_all(stream_lexer), lex_all(buffer_lexer)) << isa;
+    }
+  }
+  set_scan_isa(best_isa);
+  EXPECT_EQ(best_isa, scan_isa());
+}
+
+TEST(LexerTests, KeywordTable) {
+  string text = "";
+  for (const Keyword& keyword : KEYWORDS)
+    text += string(keyword.word) + " ";
+  // near misses (prefixes, extensions, case, same hash inputs)
+  text += "el elsei elseiff Int nul nulll ture fals arrray a z_ strict";
+  SourceBuffer source = SourceBuffer::from_string(text);
+  Lexer lexer(source);
+  for (const Keyword& keyword : KEYWORDS) {
+    Token t = lexer.next_token();
+    EXPECT_EQ(keyword.type, t.type());
+    EXPECT_EQ(keyword.word, t.lexeme());
+  }
+  for (int i = 0; i < 12; ++i)
+    EXPECT_EQ(TokenType::ID, lexer.next_token().type());
+  EXPECT_EQ(TokenType::EOS, lexer.next_token().type());
+}
+
 //----------------------------------------------------------------------
 // Simple Parser Tests
 //----------------------------------------------------------------------
@@ -187,6 +339,89 @@ TEST(ASTParserTests, BadArrayAccess) {
   }  
 }
 
+// counts the destructor calls of arena nodes
+struct ArenaNode {
+  int* destroyed;
+  std::string name;
+  ~ArenaNode() {++*destroyed;}
+};
+
+TEST(ASTParserTests, ArenaNodes) {
+  int destroyed = 0;
+  vector<ArenaNode*> nodes;
+  {
+    ASTArena arena;
+    for (int i = 0; i < 10000; ++i) {
+      nodes.push_back(arena.make<ArenaNode>(&destroyed, to_string(i)));
+      ASSERT_EQ(0, reinterpret_cast<uintptr_t>(nodes.back()) %
+                alignof(ArenaNode));
+    }
+    // the nodes stay put as the arena grows
+    EXPECT_EQ("0", nodes[0]->name);
+    EXPECT_EQ("9999", nodes.back()->name);
+    EXPECT_LT(1, arena.block_count());
+    EXPECT_GT(16, arena.block_count());
+    EXPECT_EQ(0, destroyed);
+  }
+  EXPECT_EQ(10000, destroyed);
+}
+
+TEST(ASTParserTests, ArenaLists) {
+  int destroyed = 0;
+  vector<ArenaNode> items;
+  items.reserve(5);
+  for (int i = 0; i < 5; ++i)
+    items.push_back(ArenaNode {&destroyed, to_string(i)});
+  {
+    ASTArena arena;
+    // the items from index 2 on are moved into the list
+    ASTList<ArenaNode> list = arena.make_list(items, 2);
+    ASSERT_EQ(3, list.size());
+    EXPECT_EQ("2", list[0].name);
+    EXPECT_EQ("4", list.back().name);
+    ASSERT_EQ(2, items.size());
+    EXPECT_EQ("1", items.back().name);
+    EXPECT_TRUE(arena.make_list(items, 2).empty());
+    destroyed = 0;
+  }
+  EXPECT_EQ(3, destroyed);
+  // nested lists are parsed on the same stacks
+  stringstream in (build_string({
+    "void main() {",
+    "  f(g(1, 2), h(a.b[c.d]))",
+    "}"
+  }));
+  Program p = ASTParser(Lexer(in)).parse();
+  CallExpr& f = (CallExpr&)*p.fun_defs[0].stmts[0];
+  ASSERT_EQ(2, f.args.size());
+  CallExpr& g = (CallExpr&)*((SimpleTerm*)f.args[0].first)->rvalue;
+  ASSERT_EQ(2, g.args.size());
+  EXPECT_EQ("2", g.args[1].first_token().lexeme());
+  CallExpr& h = (CallExpr&)*((SimpleTerm*)f.args[1].first)->rvalue;
+  ASSERT_EQ(1, h.args.size());
+  VarRValue& v = (VarRValue&)*((SimpleTerm*)h.args[0].first)->rvalue;
+  ASSERT_EQ(2, v.path.size());
+  EXPECT_EQ("b", v.path[1].var_name.lexeme());
+  EXPECT_EQ("c", v.path[1].array_expr->first_token().lexeme());
+}
+
+TEST(ASTParserTests, ProgramOwnsNodes) {
+  stringstream in (build_string({
+    "void main() {",
+    "  int x = (1 + 2) * 3",
+    "  while (x > 0) {x = x - 1}",
+    "}"
+  }));
+  Program p = ASTParser(Lexer(in)).parse();
+  EXPECT_EQ(1, p.arena->block_count());
+  // copies share the nodes (and so the arena)
+  Program q = p;
+  EXPECT_EQ(p.fun_defs[0].stmts[1], q.fun_defs[0].stmts[1]);
+  p = Program();
+  WhileStmt& w = (WhileStmt&)*q.fun_defs[0].stmts[1];
+  EXPECT_EQ("x", w.condition.first_token().lexeme());
+}
+
 //----------------------------------------------------------------------
 // Semantic Checker Tests
 //----------------------------------------------------------------------
@@ -245,6 +480,24 @@ TEST(SemanticCheckerTest, BadArrayAccessExpression) {
   } 
 }
 
+TEST(SemanticCheckerTest, BadArray1DAccessExpression) {
+  stringstream in (build_string({
+    "void main() {",
+      "array int xs = new int [2]",
+      "int x = xs[\"x\"]", 
+    "}"
+  }));
+
+  SemanticChecker checker;
+  try {
+    ASTParser(Lexer(in)).parse().accept(checker);
+    FAIL();
+  } catch (MyPLException& ex) {
+    string msg = ex.what();
+    ASSERT_TRUE(msg.starts_with("Static Error:"));
+  } 
+}
+
 TEST(SemanticCheckerTest, Array2DAsArg) {
    stringstream in (build_string({
     "int f (array int xs) {}"
@@ -271,6 +524,28 @@ TEST(SemanticCheckerTest, BasicArrUsage) {
   ASTParser(Lexer(in)).parse().accept(checker); 
 }
 
+TEST(SemanticCheckerTest, BuiltInMissingArgument) {
+  for (string name : {"print", "to_string", "to_int", "to_double",
+                      "length"}) {
+    stringstream in (build_string({
+      "void main() {",
+        name + "()",
+      "}"
+    }));
+
+    SemanticChecker checker;
+    try {
+      ASTParser(Lexer(in)).parse().accept(checker);
+      FAIL() << name;
+    } catch (MyPLException& ex) {
+      string msg = ex.what();
+      ASSERT_TRUE(msg.starts_with("Static Error:"));
+      ASSERT_NE(string::npos, msg.find("missing function argument for " +
+                                       name));
+    }
+  }
+}
+
 //----------------------------------------------------------------------
 // VM Tests
 //----------------------------------------------------------------------
@@ -363,6 +638,507 @@ TEST(VMTests, OutOfBoundsIndex) {
   restore_cout();
 }
 
+TEST(VMTests, StringValueCopies) {
+  VMFrameInfo main {"main", 0};
+  main.instructions.push_back(VMInstr::PUSH("ab"));
+  main.instructions.push_back(VMInstr::STORE(0));
+  main.instructions.push_back(VMInstr::LOAD(0));
+  main.instructions.push_back(VMInstr::DUP());
+  main.instructions.push_back(VMInstr::CONCAT());
+  main.instructions.push_back(VMInstr::LOAD(0));
+  main.instructions.push_back(VMInstr::CONCAT());
+  main.instructions.push_back(VMInstr::WRITE());
+  VM vm;
+  vm.add(main);
+  stringstream out;
+  change_cout(out);
+  vm.run();
+  EXPECT_EQ("ababab", out.str());
+  restore_cout();
+}
+
+TEST(VMTests, ValueSize) {
+  EXPECT_EQ(16, sizeof(VMValue));
+  VMValue s = string("mypl");
+  VMValue t = s;
+  EXPECT_EQ("mypl", to_string(t));
+  EXPECT_TRUE(VMValue().is_null());
+}
+
+TEST(VMTests, MaxStackDepth) {
+  VMFrameInfo f {"f", 1};
+  f.instructions.push_back(VMInstr::STORE(0));
+  f.instructions.push_back(VMInstr::PUSH(2));
+  f.instructions.push_back(VMInstr::PUSH(2));
+  f.instructions.push_back(VMInstr::PUSH(0));
+  f.instructions.push_back(VMInstr::ALLOCA2D());
+  f.instructions.push_back(VMInstr::PUSH(1));
+  f.instructions.push_back(VMInstr::PUSH(1));
+  f.instructions.push_back(VMInstr::GETI2D());
+  f.instructions.push_back(VMInstr::RET());
+  EXPECT_EQ(3, max_stack_depth(f));
+}
+
+TEST(VMTests, SkippedVariableIndex) {
+  VMFrameInfo main {"main", 0};
+  main.instructions.push_back(VMInstr::PUSH(1));
+  main.instructions.push_back(VMInstr::STORE(2));
+  main.instructions.push_back(VMInstr::PUSH(3));
+  main.instructions.push_back(VMInstr::STORE(0));
+  main.instructions.push_back(VMInstr::LOAD(2));
+  main.instructions.push_back(VMInstr::WRITE());
+  main.instructions.push_back(VMInstr::LOAD(0));
+  main.instructions.push_back(VMInstr::WRITE());
+  VM vm;
+  vm.add(main);
+  stringstream out;
+  change_cout(out);
+  vm.run();
+  EXPECT_EQ("13", out.str());
+  restore_cout();
+}
+
+TEST(VMTests, HeapReusesFreedOids) {
+  VMHeap heap;
+  int a = heap.allocate();
+  int b = heap.allocate();
+  EXPECT_EQ(2023, a);
+  EXPECT_EQ(2024, b);
+  heap[a].elements.assign(3, 1);
+  heap.free(a);
+  EXPECT_EQ(1, heap.size());
+  EXPECT_EQ(a, heap.allocate());
+  EXPECT_TRUE(heap[a].elements.empty());
+  EXPECT_EQ(2025, heap.allocate());
+}
+
+TEST(VMTests, GarbageCollection) {
+  stringstream in (build_string({
+    "struct Node {int val, Node next}",
+    "void main() {",
+    "  Node head = null",
+    "  for (int i = 0; i < 1000; i = i + 1) {",
+    "    array int junk = new int[50]",
+    "    Node n = new Node",
+    "    n.val = i",
+    "    n.next = head",
+    "    head = n",
+    "  }",
+    "  int total = 0",
+    "  while (head != null) {",
+    "    total = total + head.val",
+    "    head = head.next",
+    "  }",
+    "  print(total)",
+    "}"
+  }));
+  VM vm;
+  CodeGenerator generator(vm);
+  ASTParser(Lexer(in)).parse().accept(generator);
+  vm.set_gc_threshold(4096);
+  stringstream out;
+  change_cout(out);
+  vm.run();
+  EXPECT_EQ("499500", out.str());
+  restore_cout();
+  EXPECT_LT(0, vm.gc_stats().collections);
+  EXPECT_LE(900, vm.gc_stats().objects_freed);
+  EXPECT_LT(0, vm.gc_stats().bytes_freed);
+}
+
+TEST(VMTests, LinkUndefinedFunction) {
+  VMFrameInfo main {"main", 0};
+  main.instructions.push_back(VMInstr::PUSH(1));
+  main.instructions.push_back(VMInstr::CALL("f"));
+  VM vm;
+  vm.add(main);
+  try {
+    vm.link();
+    FAIL();
+  } catch(MyPLException& ex) {
+    string err = ex.what();
+    string msg = "VM Error: undefined function 'f'";
+    msg += " (in main at 1: CALL(f))";
+    EXPECT_EQ(msg, err);
+  }
+}
+
+TEST(VMTests, LinkedCall) {
+  VMFrameInfo f {"f", 1};
+  f.instructions.push_back(VMInstr::PUSH(1));
+  f.instructions.push_back(VMInstr::ADD());
+  f.instructions.push_back(VMInstr::RET());
+  VMFrameInfo main {"main", 0};
+  main.instructions.push_back(VMInstr::PUSH(41));
+  main.instructions.push_back(VMInstr::CALL("f"));
+  main.instructions.push_back(VMInstr::WRITE());
+  VM vm;
+  vm.add(main);
+  vm.add(f);
+  vm.link();
+  stringstream out;
+  change_cout(out);
+  vm.run();
+  EXPECT_EQ("42", out.str());
+  restore_cout();
+}
+
+TEST(VMTests, StackOverflow) {
+  VMFrameInfo f {"f", 0};
+  f.instructions.push_back(VMInstr::CALL("f"));
+  f.instructions.push_back(VMInstr::RET());
+  VMFrameInfo main {"main", 0};
+  main.instructions.push_back(VMInstr::CALL("f"));
+  VM vm;
+  vm.set_stack_limit(1 << 16);
+  vm.add(main);
+  vm.add(f);
+  try {
+    vm.run();
+    FAIL();
+  } catch(MyPLException& ex) {
+    string err = ex.what();
+    EXPECT_EQ("VM Error: stack overflow (in f at 0: CALL(1)  // f)", err);
+  }
+}
+
+// a program recursing to the given depth, printing the depth reached
+string deep_recursion(int depth)
+{
+  return build_string({
+    "int depth(int n, string s) {",
+    "  if (n == 0) {return 0}",
+    "  return 1 + depth(n - 1, s)",
+    "}",
+    "void main() {",
+    "  print(depth(" + to_string(depth) + ", \"frame\"))",
+    "}"
+  });
+}
+
+TEST(VMTests, DeepRecursion) {
+  // the value stack grows past its first chunk, and is reused
+  stringstream in(deep_recursion(100000));
+  Program p = ASTParser(Lexer(in)).parse();
+  SemanticChecker checker;
+  p.accept(checker);
+  VM vm;
+  CodeGenerator generator(vm);
+  p.accept(generator);
+  for (int run = 0; run < 2; ++run) {
+    stringstream out;
+    change_cout(out);
+    vm.run();
+    restore_cout();
+    EXPECT_EQ("100000", out.str());
+  }
+}
+
+TEST(VMTests, StackLimit) {
+  stringstream in(deep_recursion(100000));
+  Program p = ASTParser(Lexer(in)).parse();
+  VM vm;
+  CodeGenerator generator(vm);
+  p.accept(generator);
+  vm.set_stack_limit(100000);
+  try {
+    vm.run();
+    FAIL();
+  } catch(MyPLException& ex) {
+    string err = ex.what();
+    EXPECT_EQ(0, err.find("VM Error: stack overflow (in depth at "));
+  }
+  // a higher limit
+  vm.set_stack_limit(VMValueStack::DEFAULT_LIMIT);
+  stringstream out;
+  change_cout(out);
+  vm.run();
+  restore_cout();
+  EXPECT_EQ("100000", out.str());
+}
+
+TEST(VMTests, QuickenedArithmetic) {
+  string src = build_string({
+    "void main() {",
+    "  int sum = 0",
+    "  for (int i = 0; i < 10; i = i + 1) {",
+    "    sum = sum + (i * 2)",
+    "  }",
+    "  print(sum)",
+    "}"
+  });
+  // without the checker the generator only emits generic instructions
+  stringstream in1 (src);
+  VM vm;
+  CodeGenerator generator(vm);
+  ASTParser(Lexer(in1)).parse().accept(generator);
+  stringstream in2 (src);
+  VM plain_vm;
+  CodeGenerator plain_generator(plain_vm);
+  ASTParser(Lexer(in2)).parse().accept(plain_generator);
+  plain_vm.set_quickening(false);
+  stringstream out;
+  change_cout(out);
+  vm.run();
+  plain_vm.run();
+  EXPECT_EQ("9090", out.str());
+  restore_cout();
+  string ir = to_string(vm);
+  EXPECT_NE(string::npos, ir.find("ADD_II"));
+  EXPECT_NE(string::npos, ir.find("MUL_II"));
+  EXPECT_NE(string::npos, ir.find("CMPLT_II"));
+  EXPECT_EQ(4, vm.quickened_sites());
+  EXPECT_EQ(0, vm.quicken_stats().deoptimized);
+  EXPECT_EQ(0, plain_vm.quickened_sites());
+  EXPECT_EQ(vm.instructions_retired(), plain_vm.instructions_retired());
+}
+
+TEST(VMTests, QuickeningDeoptimizes) {
+  stringstream in (build_string({
+    "int f(int a, int b) {",
+    "  return a + b",
+    "}",
+    "void main() {",
+    "  print(f(1, 2))",
+    "  print(f(1.5, 2.5))",
+    "  print(f(3, 4))",
+    "  print(f(0.5, 0.5))",
+    "  print(f(5, 6))",
+    "}"
+  }));
+  VM vm;
+  CodeGenerator generator(vm);
+  ASTParser(Lexer(in)).parse().accept(generator);
+  stringstream out;
+  change_cout(out);
+  vm.run();
+  EXPECT_EQ("34.00000071.00000011", out.str());
+  restore_cout();
+  // a site deoptimized twice stays generic
+  EXPECT_EQ(2, vm.quicken_stats().quickened);
+  EXPECT_EQ(2, vm.quicken_stats().deoptimized);
+  EXPECT_EQ(0, vm.quickened_sites());
+}
+
+TEST(VMTests, FieldInlineCache) {
+  VMFrameInfo getx {"getx", 1};
+  getx.instructions.push_back(VMInstr::GETF("x"));
+  getx.instructions.push_back(VMInstr::RET());
+  VMFrameInfo main {"main", 0};
+  // a has fields x, y and b has fields y, x (a different shape)
+  for (string first : {"x", "y"}) {
+    string second = first == "x" ? "y" : "x";
+    main.instructions.push_back(VMInstr::ALLOCS());
+    main.instructions.push_back(VMInstr::DUP());
+    main.instructions.push_back(VMInstr::ADDF(first));
+    main.instructions.push_back(VMInstr::DUP());
+    main.instructions.push_back(VMInstr::ADDF(second));
+    main.instructions.push_back(VMInstr::STORE(first == "x" ? 0 : 1));
+  }
+  main.instructions.push_back(VMInstr::LOAD(0));
+  main.instructions.push_back(VMInstr::PUSH(1));
+  main.instructions.push_back(VMInstr::SETF("x"));
+  main.instructions.push_back(VMInstr::LOAD(1));
+  main.instructions.push_back(VMInstr::PUSH(2));
+  main.instructions.push_back(VMInstr::SETF("x"));
+  for (int var : {0, 0, 1}) {
+    main.instructions.push_back(VMInstr::LOAD(var));
+    main.instructions.push_back(VMInstr::CALL("getx"));
+    main.instructions.push_back(VMInstr::WRITE());
+  }
+  VM vm;
+  vm.add(main);
+  vm.add(getx);
+  stringstream out;
+  change_cout(out);
+  vm.run();
+  EXPECT_EQ("112", out.str());
+  restore_cout();
+  // both SETFs, then the GETF for a and again for b after its guard failed
+  EXPECT_EQ(4, vm.quicken_stats().quickened);
+  EXPECT_EQ(1, vm.quicken_stats().deoptimized);
+  EXPECT_EQ(3, vm.quickened_sites());
+  EXPECT_NE(string::npos, to_string(vm).find("GETF_IC(x)"));
+}
+
+TEST(VMTests, ValueLayout) {
+  // the native code reads and writes values in place
+  VMValue v = 42;
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&v);
+  EXPECT_EQ(42, *reinterpret_cast<const int*>(bytes));
+  EXPECT_EQ(int(VMValue::Type::INT), bytes[8]);
+  v = 2.5;
+  EXPECT_EQ(2.5, *reinterpret_cast<const double*>(bytes));
+  EXPECT_EQ(int(VMValue::Type::DOUBLE), bytes[8]);
+}
+
+// helper to check, generate, and run a program with the jit on or off,
+// returning its output
+string run_jit(const string& source, bool jit, int* compiled = nullptr)
+{
+  stringstream in(source);
+  Program p = ASTParser(Lexer(in)).parse();
+  SemanticChecker checker;
+  p.accept(checker);
+  VM vm;
+  vm.set_jit(jit);
+  CodeGenerator generator(vm);
+  p.accept(generator);
+  stringstream out;
+  change_cout(out);
+  try {
+    vm.run();
+  } catch (MyPLException& ex) {
+    out << ex.what();
+  }
+  restore_cout();
+  if (compiled)
+    *compiled = vm.native_instructions();
+  return out.str();
+}
+
+TEST(VMTests, JitMatchesInterpreter) {
+  string source = build_string({
+    "struct P {int x, double y}",
+    "int sq(int n) {return n * n}",
+    "void main() {",
+    "  array int xs = new int[10]",
+    "  array double grid = new double[3][4]",
+    "  P p = new P",
+    "  p.x = 0",
+    "  p.y = 0.0",
+    "  int total = 0",
+    "  double d = 1.5",
+    "  bool flag = false",
+    "  for (int i = 0; i < 10; i = i + 1) {",
+    "    xs[i] = sq(i)",
+    "    total = total + (xs[i] / 3)",
+    "    d = d * 1.5",
+    "    flag = not flag and (i != 7)",
+    "    p.x = p.x + i",
+    "    grid[i / 4][i - ((i / 4) * 4)] = d",
+    "    if (d >= 10.0) {d = d - 10.0}",
+    "  }",
+    "  int j = 0",
+    "  while (j < 100) {j = j + 7}",
+    "  print(concat(to_string(total), \" \"))",
+    "  print(d)",
+    "  print(grid[1][2])",
+    "  print(flag)",
+    "  print(p.x)",
+    "  print(j)",
+    "}"
+  });
+  int compiled = 0;
+  string expected = run_jit(source, false);
+  EXPECT_EQ(expected, run_jit(source, true, &compiled));
+  EXPECT_EQ("93 ", expected.substr(0, 3));
+  if (native_supported())
+    EXPECT_LT(0, compiled);
+  else
+    EXPECT_EQ(0, compiled);
+}
+
+TEST(VMTests, JitFallsBackForErrors) {
+  // the guard on the null operand exits to the interpreter, which
+  // reports the error as usual
+  string source = build_string({
+    "void main() {",
+    "  int x = 0",
+    "  int y = null",
+    "  for (int i = 0; i < 5; i = i + 1) {",
+    "    x = x + i",
+    "    if (i == 3) {x = x + y}",
+    "  }",
+    "  print(x)",
+    "}"
+  });
+  string expected = run_jit(source, false);
+  EXPECT_NE(string::npos, expected.find("null reference"));
+  EXPECT_EQ(expected, run_jit(source, true));
+}
+
+TEST(VMTests, ProfileCounts) {
+  stringstream in(build_string({
+    "int sq(int n) {return n * n}",
+    "void main() {",
+    "  int total = 0",
+    "  for (int i = 0; i < 50; i = i + 1) {",
+    "    total = total + sq(i)",
+    "  }",
+    "  print(total)",
+    "}"
+  }));
+  Program p = ASTParser(Lexer(in)).parse();
+  SemanticChecker checker;
+  p.accept(checker);
+  VM vm;
+  vm.set_profiling(true);
+  vm.set_jit(true);
+  CodeGenerator generator(vm);
+  p.accept(generator);
+  stringstream out;
+  change_cout(out);
+  vm.run();
+  restore_cout();
+  EXPECT_EQ("40425", out.str());
+  VMProfile profile = vm.profile();
+  const vector<VMFunctionProfile>& functions = profile.function_profiles();
+  ASSERT_EQ(2, functions.size());
+  const VMFunctionProfile& sq = functions[0];
+  const VMFunctionProfile& main = functions[1];
+  EXPECT_EQ("sq", sq.name);
+  EXPECT_EQ(50, sq.calls);
+  EXPECT_EQ(1, main.calls);
+  // profiled runs are not compiled, so every instruction is counted
+  EXPECT_EQ(vm.instructions_retired(), sq.retired() + main.retired());
+  EXPECT_EQ(50 * sq.hits.size(), sq.retired());
+  EXPECT_EQ(50, profile.opcode_count(OpCode::CALL));
+  EXPECT_EQ(51, profile.opcode_count(OpCode::RET));
+  EXPECT_LE(sq.exclusive, sq.inclusive);
+  EXPECT_LE(sq.inclusive, main.inclusive);
+  EXPECT_LE(sq.inclusive, main.inclusive - main.exclusive);
+  // the listing shows each instruction's count
+  string listing = to_string(vm);
+  EXPECT_NE(string::npos, listing.find("Frame 'sq' (50 calls, "));
+  EXPECT_NE(string::npos, listing.find("          50   0: "));
+}
+
+TEST(VMTests, SampledStacks) {
+  stringstream in(build_string({
+    "int fib(int n) {",
+    "  if (n < 2) {return n}",
+    "  return fib(n - 1) + fib(n - 2)",
+    "}",
+    "void main() {",
+    "  int f = fib(12)",
+    "}"
+  }));
+  VM vm;
+  vm.set_sampling(7);
+  CodeGenerator generator(vm);
+  ASTParser(Lexer(in)).parse().accept(generator);
+  vm.run();
+  const VMStackSamples& samples = vm.samples();
+  EXPECT_EQ(vm.instructions_retired() / 7, samples.count());
+  // every stack starts in main, and the counts add up
+  stringstream folded(samples.folded());
+  string line;
+  uint64_t total = 0;
+  bool recursive = false;
+  while (getline(folded, line)) {
+    EXPECT_EQ(0, line.find("main:"));
+    recursive = recursive or line.find(";fib:") != line.rfind(";fib:");
+    total += stoi(line.substr(line.rfind(' ') + 1));
+  }
+  EXPECT_TRUE(recursive);
+  EXPECT_EQ(samples.count(), total);
+  // without instruction indexes, stacks of the same calls are merged
+  string functions = samples.folded(false);
+  EXPECT_EQ(string::npos, functions.find(':'));
+  EXPECT_NE(string::npos, functions.find("main;fib;fib "));
+}
+
 //----------------------------------------------------------------------
 // Code Generation Tests
 //----------------------------------------------------------------------
@@ -435,6 +1211,1369 @@ TEST(CodeGenerationTests, InvolvedArray) {
   restore_cout();   
 }
 
+TEST(CodeGenerationTests, StructFieldSlots) {
+  stringstream in (build_string({
+    "struct B {int y, int z}",
+    "struct A {int x, B b}",
+    "void main() {",
+    "array A as = new A[2]",
+    "as[1] = new A",
+    "as[1].b = new B",
+    "as[1].b.z = 5",
+    "as[1].x = 2",
+    "print(as[1].b.z + as[1].x)",
+    "print(as[1].b.y)",
+    "}"
+  }));
+
+  VM vm; 
+  CodeGenerator generator(vm); 
+  ASTParser(Lexer(in)).parse().accept(generator); 
+  EXPECT_EQ(string::npos, to_string(vm).find("GETF("));
+  stringstream out; 
+  change_cout(out); 
+  vm.run(); 
+  EXPECT_EQ("7null", out.str()); 
+  restore_cout(); 
+}
+
+TEST(CodeGenerationTests, TypedOperations) {
+  stringstream in (build_string({
+    "void main() {",
+    "  int x = 7",
+    "  int y = null",
+    "  double d = 1.5",
+    "  array int xs = new int[2]",
+    "  xs[0] = 3",
+    "  print(x * 2 + xs[0])",
+    "  print(d * 2.0)",
+    "  print(x < 8)",
+    "  print(y == null)",
+    "  print(x == y)",
+    "  print(length(xs) - 1)",
+    "}"
+  }));
+  Program p = ASTParser(Lexer(in)).parse();
+  VM plain_vm;
+  CodeGenerator plain_generator(plain_vm);
+  p.accept(plain_generator);
+  SemanticChecker checker;
+  p.accept(checker);
+  VM vm;
+  CodeGenerator generator(vm);
+  p.accept(generator);
+  string ir = to_string(vm);
+  EXPECT_NE(string::npos, ir.find("IMUL"));
+  EXPECT_NE(string::npos, ir.find("IADD"));
+  EXPECT_NE(string::npos, ir.find("DMUL"));
+  EXPECT_NE(string::npos, ir.find("ICMPLT"));
+  EXPECT_NE(string::npos, ir.find("ICMPEQ"));
+  EXPECT_NE(string::npos, ir.find("ISUB"));
+  // null has its own type, so comparing with it stays generic
+  EXPECT_NE(string::npos, ir.find(" CMPEQ"));
+  // without type information the generic operations are used
+  EXPECT_EQ(string::npos, to_string(plain_vm).find("IADD"));
+  stringstream out;
+  change_cout(out);
+  vm.run();
+  EXPECT_EQ("353.000000truetruefalse1", out.str());
+  restore_cout();
+}
+
+TEST(CodeGenerationTests, TypedNullReference) {
+  stringstream in (build_string({
+    "void main() {",
+    "  int x = null",
+    "  int y = x + 1",
+    "}"
+  }));
+  Program p = ASTParser(Lexer(in)).parse();
+  SemanticChecker checker;
+  p.accept(checker);
+  VM vm;
+  CodeGenerator generator(vm);
+  p.accept(generator);
+  try {
+    vm.run();
+    FAIL();
+  } catch(MyPLException& ex) {
+    string err = ex.what();
+    EXPECT_EQ("VM Error: null reference (in main at 4: IADD())", err);
+  }
+}
+
+TEST(CodeGenerationTests, CheckedIndex) {
+  stringstream in (build_string({
+    "void main() {",
+    "  array int xs = new int[3]",
+    "  xs[2] = 7",
+    "  print(xs[length(xs) - 1])",
+    "  print(xs[1 + 1] * 2)",
+    "}"
+  }));
+  Program p = ASTParser(Lexer(in)).parse();
+  SemanticChecker checker;
+  p.accept(checker);
+  VM vm;
+  CodeGenerator generator(vm);
+  p.accept(generator);
+  // the index of an rvalue is checked, so its operations are typed and
+  // its length call is the array length
+  string ir = to_string(vm);
+  EXPECT_NE(string::npos, ir.find("ISUB"));
+  EXPECT_NE(string::npos, ir.find("IADD"));
+  EXPECT_NE(string::npos, ir.find("ALEN"));
+  stringstream out;
+  change_cout(out);
+  vm.run();
+  EXPECT_EQ("714", out.str());
+  restore_cout();
+}
+
+//----------------------------------------------------------------------
+// Optimizer Tests
+//----------------------------------------------------------------------
+
+TEST(OptimizerTests, PeepholePairs) {
+  VMFrameInfo main {"main", 0};
+  main.instructions.push_back(VMInstr::PUSH(3));
+  main.instructions.push_back(VMInstr::POP());
+  main.instructions.push_back(VMInstr::PUSH(4));
+  main.instructions.push_back(VMInstr::STORE(0));
+  main.instructions.push_back(VMInstr::LOAD(0));
+  main.instructions.push_back(VMInstr::WRITE());
+  main.instructions.push_back(VMInstr::JMP(7));
+  main.instructions.push_back(VMInstr::NOP());
+  optimize(main, 1);
+  ASSERT_EQ(4, main.instructions.size());
+  EXPECT_EQ(OpCode::PUSH, main.instructions[0].opcode());
+  EXPECT_EQ(OpCode::DUP, main.instructions[1].opcode());
+  EXPECT_EQ(OpCode::STORE, main.instructions[2].opcode());
+  EXPECT_EQ(OpCode::WRITE, main.instructions[3].opcode());
+  EXPECT_EQ(2, main.max_stack);
+}
+
+TEST(OptimizerTests, JumpsRetargeted) {
+  stringstream in (build_string({
+    "void main() {",
+    "  for (int i = 0; i < 3; i = i + 1) {",
+    "    if (i == 1) {",
+    "      print(\"a\")",
+    "    }",
+    "    elseif (i == 2) {",
+    "      print(\"b\")",
+    "    }",
+    "    else {",
+    "      print(\"c\")",
+    "    }",
+    "  }",
+    "}"
+  }));
+  Program p = ASTParser(Lexer(in)).parse();
+  VM plain_vm;
+  CodeGenerator plain_generator(plain_vm, 0);
+  p.accept(plain_generator);
+  VM vm;
+  CodeGenerator generator(vm, 1);
+  p.accept(generator);
+  EXPECT_EQ(string::npos, to_string(vm).find("NOP"));
+  stringstream out;
+  change_cout(out);
+  plain_vm.run();
+  vm.run();
+  EXPECT_EQ("cabcab", out.str());
+  restore_cout();
+  EXPECT_LT(vm.instructions_retired(), plain_vm.instructions_retired());
+}
+
+TEST(OptimizerTests, ElseIfWithoutElse) {
+  stringstream in (build_string({
+    "void main() {",
+    "  for (int i = 0; i < 3; i = i + 1) {",
+    "    if (i == 1) {",
+    "      print(\"a\")",
+    "    }",
+    "    elseif (i == 2) {",
+    "      print(\"b\")",
+    "    }",
+    "  }",
+    "}"
+  }));
+  Program p = ASTParser(Lexer(in)).parse();
+  VM vm;
+  CodeGenerator generator(vm, 1);
+  p.accept(generator);
+  stringstream out;
+  change_cout(out);
+  vm.run();
+  EXPECT_EQ("ab", out.str());
+  restore_cout();
+}
+
+TEST(OptimizerTests, Superinstructions) {
+  stringstream in (build_string({
+    "void main() {",
+    "  array int xs = new int[5]",
+    "  int sum = 0",
+    "  for (int i = 0; i < 5; i = i + 1) {",
+    "    xs[i] = i * 2",
+    "  }",
+    "  for (int j = 4; j >= 0; j = j - 1) {",
+    "    sum = sum + xs[j]",
+    "  }",
+    "  print(sum)",
+    "}"
+  }));
+  Program p = ASTParser(Lexer(in)).parse();
+  VM plain_vm;
+  CodeGenerator plain_generator(plain_vm, 1);
+  p.accept(plain_generator);
+  VM vm;
+  CodeGenerator generator(vm, 2);
+  p.accept(generator);
+  string ir = to_string(vm);
+  EXPECT_NE(string::npos, ir.find("INCLOCAL(2, 1)"));
+  EXPECT_NE(string::npos, ir.find("INCLOCAL(2, -1)"));
+  EXPECT_NE(string::npos, ir.find("CMPLT_JMPF"));
+  EXPECT_NE(string::npos, ir.find("CMPGE_JMPF"));
+  EXPECT_NE(string::npos, ir.find("LOAD_GETI(2)"));
+  EXPECT_NE(string::npos, ir.find("LOADLOAD(1, 0)"));
+  stringstream out;
+  change_cout(out);
+  plain_vm.run();
+  vm.run();
+  EXPECT_EQ("2020", out.str());
+  restore_cout();
+  EXPECT_LT(vm.instructions_retired(), plain_vm.instructions_retired());
+}
+
+//----------------------------------------------------------------------
+// Constant Folder Tests
+//----------------------------------------------------------------------
+
+TEST(ConstantFolderTests, FoldedExpressions) {
+  stringstream in (build_string({
+    "void main() {",
+    "  int x = 10 - 2 - 3",
+    "  double y = (1.5 * 2.0) / 4.0",
+    "  bool z = not (1 < 2) or true",
+    "  int n = x",
+    "  n = n + x",
+    "  print(concat(to_string(x), to_string(n)))",
+    "}"
+  }));
+  Program p = ASTParser(Lexer(in)).parse();
+  SemanticChecker checker;
+  p.accept(checker);
+  ConstantFolder folder;
+  p.accept(folder);
+  VM vm;
+  CodeGenerator generator(vm, 1);
+  p.accept(generator);
+  string ir = to_string(vm);
+  // expressions are right associative: 10 - (2 - 3)
+  EXPECT_NE(string::npos, ir.find("PUSH(11)"));
+  EXPECT_NE(string::npos, ir.find("PUSH(0.75"));
+  EXPECT_NE(string::npos, ir.find("PUSH(false)"));
+  EXPECT_EQ(string::npos, ir.find("MUL"));
+  EXPECT_EQ(string::npos, ir.find("CMPLT"));
+  stringstream out;
+  change_cout(out);
+  vm.run();
+  EXPECT_EQ("1122", out.str());
+  restore_cout();
+}
+
+TEST(ConstantFolderTests, PrunedBranches) {
+  stringstream in (build_string({
+    "void main() {",
+    "  int n = 3",
+    "  if (false) {",
+    "    print(\"a\")",
+    "  }",
+    "  elseif (n > 5) {",
+    "    print(\"b\")",
+    "  }",
+    "  elseif (n == 3) {",
+    "    print(\"c\")",
+    "  }",
+    "  else {",
+    "    print(\"d\")",
+    "  }",
+    "  while (n < 0) {",
+    "    print(\"e\")",
+    "  }",
+    "}"
+  }));
+  Program p = ASTParser(Lexer(in)).parse();
+  SemanticChecker checker;
+  p.accept(checker);
+  ConstantFolder folder;
+  p.accept(folder);
+  VM vm;
+  CodeGenerator generator(vm, 1);
+  p.accept(generator);
+  string ir = to_string(vm);
+  EXPECT_EQ(string::npos, ir.find("JMP"));
+  EXPECT_EQ(string::npos, ir.find("PUSH(a)"));
+  EXPECT_EQ(string::npos, ir.find("PUSH(e)"));
+  stringstream out;
+  change_cout(out);
+  vm.run();
+  EXPECT_EQ("c", out.str());
+  restore_cout();
+}
+
+TEST(ConstantFolderTests, UnfoldedOperations) {
+  stringstream in (build_string({
+    "void main() {",
+    "  int big = 2147483647 + 1",
+    "  print(to_string(7 / 0))",
+    "}"
+  }));
+  Program p = ASTParser(Lexer(in)).parse();
+  SemanticChecker checker;
+  p.accept(checker);
+  ConstantFolder folder;
+  p.accept(folder);
+  VM vm;
+  CodeGenerator generator(vm, 1);
+  p.accept(generator);
+  string ir = to_string(vm);
+  EXPECT_NE(string::npos, ir.find("ADD"));
+  EXPECT_NE(string::npos, ir.find("DIV"));
+}
+
+//----------------------------------------------------------------------
+// Register VM Tests
+//----------------------------------------------------------------------
+
+TEST(RegVMTests, InvolvedArray) {
+  stringstream in (build_string({
+    "void main() {",
+    " int count = 0",
+    " array int xs = new int[3][5]",
+    " for(int i = 0; i < 3; i = i + 1) {",
+    "   for(int j = 0; j < 5; j = j + 1) {",
+    "    xs[i][j] = count",
+    "    count = count + 1",
+    "   }",
+    " }",
+    " for(int i = 0; i < 3; i = i + 1) {",
+    "   for(int j = 0; j < 5; j = j + 1) {",
+    "     print(xs[i][j])",
+    "     print(\" \")",
+    "   }",
+    " }",
+    "}"
+  }));
+  RegVM vm;
+  RegCodeGenerator generator(vm);
+  ASTParser(Lexer(in)).parse().accept(generator);
+  stringstream out;
+  change_cout(out);
+  vm.run();
+  EXPECT_EQ("0 1 2 3 4 5 6 7 8 9 10 11 12 13 14 ", out.str());
+  restore_cout();
+}
+
+TEST(RegVMTests, StructFields) {
+  stringstream in (build_string({
+    "struct B {int y, int z}",
+    "struct A {int x, B b}",
+    "void main() {",
+    "array A as = new A[2]",
+    "as[1] = new A",
+    "as[1].b = new B",
+    "as[1].b.z = 5",
+    "as[1].x = 2",
+    "print(as[1].b.z + as[1].x)",
+    "print(as[1].b.y)",
+    "}"
+  }));
+  RegVM vm;
+  RegCodeGenerator generator(vm);
+  ASTParser(Lexer(in)).parse().accept(generator);
+  stringstream out;
+  change_cout(out);
+  vm.run();
+  EXPECT_EQ("7null", out.str());
+  restore_cout();
+}
+
+TEST(RegVMTests, RecursiveCalls) {
+  stringstream in (build_string({
+    "int fib(int n) {",
+    "  if (n < 2) {return n}",
+    "  return fib(n - 1) + fib(n - 2)",
+    "}",
+    "string join(string a, string b, int n) {",
+    "  return concat(concat(a, \"-\"), concat(b, concat(\"-\", to_string(n))))",
+    "}",
+    "void main() {",
+    "  print(join(\"fib\", to_string(15), fib(15)))",
+    "}"
+  }));
+  RegVM vm;
+  RegCodeGenerator generator(vm);
+  ASTParser(Lexer(in)).parse().accept(generator);
+  stringstream out;
+  change_cout(out);
+  vm.run();
+  EXPECT_EQ("fib-15-610", out.str());
+  restore_cout();
+}
+
+TEST(RegVMTests, FewerInstructions) {
+  string src = build_string({
+    "void main() {",
+    "  int total = 0",
+    "  for (int i = 0; i < 100; i = i + 1) {",
+    "    total = total + i * 2",
+    "  }",
+    "  print(total)",
+    "}"
+  });
+  stringstream in1 (src);
+  VM stack_vm;
+  CodeGenerator stack_generator(stack_vm);
+  ASTParser(Lexer(in1)).parse().accept(stack_generator);
+  stringstream in2 (src);
+  RegVM reg_vm;
+  RegCodeGenerator reg_generator(reg_vm);
+  ASTParser(Lexer(in2)).parse().accept(reg_generator);
+  stringstream out;
+  change_cout(out);
+  stack_vm.run();
+  reg_vm.run();
+  EXPECT_EQ("99009900", out.str());
+  restore_cout();
+  EXPECT_LT(reg_vm.instructions_retired(), stack_vm.instructions_retired());
+  // the loop test is a single fused compare and jump on registers
+  EXPECT_NE(string::npos, to_string(reg_vm).find("JMPF_LT("));
+}
+
+TEST(RegVMTests, GarbageCollection) {
+  stringstream in (build_string({
+    "struct Node {int val, Node next}",
+    "void main() {",
+    "  Node head = null",
+    "  for (int i = 0; i < 1000; i = i + 1) {",
+    "    array int junk = new int[50]",
+    "    Node n = new Node",
+    "    n.val = i",
+    "    n.next = head",
+    "    head = n",
+    "  }",
+    "  int total = 0",
+    "  while (head != null) {",
+    "    total = total + head.val",
+    "    head = head.next",
+    "  }",
+    "  print(total)",
+    "}"
+  }));
+  RegVM vm;
+  RegCodeGenerator generator(vm);
+  ASTParser(Lexer(in)).parse().accept(generator);
+  vm.set_gc_threshold(4096);
+  stringstream out;
+  change_cout(out);
+  vm.run();
+  EXPECT_EQ("499500", out.str());
+  restore_cout();
+  EXPECT_LT(0, vm.gc_stats().collections);
+  EXPECT_LE(900, vm.gc_stats().objects_freed);
+}
+
+TEST(RegVMTests, OutOfBoundsIndex) {
+  stringstream in (build_string({
+    "void main() {",
+    "  array int xs = new int[2][4]",
+    "  xs[2][0] = 1",
+    "}"
+  }));
+  RegVM vm;
+  RegCodeGenerator generator(vm);
+  ASTParser(Lexer(in)).parse().accept(generator);
+  try {
+    vm.run();
+    FAIL();
+  } catch(MyPLException& ex) {
+    string err = ex.what();
+    EXPECT_EQ(0, err.find("VM Error: out-of-bounds 2D array index"));
+  }
+}
+
+TEST(RegVMTests, UndefinedFunction) {
+  RegVM vm;
+  RegFrameInfo main {"main", 0};
+  main.instructions.push_back(RegInstr(RegOpCode::CALL, 0, vm.function_id("f"), 0));
+  main.instructions.push_back(RegInstr(RegOpCode::RET, 0));
+  main.register_count = 1;
+  vm.add(main);
+  try {
+    vm.run();
+    FAIL();
+  } catch(MyPLException& ex) {
+    string err = ex.what();
+    EXPECT_EQ("VM Error: undefined function 'f'", err);
+  }
+}
+
+TEST(RegVMTests, StackLimit) {
+  stringstream in(deep_recursion(100000));
+  Program p = ASTParser(Lexer(in)).parse();
+  RegVM vm;
+  RegCodeGenerator generator(vm);
+  p.accept(generator);
+  vm.set_stack_limit(100000);
+  try {
+    vm.run();
+    FAIL();
+  } catch(MyPLException& ex) {
+    string err = ex.what();
+    EXPECT_EQ(0, err.find("VM Error: stack overflow (in depth at "));
+  }
+  vm.set_stack_limit(VMValueStack::DEFAULT_LIMIT);
+  stringstream out;
+  change_cout(out);
+  vm.run();
+  restore_cout();
+  EXPECT_EQ("100000", out.str());
+}
+
+// a program run by the tests comparing its output on the stack vm, the
+// register vm, and as compiled C++
+struct TestProgram {
+  string name;
+  string source;
+  // false if the checker rejects the program (it runs unchecked)
+  bool checked = true;
+};
+
+// the programs run on each backend (the programs of the other tests,
+// grouped by test suite, and the hand assembled VMTests programs written
+// in MyPL)
+const vector<TestProgram> BACKEND_PROGRAMS = {
+  // VMTests (hand assembled)
+  {"ArrayIndex2D", build_string({
+    "void main() {",
+    "  array int xs = new int[2][2]",
+    "  print(xs[1][1])",
+    "  xs[1][1] = 23",
+    "  print(xs[1][1])",
+    "  print(xs[2][2])",
+    "}"
+  })},
+  {"StringCopies", build_string({
+    "void main() {",
+    "  string s = \"ab\"",
+    "  string t = s",
+    "  s = concat(s, s)",
+    "  print(concat(s, t))",
+    "}"
+  })},
+  {"LinkedCall", build_string({
+    "int f(int n) {return n + 1}",
+    "void main() {",
+    "  print(f(41))",
+    "}"
+  })},
+
+  // VMTests
+  {"GarbageCollection", build_string({
+    "struct Node {int val, Node next}",
+    "void main() {",
+    "  Node head = null",
+    "  for (int i = 0; i < 1000; i = i + 1) {",
+    "    array int junk = new int[50]",
+    "    Node n = new Node",
+    "    n.val = i",
+    "    n.next = head",
+    "    head = n",
+    "  }",
+    "  int total = 0",
+    "  while (head != null) {",
+    "    total = total + head.val",
+    "    head = head.next",
+    "  }",
+    "  print(total)",
+    "}"
+  })},
+  {"DeepRecursion", build_string({
+    "int depth(int n, string s) {",
+    "  if (n == 0) {return 0}",
+    "  return 1 + depth(n - 1, s)",
+    "}",
+    "void main() {",
+    "  print(depth(100000, \"frame\"))",
+    "}"
+  })},
+  {"QuickenedArithmetic", build_string({
+    "void main() {",
+    "  int sum = 0",
+    "  for (int i = 0; i < 10; i = i + 1) {",
+    "    sum = sum + (i * 2)",
+    "  }",
+    "  print(sum)",
+    "}"
+  })},
+  // (calls f with doubles on purpose, so it runs unchecked)
+  {"QuickeningDeoptimizes", build_string({
+    "int f(int a, int b) {",
+    "  return a + b",
+    "}",
+    "void main() {",
+    "  print(f(1, 2))",
+    "  print(f(1.5, 2.5))",
+    "  print(f(3, 4))",
+    "  print(f(0.5, 0.5))",
+    "  print(f(5, 6))",
+    "}"
+  }), false},
+  {"JitMatchesInterpreter", build_string({
+    "struct P {int x, double y}",
+    "int sq(int n) {return n * n}",
+    "void main() {",
+    "  array int xs = new int[10]",
+    "  array double grid = new double[3][4]",
+    "  P p = new P",
+    "  p.x = 0",
+    "  p.y = 0.0",
+    "  int total = 0",
+    "  double d = 1.5",
+    "  bool flag = false",
+    "  for (int i = 0; i < 10; i = i + 1) {",
+    "    xs[i] = sq(i)",
+    "    total = total + (xs[i] / 3)",
+    "    d = d * 1.5",
+    "    flag = not flag and (i != 7)",
+    "    p.x = p.x + i",
+    "    grid[i / 4][i - ((i / 4) * 4)] = d",
+    "    if (d >= 10.0) {d = d - 10.0}",
+    "  }",
+    "  int j = 0",
+    "  while (j < 100) {j = j + 7}",
+    "  print(concat(to_string(total), \" \"))",
+    "  print(d)",
+    "  print(grid[1][2])",
+    "  print(flag)",
+    "  print(p.x)",
+    "  print(j)",
+    "}"
+  })},
+  {"JitFallsBackForErrors", build_string({
+    "void main() {",
+    "  int x = 0",
+    "  int y = null",
+    "  for (int i = 0; i < 5; i = i + 1) {",
+    "    x = x + i",
+    "    if (i == 3) {x = x + y}",
+    "  }",
+    "  print(x)",
+    "}"
+  })},
+  {"ProfileCounts", build_string({
+    "int sq(int n) {return n * n}",
+    "void main() {",
+    "  int total = 0",
+    "  for (int i = 0; i < 50; i = i + 1) {",
+    "    total = total + sq(i)",
+    "  }",
+    "  print(total)",
+    "}"
+  })},
+  {"SampledStacks", build_string({
+    "int fib(int n) {",
+    "  if (n < 2) {return n}",
+    "  return fib(n - 1) + fib(n - 2)",
+    "}",
+    "void main() {",
+    "  int f = fib(12)",
+    "}"
+  })},
+
+  // CodeGenerationTests
+  {"BasicTest", build_string({
+    "void main() {",
+    "array int xs = new int[2][4]",
+    "xs[1][1] = 3",
+    "int x = xs[1][1]",
+    "print(x)",
+    "}"
+  })},
+  {"NullInit", build_string({
+    "void main() {",
+    "array int xs = new int[2][4]",
+    "print(xs[0][0])",
+    "}"
+  })},
+  {"InvolvedArray", build_string({
+    "void main() {",
+    " int count = 0"
+    " array int xs = new int[3][5]",
+    " for(int i = 0; i < 3; i = i+ 1) {",
+    "   for(int j = 0; j < 5; j = j+ 1) {",
+    "    xs[i][j] = count",
+    "    count = count + 1",
+    "   }",
+    " }",
+    " for(int i = 0; i < 3; i = i+ 1) {",
+    "   for(int j = 0; j < 5; j = j+ 1) {",
+    "     print(xs[i][j])",
+    "     print(\" \")",
+    "   }",
+    " }",
+    "}"
+  })},
+  {"StructFieldSlots", build_string({
+    "struct B {int y, int z}",
+    "struct A {int x, B b}",
+    "void main() {",
+    "array A as = new A[2]",
+    "as[1] = new A",
+    "as[1].b = new B",
+    "as[1].b.z = 5",
+    "as[1].x = 2",
+    "print(as[1].b.z + as[1].x)",
+    "print(as[1].b.y)",
+    "}"
+  })},
+  {"TypedOperations", build_string({
+    "void main() {",
+    "  int x = 7",
+    "  int y = null",
+    "  double d = 1.5",
+    "  array int xs = new int[2]",
+    "  xs[0] = 3",
+    "  print(x * 2 + xs[0])",
+    "  print(d * 2.0)",
+    "  print(x < 8)",
+    "  print(y == null)",
+    "  print(x == y)",
+    "  print(length(xs) - 1)",
+    "}"
+  })},
+  {"TypedNullReference", build_string({
+    "void main() {",
+    "  int x = null",
+    "  int y = x + 1",
+    "}"
+  })},
+  {"CheckedIndex", build_string({
+    "void main() {",
+    "  array int xs = new int[3]",
+    "  xs[2] = 7",
+    "  print(xs[length(xs) - 1])",
+    "  print(xs[1 + 1] * 2)",
+    "}"
+  })},
+
+  // OptimizerTests
+  {"JumpsRetargeted", build_string({
+    "void main() {",
+    "  for (int i = 0; i < 3; i = i + 1) {",
+    "    if (i == 1) {",
+    "      print(\"a\")",
+    "    }",
+    "    elseif (i == 2) {",
+    "      print(\"b\")",
+    "    }",
+    "    else {",
+    "      print(\"c\")",
+    "    }",
+    "  }",
+    "}"
+  })},
+  {"ElseIfWithoutElse", build_string({
+    "void main() {",
+    "  for (int i = 0; i < 3; i = i + 1) {",
+    "    if (i == 1) {",
+    "      print(\"a\")",
+    "    }",
+    "    elseif (i == 2) {",
+    "      print(\"b\")",
+    "    }",
+    "  }",
+    "}"
+  })},
+  {"Superinstructions", build_string({
+    "void main() {",
+    "  array int xs = new int[5]",
+    "  int sum = 0",
+    "  for (int i = 0; i < 5; i = i + 1) {",
+    "    xs[i] = i * 2",
+    "  }",
+    "  for (int j = 4; j >= 0; j = j - 1) {",
+    "    sum = sum + xs[j]",
+    "  }",
+    "  print(sum)",
+    "}"
+  })},
+
+  // ConstantFolderTests
+  {"FoldedExpressions", build_string({
+    "void main() {",
+    "  int x = 10 - 2 - 3",
+    "  double y = (1.5 * 2.0) / 4.0",
+    "  bool z = not (1 < 2) or true",
+    "  int n = x",
+    "  n = n + x",
+    "  print(concat(to_string(x), to_string(n)))",
+    "}"
+  })},
+  {"PrunedBranches", build_string({
+    "void main() {",
+    "  int n = 3",
+    "  if (false) {",
+    "    print(\"a\")",
+    "  }",
+    "  elseif (n > 5) {",
+    "    print(\"b\")",
+    "  }",
+    "  elseif (n == 3) {",
+    "    print(\"c\")",
+    "  }",
+    "  else {",
+    "    print(\"d\")",
+    "  }",
+    "  while (n < 0) {",
+    "    print(\"e\")",
+    "  }",
+    "}"
+  })},
+
+  // RegVMTests
+  {"RecursiveCalls", build_string({
+    "int fib(int n) {",
+    "  if (n < 2) {return n}",
+    "  return fib(n - 1) + fib(n - 2)",
+    "}",
+    "string join(string a, string b, int n) {",
+    "  return concat(concat(a, \"-\"), concat(b, concat(\"-\", to_string(n))))",
+    "}",
+    "void main() {",
+    "  print(join(\"fib\", to_string(15), fib(15)))",
+    "}"
+  })},
+  {"FewerInstructions", build_string({
+    "void main() {",
+    "  int total = 0",
+    "  for (int i = 0; i < 100; i = i + 1) {",
+    "    total = total + i * 2",
+    "  }",
+    "  print(total)",
+    "}"
+  })},
+  {"GarbageListNodes", build_string({
+    "struct Node {int val, Node next}",
+    "void main() {",
+    "  Node head = null",
+    "  for (int i = 0; i < 1000; i = i + 1) {",
+    "    array int junk = new int[50]",
+    "    Node n = new Node",
+    "    n.val = i",
+    "    n.next = head",
+    "    head = n",
+    "  }",
+    "  int total = 0",
+    "  while (head != null) {",
+    "    total = total + head.val",
+    "    head = head.next",
+    "  }",
+    "  print(total)",
+    "}"
+  })},
+  {"OutOfBoundsAssign", build_string({
+    "void main() {",
+    "  array int xs = new int[2][4]",
+    "  xs[2][0] = 1",
+    "}"
+  })},
+
+  // CppEmitterTests
+  {"NativeAndNullableLocals", build_string({
+    "int f(int n) {return n}",
+    "void main() {",
+    "  int x = 1",
+    "  int y = 2",
+    "  y = null",
+    "  x = x + f(3)",
+    "}"
+  })},
+  {"CompiledMatchesVM", build_string({
+    "struct Node {int val, Node next}",
+    "int fib(int n) {",
+    "  if (n < 2) {return n}",
+    "  return fib(n - 1) + fib(n - 2)",
+    "}",
+    "void main() {",
+    "  array int xs = new int[2][3]",
+    "  Node head = null",
+    "  for (int i = 0; i < 6; i = i + 1) {",
+    "    xs[i / 3][i - ((i / 3) * 3)] = fib(i + 10)",
+    "    Node n = new Node",
+    "    n.val = xs[i / 3][i - ((i / 3) * 3)]",
+    "    n.next = head",
+    "    head = n",
+    "  }",
+    "  int big = 2147483647",
+    "  print(big + 1)",
+    "  double d = 0.5",
+    "  while (head != null) {",
+    "    print(concat(\" \", to_string(head.val)))",
+    "    d = d * 2.0",
+    "    head = head.next",
+    "  }",
+    "  print(concat(\" \", to_string(d)))",
+    "  print(get(length(\"abc\"), \"abc\"))",
+    "}"
+  })},
+
+  // FlatASTTests
+  {"FlatProgram", build_string({
+    "struct Node {int val, Node next, array Node kids, array int grid}",
+    "int count(Node n, int k) {",
+    "  int total = 0",
+    "  for (int i = 0; i < k; i = i + 1) {",
+    "    if (((i / 2) * 2) == i) {total = total + (i * 3) + n.val}",
+    "    elseif ((i > 10) and not (i == 12)) {total = total - 1}",
+    "    else {",
+    "      n.grid[i] = total",
+    "      n.kids[0].grid[i] = i",
+    "    }",
+    "  }",
+    "  while (not (total < 100)) {total = total / 2}",
+    "  return total",
+    "}",
+    "void main() {",
+    "  Node n = new Node",
+    "  n.val = 1",
+    "  n.grid = new int[20]",
+    "  n.kids = new Node[1]",
+    "  n.kids[0] = new Node",
+    "  n.kids[0].grid = new int[20]",
+    "  array int g = new int[2][3]",
+    "  g[1][2] = length(n.grid) + length(\"abc\")",
+    "  char c = get(0, concat(\"x\\n\", to_string('z')))",
+    "  if (c == 'x') {print(to_string(count(n, 20)))}",
+    "  count(n, 2)",
+    "  print(to_string(g[1][2] + n.kids[0].grid[1]))",
+    "}"
+  })}
+};
+
+// helper to check (unless the checker rejects it), fold (above opt
+// level 0), generate, and run a test program on the stack vm or the
+// register vm, returning its output followed by the error that stopped
+// it, if any (without the error's location, which differs between the
+// vms)
+string run_backend(const TestProgram& program, bool reg, int opt_level)
+{
+  stringstream in(program.source);
+  Program p = ASTParser(Lexer(in)).parse();
+  if (program.checked) {
+    SemanticChecker checker;
+    p.accept(checker);
+  }
+  if (opt_level > 0) {
+    ConstantFolder folder;
+    p.accept(folder);
+  }
+  stringstream out;
+  change_cout(out);
+  try {
+    if (reg) {
+      RegVM vm;
+      RegCodeGenerator generator(vm);
+      p.accept(generator);
+      vm.run();
+    }
+    else {
+      VM vm;
+      CodeGenerator generator(vm, opt_level);
+      p.accept(generator);
+      vm.run();
+    }
+  } catch (MyPLException& ex) {
+    string err = ex.what();
+    out << err.substr(0, err.find(" (in "));
+  }
+  restore_cout();
+  return out.str();
+}
+
+TEST(RegVMTests, MatchesStackVM) {
+  for (const TestProgram& program : BACKEND_PROGRAMS) {
+    for (int opt_level : {0, 2}) {
+      string expected = run_backend(program, false, opt_level);
+      EXPECT_EQ(expected, run_backend(program, true, opt_level))
+        << program.name << " at opt level " << opt_level;
+    }
+  }
+}
+
+//----------------------------------------------------------------------
+// C++ Emitter Tests
+//----------------------------------------------------------------------
+
+// helper to check a program and translate it to C++
+string emit_cpp(const string& source)
+{
+  stringstream in(source);
+  Program p = ASTParser(Lexer(in)).parse();
+  SemanticChecker checker;
+  p.accept(checker);
+  stringstream out;
+  CppEmitter emitter(out);
+  p.accept(emitter);
+  return out.str();
+}
+
+TEST(CppEmitterTests, NativeAndNullableLocals) {
+  string out = emit_cpp(build_string({
+    "int f(int n) {return n}",
+    "void main() {",
+    "  int x = 1",
+    "  int y = 2",
+    "  y = null",
+    "  x = x + f(3)",
+    "}"
+  }));
+  EXPECT_NE(string::npos, out.find("mypl::Maybe<int> f_f(mypl::Maybe<int> v_n)"));
+  EXPECT_NE(string::npos, out.find("  int v_x = "));
+  EXPECT_NE(string::npos, out.find("  mypl::Maybe<int> v_y = "));
+  // the lhs is evaluated before the call
+  EXPECT_NE(string::npos, out.find("auto t1 = v_x;"));
+  EXPECT_NE(string::npos, out.find("mypl::add(t1, f_f(3))"));
+  EXPECT_NE(string::npos, out.find("return mypl::run(f_main);"));
+}
+
+TEST(CppEmitterTests, CompiledMatchesVM) {
+  if (system("g++ --version > /dev/null 2>&1") != 0)
+    GTEST_SKIP() << "no g++ to build the emitted C++";
+  // the (well typed) test programs are built as one executable (one
+  // compile instead of one per program), each in a namespace of its
+  // own with its main renamed, and run by number
+  string base = testing::TempDir() + "mypl_emit_test";
+  vector<const TestProgram*> programs;
+  ofstream all(base + ".cpp");
+  all << "#include \"mypl_runtime.h\"\n";
+  for (const TestProgram& program : BACKEND_PROGRAMS) {
+    if (!program.checked)
+      continue;
+    string file = base + "_" + to_string(programs.size()) + ".cpp";
+    ofstream(file) << emit_cpp(program.source);
+    all << "namespace p" << programs.size() << " {\n"
+        << "#define main program_main\n"
+        << "#include \"" << file << "\"\n"
+        << "#undef main\n"
+        << "}\n";
+    programs.push_back(&program);
+  }
+  all << "int main(int argc, char* argv[])\n{\n"
+      << "  int program = std::stoi(argv[1]);\n";
+  for (int i = 0; i < int(programs.size()); ++i)
+    all << "  if (program == " << i << ") return p" << i << "::program_main();\n";
+  all << "  return 1;\n}\n";
+  all.close();
+  string build = "g++ -std=c++20 -O2 -pthread -I " MYPL_SRC_DIR " " + base +
+    ".cpp -o " + base + " 2>&1";
+  ASSERT_EQ(0, system(build.c_str()));
+  for (int i = 0; i < int(programs.size()); ++i) {
+    string run = base + " " + to_string(i) + " > " + base + ".out 2> " +
+      base + ".err";
+    ASSERT_EQ(0, system(run.c_str())) << programs[i]->name;
+    stringstream out, err;
+    out << ifstream(base + ".out").rdbuf();
+    err << ifstream(base + ".err").rdbuf();
+    // the runtime ends its error message with a newline
+    string actual = out.str() + err.str();
+    if (err.str() != "")
+      actual.pop_back();
+    EXPECT_EQ(run_backend(*programs[i], false, 0), actual) << programs[i]->name;
+  }
+}
+
+//----------------------------------------------------------------------
+// Flat AST Tests
+//----------------------------------------------------------------------
+
+// a program using each kind of statement, expression, and path
+const string FLAT_PROGRAM = build_string({
+  "struct Node {int val, Node next, array Node kids, array int grid}",
+  "int count(Node n, int k) {",
+  "  int total = 0",
+  "  for (int i = 0; i < k; i = i + 1) {",
+  "    if (((i / 2) * 2) == i) {total = total + (i * 3) + n.val}",
+  "    elseif ((i > 10) and not (i == 12)) {total = total - 1}",
+  "    else {",
+  "      n.grid[i] = total",
+  "      n.kids[0].grid[i] = i",
+  "    }",
+  "  }",
+  "  while (not (total < 100)) {total = total / 2}",
+  "  return total",
+  "}",
+  "void main() {",
+  "  Node n = new Node",
+  "  n.val = 1",
+  "  n.grid = new int[20]",
+  "  n.kids = new Node[1]",
+  "  n.kids[0] = new Node",
+  "  n.kids[0].grid = new int[20]",
+  "  array int g = new int[2][3]",
+  "  g[1][2] = length(n.grid) + length(\"abc\")",
+  "  char c = get(0, concat(\"x\\n\", to_string('z')))",
+  "  if (c == 'x') {print(to_string(count(n, 20)))}",
+  "  count(n, 2)",
+  "  print(to_string(g[1][2] + n.kids[0].grid[1]))",
+  "}"
+});
+
+// helpers to print a tree and a flat program
+string print_tree(Program& p)
+{
+  stringstream out;
+  PrintVisitor printer(out);
+  p.accept(printer);
+  return out.str();
+}
+
+string print_flat(const FlatAST& ast)
+{
+  stringstream out;
+  PrintVisitor printer(out);
+  printer.print(ast);
+  return out.str();
+}
+
+TEST(FlatASTTests, ChildrenAreRanges) {
+  stringstream in (build_string({
+    "void main() {",
+    "  int x = 1",
+    "  while (x < 10) {x = x + 1}",
+    "  print(concat(to_string(x), to_string(x)))",
+    "}"
+  }));
+  Program p = ASTParser(Lexer(in)).parse();
+  FlatAST ast(p);
+  ASSERT_EQ(1, ast.fun_defs.size());
+  // the function's statements are next to each other
+  FlatRange body = ast.fun_defs[0].body;
+  ASSERT_EQ(3, body.size());
+  EXPECT_EQ(FlatStmtKind::VAR_DECL, ast.stmts[body.begin].kind);
+  EXPECT_EQ(FlatStmtKind::WHILE, ast.stmts[body.begin + 1].kind);
+  EXPECT_EQ(FlatStmtKind::CALL, ast.stmts[body.begin + 2].kind);
+  EXPECT_EQ(1, ast.stmts[body.begin + 1].body.size());
+  // as are a call's arguments
+  const FlatExpr& print = ast.exprs[ast.stmts[body.begin + 2].expr];
+  ASSERT_EQ(1, print.children.size());
+  const FlatExpr& concat = ast.exprs[print.children.begin];
+  EXPECT_EQ("concat", ast.lexeme(concat.token));
+  ASSERT_EQ(2, concat.children.size());
+  for (FlatIndex i = concat.children.begin; i < concat.children.end; ++i) {
+    EXPECT_EQ(FlatExprKind::CALL, ast.exprs[i].kind);
+    EXPECT_EQ("to_string", ast.lexeme(ast.exprs[i].token));
+  }
+  // each name is stored once
+  EXPECT_EQ(1, count(ast.names.begin(), ast.names.end(), "x"));
+  EXPECT_EQ(1, count(ast.names.begin(), ast.names.end(), "to_string"));
+}
+
+TEST(FlatASTTests, CheckAnnotatesTree) {
+  stringstream in(FLAT_PROGRAM);
+  Program p = ASTParser(Lexer(in)).parse();
+  FlatAST ast(p);
+  SemanticChecker flat_checker;
+  flat_checker.check(ast);
+  // checking the tree records the same operand types and call names in
+  // it as checking its flat encoding
+  SemanticChecker tree_checker;
+  p.accept(tree_checker);
+  FlatAST checked(p);
+  ASSERT_EQ(ast.exprs.size(), checked.exprs.size());
+  for (FlatIndex i = 0; i < ast.exprs.size(); ++i) {
+    EXPECT_EQ(ast.exprs[i].op_type, checked.exprs[i].op_type);
+    if (ast.exprs[i].kind == FlatExprKind::CALL)
+      EXPECT_EQ(ast.lexeme(ast.exprs[i].token),
+                checked.lexeme(checked.exprs[i].token));
+  }
+  EXPECT_NE(string::npos, print_tree(p).find("length@array("));
+}
+
+TEST(FlatASTTests, CodeMatchesTree) {
+  stringstream in(FLAT_PROGRAM);
+  Program p = ASTParser(Lexer(in)).parse();
+  FlatAST ast(p);
+  SemanticChecker tree_checker;
+  p.accept(tree_checker);
+  SemanticChecker flat_checker;
+  flat_checker.check(ast);
+  // the checker records array lengths and operand types in both forms
+  EXPECT_EQ(1, count(ast.names.begin(), ast.names.end(), "length@array"));
+  for (int level : {0, 2}) {
+    VM tree_vm;
+    CodeGenerator tree_generator(tree_vm, level);
+    p.accept(tree_generator);
+    VM flat_vm;
+    CodeGenerator flat_generator(flat_vm, level);
+    flat_generator.generate(ast);
+    EXPECT_EQ(to_string(tree_vm), to_string(flat_vm));
+    EXPECT_NE(string::npos, to_string(flat_vm).find("ALEN"));
+    EXPECT_NE(string::npos, to_string(flat_vm).find("IADD"));
+    stringstream out;
+    change_cout(out);
+    flat_vm.run();
+    restore_cout();
+    EXPECT_EQ("6824", out.str());
+  }
+}
+
+TEST(FlatASTTests, NodesVisitedOnTheirOwn) {
+  stringstream in(FLAT_PROGRAM);
+  Program p = ASTParser(Lexer(in)).parse();
+  SemanticChecker checker;
+  p.accept(checker);
+  // checking each function on its own records the same operand types
+  // and call names as checking the program
+  stringstream in_2(FLAT_PROGRAM);
+  Program q = ASTParser(Lexer(in_2)).parse();
+  for (FunDef& f : q.fun_defs)
+    f.accept(checker);
+  EXPECT_EQ(print_tree(p), print_tree(q));
+  FlatAST checked(p);
+  FlatAST checked_alone(q);
+  ASSERT_EQ(checked.exprs.size(), checked_alone.exprs.size());
+  for (FlatIndex i = 0; i < checked.exprs.size(); ++i) {
+    EXPECT_EQ(checked.exprs[i].op_type, checked_alone.exprs[i].op_type);
+  }
+  // printing each node prints it as part of the program
+  stringstream out;
+  PrintVisitor printer(out);
+  q.struct_defs[0].accept(printer);
+  for (FunDef& f : q.fun_defs)
+    f.accept(printer);
+  EXPECT_EQ(print_tree(p), out.str());
+  out.str("");
+  q.fun_defs[1].stmts[7]->accept(printer);
+  EXPECT_EQ("g[1][2] = length@array(n.grid) + length(\"abc\")", out.str());
+  out.str("");
+  q.fun_defs[0].stmts[3]->accept(printer);
+  EXPECT_EQ("return total", out.str());
+  // and generating each struct and function generates the program
+  VM program_vm;
+  CodeGenerator program_generator(program_vm, 2);
+  p.accept(program_generator);
+  VM vm;
+  CodeGenerator generator(vm, 2);
+  q.struct_defs[0].accept(generator);
+  for (FunDef& f : q.fun_defs)
+    f.accept(generator);
+  vm.link();
+  EXPECT_EQ(to_string(program_vm), to_string(vm));
+  stringstream output;
+  change_cout(output);
+  vm.run();
+  restore_cout();
+  EXPECT_EQ("6824", output.str());
+}
+
+TEST(FlatASTTests, VisitorAdapter) {
+  stringstream in (build_string({
+    "void main() {",
+    "  int x = 1 + 2",
+    "  print(to_string(x * 4))",
+    "}"
+  }));
+  Program p = ASTParser(Lexer(in)).parse();
+  FlatAST ast(p);
+  // the tree form of a flat program is the same program
+  Program tree = ast.to_program();
+  EXPECT_EQ(print_tree(p), print_tree(tree));
+  // and rewrites made by a visitor are kept
+  SemanticChecker checker;
+  ast.accept(checker);
+  ConstantFolder folder;
+  ast.accept(folder);
+  EXPECT_NE(string::npos, print_flat(ast).find("print(\"12\")"));
+  VM vm;
+  CodeGenerator generator(vm);
+  generator.generate(ast);
+  stringstream out;
+  change_cout(out);
+  vm.run();
+  restore_cout();
+  EXPECT_EQ("12", out.str());
+}
+
+//----------------------------------------------------------------------
+// Print Visitor Tests
+//----------------------------------------------------------------------
+
+TEST(PrintVisitorTests, LastParamFieldAndArgPrintedOnce) {
+  stringstream in(build_string({
+    "struct P {",
+    "  int x,",
+    "  int y",
+    "}",
+    "int f(int a, int b) {",
+    "  return a + b",
+    "}",
+    "void main() {",
+    "  int z = f(1, 2)",
+    "}"
+  }));
+  Program p = ASTParser(Lexer(in)).parse();
+  string printed = print_tree(p);
+  EXPECT_EQ(build_string({
+    "struct P {",
+    "  int x,",
+    "  int y",
+    "}",
+    "",
+    "int f(int a, int b) {",
+    "  return a + b",
+    "}",
+    "",
+    "void main() {",
+    "  int z = f(1, 2)",
+    "}",
+    ""}), printed);
+  // (the last one used to be printed twice)
+  EXPECT_EQ(string::npos, printed.find("int y,\n  int y"));
+  EXPECT_EQ(string::npos, printed.find("int f(int a, int b, int b)"));
+  EXPECT_EQ(string::npos, printed.find("f(1, 2, 2)"));
+}
+
+TEST(PrintVisitorTests, PrintedProgramReparses) {
+  stringstream in(FLAT_PROGRAM);
+  Program p = ASTParser(Lexer(in)).parse();
+  string printed = print_tree(p);
+  // the printed program is the same program
+  stringstream reparsed_in(printed);
+  Program reparsed = ASTParser(Lexer(reparsed_in)).parse();
+  EXPECT_EQ(printed, print_tree(reparsed));
+  // (the update used to be printed as the init, a path's dots were
+  // misplaced, and not and a char's quotes were dropped)
+  EXPECT_NE(string::npos, printed.find(
+    "for (int i = 0; i < k; i = i + 1) {"));
+  EXPECT_NE(string::npos, printed.find("n.kids[0].grid[i] = i"));
+  EXPECT_NE(string::npos, printed.find("while (not (total < 100)) {"));
+  EXPECT_NE(string::npos, printed.find("(c == 'x')"));
+}
+
+TEST(PrintVisitorTests, CallWithoutArguments) {
+  stringstream in(build_string({
+    "void main() {",
+    "  string s = input()",
+    "}"
+  }));
+  Program p = ASTParser(Lexer(in)).parse();
+  EXPECT_NE(string::npos, print_tree(p).find("string s = input()\n"));
+}
+
 //----------------------------------------------------------------------
 // main
 //----------------------------------------------------------------------